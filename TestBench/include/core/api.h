@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+
+#include "core/request_arena.h"
+#include "core/response_writer.h"
+#include "hal/http.h"
+
+/*
+ * Platform-independent API handlers for the bench's core routes.
+ *
+ * The handlers only see an HttpExchange, the charge control module and the
+ * HAL, so they behave identically on the ESP32 and in the native build.
+ * Platform specifics (device name, extra health fields, reasons to refuse a
+ * charge) are plugged in through ApiPlatform.
+ */
+
+struct ApiPlatform {
+  const char* device;  // Reported by /health, e.g. "ESP32"
+
+  // Adds extra members to the /health object. Optional.
+  void (*appendHealth)(ResponseWriter& response);
+
+  // Returns a message if a charge must not start right now (answered with 409),
+  // or nullptr. Optional.
+  const char* (*chargeInterlock)();
+
+  // OpenAPI document served by /swagger.json, e.g. one that adds platform
+  // routes. Optional; defaults to swaggerJson.
+  const char* openApiJson;
+};
+
+void apiBegin(const ApiPlatform& platform);
+
+// OpenAPI 3.0 specification of the core routes and the Swagger UI page (api_spec.cpp).
+extern const char* swaggerJson;
+extern const char* swaggerHtml;
+
+/**
+ * @brief Why a charge cannot start right now (answered 409), or nullptr. The
+ * checks /charge makes before its arguments, shared with the UDP control
+ * protocol (core/udp_control.h).
+ */
+const char* apiChargeConflict();
+
+// Longest and default wait of a /state long poll (ms).
+const long STATE_WAIT_MAX_MS = 30000;
+const long STATE_WAIT_DEFAULT_MS = 10000;
+
+/**
+ * @brief Ends cycles, the sweep and the charge, as /stop does.
+ * @return true if a charge was running.
+ */
+bool apiStop();
+
+void handleSwaggerJson(HttpExchange& http);
+void handleSwaggerUi(HttpExchange& http);
+void handleRoot(HttpExchange& http);
+void handleCharge(HttpExchange& http);
+void handleState(HttpExchange& http);
+void handleStop(HttpExchange& http);
+void handleEstop(HttpExchange& http);
+void handleCycle(HttpExchange& http);
+void handleStats(HttpExchange& http);
+void handleStatsReset(HttpExchange& http);
+void handleHoldup(HttpExchange& http);
+void handleHoldupReset(HttpExchange& http);
+void handleSweeps(HttpExchange& http);
+void handleSweepResults(HttpExchange& http);
+void handleSweepStop(HttpExchange& http);
+void handleHealth(HttpExchange& http);
+void handleSystemArena(HttpExchange& http);
+void handleInfo(HttpExchange& http);
+void handleNotFound(HttpExchange& http);
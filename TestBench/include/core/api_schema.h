@@ -0,0 +1,418 @@
+#pragma once
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/http.h"
+
+/*
+ * Declarative API description.
+ *
+ * Every route is described once, as constexpr data: path, method, handler,
+ * documentation, query parameters with their types and limits, and responses.
+ * The same description is
+ *
+ *   - the dispatch table both servers register (ApiRoute tables),
+ *   - the argument checks the handlers run (apiParseArgs()), and
+ *   - the OpenAPI document, rendered to a minified string by the compiler
+ *     (openApiRender()), so the published limits are the enforced ones.
+ *
+ * Descriptions are built with chained constexpr calls, e.g.
+ *
+ *   apiInteger("time", CHARGE_MIN_MS, CHARGE_MAX_MS).inUnit("ms").required()
+ *   apiRoute("/stop", HTTP_METHOD_POST, handleStop).doc("Control", "Emergency Stop")
+ *       .respond(200, "Charge stopped or confirmed idle.")
+ */
+
+// --- 1. DESCRIPTION ---
+
+enum ApiParamType {
+  API_PARAM_INTEGER,
+  API_PARAM_BOOLEAN,  // true/false (or 1/0)
+  API_PARAM_ENUM      // One of a list of names; parsed to its index
+};
+
+// Most parameters a route can take, and most documented responses per route.
+const size_t API_MAX_PARAMS = 8;
+const size_t API_MAX_RESPONSES = 4;
+
+struct ApiParam {
+  const char* name;
+  ApiParamType type;
+  bool isRequired;
+  long minimum;               // LONG_MIN: no lower limit
+  long maximum;               // LONG_MAX: no upper limit
+  bool hasDefault;
+  long defaultValue;
+  const char* unit;           // Appended to range errors, e.g. "ms"; nullptr for none
+  const char* const* choices; // API_PARAM_ENUM names
+  uint8_t choiceCount;
+  const char* description;    // nullptr for none
+
+  constexpr ApiParam required() const {
+    ApiParam param = *this;
+    param.isRequired = true;
+    return param;
+  }
+  constexpr ApiParam defaultsTo(long value) const {
+    ApiParam param = *this;
+    param.hasDefault = true;
+    param.defaultValue = value;
+    return param;
+  }
+  constexpr ApiParam inUnit(const char* text) const {
+    ApiParam param = *this;
+    param.unit = text;
+    return param;
+  }
+  constexpr ApiParam describedAs(const char* text) const {
+    ApiParam param = *this;
+    param.description = text;
+    return param;
+  }
+};
+
+constexpr ApiParam apiInteger(const char* name, long minimum, long maximum = LONG_MAX) {
+  return ApiParam{name, API_PARAM_INTEGER, false, minimum, maximum, false, 0, nullptr, nullptr, 0, nullptr};
+}
+
+constexpr ApiParam apiBoolean(const char* name) {
+  return ApiParam{name, API_PARAM_BOOLEAN, false, 0, 1, false, 0, nullptr, nullptr, 0, nullptr};
+}
+
+template <size_t N>
+constexpr ApiParam apiEnum(const char* name, const char* const (&choices)[N]) {
+  return ApiParam{name, API_PARAM_ENUM, false, 0, (long)N - 1, false, 0, nullptr, choices, (uint8_t)N, nullptr};
+}
+
+struct ApiResponse {
+  int status;
+  const char* description;
+  const char* example;  // Raw JSON, or nullptr
+};
+
+struct ApiRoute {
+  const char* uri;
+  HttpMethod method;
+  void (*handler)(HttpExchange& http);
+
+  // Documentation; routes without a tag (the Swagger UI itself) are left out.
+  const char* tag;
+  const char* summary;
+  const char* description;
+  const ApiParam* params;
+  size_t paramCount;
+  ApiResponse responses[API_MAX_RESPONSES];
+  size_t responseCount;
+
+  constexpr ApiRoute doc(const char* tagName, const char* summaryText, const char* descriptionText = nullptr) const {
+    ApiRoute route = *this;
+    route.tag = tagName;
+    route.summary = summaryText;
+    route.description = descriptionText;
+    return route;
+  }
+  template <size_t N>
+  constexpr ApiRoute withParams(const ApiParam (&list)[N]) const {
+    static_assert(N <= API_MAX_PARAMS, "Raise API_MAX_PARAMS");
+    ApiRoute route = *this;
+    route.params = list;
+    route.paramCount = N;
+    return route;
+  }
+  // More than API_MAX_RESPONSES responses fail to compile (out-of-bounds write).
+  constexpr ApiRoute respond(int status, const char* descriptionText, const char* example = nullptr) const {
+    ApiRoute route = *this;
+    route.responses[route.responseCount++] = ApiResponse{status, descriptionText, example};
+    return route;
+  }
+};
+
+constexpr ApiRoute apiRoute(const char* uri, HttpMethod method, void (*handler)(HttpExchange& http)) {
+  return ApiRoute{uri, method, handler, nullptr, nullptr, nullptr, nullptr, 0, {}, 0};
+}
+
+struct ApiRouteTable {
+  const ApiRoute* routes;
+  size_t count;
+};
+
+struct ApiInfo {
+  const char* title;
+  const char* version;
+  const char* description;
+  const char* contactUrl;
+  const char* serverDescription;
+};
+
+// --- 2. ARGUMENTS ---
+
+struct ApiArgs {
+  const ApiParam* params;
+  size_t count;
+  bool present[API_MAX_PARAMS];
+  long values[API_MAX_PARAMS];  // Integer, 0/1, or the index of an enum choice
+
+  bool has(const char* name) const;
+
+  /**
+   * @brief The parsed argument, or the parameter's default (0 without one).
+   */
+  long value(const char* name) const;
+};
+
+/**
+ * @brief Parses the request's arguments against a parameter list: required
+ * parameters present, integers well-formed and within their limits, enums and
+ * booleans one of their names. Answers 400 naming the first offending
+ * parameter and its limits.
+ * @return false if the request was answered.
+ */
+bool apiParseArgs(HttpExchange& http, const ApiParam* params, size_t count, ApiArgs& args);
+
+template <size_t N>
+bool apiParseArgs(HttpExchange& http, const ApiParam (&params)[N], ApiArgs& args) {
+  static_assert(N <= API_MAX_PARAMS, "Raise API_MAX_PARAMS");
+  return apiParseArgs(http, params, N, args);
+}
+
+// --- 3. OPENAPI ---
+
+/**
+ * @brief Minified JSON writer usable in constant expressions. With a null
+ * buffer it only counts, which sizes the buffer for the second pass.
+ */
+class ApiJsonWriter {
+public:
+  constexpr explicit ApiJsonWriter(char* buffer) : out(buffer), length(0) {}
+
+  constexpr size_t size() const { return length; }
+
+  constexpr void raw(const char* text) {
+    while (*text) put(*text++);
+  }
+
+  constexpr void string(const char* text) {
+    put('"');
+    for (; *text; text++) {
+      if (*text == '"' || *text == '\\') {
+        put('\\');
+      } else if (*text == '\n') {
+        put('\\');
+        put('n');
+        continue;
+      }
+      put(*text);
+    }
+    put('"');
+  }
+
+  constexpr void number(long value) {
+    if (value < 0) {
+      put('-');
+    }
+    unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+    char digits[20] = {};
+    int count = 0;
+    do {
+      digits[count++] = (char)('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude > 0);
+    while (count > 0) put(digits[--count]);
+  }
+
+  constexpr void key(const char* name) {
+    string(name);
+    put(':');
+  }
+
+private:
+  constexpr void put(char c) {
+    if (out) out[length] = c;
+    length++;
+  }
+
+  char* out;
+  size_t length;
+};
+
+constexpr bool apiSameText(const char* a, const char* b) {
+  while (*a && *a == *b) {
+    a++;
+    b++;
+  }
+  return *a == *b;
+}
+
+struct ApiRouteList {
+  const ApiRouteTable* tables;
+  size_t tableCount;
+
+  constexpr size_t size() const {
+    size_t total = 0;
+    for (size_t t = 0; t < tableCount; t++) total += tables[t].count;
+    return total;
+  }
+  constexpr const ApiRoute& at(size_t index) const {
+    size_t t = 0;
+    while (index >= tables[t].count) index -= tables[t++].count;
+    return tables[t].routes[index];
+  }
+};
+
+constexpr void openApiWriteParam(ApiJsonWriter& json, const ApiParam& param) {
+  json.raw("{\"name\":");
+  json.string(param.name);
+  json.raw(",\"in\":\"query\",\"required\":");
+  json.raw(param.isRequired ? "true" : "false");
+  json.raw(",\"schema\":{");
+  if (param.type == API_PARAM_INTEGER) {
+    json.raw("\"type\":\"integer\",\"format\":\"int32\"");
+    if (param.minimum != LONG_MIN) {
+      json.raw(",\"minimum\":");
+      json.number(param.minimum);
+    }
+    if (param.maximum != LONG_MAX) {
+      json.raw(",\"maximum\":");
+      json.number(param.maximum);
+    }
+    if (param.hasDefault) {
+      json.raw(",\"default\":");
+      json.number(param.defaultValue);
+    }
+  } else if (param.type == API_PARAM_BOOLEAN) {
+    json.raw("\"type\":\"boolean\"");
+    if (param.hasDefault) {
+      json.raw(param.defaultValue ? ",\"default\":true" : ",\"default\":false");
+    }
+  } else {
+    json.raw("\"type\":\"string\",\"enum\":[");
+    for (uint8_t i = 0; i < param.choiceCount; i++) {
+      if (i > 0) json.raw(",");
+      json.string(param.choices[i]);
+    }
+    json.raw("]");
+    if (param.hasDefault) {
+      json.raw(",\"default\":");
+      json.string(param.choices[param.defaultValue]);
+    }
+  }
+  json.raw("}");
+  if (param.description) {
+    json.raw(",\"description\":");
+    json.string(param.description);
+  }
+  json.raw("}");
+}
+
+constexpr void openApiWriteOperation(ApiJsonWriter& json, const ApiRoute& route) {
+  json.key(route.method == HTTP_METHOD_POST ? "post" : "get");
+  json.raw("{\"tags\":[");
+  json.string(route.tag);
+  json.raw("],\"summary\":");
+  json.string(route.summary);
+  if (route.description) {
+    json.raw(",\"description\":");
+    json.string(route.description);
+  }
+  if (route.paramCount > 0) {
+    json.raw(",\"parameters\":[");
+    for (size_t i = 0; i < route.paramCount; i++) {
+      if (i > 0) json.raw(",");
+      openApiWriteParam(json, route.params[i]);
+    }
+    json.raw("]");
+  }
+  json.raw(",\"responses\":{");
+  for (size_t i = 0; i < route.responseCount; i++) {
+    const ApiResponse& response = route.responses[i];
+    if (i > 0) json.raw(",");
+    json.raw("\"");
+    json.number(response.status);
+    json.raw("\":{\"description\":");
+    json.string(response.description);
+    if (response.example) {
+      json.raw(",\"content\":{\"application/json\":{\"example\":");
+      json.raw(response.example);
+      json.raw("}}");
+    }
+    json.raw("}");
+  }
+  json.raw("}}");
+}
+
+/**
+ * @brief Writes the OpenAPI 3.0 document of the documented routes. Methods of
+ * one path are grouped under it, in table order.
+ */
+constexpr void openApiWrite(ApiJsonWriter& json, const ApiInfo& info, const ApiRouteList& routes) {
+  json.raw("{\"openapi\":\"3.0.0\",\"info\":{\"title\":");
+  json.string(info.title);
+  json.raw(",\"version\":");
+  json.string(info.version);
+  json.raw(",\"description\":");
+  json.string(info.description);
+  json.raw(",\"contact\":{\"url\":");
+  json.string(info.contactUrl);
+  json.raw("}},\"servers\":[{\"url\":\"/\",\"description\":");
+  json.string(info.serverDescription);
+  json.raw("}],\"paths\":{");
+
+  bool firstPath = true;
+  size_t count = routes.size();
+  for (size_t i = 0; i < count; i++) {
+    const ApiRoute& route = routes.at(i);
+    bool seen = false;
+    for (size_t j = 0; j < i && !seen; j++) {
+      seen = routes.at(j).tag && apiSameText(routes.at(j).uri, route.uri);
+    }
+    if (!route.tag || seen) {
+      continue;
+    }
+    if (!firstPath) json.raw(",");
+    firstPath = false;
+    json.key(route.uri);
+    json.raw("{");
+    bool firstMethod = true;
+    for (size_t j = i; j < count; j++) {
+      const ApiRoute& method = routes.at(j);
+      if (!method.tag || !apiSameText(method.uri, route.uri)) {
+        continue;
+      }
+      if (!firstMethod) json.raw(",");
+      firstMethod = false;
+      openApiWriteOperation(json, method);
+    }
+    json.raw("}");
+  }
+  json.raw("}}");
+}
+
+template <size_t N>
+struct OpenApiDocument {
+  char text[N];
+};
+
+/**
+ * @brief Buffer size of the document, including the terminator.
+ */
+constexpr size_t openApiSize(const ApiInfo& info, const ApiRouteList& routes) {
+  ApiJsonWriter json(nullptr);
+  openApiWrite(json, info, routes);
+  return json.size() + 1;
+}
+
+/**
+ * @brief Renders the document; assign to a constexpr variable so it is built
+ * by the compiler and stored in flash:
+ *
+ *   constexpr auto DOC = openApiRender<openApiSize(INFO, ROUTES)>(INFO, ROUTES);
+ */
+template <size_t N>
+constexpr OpenApiDocument<N> openApiRender(const ApiInfo& info, const ApiRouteList& routes) {
+  OpenApiDocument<N> document{};
+  ApiJsonWriter json(document.text);
+  openApiWrite(json, info, routes);
+  return document;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Non-blocking charge cycle control.
+ *
+ * Platform independent: all timing goes through halMillis() and the pin through
+ * halDigitalWrite(), so the same logic runs on the ESP32 and against the
+ * simulated clock and GPIO of the native build.
+ *
+ * A cycle either runs for a fixed duration, or charges to a target voltage:
+ * the HAL sampler then converts the sense input every CHARGE_SAMPLE_PERIOD_US
+ * outside loop() and drives the pin LOW from the sampler context as soon as a
+ * reading reaches the target. The cutoff latency is therefore bounded by one
+ * sample period plus one conversion, whatever loop() is doing. The duration
+ * is kept as a safety timeout.
+ */
+
+// Accepted charge durations (ms).
+const long CHARGE_MIN_MS = 100;
+const long CHARGE_MAX_MS = 60000;
+
+// Safety timeout for a charge to a target voltage when none is given (ms).
+const long CHARGE_TARGET_DEFAULT_TIMEOUT_MS = 5000;
+
+// Sense input sampling period while charging to a target voltage (4 kHz).
+const uint32_t CHARGE_SAMPLE_PERIOD_US = 250;
+
+// Sense readings kept from the last charge to a target: 1 s at the default
+// sample period, 8 KiB.
+const size_t CHARGE_CAPTURE_SAMPLES = 4096;
+
+// Usable ADC input range at the pin (ESP32 at 11 dB attenuation), in mV.
+const long SENSE_FULL_SCALE_MV = 3100;
+
+// Break-before-make gap between the charge and discharge outputs, long enough
+// for a relay on either output to release before the other one closes.
+const uint32_t CHARGE_DEAD_TIME_US = 10000;
+
+enum ChargeStartResult {
+  CHARGE_STARTED,
+  CHARGE_BUSY,              // A cycle is running, or the discharge output is on or within its dead time
+  CHARGE_INVALID_DURATION,  // Outside CHARGE_MIN_MS..CHARGE_MAX_MS
+  CHARGE_INVALID_TARGET,    // Outside 1..chargeMaxTargetMv()
+  CHARGE_NO_SENSE           // No sense input configured, or the sampler failed
+};
+
+enum ChargeEndReason {
+  CHARGE_END_NONE,      // No cycle has finished yet
+  CHARGE_END_DURATION,  // A fixed-duration cycle ran its time
+  CHARGE_END_TARGET,    // The sensed voltage reached the target
+  CHARGE_END_TIMEOUT,   // The target was not reached within the duration
+  CHARGE_END_STOPPED    // chargeStop()
+};
+
+// Outcome of the most recent cycle. Voltages are capacitor millivolts (the
+// ADC reading times the sense scale).
+struct ChargeResult {
+  ChargeEndReason reason;
+  uint32_t targetMv;    // 0 for fixed-duration cycles
+  uint32_t cutoffMv;    // Reading that reached the target
+  uint32_t samples;     // Sense readings taken during the cycle
+  uint32_t endMv;       // Sense reading when the pin went LOW (the cutoff reading for a target); 0 without sense
+  uint32_t chargeUs;    // Pin HIGH to pin LOW, from halMicros()
+  uint64_t endUs;       // halMicros() when the pin went LOW
+  uint32_t latencyUs;   // Last reading below the target to pin LOW: an upper bound on the cutoff latency
+  uint32_t reactionUs;  // Start of the reading that crossed to pin LOW (conversion and dispatch)
+};
+
+/**
+ * @brief Configures the charge pin as an output and drives it LOW.
+ */
+void chargeBegin(int pin);
+
+/**
+ * @brief Configures the sense input used by chargeStartToTarget().
+ * @param mvScale Capacitor voltage per volt at the ADC pin (the divider ratio, 1.0 without one).
+ */
+void chargeSetSense(int sensePin, uint32_t samplePeriodUs, float mvScale);
+
+/**
+ * @brief Configures an optional discharge output (-1 for none) and drives it LOW.
+ */
+void chargeSetDischargePin(int dischargePin);
+
+/**
+ * @brief Optional callback invoked whenever a cycle starts (true) or ends (false).
+ */
+void chargeSetActiveCallback(void (*callback)(bool active));
+
+/**
+ * @brief Validates the duration and starts a cycle: the pin goes HIGH immediately.
+ */
+ChargeStartResult chargeStart(long durationMs);
+
+/**
+ * @brief Starts a cycle that ends when the sensed voltage reaches targetMv,
+ * or after timeoutMs (same range as chargeStart()) at the latest.
+ */
+ChargeStartResult chargeStartToTarget(long targetMv, long timeoutMs);
+
+/**
+ * @brief Drives the pin LOW and ends any running cycle.
+ * @return true if a cycle was running.
+ */
+bool chargeStop();
+
+/**
+ * @brief Drives the pin LOW from any context (an interrupt, another task) and
+ * holds off new cycles until chargeStop() has ended the running one. The
+ * emergency stop's fast path (core/emergency_stop.h).
+ */
+void chargeEmergencyStop();
+
+/**
+ * @brief Ends the cycle once its duration has elapsed. Call as often as possible.
+ * Safe across the 49.7-day wrap of halMillis().
+ * @return true if a cycle completed in this call.
+ */
+bool chargeMonitor();
+
+bool chargeActive();
+
+/**
+ * @brief Counts the starts and ends of cycles, whatever started or ended them,
+ * so a client can wait for the next change (/state?since_version).
+ */
+uint32_t chargeStateVersion();
+
+int chargePin();
+uint32_t chargeDurationMs();
+
+// Target of the running cycle in mV, 0 for a fixed-duration cycle.
+uint32_t chargeTargetMv();
+
+// Latest sense reading of the running cycle, in capacitor mV.
+uint32_t chargeSenseMv();
+
+long chargeMaxTargetMv();
+uint32_t chargeSamplePeriodUs();
+const ChargeResult& chargeLastResult();
+const char* chargeEndReasonName(ChargeEndReason reason);
+
+// Worst cutoff latency (ChargeResult::latencyUs) since boot.
+uint32_t chargeMaxLatencyUs();
+
+/**
+ * @brief The sense readings (capacitor mV, chargeSamplePeriodUs() apart) of
+ * the last charge to a target, up to the cutoff and at most
+ * CHARGE_CAPTURE_SAMPLES. Grows while that charge runs.
+ */
+size_t chargeCaptureCount();
+uint16_t chargeCaptureSample(size_t index);
+
+/**
+ * @brief One conversion of the sense input, in capacitor mV (0 without a sense input).
+ */
+uint32_t chargeReadSenseMv();
+bool chargeHasSense();
+
+/**
+ * @brief Turns the discharge output on. Break-before-make: refused while a
+ * charge cycle runs, while the charge pin is HIGH, or within
+ * CHARGE_DEAD_TIME_US of the charge pin going LOW.
+ * @return true if the output is on.
+ */
+bool dischargeOn();
+void dischargeOff();
+bool dischargeActive();
+int dischargePin();
+
+/**
+ * @brief Time left in the running cycle, 0 when idle or already due.
+ */
+uint32_t chargeRemainingMs();
+
+/**
+ * @brief Actual pin level, which may differ from the cycle state if the pin
+ * was driven externally.
+ */
+bool chargePinHigh();
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Automatic charge/discharge cycles.
+ *
+ * A cycle charges the capacitor (for a fixed time, or to a target voltage),
+ * holds it, then discharges it until the sense input reads below a threshold:
+ *
+ *   | charge | hold | dead time | discharge | dead time | charge | ...
+ *
+ * With a discharge output configured (chargeSetDischargePin()) the discharge
+ * is active; without one the cycle waits for the capacitor to bleed down on
+ * its own. As soon as the threshold is reached the next queued cycle starts,
+ * separated only by the break-before-make dead time (CHARGE_DEAD_TIME_US).
+ *
+ * Requests are queued as batches of identical cycles and run in order.
+ */
+
+struct CycleDefinition {
+  uint32_t chargeMs;            // Charge duration, or the safety timeout with targetMv
+  uint32_t targetMv;            // Charge to this voltage; 0 for a fixed duration
+  uint32_t holdMs;              // Wait between the end of the charge and the discharge
+  uint32_t dischargeMv;         // Discharge until the sense input reads below this
+  uint32_t dischargeTimeoutMs;  // Give up on the discharge after this long
+  uint16_t count;               // Cycles in this batch
+};
+
+enum CyclePhase {
+  CYCLE_IDLE,         // Nothing queued
+  CYCLE_WAITING,      // Waiting for the dead time before the next charge
+  CYCLE_CHARGING,
+  CYCLE_HOLDING,
+  CYCLE_DISCHARGING
+};
+
+struct CycleStatus {
+  CyclePhase phase;
+  uint32_t queued;             // Cycles left, including the running one
+  uint8_t batches;             // Batches in the queue
+  uint32_t completed;          // Cycles completed since the queue last started
+  uint32_t dischargeTimeouts;  // Discharges that ended on their timeout
+  uint32_t lastCycleMs;        // Charge start to the end of the discharge
+  uint32_t lastDischargeMs;    // Duration of the last discharge phase
+  uint32_t runMs;              // Queue start to the last completion (or now while running)
+  float cyclesPerMinute;       // completed / runMs
+};
+
+// Batches that can be queued at once.
+const uint8_t CYCLE_QUEUE_CAPACITY = 8;
+
+// Accepted hold (ms), discharge timeout (ms) and cycles per batch.
+const uint32_t CYCLE_MAX_HOLD_MS = 60000;
+const uint32_t CYCLE_MIN_DISCHARGE_TIMEOUT_MS = 100;
+const uint32_t CYCLE_MAX_DISCHARGE_TIMEOUT_MS = 600000;
+const uint32_t CYCLE_DEFAULT_DISCHARGE_TIMEOUT_MS = 10000;
+const uint16_t CYCLE_MAX_COUNT = 1000;
+
+/**
+ * @brief Validates a batch and appends it to the queue.
+ * @return nullptr on success, otherwise a message describing the problem,
+ * valid until the next call.
+ */
+const char* cycleEnqueue(const CycleDefinition& definition);
+
+/**
+ * @brief Clears the queue, ends the running phase and turns the discharge
+ * output off. The charge pin is left to chargeStop().
+ */
+void cycleStop();
+
+/**
+ * @brief Advances the running cycle. Call from loop() after chargeMonitor().
+ * @return true if a cycle completed in this call.
+ */
+bool cycleService();
+
+bool cycleActive();
+CycleStatus cycleStatus();
+const char* cyclePhaseName(CyclePhase phase);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "core/online_stats.h"
+
+/*
+ * Per-cycle statistics across runs.
+ *
+ * Every completed charge (not an emergency stop) records its pulse width and
+ * its end voltage from chargeMonitor(), and every relay hold-up measurement
+ * its duration from holdupService(). Each metric keeps Welford statistics and
+ * P-square estimates of the median and the 95th percentile, in the same
+ * constant memory however many cycles run. statsReset() starts a new
+ * experiment.
+ */
+
+enum StatsMetricId {
+  STATS_PULSE_WIDTH_US,  // Charge pin HIGH time
+  STATS_HOLDUP_US,       // Relay hold-up after the charge pin went LOW
+  STATS_END_MV,          // Sense reading at the end of the charge
+  STATS_METRIC_COUNT
+};
+
+struct StatsMetric {
+  RunningStats running;
+  P2Quantile p50;
+  P2Quantile p95;
+};
+
+/**
+ * @brief Clears every metric and restarts the experiment clock.
+ */
+void statsReset();
+
+void statsRecord(StatsMetricId id, double value);
+const StatsMetric& statsMetric(StatsMetricId id);
+const char* statsMetricName(StatsMetricId id);
+
+// Time since the last statsReset() (or boot), in ms.
+uint32_t statsSinceResetMs();
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Emergency stop outside the HTTP queue.
+ *
+ * POST /stop waits its turn in handleClient() behind whatever request is being
+ * served. The stop button (an edge interrupt) and the UDP stop port (a
+ * high-priority task on the ESP32) instead call estopTrigger() where the stop
+ * arrives. It drives CHARGE_PIN LOW on the spot and latches: no charge starts
+ * until estopService() has ended the cycles, the sweep and the charge from
+ * loop(), as /stop does.
+ *
+ * Each source records the time from the stop's arrival (the button edge, the
+ * datagram returned by recvfrom()) to the pin write.
+ *
+ * UDP: a datagram starting with "STOP" triggers the stop and is answered
+ * "STOPPED <latency_us>". Anything else is ignored.
+ */
+
+enum EstopSource {
+  ESTOP_BUTTON,
+  ESTOP_UDP,
+  ESTOP_SOURCE_COUNT
+};
+
+struct EstopLatency {
+  uint32_t count;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint32_t totalUs;  // For the mean
+};
+
+// Button edges within this time of a press are contact bounce (us).
+const uint32_t ESTOP_DEBOUNCE_US = 50000;
+
+/**
+ * @brief Drives the charge pin LOW and latches the stop. Safe from any context.
+ * @param arrivalUs halMicros() when the stop arrived.
+ */
+void estopTrigger(EstopSource source, uint64_t arrivalUs);
+
+/**
+ * @brief Finishes a triggered stop: stops cycles, the sweep and the charge,
+ * and releases the latch. Call from loop() before the charge and cycle services.
+ * @return true if a stop was finished.
+ */
+bool estopService();
+
+/**
+ * @brief Configures a push button to GND (internal pull-up) as a stop input.
+ * @return false if the interrupt cannot be attached.
+ */
+bool estopButtonBegin(int pin);
+
+/**
+ * @brief Opens the UDP stop port (0 picks a free one).
+ * @param blocking true for a task that waits in estopUdpReceive(), false to poll it.
+ * @return The socket, or -1.
+ */
+int estopUdpOpen(uint16_t port, bool blocking);
+
+/**
+ * @brief Handles one datagram from the stop port (waits for it on a blocking socket).
+ * @return false if there was none, or on a socket error.
+ */
+bool estopUdpReceive(int fd);
+
+bool estopLatched();
+int estopButtonPin();
+uint16_t estopUdpPort();
+const EstopLatency& estopLatency(EstopSource source);
+const char* estopSourceName(EstopSource source);
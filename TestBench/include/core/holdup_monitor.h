@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Relay hold-up measurement.
+ *
+ * The hold-up time is how long the capacitor keeps the relay closed after
+ * CHARGE_PIN goes LOW. A digital input wired to the relay contact (a switch
+ * to GND on a pulled-up input: closed reads LOW) and the charge pin itself
+ * are both timestamped by edge interrupt, so the measurement has microsecond
+ * resolution whatever loop() is doing:
+ *
+ *   CHARGE_PIN  ‾‾‾‾‾‾‾‾‾‾\________________________________
+ *   contact     ‾‾‾‾\______________________________/‾‾‾‾‾‾‾  (closed = LOW)
+ *                         |<------- hold-up ------>|
+ *
+ * A falling charge edge arms the measurement and the next contact opening
+ * completes it. It ends without a result when the contact is already open at
+ * the falling edge ("no pull-in", also what an unwired input reads), when a
+ * charge starts again before the contact opens ("interrupted"), or when the
+ * contact is still closed HOLDUP_TIMEOUT_MS after the charge ("timeout").
+ */
+
+struct HoldupRecord {
+  uint32_t sequence;  // 1 for the first measurement since the last reset
+  uint32_t chargeUs;  // CHARGE_PIN HIGH time of the charge before it
+  uint32_t holdupUs;  // CHARGE_PIN falling edge to the contact opening
+};
+
+struct HoldupStats {
+  uint32_t count;
+  uint32_t lastUs;
+  uint32_t minUs;
+  uint32_t maxUs;
+  double meanUs;
+  double stddevUs;      // Sample standard deviation, 0 below two measurements
+  uint32_t interrupted;  // Recharged while the contact was still closed
+  uint32_t noPullIn;     // The contact was open when the charge ended
+  uint32_t timeouts;     // The contact stayed closed for HOLDUP_TIMEOUT_MS
+};
+
+// Most recent measurements kept for the API.
+const uint8_t HOLDUP_HISTORY = 16;
+
+// Longest hold-up waited for; matches SWEEP_DROPOUT_TIMEOUT_MS.
+const uint32_t HOLDUP_TIMEOUT_MS = 60000;
+
+/**
+ * @brief Configures the contact input and attaches the interrupts to it and
+ * to the charge pin. Call after chargeBegin().
+ * @return false if the interrupts cannot be attached.
+ */
+bool holdupBegin(int contactPin, int chargePin);
+
+/**
+ * @brief Folds the measurements completed since the last call into the
+ * statistics, and ends a measurement that ran past HOLDUP_TIMEOUT_MS. Call from loop().
+ * @return true if there was at least one.
+ */
+bool holdupService();
+
+/**
+ * @brief Clears the statistics and the history. A measurement in progress continues.
+ */
+void holdupReset();
+
+bool holdupEnabled();
+int holdupContactPin();
+bool holdupContactClosed();
+
+/**
+ * @brief A measurement is waiting for the contact to open. Edge interrupts do
+ * not fire in light sleep, so the firmware stays awake meanwhile.
+ */
+bool holdupPending();
+
+/**
+ * @brief Time since the charge pin fell while a measurement is pending, otherwise 0.
+ */
+uint32_t holdupPendingUs();
+
+const HoldupStats& holdupStats();
+
+/**
+ * @brief Copies up to max recent measurements, newest first.
+ * @return The number copied.
+ */
+uint8_t holdupHistory(HoldupRecord* out, uint8_t max);
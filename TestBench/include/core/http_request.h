@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+#include "hal/http.h"
+
+/*
+ * Zero-copy HTTP/1.1 request parsing.
+ *
+ * The request is parsed where it was received: the method, path, arguments
+ * and header values are string views into the receive buffer. Percent escapes
+ * and '+' are decoded in place, which is safe because decoded text is never
+ * longer than its encoding. Nothing is allocated, so parsing costs the same
+ * whatever the heap looks like, and the buffer must outlive the RequestView.
+ */
+
+// Arguments kept per request (query string and form body together); further
+// ones are ignored.
+const uint8_t REQUEST_MAX_ARGS = 16;
+
+struct RequestArg {
+  std::string_view name;
+  std::string_view value;
+};
+
+struct RequestView {
+  HttpMethod method;
+  std::string_view path;  // Decoded, without the query string
+  size_t headerBytes;     // Request line and headers, through the blank line
+  size_t contentLength;
+  bool formBody;          // Content-Type: application/x-www-form-urlencoded
+  bool keepAlive;         // HTTP/1.1 without "Connection: close", or HTTP/1.0 with "keep-alive"
+  std::string_view accept;  // Accept header, empty if absent
+  uint8_t argCount;
+  RequestArg args[REQUEST_MAX_ARGS];
+};
+
+enum RequestParseResult {
+  REQUEST_INCOMPLETE,  // No blank line yet; the buffer is untouched
+  REQUEST_OK,
+  REQUEST_MALFORMED
+};
+
+/**
+ * @brief Parses the request line and headers at the start of buffer, and the
+ * query-string arguments. Decodes the path and arguments in place.
+ */
+RequestParseResult requestParseHead(char* buffer, size_t length, RequestView& request);
+
+/**
+ * @brief Adds the arguments of a form body (decoded in place) after the
+ * query-string ones.
+ */
+void requestParseForm(char* body, size_t length, RequestView& request);
+
+/**
+ * @brief First argument with this name, as with WebServer::arg(), or nullptr.
+ */
+const RequestArg* requestFindArg(const RequestView& request, const char* name);
+
+/**
+ * @brief Strict decimal integer: an optional '-' and at least one digit,
+ * nothing else (no spaces, '+', or trailing characters).
+ * @return false if malformed or outside the range of long.
+ */
+bool requestParseInteger(std::string_view text, long* value);
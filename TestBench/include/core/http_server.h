@@ -0,0 +1,186 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/api_schema.h"
+#include "core/http_request.h"
+#include "core/route_trie.h"
+#include "hal/http.h"
+
+/*
+ * Minimal HTTP/1.1 server over BSD sockets, dispatching ApiRoute tables.
+ *
+ * Written against the POSIX socket API only, so it builds both on Linux and
+ * on lwIP. Mirrors the Arduino WebServer's request semantics: query-string
+ * and form-body arguments, and unmatched method/path combinations going to
+ * the not-found handler. Routes are looked up in a RouteTrie; {name} path
+ * segments are passed to the handler as arguments. Requests are parsed in
+ * place in a fixed buffer and responses sent from the handler's body, so
+ * serving allocates nothing of its own.
+ *
+ * Connections are persistent (HTTP/1.1 keep-alive): up to MAX_CONNECTIONS
+ * stay open between requests and are polled together with the listener, so a
+ * client polling /state pays for the TCP handshake once. Pipelined requests
+ * are answered in order. A connection is closed when the client asks for it,
+ * after an idle timeout, or after a number of requests.
+ *
+ * handleClient() never waits for a client. Sockets are non-blocking and each
+ * connection collects its request in its own buffer across calls, so a client
+ * trickling bytes only costs a recv() per call; one that has not delivered its
+ * request within the read deadline is answered 408. While a response waits for
+ * the client to take more data, the onWait() callback keeps the control loop
+ * running, up to the write deadline. Connections beyond MAX_CONNECTIONS are
+ * answered 503 with Retry-After.
+ *
+ * A handler can park its request to answer it later (HttpExchange::park()),
+ * e.g. /state waiting for a charge to end. The connection then holds the
+ * request without anyone waiting for it, and handleClient() runs the handler
+ * again when the version given to wakeParkedOn() changes or the request's
+ * timeout passes. A parked connection is not read from, so requests pipelined
+ * behind it wait their turn.
+ */
+class HttpServer {
+public:
+  // Requests are small; every connection holds a buffer of both. Larger ones
+  // are answered 400.
+  static const size_t MAX_HEADER_BYTES = 2048;
+  static const size_t MAX_BODY_BYTES = 1024;
+
+  // Connections kept open at a time; lwIP allows 10 sockets in all by default.
+  // Further clients are answered 503 until one closes.
+  static const uint8_t MAX_CONNECTIONS = 4;
+
+  // From a request's first byte to its last, and for sending a response (ms).
+  static const uint32_t READ_TIMEOUT_MS = 2000;
+  static const uint32_t WRITE_TIMEOUT_MS = 2000;
+
+  // Requests parked at a time, leaving connections for other clients; further
+  // ones are answered at once. A request is parked for MAX_PARK_MS at most.
+  static const uint8_t MAX_PARKED = 2;
+  static const uint32_t MAX_PARK_MS = 60000;
+
+  HttpServer();
+  ~HttpServer();
+
+  /**
+   * @brief Adds a route table. A method and path in several tables goes to the
+   * table added first.
+   * @return false if the route arrays are full or a uri is rejected by RouteTrie::add().
+   */
+  bool addRoutes(const ApiRoute* routes, size_t count);
+  void onNotFound(void (*handler)(HttpExchange& http));
+
+  /**
+   * @brief Called about every millisecond while a response waits for the
+   * client to accept more data, so polling (e.g. chargeMonitor()) goes on.
+   * Must not call handleClient().
+   */
+  void onWait(void (*service)());
+
+  /**
+   * @brief Also ends handleClient()'s wait when fd becomes readable, so a
+   * socket served next to the server (e.g. a UDP port) is not held up by waitMs.
+   * @return false if MAX_WAKE_SOCKETS are already watched.
+   */
+  bool wakeOn(int fd);
+
+  /**
+   * @brief Parked requests are run again once version() differs from its value
+   * when they were parked, e.g. chargeStateVersion(). Requests are only parked
+   * with a version to wake them.
+   */
+  void wakeParkedOn(uint32_t (*version)());
+
+  /**
+   * @brief Binds and listens on the port (0 picks a free port).
+   * @return false if the socket could not be bound.
+   */
+  bool begin(uint16_t port);
+
+  /**
+   * @brief Keep-alive policy. A connection idle for idleTimeoutMs is closed,
+   * and so is the one carrying its maxRequests-th request, after answering it.
+   * idleTimeoutMs 0 closes every connection after one request.
+   */
+  void setKeepAlive(uint32_t idleTimeoutMs, uint16_t maxRequests);
+
+  /**
+   * @brief Reads what has arrived on each connection, answers at most one
+   * complete request per connection and accepts a new one, if any, then runs
+   * the parked requests that are due. Waits at most waitMs for something to
+   * arrive or a parked request to time out, but never for a client.
+   */
+  void handleClient(uint32_t waitMs = 0);
+
+  void close();
+  uint16_t port() const { return boundPort; }
+
+  // Accepted connections and answered requests since begin(): their ratio
+  // shows how well clients reuse connections.
+  uint32_t connectionsAccepted() const { return acceptedCount; }
+  uint32_t requestsServed() const { return servedCount; }
+
+  // Connections answered 503, requests answered 408, and responses abandoned
+  // at the write deadline, since begin().
+  uint32_t connectionsRejected() const { return rejectedCount; }
+  uint32_t readTimeouts() const { return readTimeoutCount; }
+  uint32_t writeTimeouts() const { return writeTimeoutCount; }
+
+  // Requests parked since begin(), and parked now.
+  uint32_t requestsParked() const { return parkedCount; }
+  uint8_t parkedNow() const;
+
+private:
+  struct Connection {
+    int fd;                   // -1: free
+    uint16_t requests;
+    uint32_t lastActiveMs;
+    uint32_t requestStartMs;  // First byte of the request in buffer
+    bool headParsed;          // request holds the parsed head
+    bool buffered;            // buffer may hold a complete pipelined request
+    bool parked;              // request waits for its handler to run again
+    bool inputWaiting;        // Bytes behind the parked request, left in the socket
+    uint32_t parkedAtMs;      // When the request was first parked
+    uint32_t parkTimeoutMs;
+    uint32_t parkedVersion;   // wakeVersion() when last parked
+    size_t length;
+    RequestView request;
+    // The request is received and parsed in place here (see core/http_request.h).
+    char buffer[MAX_HEADER_BYTES + MAX_BODY_BYTES];
+  };
+
+  // Path segments of all routes, and their hash slots (a power of two).
+  static const size_t MAX_ROUTE_NODES = 128;
+  static const size_t ROUTE_SLOTS = 256;
+
+  static const uint8_t MAX_WAKE_SOCKETS = 4;
+
+  void acceptConnection();
+  bool serve(Connection& connection);
+  bool answer(Connection& connection);
+  bool dispatch(Connection& connection, bool keepAlive);
+  bool parkedDue(const Connection& connection, uint32_t now, uint32_t version) const;
+  void reject(int fd, int code, const char* message);
+  void closeConnection(Connection& connection);
+
+  int listenFd;
+  uint16_t boundPort;
+  RouteTrieNode routeNodes[MAX_ROUTE_NODES];
+  RouteTrieSlot routeSlots[ROUTE_SLOTS];
+  RouteTrie router;
+  void (*notFound)(HttpExchange& http);
+  void (*waitService)();
+  uint32_t (*wakeVersion)();
+  Connection connections[MAX_CONNECTIONS];
+  int wakeFds[MAX_WAKE_SOCKETS];
+  uint8_t wakeCount;
+  uint32_t idleTimeoutMs;
+  uint16_t maxRequests;
+  uint32_t acceptedCount;
+  uint32_t servedCount;
+  uint32_t rejectedCount;
+  uint32_t readTimeoutCount;
+  uint32_t writeTimeoutCount;
+  uint32_t parkedCount;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Constant-memory statistics over a stream of samples, for metrics that are
+ * recorded once per cycle over long runs without storing the samples.
+ *
+ * RunningStats keeps the count, mean, variance (Welford's update, which stays
+ * accurate where the naive sum of squares cancels), minimum and maximum.
+ *
+ * P2Quantile estimates one quantile with the P-square algorithm (Jain and
+ * Chlamtac, 1985): five markers whose heights are adjusted with a piecewise
+ * parabolic fit as samples arrive. Exact for the first five samples, then
+ * typically within a fraction of a percent for smooth distributions.
+ */
+
+struct RunningStats {
+  uint32_t count;
+  double mean;
+  double m2;    // Sum of squared deviations from the mean
+  double minValue;
+  double maxValue;
+};
+
+void runningStatsReset(RunningStats& stats);
+void runningStatsAdd(RunningStats& stats, double value);
+
+/**
+ * @brief Sample variance (n - 1), 0 below two samples.
+ */
+double runningStatsVariance(const RunningStats& stats);
+double runningStatsStddev(const RunningStats& stats);
+
+struct P2Quantile {
+  double p;             // Quantile in 0..1, e.g. 0.95
+  uint32_t count;
+  double heights[5];    // Marker heights; the first samples, sorted, until there are five
+  double positions[5];  // Actual marker positions (1-based)
+  double desired[5];    // Desired marker positions
+};
+
+void p2Reset(P2Quantile& quantile, double p);
+void p2Add(P2Quantile& quantile, double value);
+
+/**
+ * @brief Current estimate, 0 without samples.
+ */
+double p2Value(const P2Quantile& quantile);
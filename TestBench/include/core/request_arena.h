@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <charconv>
+#include <string>
+#include <type_traits>
+
+#include "core/api_schema.h"
+
+/*
+ * Per-request scratch memory.
+ *
+ * Handlers build their responses in ArenaString, whose storage is bumped off
+ * one static block. The dispatcher empties the block once the handler has
+ * returned, so the strings of a request never reach the heap and cannot
+ * fragment it over weeks of uptime. Freeing the most recent allocation hands
+ * it back at once, which covers most short-lived temporaries. Should a request
+ * outgrow the block, the rest of its allocations come from the heap and are
+ * counted as overflows.
+ *
+ * ArenaAllocator works with any standard container. Only memory that dies with
+ * the request belongs here: the arena is reset under anything still using it.
+ */
+
+const size_t ARENA_BYTES = 16384;
+
+// Routes with their own usage statistics; requests for further routes are
+// not recorded.
+const uint8_t ARENA_MAX_ROUTES = 48;
+
+struct ArenaRouteStats {
+  const ApiRoute* route;  // nullptr: requests no route matched
+  uint32_t requests;
+  uint32_t peakBytes;     // Largest use by one request
+  uint64_t totalBytes;    // Sum of each request's peak, for the mean
+  uint32_t overflows;     // Requests that fell back to the heap
+};
+
+/**
+ * @brief Scratch memory for the current request, 8-byte aligned. Falls back
+ * to the heap when the arena is full (or disabled).
+ */
+void* arenaAllocate(size_t bytes);
+
+/**
+ * @brief Returns memory from arenaAllocate(). Only the most recent arena
+ * allocation is reclaimed before the reset; heap fallbacks are freed.
+ */
+void arenaFree(void* memory, size_t bytes);
+
+/**
+ * @brief Records the request's peak use under its route (nullptr when none
+ * matched) and empties the arena. Called by the dispatcher after the handler.
+ */
+void arenaFinishRequest(const ApiRoute* route);
+
+size_t arenaUsed();
+size_t arenaRouteCount();
+const ArenaRouteStats& arenaRouteStats(size_t index);
+
+/**
+ * @brief With the arena disabled every allocation goes to the heap, for
+ * comparing the two.
+ */
+void arenaSetEnabled(bool enabled);
+
+template <typename T>
+struct ArenaAllocator {
+  using value_type = T;
+
+  ArenaAllocator() = default;
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>&) {}
+
+  T* allocate(size_t count) { return static_cast<T*>(arenaAllocate(count * sizeof(T))); }
+  void deallocate(T* memory, size_t count) { arenaFree(memory, count * sizeof(T)); }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return false; }
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+/**
+ * @brief std::to_string() for ArenaString, integers only.
+ */
+template <typename T>
+ArenaString arenaToString(T value) {
+  static_assert(std::is_integral<T>::value, "Format floating point with snprintf()");
+  char text[24];
+  char* end = std::to_chars(text, text + sizeof(text), value).ptr;
+  return ArenaString(text, end - text);
+}
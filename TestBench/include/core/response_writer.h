@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+#include <type_traits>
+
+#include "core/request_arena.h"
+#include "hal/http.h"
+
+/*
+ * Response bodies in the format the client asked for.
+ *
+ * Handlers describe their response once, as objects, arrays and values, and
+ * ResponseWriter encodes it straight into an ArenaString that is then sent as
+ * it is: JSON text by default, or CBOR (RFC 8949) or MessagePack when the
+ * request's Accept header prefers application/cbor or application/msgpack.
+ * There is no document tree in between; each value is encoded as it is added.
+ *
+ * CBOR and MessagePack put the number of members before a container, which
+ * is not known until it is closed. The writer reserves three bytes for the
+ * count and, on closing, writes it in the shortest form, moving the members
+ * back over the bytes not needed. Those are the few bytes of a small object,
+ * since nested containers are closed first.
+ *
+ * JSON output keeps the API's layout: "key":value members separated by ", ".
+ * value(number, decimals) prints that many decimals. The binary formats carry
+ * the same rounded number: an integer for 0 decimals, otherwise a 32-bit
+ * float where that keeps the decimals and a 64-bit float where it does not.
+ */
+
+enum ResponseFormat {
+  RESPONSE_JSON,
+  RESPONSE_CBOR,
+  RESPONSE_MSGPACK,
+};
+
+/**
+ * @brief The format an Accept header prefers: the supported media type with
+ * the highest q value, the earlier one on a tie. JSON if none is supported.
+ */
+ResponseFormat responseFormat(std::string_view accept);
+
+const char* responseContentType(ResponseFormat format);
+
+// Body bytes reserved up front. Most responses fit, so the arena holds one
+// block per response instead of every size the string grows through.
+const size_t RESPONSE_RESERVE_BYTES = 512;
+
+class ResponseWriter {
+public:
+  explicit ResponseWriter(ResponseFormat format) : encoding(format) { out.reserve(RESPONSE_RESERVE_BYTES); }
+
+  // The format http's Accept header asks for.
+  explicit ResponseWriter(const HttpExchange& http) : ResponseWriter(::responseFormat(http.accept())) {}
+
+  void beginObject();
+  void endObject();
+  void beginArray();
+  void endArray();
+
+  /**
+   * @brief The name of the next member of the open object.
+   */
+  void key(const char* name);
+
+  void value(const char* text);
+  void value(bool flag);
+  void value(double number, int decimals);
+  void null();
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type value(T number) {
+    if (std::is_signed<T>::value && number < 0) {
+      writeInteger(true, (uint64_t)(-((int64_t)number + 1)));
+    } else {
+      writeInteger(false, (uint64_t)number);
+    }
+  }
+
+  // key(name) followed by value(...).
+  template <typename T>
+  void field(const char* name, T number) {
+    key(name);
+    value(number);
+  }
+  void field(const char* name, double number, int decimals) {
+    key(name);
+    value(number, decimals);
+  }
+  void nullField(const char* name) {
+    key(name);
+    null();
+  }
+
+  /**
+   * @brief Sends the body with the format's content type and "Vary: Accept".
+   * Any containers still open are closed first.
+   */
+  void send(HttpExchange& http, int code = 200);
+
+  const ArenaString& body() const { return out; }
+  ResponseFormat format() const { return encoding; }
+
+private:
+  // Deepest nesting of objects and arrays.
+  static const uint8_t MAX_DEPTH = 8;
+
+  struct Container {
+    uint32_t offset;  // Where the container's header starts
+    uint32_t count;   // Members (objects) or elements (arrays) so far
+    bool object;
+  };
+
+  void begin(bool object);
+  void end();
+  void beforeValue();
+  void writeInteger(bool negative, uint64_t magnitude);
+  void writeString(const char* text, size_t length);
+  void writeHead(uint8_t major, uint64_t argument);
+
+  ResponseFormat encoding;
+  ArenaString out;
+  Container stack[MAX_DEPTH];
+  uint8_t depth = 0;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/api_schema.h"
+
+/*
+ * Route lookup over path segments.
+ *
+ * Routes are inserted into a trie with one node per path segment. The
+ * children of every node share one open-addressing hash table, keyed by the
+ * parent node and the segment's hash, so a lookup hashes each segment of the
+ * request path once while scanning it and probes the table: the cost follows
+ * the length of the path, not the number of routes.
+ *
+ * A segment written {name} matches any one non-empty segment, which is
+ * captured in the RouteMatch. A literal segment takes precedence over a
+ * parameter at the same position; there is no backtracking.
+ *
+ * Nodes and slots live in arrays supplied by the owner: adding routes never
+ * allocates, and a lookup touches nothing but the trie and the path.
+ */
+
+// Most {name} segments per route.
+const uint8_t ROUTE_MAX_PARAMS = 4;
+
+struct RouteParam {
+  const char* name;      // Into the route's uri, not terminated
+  uint8_t nameLength;
+  const char* value;     // Into the request path, not terminated
+  uint16_t valueLength;
+};
+
+struct RouteMatch {
+  const ApiRoute* route;
+  uint8_t paramCount;
+  RouteParam params[ROUTE_MAX_PARAMS];
+};
+
+struct RouteTrieNode {
+  const char* segment;        // Into the route's uri, including the braces of a {name}
+  uint16_t segmentLength;
+  uint16_t parent;
+  uint16_t paramChild;        // Child for a {name} segment, 0 for none
+  const ApiRoute* routes[2];  // GET, POST
+};
+
+struct RouteTrieSlot {
+  uint32_t hash;   // Of the parent node and the segment
+  uint16_t child;  // 0: empty
+};
+
+class RouteTrie {
+public:
+  /**
+   * @param slotArraySize A power of two; probes stay short below half full,
+   * so about twice the node count.
+   */
+  RouteTrie(RouteTrieNode* nodeArray, size_t nodeArraySize, RouteTrieSlot* slotArray, size_t slotArraySize);
+
+  void clear();
+
+  /**
+   * @brief Adds a route. When a method and path is added twice the first one
+   * is kept, as with a linear scan of the tables.
+   * @return false if the arrays are full, the uri does not start with '/',
+   * has more than ROUTE_MAX_PARAMS parameters, or names a parameter
+   * differently from an earlier route at the same position.
+   */
+  bool add(const ApiRoute& route);
+  bool add(const ApiRoute* routes, size_t count);
+
+  /**
+   * @brief Finds the route for a path (without the query string) and method.
+   * @return false if there is none.
+   */
+  bool find(const char* path, size_t length, HttpMethod method, RouteMatch& match) const;
+  bool find(const char* path, HttpMethod method, RouteMatch& match) const;
+
+  size_t nodesUsed() const { return nodeCount; }
+
+private:
+  uint16_t findChild(uint16_t parent, const char* segment, size_t length, uint32_t hash) const;
+
+  RouteTrieNode* nodes;
+  size_t nodeCapacity;
+  size_t nodeCount;
+  RouteTrieSlot* slots;
+  size_t slotMask;
+  size_t slotsUsed;
+};
+
+/**
+ * @brief A captured parameter by name, or nullptr.
+ */
+const RouteParam* routeFindParam(const RouteMatch& match, const char* name);
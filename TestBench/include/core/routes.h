@@ -0,0 +1,226 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "core/api.h"
+#include "core/api_schema.h"
+#include "core/charge_control.h"
+#include "core/cycle_control.h"
+#include "core/sweep_control.h"
+
+/*
+ * Route table shared by every server the bench runs on: the ESP32 firmware
+ * and the native bench server both register it with an HttpServer
+ * (core/http_server.h), over lwIP and POSIX sockets respectively.
+ *
+ * Each entry also documents its route, and the parameter lists below are the
+ * ones the handlers check their arguments against, so the OpenAPI document
+ * rendered from this table (api_spec.cpp) always matches what is enforced.
+ */
+
+inline constexpr ApiInfo API_INFO = {
+  "ESP32 Capacitor Charger API (Project Scrooge)",
+  "1.0.1",
+  "API to control the charge duration of an external capacitor connected to GPIO 17. Part of Project Scrooge: "
+  "a zero-leakage switching test bench. Routes that report data also answer in CBOR or MessagePack when the "
+  "Accept header asks for application/cbor or application/msgpack.",
+  "https://github.com/psmgeelen/ESP32_API_TestBench",
+  "Local ESP32 Server",
+};
+
+// --- 1. PARAMETERS ---
+
+inline constexpr ApiParam CHARGE_PARAMS[] = {
+  apiInteger("time", CHARGE_MIN_MS, CHARGE_MAX_MS).inUnit("ms").defaultsTo(CHARGE_TARGET_DEFAULT_TIMEOUT_MS)
+      .describedAs("Duration to hold GPIO 17 HIGH, in milliseconds. Required unless target_mv is given; with "
+                   "target_mv it is the safety timeout."),
+  apiInteger("target_mv", 1).inUnit("mV")
+      .describedAs("Charge until the sensed capacitor voltage reaches this value (mV). The sense input is sampled "
+                   "every 250 us outside the main loop and GPIO 17 is driven LOW from the sampler, so the cutoff "
+                   "follows the crossing within one sample period plus one conversion."),
+};
+
+inline constexpr ApiParam CYCLE_PARAMS[] = {
+  apiInteger("charge_ms", CHARGE_MIN_MS, CHARGE_MAX_MS).inUnit("ms").defaultsTo(CHARGE_TARGET_DEFAULT_TIMEOUT_MS)
+      .describedAs("Charge duration; with target_mv the safety timeout."),
+  apiInteger("target_mv", 1).inUnit("mV"),
+  apiInteger("hold_ms", 0, CYCLE_MAX_HOLD_MS).inUnit("ms").defaultsTo(0),
+  apiInteger("discharge_mv", 1).inUnit("mV").required(),
+  apiInteger("discharge_timeout_ms", CYCLE_MIN_DISCHARGE_TIMEOUT_MS, CYCLE_MAX_DISCHARGE_TIMEOUT_MS).inUnit("ms")
+      .defaultsTo(CYCLE_DEFAULT_DISCHARGE_TIMEOUT_MS),
+  apiInteger("count", 1, CYCLE_MAX_COUNT).defaultsTo(1),
+};
+
+// In the order of chargeActive(): wait_until=charging is 1.
+inline constexpr const char* STATE_WAIT_NAMES[] = {"idle", "charging"};
+
+inline constexpr ApiParam STATE_PARAMS[] = {
+  apiEnum("wait_until", STATE_WAIT_NAMES)
+      .describedAs("Answer once the status is this one, or at timeout_ms, instead of at once."),
+  apiInteger("since_version", 0)
+      .describedAs("Answer once version differs from this one (a charge started or ended), or at timeout_ms."),
+  apiInteger("timeout_ms", 0, STATE_WAIT_MAX_MS).inUnit("ms").defaultsTo(STATE_WAIT_DEFAULT_MS)
+      .describedAs("Longest wait for wait_until or since_version; the state is reported either way."),
+};
+
+// In SweepParameter order.
+inline constexpr const char* SWEEP_PARAMETER_NAMES[] = {"charge_ms", "target_mv"};
+
+inline constexpr ApiParam SWEEP_PARAMS[] = {
+  apiEnum("param", SWEEP_PARAMETER_NAMES).required().describedAs("Swept parameter."),
+  apiInteger("from", 1).required().describedAs("First value (ms, or mV for target_mv)."),
+  apiInteger("to", 1).describedAs("Last value (default: from)."),
+  apiInteger("steps", 1, SWEEP_MAX_STEPS).defaultsTo(1),
+  apiInteger("repeats", 1, SWEEP_MAX_REPEATS).defaultsTo(1).describedAs("Charges per step."),
+  apiInteger("gap_ms", 0, SWEEP_MAX_GAP_MS).inUnit("ms").defaultsTo(SWEEP_DEFAULT_GAP_MS)
+      .describedAs("From the end of one cycle to the next charge."),
+  apiInteger("timeout_ms", CHARGE_MIN_MS, CHARGE_MAX_MS).inUnit("ms").defaultsTo(CHARGE_TARGET_DEFAULT_TIMEOUT_MS)
+      .describedAs("Charge timeout for target_mv sweeps."),
+  apiBoolean("wait_dropout")
+      .describedAs("End each cycle when the relay drops out and record its hold-up (default: true when a contact "
+                   "input is configured)."),
+};
+
+inline constexpr ApiParam SWEEP_RESULTS_PARAMS[] = {
+  apiInteger("since", 0).defaultsTo(0),
+  apiInteger("limit", 1, SWEEP_MAX_STEPS).defaultsTo(16),
+};
+
+// --- 2. ROUTES ---
+
+inline constexpr ApiRoute CORE_ROUTES[] = {
+  apiRoute("/", HTTP_METHOD_GET, handleRoot),
+  apiRoute("/swagger", HTTP_METHOD_GET, handleSwaggerUi),
+  apiRoute("/swagger.json", HTTP_METHOD_GET, handleSwaggerJson),
+
+  // Control Endpoints
+  apiRoute("/charge", HTTP_METHOD_GET, handleCharge)
+      .doc("Control", "Start Capacitor Charging")
+      .withParams(CHARGE_PARAMS)
+      .respond(200, "Charging cycle initiated successfully.")
+      .respond(400, "Invalid or missing 'time' or 'target_mv' parameter.")
+      .respond(409, "A charging cycle is already in progress, or /cycle batches or a sweep are running."),
+  apiRoute("/stop", HTTP_METHOD_POST, handleStop)
+      .doc("Control", "Emergency Stop", "Immediately stops any active charging cycle by setting GPIO 17 LOW.")
+      .respond(200, "Charge stopped or confirmed idle."),
+  apiRoute("/estop", HTTP_METHOD_GET, handleEstop)
+      .doc("Control", "Get Emergency Stop Latency",
+           "The stop inputs that bypass the HTTP queue: a push button on an interrupt and the UDP stop port (a "
+           "datagram starting with STOP, answered STOPPED and the latency). Each drives the charge pin LOW where "
+           "the stop arrives; the latencies are from the button edge or the datagram's receipt to the pin write. "
+           "A pin or port of -1 or 0 is not in use.")
+      .respond(200, "Stop inputs and latency per source.",
+               R"({"latched":false,"button_pin":25,"udp_port":4210,"button":{"count":3,"last_us":4,"max_us":6,)"
+               R"("mean_us":4},"udp":{"count":12,"last_us":9,"max_us":14,"mean_us":10}})"),
+  apiRoute("/cycle", HTTP_METHOD_GET, handleCycle)
+      .doc("Control", "Get Cycle Queue",
+           "Reports the running charge/hold/discharge phase, the queued cycles and the throughput in cycles per "
+           "minute.")
+      .respond(200, "Cycle queue status.",
+               R"({"phase":"discharging","queued":12,"batches":1,"completed":8,"discharge_timeouts":0,)"
+               R"("last_cycle_ms":95,"last_discharge_ms":31,"run_ms":780,"cycles_per_minute":615.38,)"
+               R"("active_discharge":true})"),
+  apiRoute("/cycle", HTTP_METHOD_POST, handleCycle)
+      .doc("Control", "Queue Charge/Discharge Cycles",
+           "Queues a batch of cycles: charge (for charge_ms, or to target_mv), hold, then discharge until the sensed "
+           "voltage is below discharge_mv, and start the next cycle straight away. The charge and discharge outputs "
+           "are never on together and are separated by a 10 ms dead time. Without a discharge output the capacitor "
+           "bleeds down passively. POST /stop clears the queue.")
+      .withParams(CYCLE_PARAMS)
+      .respond(200, "Batch queued.")
+      .respond(400, "Invalid or missing parameter, or the queue is full.")
+      .respond(409, "A manual charge cycle is running."),
+  apiRoute("/sweeps", HTTP_METHOD_GET, handleSweeps)
+      .doc("Sweeps", "Get Sweep Status", "Reports the definition and progress of the running (or last) sweep.")
+      .respond(200, "Sweep status.",
+               R"({"id":3,"state":"running","param":"charge_ms","from":100,"to":5000,"steps":50,"repeats":20,)"
+               R"("gap_ms":500,"wait_dropout":true,"step":12,"repeat":7,"steps_done":12,"cycles":247,)"
+               R"("total_cycles":1000,"elapsed_ms":301250,"max_gap_error_us":840})"),
+  apiRoute("/sweeps", HTTP_METHOD_POST, handleSweeps)
+      .doc("Sweeps", "Start a Parameter Sweep",
+           "Runs a sweep on the device: the charge duration or target voltage steps linearly from 'from' to 'to', "
+           "with 'repeats' charges per step. Each charge starts gap_ms after the previous cycle ended (GPIO 17 LOW, "
+           "or the relay dropping out with wait_dropout), and every cycle feeds the step's pulse width, hold-up and "
+           "end voltage statistics. POST /stop or /sweeps/stop ends it.")
+      .withParams(SWEEP_PARAMS)
+      .respond(200, "Sweep started.")
+      .respond(400, "Invalid or missing parameter.")
+      .respond(409, "A charge, cycle or sweep is already running."),
+  apiRoute("/sweeps/results", HTTP_METHOD_GET, handleSweepResults)
+      .doc("Sweeps", "Get Sweep Results",
+           "Completed steps from index 'since' on, readable while the sweep runs. Stream the results by passing the "
+           "returned 'next' as 'since' until 'done' is true. Metrics without samples are null.")
+      .withParams(SWEEP_RESULTS_PARAMS)
+      .respond(200, "Sweep status and completed steps.",
+               R"({"id":3,"state":"running","param":"charge_ms","from":100,"to":5000,"steps":50,"repeats":20,)"
+               R"("gap_ms":500,"wait_dropout":true,"step":12,"repeat":7,"steps_done":12,"cycles":247,)"
+               R"("total_cycles":1000,"elapsed_ms":301250,"max_gap_error_us":840,"since":11,"next":12,)"
+               R"("done":false,"results":[{"step":11,"value":1200,"cycles":20,"timeouts":0,)"
+               R"("charge_us":{"count":20,"mean":1200012.4,"stddev":7.9,"min":1200004,"max":1200031},)"
+               R"("holdup_us":{"count":20,"mean":352118.6,"stddev":141.2,"min":351870,"max":352402},)"
+               R"("end_mv":{"count":20,"mean":4928.3,"stddev":3.4,"min":4921,"max":4934},)"
+               R"("max_gap_error_us":840}]})")
+      .respond(400, "Invalid 'since' or 'limit'."),
+  apiRoute("/sweeps/stop", HTTP_METHOD_POST, handleSweepStop)
+      .doc("Sweeps", "Stop the Sweep", "Ends the running sweep and its charge. Completed steps stay readable.")
+      .respond(200, "Sweep stopped or none running."),
+
+  // Status/Info Endpoints
+  apiRoute("/state", HTTP_METHOD_GET, handleState)
+      .doc("Status", "Get Current GPIO Charge State",
+           "Reports if the GPIO is currently HIGH (charging) or LOW (idle), and the remaining time if charging. A "
+           "charge to target_mv also reports the latest sense reading; when idle, last_charge describes how the "
+           "previous cycle ended and its cutoff latency. version counts the starts and ends of charges. With "
+           "wait_until or since_version the request is held until the state matches (a long poll), without "
+           "holding up the control loop, and answered in the loop pass that makes the change.")
+      .withParams(STATE_PARAMS)
+      .respond(200, "Current state information.",
+               R"({"status":"idle","gpio_level":"LOW","version":14,"last_charge":{"end":"target","charge_us":22000,)"
+               R"("target_mv":4200,"samples":88,"cutoff_mv":4204,"cutoff_latency_us":250,"reaction_us":40,)"
+               R"("max_cutoff_latency_us":290}})"),
+  apiRoute("/stats", HTTP_METHOD_GET, handleStats)
+      .doc("Status", "Get Cycle Statistics",
+           "Statistics of every completed charge since the last reset: pulse width, relay hold-up and end voltage. "
+           "Mean, variance and extremes are exact (Welford); p50 and p95 are P-square estimates. Memory use is "
+           "constant however many cycles run. Metrics without samples are null.")
+      .respond(200, "Per-metric statistics.",
+               R"({"since_reset_ms":600250,"pulse_width_us":{"count":1000,"mean":500004.2,"stddev":6.1,)"
+               R"("min":499991,"max":500027,"variance":37.2,"p50":500003.8,"p95":500014.9},)"
+               R"("holdup_us":{"count":1000,"mean":351990.1,"stddev":2001.7,"min":350002,"max":366214,)"
+               R"("variance":4006803.0,"p50":351382.6,"p95":355969.0},"end_mv":{"count":1000,"mean":4934.7,)"
+               R"("stddev":2.1,"min":4927,"max":4941,"variance":4.4,"p50":4935.0,"p95":4938.0}})"),
+  apiRoute("/stats/reset", HTTP_METHOD_POST, handleStatsReset)
+      .doc("Status", "Reset Cycle Statistics", "Starts a new experiment: clears every metric.")
+      .respond(200, "Statistics cleared."),
+  apiRoute("/holdup", HTTP_METHOD_GET, handleHoldup)
+      .doc("Status", "Get Relay Hold-Up Statistics",
+           "How long the relay stays closed after GPIO 17 goes LOW. Both the charge pin and the relay contact input "
+           "are timestamped by edge interrupt, so each measurement has microsecond resolution. Reports the "
+           "statistics since the last reset and the 16 most recent measurements, newest first. A charge that starts "
+           "before the contact opens ends the measurement without a result (interrupted), as does a contact that "
+           "is open when the charge ends (no_pull_in, also an unwired input) or still closed 60 s later (timeouts).")
+      .respond(200, "Hold-up statistics.",
+               R"({"enabled":true,"contact_pin":27,"contact":"open","pending_us":0,"count":2,"last_us":347455,)"
+               R"("min_us":347449,"max_us":347455,"mean_us":347452.0,"stddev_us":4.2,"interrupted":0,)"
+               R"("no_pull_in":0,"timeouts":0,"recent":[{"seq":2,"charge_us":299947,"holdup_us":347455},)"
+               R"({"seq":1,"charge_us":99854,"holdup_us":347449}]})"),
+  apiRoute("/holdup/reset", HTTP_METHOD_POST, handleHoldupReset)
+      .doc("Status", "Reset Hold-Up Statistics")
+      .respond(200, "Statistics and recent measurements cleared."),
+  apiRoute("/health", HTTP_METHOD_GET, handleHealth)
+      .doc("System", "Health Check", "Simple check to ensure the server is running.")
+      .respond(200, "System operational."),
+  apiRoute("/info", HTTP_METHOD_GET, handleInfo)
+      .doc("System", "Get Project Information", "Provides details about the project context and configuration.")
+      .respond(200, "Project details."),
+  apiRoute("/system/arena", HTTP_METHOD_GET, handleSystemArena)
+      .doc("System", "Get Request Arena Use",
+           "Scratch memory per route: response strings are built in a fixed arena that is emptied after each "
+           "request, so they never fragment the heap. Overflows count requests that outgrew the arena and "
+           "fell back to the heap.")
+      .respond(200, "Arena capacity and per-route use in bytes.",
+               R"({"capacity_bytes":16384,"routes":[{"method":"GET","uri":"/state","requests":1200,)"
+               R"("peak_bytes":304,"mean_bytes":296,"overflows":0}]})"),
+};
+
+inline constexpr size_t CORE_ROUTE_COUNT = sizeof(CORE_ROUTES) / sizeof(CORE_ROUTES[0]);
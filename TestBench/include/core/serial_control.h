@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/serial_frame.h"
+#include "core/udp_frame.h"
+
+/*
+ * Binary control over the serial port that carries the log, for when Wi-Fi
+ * is unreliable or its jitter matters.
+ *
+ * The commands are the UDP control protocol's frames (core/udp_frame.h):
+ * charge, stop, state and capture download, run by udpControlHandle() with
+ * the same checks and replies. On the line each one is framed as
+ * core/serial_frame.h describes, so log text keeps flowing in between: a host
+ * reads text up to a 0x00, then a frame up to the next 0x00. Input outside
+ * frames is ignored, and corrupt frames are dropped unanswered; the host
+ * sends the same frame again, and a repeated charge is answered from the
+ * last reply as over UDP.
+ */
+
+struct SerialControlStats {
+  uint32_t frames;    // Answered, repeats included
+  uint32_t repeated;  // Answered from the last reply
+  uint32_t corrupt;   // Bad COBS or CRC, too long, or not a control frame
+};
+
+// Longest request on the line: a control frame, stuffed, with its CRC.
+const size_t SERIAL_REQUEST_MAX_BYTES = serialFrameBytes(UDP_FRAME_BYTES);
+
+/**
+ * @brief Reads what has arrived and answers complete frames. Call from loop().
+ */
+void serialControlService();
+
+const SerialControlStats& serialControlStats();
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Framing of the serial control transport (core/serial_control.h).
+ *
+ * Header-only, for host tools (src/native/serial_client.cpp) as well. A frame
+ * on the wire is
+ *
+ *   0x00, COBS(payload, CRC-16 of payload), 0x00
+ *
+ * COBS (consistent overhead byte stuffing) removes every 0x00 from the
+ * encoded bytes at a cost of one byte per 254, so 0x00 only ever delimits
+ * frames, and log text, which never contains it, can share the line. The CRC
+ * is CRC-16/CCITT-FALSE (polynomial 0x1021, initial 0xFFFF), little-endian.
+ */
+
+const uint8_t SERIAL_FRAME_DELIMITER = 0x00;
+const size_t SERIAL_CRC_BYTES = 2;
+
+/**
+ * @brief Bytes on the wire for a payload of the given length, at most.
+ */
+constexpr size_t serialFrameBytes(size_t payloadLength) {
+  return 2 + (payloadLength + SERIAL_CRC_BYTES) + (payloadLength + SERIAL_CRC_BYTES) / 254 + 1;
+}
+
+inline uint16_t serialCrc16(const uint8_t* data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (uint16_t)(crc << 1 ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**
+ * @brief COBS-encodes length bytes to out (up to length + length / 254 + 1 bytes).
+ * @return The encoded length.
+ */
+inline size_t cobsEncode(const uint8_t* in, size_t length, uint8_t* out) {
+  size_t codeAt = 0;
+  size_t written = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < length; i++) {
+    if (in[i] != 0) {
+      out[written++] = in[i];
+      code++;
+    }
+    if (in[i] == 0 || code == 0xFF) {
+      out[codeAt] = code;
+      codeAt = written++;
+      code = 1;
+    }
+  }
+  out[codeAt] = code;
+  return written;
+}
+
+/**
+ * @brief Decodes COBS bytes (without delimiters) to out, which needs length bytes.
+ * @return false if the bytes are not valid COBS.
+ */
+inline bool cobsDecode(const uint8_t* in, size_t length, uint8_t* out, size_t* outLength) {
+  size_t read = 0;
+  size_t written = 0;
+  while (read < length) {
+    uint8_t code = in[read++];
+    if (code == 0 || read + code - 1 > length) {
+      return false;
+    }
+    for (uint8_t i = 1; i < code; i++) {
+      out[written++] = in[read++];
+    }
+    if (code < 0xFF && read < length) {
+      out[written++] = 0;
+    }
+  }
+  *outLength = written;
+  return true;
+}
+
+/**
+ * @brief Writes a payload as a delimited frame. The CRC is appended to
+ * payload in place, so it needs SERIAL_CRC_BYTES of room after length.
+ * @param out serialFrameBytes(length) bytes.
+ * @return The frame's length.
+ */
+inline size_t serialFrameEncode(uint8_t* payload, size_t length, uint8_t* out) {
+  uint16_t crc = serialCrc16(payload, length);
+  payload[length] = (uint8_t)crc;
+  payload[length + 1] = (uint8_t)(crc >> 8);
+  out[0] = SERIAL_FRAME_DELIMITER;
+  size_t encoded = cobsEncode(payload, length + SERIAL_CRC_BYTES, out + 1);
+  out[1 + encoded] = SERIAL_FRAME_DELIMITER;
+  return encoded + 2;
+}
+
+/**
+ * @brief Decodes the bytes between two delimiters and checks the CRC.
+ * @param out length bytes; receives the payload without the CRC.
+ * @return false if the frame is corrupt.
+ */
+inline bool serialFrameDecode(const uint8_t* in, size_t length, uint8_t* out, size_t* payloadLength) {
+  size_t decoded = 0;
+  if (!cobsDecode(in, length, out, &decoded) || decoded <= SERIAL_CRC_BYTES) {
+    return false;
+  }
+  decoded -= SERIAL_CRC_BYTES;
+  uint16_t crc = (uint16_t)(out[decoded] | out[decoded + 1] << 8);
+  if (crc != serialCrc16(out, decoded)) {
+    return false;
+  }
+  *payloadLength = decoded;
+  return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "core/online_stats.h"
+
+/*
+ * On-device parameter sweeps.
+ *
+ * A sweep steps one charge parameter (the charge duration, or the target
+ * voltage) linearly from `from` to `to`, and runs `repeats` charges at each
+ * step. Every charge starts exactly gapMs after the previous cycle ended,
+ * which is the charge pin going LOW, or the relay dropping out when a contact
+ * input is wired and waitDropout is set:
+ *
+ *   | charge | hold-up | gap | charge | hold-up | gap | ...
+ *
+ * Each cycle feeds the step's statistics: the measured pulse width, the
+ * relay hold-up and the sense reading at the end of the charge. Completed
+ * steps can be read while the sweep is still running (sweepStep()), so a
+ * client can stream the results incrementally.
+ */
+
+enum SweepParameter {
+  SWEEP_CHARGE_MS,  // Fixed-duration charges of `value` ms
+  SWEEP_TARGET_MV   // Charges to `value` mV, with timeoutMs as the safety timeout
+};
+
+struct SweepDefinition {
+  SweepParameter parameter;
+  uint32_t from;
+  uint32_t to;
+  uint16_t steps;
+  uint16_t repeats;     // Charges per step
+  uint32_t gapMs;       // From the end of one cycle to the next charge
+  uint32_t timeoutMs;   // Charge timeout for SWEEP_TARGET_MV
+  bool waitDropout;     // A cycle ends when the relay drops out (needs a contact input)
+};
+
+enum SweepState {
+  SWEEP_IDLE,     // No sweep since boot
+  SWEEP_RUNNING,
+  SWEEP_DONE,
+  SWEEP_STOPPED,  // sweepStop() or an emergency stop
+  SWEEP_FAILED    // A charge could not be started
+};
+
+struct SweepStep {
+  uint32_t value;          // Charge duration (ms) or target (mV) of this step
+  uint16_t cycles;
+  uint16_t timeouts;       // Target not reached, or no relay drop-out measured
+  RunningStats chargeUs;   // Pulse width
+  RunningStats holdupUs;   // Relay hold-up (only with waitDropout)
+  RunningStats endMv;      // Sense reading at the end of the charge (only with a sense input)
+  uint32_t maxGapErrorUs;  // Latest charge start relative to its schedule
+};
+
+struct SweepStatus {
+  uint32_t id;             // Increments with every sweep started
+  SweepState state;
+  uint16_t step;           // Step running now
+  uint16_t repeat;         // Charges completed in the running step
+  uint16_t stepsDone;      // Steps readable through sweepStep()
+  uint32_t cycles;         // Charges completed
+  uint32_t totalCycles;    // steps * repeats
+  uint32_t elapsedMs;
+  uint32_t maxGapErrorUs;
+};
+
+// Upper bound on the steps of one sweep (the per-step results are kept in RAM).
+const uint16_t SWEEP_MAX_STEPS = 64;
+
+// Accepted gap between cycles (ms) and repetitions per step.
+const uint32_t SWEEP_MAX_GAP_MS = 3600000;
+const uint32_t SWEEP_DEFAULT_GAP_MS = 1000;
+const uint16_t SWEEP_MAX_REPEATS = 1000;
+
+// Longest wait for the relay to drop out before a cycle counts as a timeout.
+const uint32_t SWEEP_DROPOUT_TIMEOUT_MS = 60000;
+
+/**
+ * @brief Validates a definition and starts the sweep; the first charge starts
+ * from the next sweepService() call.
+ * @return nullptr on success, otherwise a message describing the problem,
+ * valid until the next call.
+ */
+const char* sweepStart(const SweepDefinition& definition);
+
+/**
+ * @brief Ends the running sweep. Completed steps stay readable. The charge
+ * pin is left to chargeStop().
+ */
+void sweepStop();
+
+/**
+ * @brief Advances the running sweep. Call from loop() after chargeMonitor().
+ * @return true if a step completed in this call.
+ */
+bool sweepService();
+
+bool sweepActive();
+SweepStatus sweepStatus();
+const SweepDefinition& sweepDefinition();
+
+/**
+ * @brief A completed step of the current (or last) sweep, or nullptr if
+ * index is not below sweepStatus().stepsDone.
+ */
+const SweepStep* sweepStep(uint16_t index);
+
+/**
+ * @brief Charge duration (ms) or target (mV) of a step.
+ */
+uint32_t sweepStepValue(const SweepDefinition& definition, uint16_t index);
+
+const char* sweepStateName(SweepState state);
+const char* sweepParameterName(SweepParameter parameter);
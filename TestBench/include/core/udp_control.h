@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/udp_frame.h"
+
+/*
+ * UDP control protocol: charge, stop and state as fixed-layout binary frames
+ * (core/udp_frame.h), for scripted high-rate experiments where HTTP parsing
+ * and the TCP handshake would dominate a command's cost.
+ *
+ * Commands make the same checks as the HTTP handlers (apiChargeConflict(),
+ * apiStop()) and run from loop() like HTTP requests; this is not the
+ * emergency stop path (core/emergency_stop.h). Every frame is answered with
+ * its sequence number. A client that gets no reply sends the same frame
+ * again: a repeat of the last sequence number from the same address is
+ * answered from the last reply instead of being run again, so a retried
+ * charge does not start a second one. Capture replies are not kept; reading
+ * a capture has no effect to repeat.
+ */
+
+struct UdpControlStats {
+  uint32_t received;  // Frames, repeats included
+  uint32_t repeated;  // Answered from the last reply
+  uint32_t dropped;   // Datagrams that were not frames, not answered
+};
+
+// Datagrams handled per udpControlService() call at most.
+const int UDP_CONTROL_BURST = 8;
+
+/**
+ * @brief Opens the control port (0 picks a free one) without blocking.
+ * @return The socket, or -1.
+ */
+int udpControlBegin(uint16_t port);
+
+/**
+ * @brief Runs and answers the frames that have arrived. Call from loop().
+ */
+void udpControlService();
+
+/**
+ * @brief Runs one request frame and writes the reply to reply. A capture reply
+ * carries as many samples as fit capacity.
+ * @return The reply's length, or 0 if the request is not a frame.
+ */
+size_t udpControlHandle(const uint8_t* request, size_t length, uint8_t* reply, size_t capacity);
+
+void udpControlClose();
+uint16_t udpControlPort();
+const UdpControlStats& udpControlStats();
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Frames of the UDP control protocol (core/udp_control.h).
+ *
+ * Header-only, so host tools (src/native/udp_client.cpp) build the same
+ * frames as the bench. The serial transport (core/serial_control.h) carries
+ * the same frames. Requests and replies are UDP_FRAME_BYTES each, except
+ * capture replies, with multi-byte fields little-endian:
+ *
+ *   offset  size  field
+ *        0     2  magic, 'T' 'B'
+ *        2     1  version, UDP_FRAME_VERSION
+ *        3     1  opcode; a reply carries the request's opcode | UDP_REPLY
+ *        4     4  sequence number, chosen by the client and echoed in the reply
+ *        8     1  status (replies)
+ *        9     1  flags (replies)
+ *       10     1  end reason of the last charge, a ChargeEndReason (replies)
+ *       11     1  reserved, 0
+ *       12     4  value0
+ *       16     4  value1
+ *
+ *   opcode          request value0, value1               reply value0, value1
+ *   UDP_OP_CHARGE   duration ms, target mV (0: timed)    as requested
+ *   UDP_OP_STOP     -                                    -
+ *   UDP_OP_STATE    -                                    ms remaining, last charge us
+ *   UDP_OP_CAPTURE  first sample, samples (0: a chunk)   first sample, samples captured
+ *
+ * With a target, a duration of 0 selects the /charge default timeout.
+ *
+ * A capture reply is followed by up to UDP_CAPTURE_CHUNK uint16 samples from
+ * the first one requested: the sense readings of the last charge to a target
+ * in mV, one sample period (250 us by default) apart. The reply's length
+ * gives their number; read until the first sample reaches the samples captured.
+ */
+
+const size_t UDP_FRAME_BYTES = 20;
+const uint8_t UDP_FRAME_VERSION = 1;
+
+enum UdpOpcode {
+  UDP_OP_CHARGE = 1,
+  UDP_OP_STOP = 2,
+  UDP_OP_STATE = 3,
+  UDP_OP_CAPTURE = 4,
+};
+
+// Samples in one capture reply at most; the reply still fits one Ethernet frame.
+const size_t UDP_CAPTURE_CHUNK = 512;
+const size_t UDP_REPLY_MAX_BYTES = UDP_FRAME_BYTES + 2 * UDP_CAPTURE_CHUNK;
+
+const uint8_t UDP_REPLY = 0x80;
+
+// Reply statuses; CONFLICT and INVALID are /charge's 409 and 400.
+enum UdpStatus {
+  UDP_STATUS_OK = 0,
+  UDP_STATUS_CONFLICT = 1,
+  UDP_STATUS_INVALID = 2,
+  UDP_STATUS_BAD_FRAME = 3,  // Unknown version or opcode
+};
+
+// Reply flags: the state after the command.
+const uint8_t UDP_FLAG_CHARGING = 0x01;
+const uint8_t UDP_FLAG_PIN_HIGH = 0x02;
+const uint8_t UDP_FLAG_CYCLES = 0x04;
+const uint8_t UDP_FLAG_SWEEP = 0x08;
+const uint8_t UDP_FLAG_ESTOP = 0x10;
+
+struct UdpFrame {
+  uint8_t version;
+  uint8_t opcode;
+  uint32_t sequence;
+  uint8_t status;
+  uint8_t flags;
+  uint8_t endReason;
+  uint32_t value0;
+  uint32_t value1;
+};
+
+inline void udpPut32(uint8_t* out, uint32_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+  out[2] = (uint8_t)(value >> 16);
+  out[3] = (uint8_t)(value >> 24);
+}
+
+inline uint32_t udpGet32(const uint8_t* in) {
+  return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+/**
+ * @brief Writes the frame's UDP_FRAME_BYTES to out.
+ */
+inline void udpFrameEncode(const UdpFrame& frame, uint8_t* out) {
+  out[0] = 'T';
+  out[1] = 'B';
+  out[2] = frame.version;
+  out[3] = frame.opcode;
+  udpPut32(out + 4, frame.sequence);
+  out[8] = frame.status;
+  out[9] = frame.flags;
+  out[10] = frame.endReason;
+  out[11] = 0;
+  udpPut32(out + 12, frame.value0);
+  udpPut32(out + 16, frame.value1);
+}
+
+/**
+ * @brief Reads a frame's fields; what follows them (capture samples) is left
+ * to the caller. The version and opcode are not checked.
+ * @return false if the data is not a frame (too short, or no magic).
+ */
+inline bool udpFrameDecode(const uint8_t* in, size_t length, UdpFrame& frame) {
+  if (length < UDP_FRAME_BYTES || in[0] != 'T' || in[1] != 'B') {
+    return false;
+  }
+  frame.version = in[2];
+  frame.opcode = in[3];
+  frame.sequence = udpGet32(in + 4);
+  frame.status = in[8];
+  frame.flags = in[9];
+  frame.endReason = in[10];
+  frame.value0 = udpGet32(in + 12);
+  frame.value1 = udpGet32(in + 16);
+  return true;
+}
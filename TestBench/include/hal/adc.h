@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * ADC HAL. On the ESP32 this is the calibrated analogReadMilliVolts(); the
+ * native build reads the simulated circuit (src/native/rc_circuit.h) at the
+ * current virtual time, including its quantisation and noise.
+ */
+
+/**
+ * @brief One ADC conversion on the pin, in millivolts at the pin.
+ */
+int halAnalogReadMilliVolts(int pin);
+
+/*
+ * Periodic sampler: converts one pin at a fixed period outside loop(), so a
+ * threshold can be acted on with a latency that does not depend on what
+ * loop() is doing. On the ESP32 it is an esp_timer dispatched from the
+ * high-priority esp_timer task; in the native build it fires as the virtual
+ * clock advances. The callback runs in that context: keep it short.
+ */
+
+typedef void (*HalSampleCallback)(int millivolts, uint64_t atUs);
+
+/**
+ * @brief Starts (or restarts) sampling. The first sample follows one period
+ * after the call. Only one sampler exists at a time.
+ * @param callback Receives each reading and the halMicros() time its conversion started.
+ */
+bool halSamplerStart(int pin, uint32_t periodUs, HalSampleCallback callback);
+void halSamplerStop();
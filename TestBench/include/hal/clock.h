@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Clock HAL.
+ *
+ * On the ESP32 these map onto millis() and esp_timer_get_time(). The native
+ * build links a virtual clock instead (src/native/sim_hal.cpp) that only moves
+ * when the simulation advances it, so timing logic can be driven through days
+ * of virtual time in microsecond steps.
+ *
+ * halMillis() deliberately keeps the 32-bit width of Arduino's millis(): it
+ * wraps after 2^32 ms (~49.7 days) on both targets, and all elapsed-time
+ * arithmetic must be written as unsigned subtraction to survive that.
+ */
+
+uint32_t halMillis();
+
+/**
+ * @brief Monotonic microseconds since boot. 64-bit, does not wrap in practice.
+ * Safe to call from interrupt context (in IRAM on the ESP32).
+ */
+uint64_t halMicros();
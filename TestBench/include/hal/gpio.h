@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * GPIO HAL. On the ESP32 these are the Arduino pin functions; the native build
+ * keeps simulated pin levels and records every transition with its virtual
+ * timestamp.
+ */
+
+const int HAL_LOW = 0;
+const int HAL_HIGH = 1;
+
+void halPinOutput(int pin);
+void halPinInput(int pin, bool pullUp);
+void halDigitalWrite(int pin, int level);
+int halDigitalRead(int pin);
+
+/*
+ * Edge interrupts: the callback runs in interrupt context on every transition
+ * of the pin, with the new level and the halMicros() time of the edge, so
+ * timestamps do not depend on what loop() is doing. It works on output pins
+ * too (their own writes trigger it). Keep callbacks short, mark them
+ * HAL_ISR_ATTR and only touch plain variables, halMicros() and
+ * halDigitalWriteFromIsr(): they may run while the flash cache is disabled.
+ */
+
+#ifdef ARDUINO
+#include <esp_attr.h>
+#define HAL_ISR_ATTR IRAM_ATTR
+#else
+#define HAL_ISR_ATTR
+#endif
+
+/**
+ * @brief halDigitalWrite() for interrupt context: in IRAM on the ESP32, and
+ * writes the GPIO output registers directly instead of going through code in flash.
+ */
+void halDigitalWriteFromIsr(int pin, int level);
+
+typedef void (*HalEdgeCallback)(int level, uint64_t atUs);
+
+/**
+ * @brief Calls the callback on every edge of the pin, replacing any previous one.
+ */
+bool halAttachEdgeInterrupt(int pin, HalEdgeCallback callback);
+void halDetachEdgeInterrupt(int pin);
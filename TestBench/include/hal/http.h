@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+
+/*
+ * HTTP HAL.
+ *
+ * API handlers receive one HttpExchange per request and never touch the server
+ * implementation directly. It is backed by a socket (core/http_server.h) on
+ * both the ESP32 and Linux, or by a recorded request in the native tests.
+ */
+
+enum HttpMethod {
+  HTTP_METHOD_GET,
+  HTTP_METHOD_POST,
+  HTTP_METHOD_OTHER
+};
+
+class HttpExchange {
+public:
+  virtual ~HttpExchange() {}
+
+  virtual HttpMethod method() const = 0;
+  virtual std::string uri() const = 0;
+  virtual bool hasArg(const char* name) const = 0;
+  virtual std::string arg(const char* name) const = 0;
+  // The Accept header, empty if the request had none. Valid until the response is sent.
+  virtual std::string_view accept() const = 0;
+
+  /**
+   * @brief Answers later instead of now: the handler returns without sending,
+   * and the server runs it again once the state it watches has changed
+   * (HttpServer::wakeParkedOn()) or timeoutMs after it first parked. It then
+   * answers, or parks again to keep waiting.
+   * @return false if the request cannot wait (the time is up, or the server
+   * has no room for it); the handler answers now.
+   */
+  virtual bool park(uint32_t /* timeoutMs */) { return false; }
+
+  virtual void sendHeader(const char* name, const char* value) = 0;
+  virtual void send(int code, const char* contentType, const char* body, size_t length) = 0;
+
+  void send(int code, const char* contentType, const char* body) {
+    send(code, contentType, body, strlen(body));
+  }
+  // std::string and strings with other allocators (ArenaString).
+  template <typename Allocator>
+  void send(int code, const char* contentType, const std::basic_string<char, std::char_traits<char>, Allocator>& body) {
+    send(code, contentType, body.data(), body.size());
+  }
+};
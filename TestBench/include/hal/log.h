@@ -0,0 +1,7 @@
+#pragma once
+
+/*
+ * Logging HAL: printf-style output to Serial on the ESP32, stdout on Linux.
+ */
+
+void halLog(const char* format, ...) __attribute__((format(printf, 1, 2)));
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Serial HAL: the port that also carries halLog(). Serial on the ESP32; in the
+ * native build a file descriptor given to simSerialAttach(), e.g. a pty.
+ */
+
+/**
+ * @brief Reads what has arrived, without waiting.
+ * @return Bytes read, 0 if none.
+ */
+size_t halSerialRead(uint8_t* buffer, size_t capacity);
+
+/**
+ * @brief Writes the bytes in one piece, so halLog() output from another
+ * context cannot land in between.
+ */
+void halSerialWrite(const uint8_t* data, size_t length);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Heap, stack and fragmentation telemetry.
+ *
+ * The free heap, its largest free block and the lowest free heap since boot
+ * are sampled periodically into a small ring buffer, so a leak or slow
+ * fragmentation shows up as a trend in /system/memory without a debugger
+ * attached. The stack high-water marks of the watched FreeRTOS tasks (loop,
+ * Wi-Fi, TCP/IP, ...) are read on demand.
+ */
+
+// One hour of history at one sample per minute.
+const uint8_t MEMORY_HISTORY = 60;
+const uint32_t MEMORY_SAMPLE_PERIOD_MS = 60000;
+
+// Tasks whose stack is reported, including the system ones.
+const uint8_t MEMORY_MAX_TASKS = 12;
+
+struct MemorySample {
+  uint32_t uptimeS;
+  uint32_t freeHeap;       // Bytes, internal 8-bit capable heap
+  uint32_t largestBlock;   // Largest single allocation that would succeed
+  uint32_t minFreeHeap;    // Lowest free heap since boot
+  uint32_t freePsram;      // 0 without PSRAM
+};
+
+struct MemoryTaskStack {
+  const char* name;
+  bool running;            // false if no task of this name exists (yet)
+  uint32_t stackFreeMin;   // High-water mark: least free stack ever, bytes
+};
+
+/**
+ * @brief Watches the loop, Wi-Fi, TCP/IP, event and timer tasks, and takes
+ * the first sample.
+ */
+void memoryBegin();
+
+/**
+ * @brief Adds a FreeRTOS task, by name, to the stack report. For tasks the
+ * firmware creates itself.
+ * @return false if MEMORY_MAX_TASKS are already watched.
+ */
+bool memoryWatchTask(const char* name);
+
+/**
+ * @brief Called from loop(); takes a sample every MEMORY_SAMPLE_PERIOD_MS.
+ */
+void memoryService();
+
+MemorySample memoryNow();
+
+/**
+ * @brief Copies the sampled history, oldest first.
+ * @return Number of samples copied.
+ */
+uint8_t memoryHistory(MemorySample* out, uint8_t max);
+
+uint8_t memoryTaskCount();
+MemoryTaskStack memoryTaskStack(uint8_t index);
+
+uint32_t memoryHeapSize();
+uint32_t memoryPsramSize();  // 0 without PSRAM
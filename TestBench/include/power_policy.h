@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Idle power policy for the test bench.
+ *
+ * The bench spends most of its life waiting for the next request. Depending on
+ * the selected mode, loop() yields to the idle task between polls so that
+ * dynamic frequency scaling (DFS), Wi-Fi modem sleep and automatic light sleep
+ * can kick in. While a charge cycle is active a PM lock pins the CPU at full
+ * clock and forbids light sleep, so charge timing is unaffected by the mode.
+ */
+
+enum PowerMode {
+  POWER_PERFORMANCE,  // Full clock, radio always on, loop() never yields (original behaviour)
+  POWER_MODEM_SLEEP,  // DFS 80-240 MHz, Wi-Fi modem sleep (DTIM), short loop() yields
+  POWER_LIGHT_SLEEP,  // As modem sleep, plus automatic light sleep when idle
+  POWER_MODE_COUNT
+};
+
+// Loop service statistics for one mode, used to report the latency the
+// policy adds on top of the network. All values in microseconds.
+struct PowerModeStats {
+  uint32_t samples;
+  uint32_t avgGapUs;     // Mean time between two HTTP polls
+  uint32_t maxGapUs;     // Worst time between two HTTP polls
+  uint64_t residencyMs;  // Time spent in this mode since boot
+};
+
+/**
+ * @brief Restores the mode saved in NVS (or the default) and applies it.
+ */
+void powerBegin(PowerMode defaultMode);
+
+/**
+ * @brief Switches mode at runtime and saves it to NVS.
+ * @return false if the build does not support the mode (it then stays unchanged).
+ */
+bool powerSetMode(PowerMode mode);
+
+/**
+ * @brief Acquires or releases the PM lock that keeps timing exact during a charge.
+ */
+void powerSetChargeActive(bool active);
+
+/**
+ * @brief Called once at the end of every loop() iteration. Yields to the idle
+ * task according to the current mode and records the loop service gap.
+ */
+void powerIdle();
+
+PowerMode powerMode();
+const char* powerModeName(PowerMode mode);
+bool powerModeFromName(const char* name, PowerMode* mode);
+bool powerModeSupported(PowerMode mode);
+// A snapshot; the current mode's residency includes the time since it was selected.
+PowerModeStats powerModeStats(PowerMode mode);
+
+// Nominal ESP32 idle current in mA for a mode: fixed figures from the Espressif
+// datasheet and power-management guide, not measured on this board. Actual draw
+// depends on the board and the AP's DTIM.
+float powerNominalIdleCurrentMa(PowerMode mode);
+
+// Worst-case extra latency the mode adds before a request is read, in ms:
+// loop() yield interval plus the DTIM beacon wait for power-save modes.
+uint32_t powerExpectedAddedLatencyMs(PowerMode mode);
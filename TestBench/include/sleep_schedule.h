@@ -0,0 +1,102 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string>
+
+#include "core/request_arena.h"
+
+/*
+ * Deep-sleep scheduled experiments for long self-discharge tests.
+ *
+ * An experiment is a number of cycles. Each cycle charges the capacitor once
+ * and then measures its voltage a fixed number of times at a fixed interval:
+ *
+ *   | charge | interval | measure | interval | measure | ... | charge | ...
+ *
+ * Between events the ESP32 is in deep sleep with CHARGE_PIN held LOW by the pad
+ * hold latch. The schedule and the measured results live in RTC slow memory,
+ * so a timer wake-up only runs the due event and goes straight back to sleep
+ * without starting Wi-Fi. Wi-Fi is only brought up when the result buffer
+ * needs to be uploaded, or when the experiment has finished.
+ */
+
+struct ScheduleDefinition {
+  uint32_t chargeMs;     // Charge pulse length at the start of each cycle
+  uint32_t intervalS;    // Time between measurements
+  uint16_t measures;     // Measurements per cycle
+  uint16_t cycles;       // Number of cycles
+  uint16_t uploadEvery;  // Upload after this many buffered results (with a collector URL)
+};
+
+struct ScheduleResult {
+  uint32_t offsetS;      // Seconds since the experiment started
+  uint16_t cycle;
+  uint16_t millivolts;   // 0 for charge events
+  uint8_t isCharge;
+};
+
+struct ScheduleStatus {
+  bool active;
+  ScheduleDefinition definition;
+  uint32_t nextEvent;     // Index of the next event to run
+  uint32_t totalEvents;
+  uint32_t nextEventInS;  // Seconds until the next event
+  uint16_t buffered;      // Results waiting for upload
+  uint32_t uploaded;      // Results uploaded so far
+  uint32_t dropped;       // Results lost to buffer overflow
+  uint32_t wakeups;
+};
+
+// Results held in RTC memory between uploads.
+const uint16_t SCHEDULE_RESULT_CAPACITY = 128;
+
+// Accepted measurement interval (s), measurements per cycle and cycles.
+const uint32_t SCHEDULE_MAX_INTERVAL_S = 86400;
+const uint16_t SCHEDULE_MAX_MEASURES = 1000;
+const uint16_t SCHEDULE_MAX_CYCLES = 1000;
+
+/**
+ * @brief Configures the charge pin and the collector URL. Measurements read
+ * the sense input set with chargeSetSense(), divider included. Must run at the
+ * very start of setup(), before anything drives CHARGE_PIN.
+ * @param uploadUrl HTTP endpoint that receives result batches as a JSON POST,
+ * or an empty string to keep results on the device for GET /schedule/results.
+ * Without one, Wi-Fi only comes up when the experiment ends or after a reset.
+ */
+void scheduleBegin(int chargePin, const char* uploadUrl);
+
+/**
+ * @brief Handles a timer wake-up of an active experiment. Runs the due events
+ * and returns to deep sleep without returning, unless a Wi-Fi session is
+ * needed to upload results, in which case setup() continues normally. Call
+ * after scheduleBegin() and chargeSetSense().
+ */
+void scheduleHandleWake();
+
+/**
+ * @brief Validates and starts an experiment. The device enters deep sleep
+ * shortly afterwards (see scheduleService()).
+ * @return nullptr on success, otherwise a message describing the invalid
+ * field, valid until the next call.
+ */
+const char* scheduleStart(const ScheduleDefinition& definition);
+
+/**
+ * @brief Cancels the running experiment. Buffered results are kept.
+ */
+void scheduleStop();
+
+/**
+ * @brief Uploads pending results once Wi-Fi is up and puts the device back to
+ * sleep when the awake window has passed. Call from loop().
+ * @param busy true while a manual charge cycle is running (sleep is deferred).
+ */
+void scheduleService(bool linkUp, bool busy);
+
+ScheduleStatus scheduleStatus();
+
+/**
+ * @brief Appends the buffered results as a JSON array to the response.
+ */
+void scheduleResultsJson(std::string& out);
+void scheduleResultsJson(ArenaString& out);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * UDP emergency-stop listener.
+ *
+ * A FreeRTOS task one priority above lwIP's own waits on the stop port, so a
+ * stop datagram drives the charge pin LOW as soon as the stack delivers it,
+ * whatever loop() and the HTTP server are doing. The datagram format and the
+ * pin write are in core/emergency_stop.h; loop() still has to call
+ * estopService() to finish the stop.
+ */
+
+// Stack of the listener task, in bytes.
+const uint32_t STOP_LISTENER_STACK = 3072;
+
+/**
+ * @brief Opens the UDP port and starts the listener task. Call after the
+ * Wi-Fi stack is initialised.
+ * @return false if the port cannot be bound or the task cannot be created.
+ */
+bool stopListenerBegin(uint16_t port);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+/*
+ * Non-blocking Wi-Fi station link for the test bench.
+ *
+ * The link is driven entirely by Wi-Fi events: wifiLinkBegin() only kicks off
+ * the association and returns immediately, so setup() can bring up the charge
+ * control and the HTTP server without waiting for the access point.
+ *
+ * The BSSID, channel and IP lease of the last successful session are cached in
+ * NVS. On the next boot they are used to skip the channel scan and the DHCP
+ * handshake, which is where most of a cold connect is spent. The lease is stamped
+ * with the RTC-backed system clock and only reused until half its lifetime (the
+ * point where a DHCP client would renew); after that, after a power cycle, or
+ * when an attempt with it fails, the station goes back to DHCP.
+ *
+ * After boot the link is kept up by a small state machine that retries with
+ * exponential backoff. It never blocks loop() and never restarts the board, so
+ * a charge cycle in progress is unaffected by an access point outage.
+ */
+
+struct WifiLinkConfig {
+  const char* ssid;
+  const char* password;
+
+  // Static addressing. When useStaticIp is false the DHCP lease is used
+  // (and reused on the next boot while it is still fresh if reuseCachedLease is true).
+  bool useStaticIp;
+  IPAddress localIp;
+  IPAddress gateway;
+  IPAddress subnet;
+  IPAddress dns;
+
+  bool reuseCachedLease;
+};
+
+enum WifiLinkState {
+  WIFI_LINK_CONNECTING,  // Association/DHCP in progress
+  WIFI_LINK_CONNECTED,   // Station has an IP address
+  WIFI_LINK_BACKOFF      // Waiting before the next attempt
+};
+
+// Boot timestamps in microseconds since reset (esp_timer_get_time()), 0 if not reached yet.
+struct WifiLinkTimings {
+  int64_t beginUs;
+  int64_t associatedUs;
+  int64_t gotIpUs;
+  bool usedCachedBssid;
+  bool usedCachedLease;
+};
+
+// Reconnect statistics since boot. Durations are in milliseconds.
+struct WifiLinkStats {
+  uint32_t outages;              // Times an established link was lost
+  uint32_t attempts;             // Association attempts, including the first one
+  uint32_t lastReconnectMs;      // Link loss to IP for the most recent outage
+  uint32_t maxReconnectMs;
+  uint64_t totalDowntimeMs;      // Sum over completed outages
+  uint32_t currentBackoffMs;     // Delay before the next attempt (0 while connected)
+  unsigned long outageStartMs;   // millis() when the current outage began, 0 if up
+};
+
+/**
+ * @brief Starts the station connection and returns without waiting for it.
+ */
+void wifiLinkBegin(const WifiLinkConfig& config);
+
+/**
+ * @brief Processes Wi-Fi events posted by the event task. Call from loop().
+ */
+void wifiLinkService();
+
+/**
+ * @brief True once the station has an IP address.
+ */
+bool wifiLinkUp();
+
+WifiLinkState wifiLinkState();
+const char* wifiLinkStateName();
+const WifiLinkTimings& wifiLinkTimings();
+const WifiLinkStats& wifiLinkStats();
@@ -0,0 +1,648 @@
+#include "core/api.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/charge_control.h"
+#include "core/cycle_stats.h"
+#include "core/cycle_control.h"
+#include "core/emergency_stop.h"
+#include "core/holdup_monitor.h"
+#include "core/routes.h"
+#include "core/serial_control.h"
+#include "core/sweep_control.h"
+#include "core/udp_control.h"
+#include "hal/clock.h"
+
+static ApiPlatform platform = {"ESP32", nullptr, nullptr, nullptr};
+
+void apiBegin(const ApiPlatform& config) {
+  platform = config;
+}
+
+/**
+ * @brief Serves the OpenAPI specification in JSON format.
+ */
+void handleSwaggerJson(HttpExchange& http) {
+  http.send(200, "application/json", platform.openApiJson ? platform.openApiJson : swaggerJson);
+}
+
+/**
+ * @brief Serves the Swagger UI HTML page.
+ */
+void handleSwaggerUi(HttpExchange& http) {
+  http.send(200, "text/html", swaggerHtml);
+}
+
+/**
+ * @brief Handles the root path and redirects to Swagger UI.
+ */
+void handleRoot(HttpExchange& http) {
+  http.sendHeader("Location", "/swagger");
+  http.send(302, "text/plain", "Redirecting to Swagger UI...");
+}
+
+const char* apiChargeConflict() {
+  if (chargeActive()) {
+    return "Charging in progress. Please wait.";
+  }
+  if (cycleActive() || dischargeActive()) {
+    return "Charge/discharge cycles are running. Use /stop to cancel them.";
+  }
+  if (sweepActive()) {
+    return "A sweep is running. Use /stop to cancel it.";
+  }
+  if (estopLatched()) {
+    return "An emergency stop is being finished. Please wait.";
+  }
+  return platform.chargeInterlock ? platform.chargeInterlock() : nullptr;
+}
+
+bool apiStop() {
+  cycleStop();
+  sweepStop();
+  return chargeStop();
+}
+
+/**
+ * @brief Answers 409 for a start refused after the conflict checks passed:
+ * within the dead time after the discharge output went off, or while an
+ * emergency stop is being finished.
+ */
+static void sendChargeBusy(HttpExchange& http) {
+  http.send(409, "application/json", "{\"status\":\"error\", \"message\":\"The output is switching over or an "
+            "emergency stop is being finished. Please retry.\"}");
+}
+
+/**
+ * @brief Answers 400 for a duration chargeStart() rejected, with the limits of
+ * the 'time' parameter apiParseArgs() enforces.
+ */
+static void sendInvalidTime(HttpExchange& http) {
+  const ApiParam& time = CHARGE_PARAMS[0];
+  http.send(400, "application/json", ArenaString("{\"status\":\"error\", \"message\":\"'") + time.name +
+            "' must be between " + arenaToString(time.minimum) + " and " + arenaToString(time.maximum) + " " +
+            time.unit + ".\"}");
+}
+
+/**
+ * @brief Handles the main /charge API call.
+ * * Takes 'time' parameter and starts the non-blocking charge cycle.
+ * URL format: /charge?time=500
+ * * With 'target_mv' the cycle instead ends when the sensed capacitor voltage
+ * reaches the target, and 'time' (optional) becomes the safety timeout.
+ * URL format: /charge?target_mv=4000&time=2000
+ */
+void handleCharge(HttpExchange& http) {
+  const char* conflict = apiChargeConflict();
+  if (conflict) {
+    http.send(409, "application/json", ArenaString("{\"status\":\"error\", \"message\":\"") + conflict + "\"}");
+    return;
+  }
+
+  ApiArgs args;
+  if (!apiParseArgs(http, CHARGE_PARAMS, args)) {
+    return;
+  }
+
+  bool toTarget = args.has("target_mv");
+  if (!toTarget && !args.has("time")) {
+    // Bad request: missing parameter
+    http.send(400, "application/json", "{\"status\":\"error\", \"message\":\"Missing 'time' parameter (ms).\"}");
+    return;
+  }
+
+  // Within CHARGE_MIN_MS..CHARGE_MAX_MS; the default is the target's safety timeout.
+  long requestedTime = args.value("time");
+
+  if (!toTarget) {
+    ChargeStartResult result = chargeStart(requestedTime);
+    if (result == CHARGE_BUSY) {
+      sendChargeBusy(http);
+      return;
+    }
+    if (result != CHARGE_STARTED) {
+      sendInvalidTime(http);
+      return;
+    }
+    http.send(200, "application/json", "{\"status\":\"success\", \"message\":\"Charge cycle initiated for " + arenaToString(requestedTime) + "ms.\"}");
+    return;
+  }
+
+  long targetMv = args.value("target_mv");
+  switch (chargeStartToTarget(targetMv, requestedTime)) {
+    case CHARGE_STARTED:
+      http.send(200, "application/json", "{\"status\":\"success\", \"message\":\"Charging to " + arenaToString(targetMv) +
+                "mV (timeout " + arenaToString(requestedTime) + "ms).\"}");
+      break;
+    case CHARGE_INVALID_TARGET:
+      http.send(400, "application/json", "{\"status\":\"error\", \"message\":\"'target_mv' must be between 1 and " +
+                arenaToString(chargeMaxTargetMv()) + " mV.\"}");
+      break;
+    case CHARGE_BUSY:
+      sendChargeBusy(http);
+      break;
+    case CHARGE_NO_SENSE:
+      http.send(400, "application/json", "{\"status\":\"error\", \"message\":\"'target_mv' needs a sense input, none is available.\"}");
+      break;
+    default:
+      sendInvalidTime(http);
+      break;
+  }
+}
+
+/**
+ * @brief Adds the outcome of the last finished cycle, if any.
+ */
+static void writeLastCharge(ResponseWriter& response) {
+  const ChargeResult& last = chargeLastResult();
+  if (last.reason == CHARGE_END_NONE) {
+    return;
+  }
+  response.key("last_charge");
+  response.beginObject();
+  response.field("end", chargeEndReasonName(last.reason));
+  response.field("charge_us", last.chargeUs);
+  if (chargeHasSense()) {
+    response.field("end_mv", last.endMv);
+  }
+  if (last.targetMv > 0) {
+    response.field("target_mv", last.targetMv);
+    response.field("samples", last.samples);
+  }
+  if (last.reason == CHARGE_END_TARGET) {
+    response.field("cutoff_mv", last.cutoffMv);
+    response.field("cutoff_latency_us", last.latencyUs);
+    response.field("reaction_us", last.reactionUs);
+    response.field("max_cutoff_latency_us", chargeMaxLatencyUs());
+  }
+  response.endObject();
+}
+
+/**
+ * @brief Handles the /state API call to report charge status.
+ * * With 'wait_until' or 'since_version' the request is parked until the
+ * state matches or 'timeout_ms' passes; chargeStateVersion() changing wakes it.
+ * URL format: /state?wait_until=idle&timeout_ms=20000
+ */
+void handleState(HttpExchange& http) {
+  ApiArgs args;
+  if (!apiParseArgs(http, STATE_PARAMS, args)) {
+    return;
+  }
+  bool waiting = (args.has("wait_until") && (args.value("wait_until") == 1) != chargeActive()) ||
+                 (args.has("since_version") && (uint32_t)args.value("since_version") == chargeStateVersion());
+  if (waiting && http.park(args.value("timeout_ms"))) {
+    return;
+  }
+
+  ResponseWriter response(http);
+  response.beginObject();
+  if (chargeActive()) {
+    response.field("status", "charging");
+    response.field("gpio_level", "HIGH");
+    response.field("version", chargeStateVersion());
+    response.field("duration_ms", chargeDurationMs());
+    response.field("time_remaining_ms", chargeRemainingMs());
+    if (chargeTargetMv() > 0) {
+      response.field("target_mv", chargeTargetMv());
+      response.field("sense_mv", chargeSenseMv());
+      response.field("sample_period_us", chargeSamplePeriodUs());
+    }
+  } else {
+    // We check the actual digital read of the pin for the real state,
+    // especially after an emergency stop or if the pin was manipulated externally.
+    response.field("status", "idle");
+    response.field("gpio_level", chargePinHigh() ? "HIGH" : "LOW");
+    response.field("version", chargeStateVersion());
+    writeLastCharge(response);
+    if (cycleActive()) {
+      response.field("cycle", cyclePhaseName(cycleStatus().phase));
+    }
+    if (sweepActive()) {
+      response.field("sweep", sweepStatus().id);
+    }
+  }
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Handles the /stop API call to immediately halt charging (POST method).
+ */
+void handleStop(HttpExchange& http) {
+  if (apiStop()) {
+    http.send(200, "application/json", "{\"status\":\"success\", \"message\":\"Charging stopped immediately.\"}");
+  } else {
+    // The pin is driven LOW either way; report success if it was already idle
+    http.send(200, "application/json", "{\"status\":\"success\", \"message\":\"Not currently charging. Pin confirmed LOW.\"}");
+  }
+}
+
+/**
+ * @brief Handles the /estop API call: the stop inputs outside the HTTP queue
+ * and the time each took from a stop's arrival to the pin going LOW.
+ */
+void handleEstop(HttpExchange& http) {
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("latched", estopLatched());
+  response.field("button_pin", estopButtonPin());
+  response.field("udp_port", estopUdpPort());
+  for (int i = 0; i < ESTOP_SOURCE_COUNT; i++) {
+    const EstopLatency& latency = estopLatency((EstopSource)i);
+    response.key(estopSourceName((EstopSource)i));
+    response.beginObject();
+    response.field("count", latency.count);
+    response.field("last_us", latency.lastUs);
+    response.field("max_us", latency.maxUs);
+    response.field("mean_us", latency.count ? latency.totalUs / latency.count : 0);
+    response.endObject();
+  }
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Handles the /cycle API call. GET reports the cycle queue and its
+ * throughput; POST queues a batch of charge/hold/discharge cycles.
+ * URL format: /cycle?target_mv=4000&hold_ms=100&discharge_mv=300&count=20
+ */
+void handleCycle(HttpExchange& http) {
+  if (http.method() == HTTP_METHOD_POST) {
+    if (chargeActive() && !cycleActive()) {
+      http.send(409, "application/json", "{\"status\":\"error\", \"message\":\"Charging in progress. Please wait.\"}");
+      return;
+    }
+    if (sweepActive()) {
+      http.send(409, "application/json", "{\"status\":\"error\", \"message\":\"A sweep is running. Use /stop to cancel it.\"}");
+      return;
+    }
+    const char* interlock = platform.chargeInterlock ? platform.chargeInterlock() : nullptr;
+    if (interlock) {
+      http.send(409, "application/json", ArenaString("{\"status\":\"error\", \"message\":\"") + interlock + "\"}");
+      return;
+    }
+    ApiArgs args;
+    if (!apiParseArgs(http, CYCLE_PARAMS, args)) {
+      return;
+    }
+    if (!args.has("charge_ms") && !args.has("target_mv")) {
+      http.send(400, "application/json", "{\"status\":\"error\", \"message\":\"Missing both 'charge_ms' and 'target_mv'.\"}");
+      return;
+    }
+
+    CycleDefinition definition;
+    definition.targetMv = args.value("target_mv");
+    definition.chargeMs = args.value("charge_ms");
+    definition.holdMs = args.value("hold_ms");
+    definition.dischargeMv = args.value("discharge_mv");
+    definition.dischargeTimeoutMs = args.value("discharge_timeout_ms");
+    definition.count = args.value("count");
+
+    const char* error = cycleEnqueue(definition);
+    if (error) {
+      http.send(400, "application/json", ArenaString("{\"status\":\"error\", \"message\":\"") + error + "\"}");
+      return;
+    }
+  }
+
+  CycleStatus status = cycleStatus();
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("phase", cyclePhaseName(status.phase));
+  response.field("queued", status.queued);
+  response.field("batches", status.batches);
+  response.field("completed", status.completed);
+  response.field("discharge_timeouts", status.dischargeTimeouts);
+  response.field("last_cycle_ms", status.lastCycleMs);
+  response.field("last_discharge_ms", status.lastDischargeMs);
+  response.field("run_ms", status.runMs);
+  response.field("cycles_per_minute", status.cyclesPerMinute, 2);
+  response.field("active_discharge", dischargePin() >= 0);
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Adds the sweep definition and progress to the open object.
+ */
+static void writeSweepStatus(ResponseWriter& response) {
+  SweepStatus status = sweepStatus();
+  const SweepDefinition& sweep = sweepDefinition();
+  response.field("id", status.id);
+  response.field("state", sweepStateName(status.state));
+  if (status.id == 0) {
+    return;
+  }
+  response.field("param", sweepParameterName(sweep.parameter));
+  response.field("from", sweep.from);
+  response.field("to", sweep.to);
+  response.field("steps", sweep.steps);
+  response.field("repeats", sweep.repeats);
+  response.field("gap_ms", sweep.gapMs);
+  response.field("wait_dropout", sweep.waitDropout);
+  response.field("step", status.step);
+  response.field("repeat", status.repeat);
+  response.field("steps_done", status.stepsDone);
+  response.field("cycles", status.cycles);
+  response.field("total_cycles", status.totalCycles);
+  response.field("elapsed_ms", status.elapsedMs);
+  response.field("max_gap_error_us", status.maxGapErrorUs);
+}
+
+/**
+ * @brief Handles the /sweeps API call. GET reports the current (or last)
+ * sweep; POST starts one.
+ * URL format: /sweeps?param=charge_ms&from=100&to=5000&steps=50&repeats=20&gap_ms=500
+ */
+void handleSweeps(HttpExchange& http) {
+  if (http.method() == HTTP_METHOD_POST) {
+    if (chargeActive() || cycleActive() || dischargeActive() || sweepActive()) {
+      http.send(409, "application/json", "{\"status\":\"error\", \"message\":\"A charge, cycle or sweep is running. Use /stop to cancel it.\"}");
+      return;
+    }
+    const char* interlock = platform.chargeInterlock ? platform.chargeInterlock() : nullptr;
+    if (interlock) {
+      http.send(409, "application/json", ArenaString("{\"status\":\"error\", \"message\":\"") + interlock + "\"}");
+      return;
+    }
+    ApiArgs args;
+    if (!apiParseArgs(http, SWEEP_PARAMS, args)) {
+      return;
+    }
+
+    SweepDefinition sweep;
+    sweep.parameter = (SweepParameter)args.value("param");
+    sweep.from = args.value("from");
+    sweep.to = args.has("to") ? args.value("to") : sweep.from;
+    sweep.steps = args.value("steps");
+    sweep.repeats = args.value("repeats");
+    sweep.gapMs = args.value("gap_ms");
+    sweep.timeoutMs = args.value("timeout_ms");
+    sweep.waitDropout = args.has("wait_dropout") ? args.value("wait_dropout") != 0 : holdupEnabled();
+
+    const char* error = sweepStart(sweep);
+    if (error) {
+      http.send(400, "application/json", ArenaString("{\"status\":\"error\", \"message\":\"") + error + "\"}");
+      return;
+    }
+  }
+
+  ResponseWriter response(http);
+  response.beginObject();
+  writeSweepStatus(response);
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Adds the member name with the statistics as an object
+ * {"count", "mean", "stddev", "min", "max"} left open for more, or null
+ * without samples.
+ * @return false for null.
+ */
+static bool writeRunningStats(ResponseWriter& response, const char* name, const RunningStats& stats) {
+  if (stats.count == 0) {
+    response.nullField(name);
+    return false;
+  }
+  response.key(name);
+  response.beginObject();
+  response.field("count", stats.count);
+  response.field("mean", stats.mean, 1);
+  response.field("stddev", runningStatsStddev(stats), 1);
+  response.field("min", stats.minValue, 0);
+  response.field("max", stats.maxValue, 0);
+  return true;
+}
+
+/**
+ * @brief Handles the /sweeps/results API call: completed steps from index
+ * 'since' on, at most 'limit' (default 16) per response. Clients stream a
+ * running sweep by passing the returned 'next' as 'since' until 'done'.
+ * URL format: /sweeps/results?since=0&limit=16
+ */
+void handleSweepResults(HttpExchange& http) {
+  ApiArgs args;
+  if (!apiParseArgs(http, SWEEP_RESULTS_PARAMS, args)) {
+    return;
+  }
+  long since = args.value("since");
+  long limit = args.value("limit");
+
+  SweepStatus status = sweepStatus();
+  long next = since;
+  while (next < since + limit && next < SWEEP_MAX_STEPS && sweepStep((uint16_t)next)) {
+    next++;
+  }
+  bool done = status.state != SWEEP_RUNNING && next >= status.stepsDone;
+
+  ResponseWriter response(http);
+  response.beginObject();
+  writeSweepStatus(response);
+  response.field("since", since);
+  response.field("next", next);
+  response.field("done", done);
+  response.key("results");
+  response.beginArray();
+  for (long index = since; index < next; index++) {
+    const SweepStep* step = sweepStep((uint16_t)index);
+    response.beginObject();
+    response.field("step", index);
+    response.field("value", step->value);
+    response.field("cycles", step->cycles);
+    response.field("timeouts", step->timeouts);
+    if (writeRunningStats(response, "charge_us", step->chargeUs)) response.endObject();
+    if (writeRunningStats(response, "holdup_us", step->holdupUs)) response.endObject();
+    if (writeRunningStats(response, "end_mv", step->endMv)) response.endObject();
+    response.field("max_gap_error_us", step->maxGapErrorUs);
+    response.endObject();
+  }
+  response.endArray();
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Handles the /sweeps/stop API call (POST method): ends the running
+ * sweep and the charge it started. Completed steps stay readable.
+ */
+void handleSweepStop(HttpExchange& http) {
+  bool running = sweepActive();
+  sweepStop();
+  if (running) {
+    chargeStop();
+  }
+  http.send(200, "application/json", ArenaString("{\"status\":\"success\", \"message\":\"") +
+            (running ? "Sweep stopped." : "No sweep running.") + "\"}");
+}
+
+/**
+ * @brief Handles the /stats API call: per-cycle statistics since the last
+ * reset, with p50/p95 estimates.
+ */
+void handleStats(HttpExchange& http) {
+  holdupService();
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("since_reset_ms", statsSinceResetMs());
+  for (int id = 0; id < STATS_METRIC_COUNT; id++) {
+    const StatsMetric& metric = statsMetric((StatsMetricId)id);
+    if (!writeRunningStats(response, statsMetricName((StatsMetricId)id), metric.running)) {
+      continue;
+    }
+    response.field("variance", runningStatsVariance(metric.running), 1);
+    response.field("p50", p2Value(metric.p50), 1);
+    response.field("p95", p2Value(metric.p95), 1);
+    response.endObject();
+  }
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Handles the /stats/reset API call (POST method): starts a new experiment.
+ */
+void handleStatsReset(HttpExchange& http) {
+  statsReset();
+  http.send(200, "application/json", "{\"status\":\"success\", \"message\":\"Statistics cleared.\"}");
+}
+
+/**
+ * @brief Handles the /holdup API call: relay hold-up statistics and the most
+ * recent measurements, in microseconds.
+ */
+void handleHoldup(HttpExchange& http) {
+  holdupService();
+  const HoldupStats& stats = holdupStats();
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("enabled", holdupEnabled());
+  response.field("contact_pin", holdupContactPin());
+  response.field("contact", holdupContactClosed() ? "closed" : "open");
+  response.field("pending_us", holdupPendingUs());
+  response.field("count", stats.count);
+  response.field("last_us", stats.lastUs);
+  response.field("min_us", stats.minUs);
+  response.field("max_us", stats.maxUs);
+  response.field("mean_us", stats.meanUs, 1);
+  response.field("stddev_us", stats.stddevUs, 1);
+  response.field("interrupted", stats.interrupted);
+  response.field("no_pull_in", stats.noPullIn);
+  response.field("timeouts", stats.timeouts);
+  response.key("recent");
+  response.beginArray();
+  HoldupRecord recent[HOLDUP_HISTORY];
+  uint8_t count = holdupHistory(recent, HOLDUP_HISTORY);
+  for (uint8_t i = 0; i < count; i++) {
+    response.beginObject();
+    response.field("seq", recent[i].sequence);
+    response.field("charge_us", recent[i].chargeUs);
+    response.field("holdup_us", recent[i].holdupUs);
+    response.endObject();
+  }
+  response.endArray();
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Handles the /holdup/reset API call (POST method): clears the
+ * statistics and the recent measurements.
+ */
+void handleHoldupReset(HttpExchange& http) {
+  holdupReset();
+  http.send(200, "application/json", "{\"status\":\"success\", \"message\":\"Hold-up statistics cleared.\"}");
+}
+
+/**
+ * @brief Handles the /health API call.
+ */
+void handleHealth(HttpExchange& http) {
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("status", "ok");
+  response.field("device", platform.device);
+  response.field("uptime_ms", halMillis());
+  if (udpControlPort() > 0) {
+    const UdpControlStats& udp = udpControlStats();
+    response.key("udp_control");
+    response.beginObject();
+    response.field("port", udpControlPort());
+    response.field("received", udp.received);
+    response.field("repeated", udp.repeated);
+    response.field("dropped", udp.dropped);
+    response.endObject();
+  }
+  const SerialControlStats& serial = serialControlStats();
+  response.key("serial_control");
+  response.beginObject();
+  response.field("frames", serial.frames);
+  response.field("repeated", serial.repeated);
+  response.field("corrupt", serial.corrupt);
+  response.endObject();
+  if (platform.appendHealth) {
+    platform.appendHealth(response);
+  }
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Handles the /system/arena API call: per-route use of the request
+ * arena, for sizing ARENA_BYTES. Unmatched requests are listed with a null uri.
+ */
+void handleSystemArena(HttpExchange& http) {
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("capacity_bytes", ARENA_BYTES);
+  response.key("routes");
+  response.beginArray();
+  for (size_t i = 0; i < arenaRouteCount(); i++) {
+    const ArenaRouteStats& stats = arenaRouteStats(i);
+    response.beginObject();
+    if (stats.route) {
+      response.field("method", stats.route->method == HTTP_METHOD_POST ? "POST" : "GET");
+      response.field("uri", stats.route->uri);
+    } else {
+      response.nullField("method");
+      response.nullField("uri");
+    }
+    response.field("requests", stats.requests);
+    response.field("peak_bytes", stats.peakBytes);
+    response.field("mean_bytes", stats.requests ? stats.totalBytes / stats.requests : 0);
+    response.field("overflows", stats.overflows);
+    response.endObject();
+  }
+  response.endArray();
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Handles the /info API call, providing project context.
+ */
+void handleInfo(HttpExchange& http) {
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("project", "Scrooge Capacitor Test Bench");
+  response.field("description", "Tests capacitor charge/discharge for zero-leakage switching using relays (no transistors/MOSFETs).");
+  response.field("repository", "https://github.com/psmgeelen/ESP32_API_TestBench");
+  response.field("charge_pin", chargePin());
+  response.field("api_version", "1.0.1");
+  response.endObject();
+  response.send(http);
+}
+
+/**
+ * @brief Handles any 404 not found errors.
+ */
+void handleNotFound(HttpExchange& http) {
+  ArenaString message = "Resource Not Found\n\n";
+  message += "URI: ";
+  message += http.uri();
+  message += "\nMethod: ";
+  message += (http.method() == HTTP_METHOD_GET) ? "GET" : (http.method() == HTTP_METHOD_POST ? "POST" : "OTHER");
+  http.send(404, "text/plain", message);
+}
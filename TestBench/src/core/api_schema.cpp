@@ -0,0 +1,89 @@
+#include "core/api_schema.h"
+
+#include <string.h>
+
+#include "core/http_request.h"
+#include "core/request_arena.h"
+
+static int findParam(const ApiArgs& args, const char* name) {
+  for (size_t i = 0; i < args.count; i++) {
+    if (strcmp(args.params[i].name, name) == 0) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+bool ApiArgs::has(const char* name) const {
+  int index = findParam(*this, name);
+  return index >= 0 && present[index];
+}
+
+long ApiArgs::value(const char* name) const {
+  int index = findParam(*this, name);
+  return index >= 0 ? values[index] : 0;
+}
+
+/**
+ * @brief Answers 400 with "'name' must ..." describing the accepted values.
+ */
+static void sendInvalid(HttpExchange& http, const ApiParam& param) {
+  ArenaString message = ArenaString("'") + param.name + "' must be ";
+  if (param.type == API_PARAM_BOOLEAN) {
+    message += "true or false";
+  } else if (param.type == API_PARAM_ENUM) {
+    for (uint8_t i = 0; i < param.choiceCount; i++) {
+      if (i > 0) message += i + 1 == param.choiceCount ? " or " : ", ";
+      message += param.choices[i];
+    }
+  } else if (param.maximum != LONG_MAX) {
+    message += "an integer between " + arenaToString(param.minimum) + " and " + arenaToString(param.maximum);
+  } else if (param.minimum != LONG_MIN) {
+    message += "an integer of at least " + arenaToString(param.minimum);
+  } else {
+    message += "an integer";
+  }
+  if (param.unit && param.type == API_PARAM_INTEGER) {
+    message += ArenaString(" ") + param.unit;
+  }
+  http.send(400, "application/json", "{\"status\":\"error\", \"message\":\"" + message + ".\"}");
+}
+
+bool apiParseArgs(HttpExchange& http, const ApiParam* params, size_t count, ApiArgs& args) {
+  args.params = params;
+  args.count = count;
+  for (size_t i = 0; i < count; i++) {
+    const ApiParam& param = params[i];
+    args.present[i] = http.hasArg(param.name);
+    args.values[i] = param.hasDefault ? param.defaultValue : 0;
+    if (!args.present[i]) {
+      if (param.isRequired) {
+        http.send(400, "application/json", ArenaString("{\"status\":\"error\", \"message\":\"Missing '") + param.name +
+                  "' parameter.\"}");
+        return false;
+      }
+      continue;
+    }
+
+    std::string text = http.arg(param.name);
+    bool valid = false;
+    if (param.type == API_PARAM_INTEGER) {
+      long value = 0;
+      valid = requestParseInteger(text, &value) && value >= param.minimum && value <= param.maximum;
+      args.values[i] = value;
+    } else if (param.type == API_PARAM_BOOLEAN) {
+      valid = text == "true" || text == "1" || text == "false" || text == "0";
+      args.values[i] = text == "true" || text == "1";
+    } else {
+      for (uint8_t c = 0; c < param.choiceCount && !valid; c++) {
+        valid = text == param.choices[c];
+        args.values[i] = c;
+      }
+    }
+    if (!valid) {
+      sendInvalid(http, param);
+      return false;
+    }
+  }
+  return true;
+}
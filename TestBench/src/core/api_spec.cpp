@@ -0,0 +1,49 @@
+#include "core/api.h"
+
+#include "core/routes.h"
+
+// OpenAPI 3.0 specification of the core routes, rendered from CORE_ROUTES by
+// the compiler. The firmware serves its own render that adds the ESP32-only
+// routes (ApiPlatform::openApiJson).
+static constexpr ApiRouteTable CORE_TABLES[] = {{CORE_ROUTES, CORE_ROUTE_COUNT}};
+static constexpr ApiRouteList CORE_ROUTE_LIST = {CORE_TABLES, 1};
+static constexpr auto CORE_OPENAPI =
+    openApiRender<openApiSize(API_INFO, CORE_ROUTE_LIST)>(API_INFO, CORE_ROUTE_LIST);
+
+const char* swaggerJson = CORE_OPENAPI.text;
+
+// HTML for the Swagger UI page, loading assets from a CDN
+const char* swaggerHtml = R"rawliteral(
+<!DOCTYPE html>
+<html lang="en">
+<head>
+  <meta charset="UTF-8">
+  <title>ESP32 Capacitor Charger API</title>
+  <link rel="stylesheet" type="text/css" href="https://cdnjs.cloudflare.com/ajax/libs/swagger-ui/3.52.0/swagger-ui.css" >
+  <style>
+    body { font-family: 'Inter', sans-serif; background-color: #f0f0f0; }
+    .topbar a span { content: "Capacitor Charger (Project Scrooge)"; }
+  </style>
+</head>
+<body>
+  <div id="swagger-ui"></div>
+  <script src="https://cdnjs.cloudflare.com/ajax/libs/swagger-ui/3.52.0/swagger-ui-bundle.js"></script>
+  <script>
+    window.onload = function() {
+      // Build a system
+      const ui = SwaggerUIBundle({
+        url: window.location.origin + "/swagger.json", // Load the OpenAPI spec from our ESP32 endpoint
+        dom_id: '#swagger-ui',
+        deepLinking: true,
+        presets: [
+          SwaggerUIBundle.presets.apis,
+          SwaggerUIBundle.SwaggerUIStandalonePreset
+        ],
+        layout: "BaseLayout"
+      });
+      window.ui = ui;
+    };
+  </script>
+</body>
+</html>
+)rawliteral";
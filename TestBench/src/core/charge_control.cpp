@@ -0,0 +1,379 @@
+#include "core/charge_control.h"
+
+#include <atomic>
+
+#include "core/cycle_stats.h"
+#include "hal/adc.h"
+#include "hal/clock.h"
+#include "hal/gpio.h"
+#include "hal/log.h"
+
+// Non-blocking charge state management
+// These are only used from the main loop (loop() and the HTTP and UDP handlers); the closed-loop fields below are
+// shared with the sampler callback, which runs in the esp_timer task on the ESP32.
+static volatile bool isCharging = false;
+static uint32_t chargeStartTime = 0;
+static uint32_t chargeDuration = 0;
+static int pin = -1;
+static void (*activeCallback)(bool) = nullptr;
+static uint64_t pinHighUs = 0;
+
+// Discharge output. The *LowUs timestamps enforce the break-before-make gap
+// in both directions.
+static int dischargePinNumber = -1;
+static bool discharging = false;
+static uint64_t chargeLowUs = 0;
+static uint64_t dischargeLowUs = 0;
+
+// Closed-loop charging. The sampler callback runs outside loop() (the
+// esp_timer task on the ESP32) and drives the pin LOW itself; chargeMonitor()
+// then finishes the cycle. cutoffDone publishes the sampler's fields to loop().
+static int sensePin = -1;
+static uint32_t samplePeriodUs = CHARGE_SAMPLE_PERIOD_US;
+static float senseScale = 1.0f;
+static volatile uint32_t targetMv = 0;
+static volatile uint32_t senseMv = 0;
+static volatile uint32_t sampleCount = 0;
+static volatile uint64_t lastBelowUs = 0;
+static volatile uint64_t crossingUs = 0;
+static volatile uint64_t cutoffUs = 0;
+static volatile uint32_t cutoffMv = 0;
+static std::atomic<bool> cutoffDone(false);
+
+// Written by the sampler, read from loop() below captureCount.
+static uint16_t capture[CHARGE_CAPTURE_SAMPLES];
+static volatile uint32_t captureCount = 0;
+
+// Set by chargeEmergencyStop() from any context, cleared by chargeStop().
+static std::atomic<bool> emergencyStopped(false);
+
+static ChargeResult lastResult = {};
+static uint32_t maxLatencyUs = 0;
+static uint32_t stateVersion = 0;
+
+static void setActive(bool active) {
+  isCharging = active;
+  stateVersion++;
+  if (activeCallback) {
+    activeCallback(active);
+  }
+}
+
+/**
+ * @brief Sampler callback (sampler context): cuts the charge at the target.
+ */
+static void onSample(int millivolts, uint64_t atUs) {
+  if (cutoffDone.load(std::memory_order_relaxed)) {
+    return;
+  }
+  uint32_t mv = (uint32_t)(millivolts * senseScale + 0.5f);
+  senseMv = mv;
+  sampleCount = sampleCount + 1;
+  if (captureCount < CHARGE_CAPTURE_SAMPLES) {
+    capture[captureCount] = mv > 0xFFFF ? 0xFFFF : (uint16_t)mv;
+    captureCount = captureCount + 1;
+  }
+  if (mv < targetMv) {
+    lastBelowUs = atUs;
+    return;
+  }
+  halDigitalWrite(pin, HAL_LOW);
+  cutoffUs = halMicros();
+  crossingUs = atUs;
+  cutoffMv = mv;
+  cutoffDone.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief Records the outcome of the cycle that just ended and notifies.
+ */
+static void finishCycle(ChargeEndReason reason, uint64_t pinLowUs) {
+  ChargeResult result = {};
+  result.reason = reason;
+  result.targetMv = targetMv;
+  result.samples = sampleCount;
+  result.chargeUs = (uint32_t)(pinLowUs - pinHighUs);
+  result.endUs = pinLowUs;
+  // Read straight after the pin went LOW, before the capacitor sags.
+  result.endMv = reason == CHARGE_END_TARGET ? cutoffMv : chargeReadSenseMv();
+  chargeLowUs = pinLowUs;
+  if (reason == CHARGE_END_TARGET) {
+    result.cutoffMv = cutoffMv;
+    result.latencyUs = (uint32_t)(cutoffUs - lastBelowUs);
+    result.reactionUs = (uint32_t)(cutoffUs - crossingUs);
+    if (result.latencyUs > maxLatencyUs) {
+      maxLatencyUs = result.latencyUs;
+    }
+  }
+  lastResult = result;
+  if (reason != CHARGE_END_STOPPED) {
+    statsRecord(STATS_PULSE_WIDTH_US, result.chargeUs);
+    if (chargeHasSense()) {
+      statsRecord(STATS_END_MV, result.endMv);
+    }
+  }
+  targetMv = 0;
+  setActive(false);
+}
+
+void chargeBegin(int chargePinNumber) {
+  pin = chargePinNumber;
+  halPinOutput(pin);
+  halDigitalWrite(pin, HAL_LOW);
+}
+
+void chargeSetSense(int sensePinNumber, uint32_t periodUs, float mvScale) {
+  sensePin = sensePinNumber;
+  samplePeriodUs = periodUs;
+  senseScale = mvScale;
+}
+
+void chargeSetDischargePin(int pinNumber) {
+  dischargePinNumber = pinNumber;
+  discharging = false;
+  if (dischargePinNumber >= 0) {
+    halPinOutput(dischargePinNumber);
+    halDigitalWrite(dischargePinNumber, HAL_LOW);
+  }
+}
+
+void chargeSetActiveCallback(void (*callback)(bool active)) {
+  activeCallback = callback;
+}
+
+/**
+ * @brief Starts a validated cycle: notifies, then drives the pin HIGH.
+ */
+static void beginCycle(long durationMs, uint32_t target) {
+  // Notify first so a PM lock is held before the pin goes HIGH.
+  setActive(true);
+  chargeStartTime = halMillis();
+  chargeDuration = (uint32_t)durationMs;
+  targetMv = target;
+  senseMv = 0;
+  sampleCount = 0;
+  if (target > 0) {
+    captureCount = 0;
+  }
+  cutoffDone.store(false);
+
+  // Immediately set pin HIGH
+  halDigitalWrite(pin, HAL_HIGH);
+  // An emergency stop between the caller's check and the write above.
+  if (emergencyStopped.load()) {
+    halDigitalWrite(pin, HAL_LOW);
+  }
+  pinHighUs = halMicros();
+  lastBelowUs = pinHighUs;
+}
+
+/**
+ * @brief Break-before-make on the charge side: the discharge output must be
+ * off and have been off for the dead time.
+ */
+static bool dischargeSettled() {
+  return !discharging && (dischargePinNumber < 0 || halMicros() - dischargeLowUs >= CHARGE_DEAD_TIME_US);
+}
+
+ChargeStartResult chargeStart(long durationMs) {
+  if (isCharging || emergencyStopped.load() || !dischargeSettled()) {
+    return CHARGE_BUSY;
+  }
+  if (durationMs < CHARGE_MIN_MS || durationMs > CHARGE_MAX_MS) {
+    return CHARGE_INVALID_DURATION;
+  }
+
+  beginCycle(durationMs, 0);
+  halLog("Charge initiated for %d ms.\n", (int)durationMs);
+  return CHARGE_STARTED;
+}
+
+ChargeStartResult chargeStartToTarget(long target, long timeoutMs) {
+  if (isCharging || emergencyStopped.load() || !dischargeSettled()) {
+    return CHARGE_BUSY;
+  }
+  if (sensePin < 0) {
+    return CHARGE_NO_SENSE;
+  }
+  if (timeoutMs < CHARGE_MIN_MS || timeoutMs > CHARGE_MAX_MS) {
+    return CHARGE_INVALID_DURATION;
+  }
+  if (target < 1 || target > chargeMaxTargetMv()) {
+    return CHARGE_INVALID_TARGET;
+  }
+
+  beginCycle(timeoutMs, (uint32_t)target);
+  if (!halSamplerStart(sensePin, samplePeriodUs, onSample)) {
+    halDigitalWrite(pin, HAL_LOW);
+    targetMv = 0;
+    setActive(false);
+    return CHARGE_NO_SENSE;
+  }
+  halLog("Charge to %d mV initiated (timeout %d ms).\n", (int)target, (int)timeoutMs);
+  return CHARGE_STARTED;
+}
+
+void HAL_ISR_ATTR chargeEmergencyStop() {
+  emergencyStopped.store(true);
+  halDigitalWriteFromIsr(pin, HAL_LOW);
+}
+
+bool chargeStop() {
+  halSamplerStop();
+  halDigitalWrite(pin, HAL_LOW); // Turn off the charge immediately
+  if (!isCharging) {
+    chargeLowUs = halMicros();
+    emergencyStopped.store(false);
+    return false;
+  }
+  finishCycle(CHARGE_END_STOPPED, halMicros());
+  emergencyStopped.store(false);
+  halLog("Emergency stop requested. Charge pin set LOW.\n");
+  return true;
+}
+
+bool chargeMonitor() {
+  if (!isCharging) {
+    return false;
+  }
+  if (targetMv > 0 && cutoffDone.load(std::memory_order_acquire)) {
+    halSamplerStop();
+    finishCycle(CHARGE_END_TARGET, cutoffUs);
+    halLog("Charge reached %d mV after %d us (cutoff latency %d us).\n", (int)lastResult.cutoffMv,
+           (int)lastResult.chargeUs, (int)lastResult.latencyUs);
+    return true;
+  }
+  // This is the non-blocking way to check time elapsed, safely handling millis() overflow.
+  if (halMillis() - chargeStartTime >= chargeDuration) {
+    if (targetMv > 0) {
+      halSamplerStop();
+      if (cutoffDone.load(std::memory_order_acquire)) {
+        // The target was reached in the same instant; report it as such.
+        return chargeMonitor();
+      }
+    }
+    halDigitalWrite(pin, HAL_LOW); // Turn off the charge
+    bool timedOut = targetMv > 0;
+    finishCycle(timedOut ? CHARGE_END_TIMEOUT : CHARGE_END_DURATION, halMicros());
+    if (timedOut) {
+      halLog("Charge timed out after %d ms below %d mV. Pin set LOW.\n", (int)chargeDuration,
+             (int)lastResult.targetMv);
+    } else {
+      halLog("Charge complete after %d ms. Pin set LOW.\n", (int)chargeDuration);
+    }
+    return true;
+  }
+  return false;
+}
+
+bool chargeActive() {
+  return isCharging;
+}
+
+uint32_t chargeStateVersion() {
+  return stateVersion;
+}
+
+int chargePin() {
+  return pin;
+}
+
+uint32_t chargeDurationMs() {
+  return chargeDuration;
+}
+
+uint32_t chargeRemainingMs() {
+  if (!isCharging) {
+    return 0;
+  }
+  uint32_t timeElapsed = halMillis() - chargeStartTime;
+  // Use ternary to prevent underflow if chargeMonitor() hasn't run yet.
+  return chargeDuration > timeElapsed ? chargeDuration - timeElapsed : 0;
+}
+
+bool chargePinHigh() {
+  return halDigitalRead(pin) == HAL_HIGH;
+}
+
+uint32_t chargeTargetMv() {
+  return targetMv;
+}
+
+uint32_t chargeSenseMv() {
+  return senseMv;
+}
+
+long chargeMaxTargetMv() {
+  return (long)(SENSE_FULL_SCALE_MV * senseScale);
+}
+
+size_t chargeCaptureCount() {
+  return captureCount;
+}
+
+uint16_t chargeCaptureSample(size_t index) {
+  return index < captureCount ? capture[index] : 0;
+}
+
+uint32_t chargeSamplePeriodUs() {
+  return samplePeriodUs;
+}
+
+const ChargeResult& chargeLastResult() {
+  return lastResult;
+}
+
+const char* chargeEndReasonName(ChargeEndReason reason) {
+  switch (reason) {
+    case CHARGE_END_DURATION: return "duration";
+    case CHARGE_END_TARGET: return "target";
+    case CHARGE_END_TIMEOUT: return "timeout";
+    case CHARGE_END_STOPPED: return "stopped";
+    default: return "none";
+  }
+}
+
+uint32_t chargeMaxLatencyUs() {
+  return maxLatencyUs;
+}
+
+uint32_t chargeReadSenseMv() {
+  if (sensePin < 0) {
+    return 0;
+  }
+  return (uint32_t)(halAnalogReadMilliVolts(sensePin) * senseScale + 0.5f);
+}
+
+bool chargeHasSense() {
+  return sensePin >= 0;
+}
+
+bool dischargeOn() {
+  if (dischargePinNumber < 0 || isCharging || chargePinHigh() || halMicros() - chargeLowUs < CHARGE_DEAD_TIME_US) {
+    return false;
+  }
+  if (!discharging) {
+    discharging = true;
+    halDigitalWrite(dischargePinNumber, HAL_HIGH);
+  }
+  return true;
+}
+
+void dischargeOff() {
+  if (dischargePinNumber < 0) {
+    return;
+  }
+  halDigitalWrite(dischargePinNumber, HAL_LOW);
+  if (discharging) {
+    discharging = false;
+    dischargeLowUs = halMicros();
+  }
+}
+
+bool dischargeActive() {
+  return discharging;
+}
+
+int dischargePin() {
+  return dischargePinNumber;
+}
@@ -0,0 +1,208 @@
+#include "core/cycle_control.h"
+
+#include <stdio.h>
+
+#include "core/charge_control.h"
+#include "hal/clock.h"
+#include "hal/log.h"
+
+static CycleDefinition queue[CYCLE_QUEUE_CAPACITY];
+static uint8_t queueHead = 0;
+static uint8_t queueCount = 0;
+static uint16_t doneInBatch = 0;
+
+static CyclePhase phase = CYCLE_IDLE;
+static uint32_t phaseStartMs = 0;
+static uint32_t cycleStartMs = 0;
+static uint32_t runStartMs = 0;
+static uint32_t runEndMs = 0;
+
+static uint32_t completed = 0;
+static uint32_t dischargeTimeouts = 0;
+static uint32_t lastCycleMs = 0;
+static uint32_t lastDischargeMs = 0;
+
+static void enterPhase(CyclePhase next) {
+  phase = next;
+  phaseStartMs = halMillis();
+}
+
+/**
+ * @brief Finishes one cycle of the head batch and moves on to the next.
+ */
+static void completeCycle(bool timedOut) {
+  uint32_t now = halMillis();
+  lastDischargeMs = now - phaseStartMs;
+  lastCycleMs = now - cycleStartMs;
+  completed++;
+  if (timedOut) {
+    dischargeTimeouts++;
+    halLog("Cycle %u: discharge timed out after %u ms.\n", (unsigned)completed, (unsigned)lastDischargeMs);
+  }
+
+  if (++doneInBatch >= queue[queueHead].count) {
+    queueHead = (queueHead + 1) % CYCLE_QUEUE_CAPACITY;
+    queueCount--;
+    doneInBatch = 0;
+  }
+  if (queueCount == 0) {
+    runEndMs = now;
+    enterPhase(CYCLE_IDLE);
+    halLog("Cycle queue done: %u cycles in %u ms.\n", (unsigned)completed, (unsigned)(runEndMs - runStartMs));
+  } else {
+    enterPhase(CYCLE_WAITING);
+  }
+}
+
+// Text of the last range error returned by cycleEnqueue().
+static char rangeErrorText[80];
+
+/**
+ * @brief Formats "'name' must be between minimum and maximum unit." from the limits themselves.
+ */
+static const char* rangeError(const char* name, long minimum, long maximum, const char* unit = nullptr) {
+  snprintf(rangeErrorText, sizeof(rangeErrorText), "'%s' must be between %ld and %ld%s%s.", name, minimum, maximum,
+           unit ? " " : "", unit ? unit : "");
+  return rangeErrorText;
+}
+
+const char* cycleEnqueue(const CycleDefinition& definition) {
+  if (!chargeHasSense()) {
+    return "Cycles need a sense input to detect the end of the discharge.";
+  }
+  if (definition.chargeMs < (uint32_t)CHARGE_MIN_MS || definition.chargeMs > (uint32_t)CHARGE_MAX_MS) {
+    return rangeError("charge_ms", CHARGE_MIN_MS, CHARGE_MAX_MS, "ms");
+  }
+  if (definition.targetMv > (uint32_t)chargeMaxTargetMv()) {
+    return "'target_mv' is above the sense input range.";
+  }
+  if (definition.holdMs > CYCLE_MAX_HOLD_MS) {
+    return rangeError("hold_ms", 0, CYCLE_MAX_HOLD_MS, "ms");
+  }
+  if (definition.dischargeMv < 1 || definition.dischargeMv > (uint32_t)chargeMaxTargetMv()) {
+    return "'discharge_mv' must be within the sense input range.";
+  }
+  if (definition.dischargeTimeoutMs < CYCLE_MIN_DISCHARGE_TIMEOUT_MS ||
+      definition.dischargeTimeoutMs > CYCLE_MAX_DISCHARGE_TIMEOUT_MS) {
+    return rangeError("discharge_timeout_ms", CYCLE_MIN_DISCHARGE_TIMEOUT_MS, CYCLE_MAX_DISCHARGE_TIMEOUT_MS,
+                      "ms");
+  }
+  if (definition.count < 1 || definition.count > CYCLE_MAX_COUNT) {
+    return rangeError("count", 1, CYCLE_MAX_COUNT);
+  }
+  if (queueCount == CYCLE_QUEUE_CAPACITY) {
+    return "Cycle queue is full.";
+  }
+
+  if (queueCount == 0) {
+    // A new run: throughput is measured from here.
+    completed = 0;
+    dischargeTimeouts = 0;
+    runStartMs = halMillis();
+    enterPhase(CYCLE_WAITING);
+  }
+  queue[(queueHead + queueCount) % CYCLE_QUEUE_CAPACITY] = definition;
+  queueCount++;
+  halLog("Queued %u cycles.\n", (unsigned)definition.count);
+  return nullptr;
+}
+
+void cycleStop() {
+  dischargeOff();
+  if (phase != CYCLE_IDLE) {
+    runEndMs = halMillis();
+    halLog("Cycle queue cleared after %u cycles.\n", (unsigned)completed);
+  }
+  queueHead = 0;
+  queueCount = 0;
+  doneInBatch = 0;
+  enterPhase(CYCLE_IDLE);
+}
+
+bool cycleService() {
+  if (phase == CYCLE_IDLE) {
+    return false;
+  }
+  const CycleDefinition& definition = queue[queueHead];
+  uint32_t elapsed = halMillis() - phaseStartMs;
+
+  switch (phase) {
+    case CYCLE_WAITING: {
+      ChargeStartResult result = definition.targetMv > 0
+                                     ? chargeStartToTarget(definition.targetMv, definition.chargeMs)
+                                     : chargeStart(definition.chargeMs);
+      if (result == CHARGE_STARTED) {
+        cycleStartMs = halMillis();
+        enterPhase(CYCLE_CHARGING);
+      } else if (result != CHARGE_BUSY) {
+        // Validated on enqueue, so only a failing sampler gets here.
+        halLog("Cycle charge could not start (%d). Queue cleared.\n", (int)result);
+        cycleStop();
+      }
+      return false;
+    }
+
+    case CYCLE_CHARGING:
+      if (chargeActive()) {
+        return false;
+      }
+      if (chargeLastResult().reason == CHARGE_END_STOPPED) {
+        cycleStop();
+        return false;
+      }
+      enterPhase(CYCLE_HOLDING);
+      return false;
+
+    case CYCLE_HOLDING:
+      // Without a discharge output the capacitor bleeds down passively.
+      if (elapsed < definition.holdMs || (dischargePin() >= 0 && !dischargeOn())) {
+        return false;
+      }
+      enterPhase(CYCLE_DISCHARGING);
+      return false;
+
+    case CYCLE_DISCHARGING: {
+      bool timedOut = elapsed >= definition.dischargeTimeoutMs;
+      if (!timedOut && chargeReadSenseMv() >= definition.dischargeMv) {
+        return false;
+      }
+      dischargeOff();
+      completeCycle(timedOut);
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+bool cycleActive() {
+  return phase != CYCLE_IDLE;
+}
+
+CycleStatus cycleStatus() {
+  CycleStatus status = {};
+  status.phase = phase;
+  status.batches = queueCount;
+  for (uint8_t i = 0; i < queueCount; i++) {
+    status.queued += queue[(queueHead + i) % CYCLE_QUEUE_CAPACITY].count;
+  }
+  status.queued -= doneInBatch;
+  status.completed = completed;
+  status.dischargeTimeouts = dischargeTimeouts;
+  status.lastCycleMs = lastCycleMs;
+  status.lastDischargeMs = lastDischargeMs;
+  status.runMs = (phase == CYCLE_IDLE ? runEndMs : halMillis()) - runStartMs;
+  status.cyclesPerMinute = status.runMs > 0 ? completed * 60000.0f / status.runMs : 0;
+  return status;
+}
+
+const char* cyclePhaseName(CyclePhase value) {
+  switch (value) {
+    case CYCLE_WAITING: return "waiting";
+    case CYCLE_CHARGING: return "charging";
+    case CYCLE_HOLDING: return "holding";
+    case CYCLE_DISCHARGING: return "discharging";
+    default: return "idle";
+  }
+}
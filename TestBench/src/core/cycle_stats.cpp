@@ -0,0 +1,51 @@
+#include "core/cycle_stats.h"
+
+#include "hal/clock.h"
+
+static StatsMetric metrics[STATS_METRIC_COUNT];
+static uint32_t resetMs = 0;
+static bool initialised = false;
+
+static void resetMetrics() {
+  for (StatsMetric& metric : metrics) {
+    runningStatsReset(metric.running);
+    p2Reset(metric.p50, 0.5);
+    p2Reset(metric.p95, 0.95);
+  }
+  initialised = true;
+}
+
+void statsReset() {
+  resetMetrics();
+  resetMs = halMillis();
+}
+
+void statsRecord(StatsMetricId id, double value) {
+  if (!initialised) {
+    resetMetrics();
+  }
+  StatsMetric& metric = metrics[id];
+  runningStatsAdd(metric.running, value);
+  p2Add(metric.p50, value);
+  p2Add(metric.p95, value);
+}
+
+const StatsMetric& statsMetric(StatsMetricId id) {
+  if (!initialised) {
+    resetMetrics();
+  }
+  return metrics[id];
+}
+
+const char* statsMetricName(StatsMetricId id) {
+  switch (id) {
+    case STATS_PULSE_WIDTH_US: return "pulse_width_us";
+    case STATS_HOLDUP_US: return "holdup_us";
+    case STATS_END_MV: return "end_mv";
+    default: return "unknown";
+  }
+}
+
+uint32_t statsSinceResetMs() {
+  return halMillis() - resetMs;
+}
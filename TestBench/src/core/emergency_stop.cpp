@@ -0,0 +1,138 @@
+#include "core/emergency_stop.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+
+#include "core/charge_control.h"
+#include "core/cycle_control.h"
+#include "core/sweep_control.h"
+#include "hal/clock.h"
+#include "hal/gpio.h"
+#include "hal/log.h"
+
+// Each source's statistics are only written from its own context.
+static volatile EstopLatency latencies[ESTOP_SOURCE_COUNT];
+static std::atomic<bool> pending(false);
+static volatile uint32_t lastPressUs = 0;
+static int buttonPin = -1;
+static uint16_t udpPort = 0;
+
+void HAL_ISR_ATTR estopTrigger(EstopSource source, uint64_t arrivalUs) {
+  chargeEmergencyStop();
+  uint32_t latencyUs = (uint32_t)(halMicros() - arrivalUs);
+  pending.store(true);
+
+  volatile EstopLatency& latency = latencies[source];
+  latency.count = latency.count + 1;
+  latency.lastUs = latencyUs;
+  latency.totalUs = latency.totalUs + latencyUs;
+  if (latencyUs > latency.maxUs) {
+    latency.maxUs = latencyUs;
+  }
+}
+
+bool estopService() {
+  if (!pending.exchange(false)) {
+    return false;
+  }
+  cycleStop();
+  sweepStop();
+  chargeStop();
+  halLog("Emergency stop finished (button %u, UDP %u so far).\n", (unsigned)latencies[ESTOP_BUTTON].count,
+         (unsigned)latencies[ESTOP_UDP].count);
+  return true;
+}
+
+static void HAL_ISR_ATTR onButtonEdge(int level, uint64_t atUs) {
+  if (level != HAL_LOW) {
+    return;
+  }
+  // The first edge stops at once; the bounce after it is not another press.
+  if (latencies[ESTOP_BUTTON].count > 0 && (uint32_t)atUs - lastPressUs < ESTOP_DEBOUNCE_US) {
+    return;
+  }
+  lastPressUs = (uint32_t)atUs;
+  estopTrigger(ESTOP_BUTTON, atUs);
+}
+
+bool estopButtonBegin(int pin) {
+  buttonPin = pin;
+  if (pin < 0) {
+    return false;
+  }
+  halPinInput(pin, true);
+  return halAttachEdgeInterrupt(pin, onButtonEdge);
+}
+
+int estopUdpOpen(uint16_t port, bool blocking) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  socklen_t length = sizeof(addr);
+  getsockname(fd, (struct sockaddr*)&addr, &length);
+  udpPort = ntohs(addr.sin_port);
+  if (!blocking) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  }
+  return fd;
+}
+
+bool estopUdpReceive(int fd) {
+  char datagram[64];
+  struct sockaddr_in from;
+  socklen_t fromLength = sizeof(from);
+  ssize_t n = recvfrom(fd, datagram, sizeof(datagram), 0, (struct sockaddr*)&from, &fromLength);
+  uint64_t arrivalUs = halMicros();
+  if (n < 0) {
+    return false;
+  }
+  if (n < 4 || memcmp(datagram, "STOP", 4) != 0) {
+    return true;
+  }
+  estopTrigger(ESTOP_UDP, arrivalUs);
+
+  char reply[32];
+  int length = snprintf(reply, sizeof(reply), "STOPPED %u", (unsigned)latencies[ESTOP_UDP].lastUs);
+  sendto(fd, reply, length, 0, (struct sockaddr*)&from, fromLength);
+  return true;
+}
+
+bool estopLatched() {
+  return pending.load();
+}
+
+int estopButtonPin() {
+  return buttonPin;
+}
+
+uint16_t estopUdpPort() {
+  return udpPort;
+}
+
+const EstopLatency& estopLatency(EstopSource source) {
+  return const_cast<const EstopLatency&>(latencies[source]);
+}
+
+const char* estopSourceName(EstopSource source) {
+  switch (source) {
+    case ESTOP_BUTTON: return "button";
+    case ESTOP_UDP: return "udp";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,163 @@
+#include "core/holdup_monitor.h"
+
+#include <atomic>
+
+#include "core/cycle_stats.h"
+#include "core/online_stats.h"
+#include "hal/clock.h"
+#include "hal/gpio.h"
+
+// The interrupt handlers only use the low 32 bits of the timestamps: single
+// loads and stores that cannot tear, and differences stay exact up to ~71 min.
+static int contactPin = -1;
+static int chargePinNumber = -1;
+static volatile bool contactClosed = false;
+static volatile bool armed = false;
+static volatile uint32_t riseUs = 0;
+static volatile uint32_t fallUs = 0;
+static volatile uint32_t chargeUs = 0;
+static volatile uint32_t interruptedTotal = 0;
+static volatile uint32_t noPullInTotal = 0;
+
+// Completed measurements, written by the contact interrupt and drained by
+// holdupService(). One measurement needs a whole charge, so loop() cannot fall
+// this far behind.
+static const uint8_t PENDING_CAPACITY = 8;
+static HoldupRecord pending[PENDING_CAPACITY];
+static std::atomic<uint8_t> pendingHead(0);
+static uint8_t pendingTail = 0;
+
+static HoldupStats stats = {};
+static RunningStats running = {};
+static uint32_t interruptedBase = 0;
+static uint32_t noPullInBase = 0;
+static uint32_t timeoutsTotal = 0;  // Only touched by holdupService(), in loop()
+static uint32_t timeoutsBase = 0;
+static uint32_t sequence = 0;
+static HoldupRecord history[HOLDUP_HISTORY];
+static uint8_t historyNext = 0;
+
+static void HAL_ISR_ATTR onChargeEdge(int level, uint64_t atUs) {
+  if (level == HAL_HIGH) {
+    if (armed) {
+      interruptedTotal = interruptedTotal + 1;
+      armed = false;
+    }
+    riseUs = (uint32_t)atUs;
+  } else {
+    fallUs = (uint32_t)atUs;
+    chargeUs = fallUs - riseUs;
+    // A contact that is open when the charge ends never pulled in (or is not
+    // wired, reading open through its pull-up); there is nothing to wait for.
+    if (contactClosed) {
+      armed = true;
+    } else {
+      noPullInTotal = noPullInTotal + 1;
+    }
+  }
+}
+
+static void HAL_ISR_ATTR onContactEdge(int level, uint64_t atUs) {
+  contactClosed = level == HAL_LOW;
+  if (contactClosed || !armed) {
+    return;
+  }
+  armed = false;
+  uint8_t head = pendingHead.load(std::memory_order_relaxed);
+  HoldupRecord& record = pending[head % PENDING_CAPACITY];
+  record.chargeUs = chargeUs;
+  record.holdupUs = (uint32_t)atUs - fallUs;
+  pendingHead.store(head + 1, std::memory_order_release);
+}
+
+bool holdupBegin(int contact, int charge) {
+  contactPin = contact;
+  chargePinNumber = charge;
+  if (contactPin < 0) {
+    return false;
+  }
+  halPinInput(contactPin, true);
+  contactClosed = halDigitalRead(contactPin) == HAL_LOW;
+  armed = false;
+  return halAttachEdgeInterrupt(contactPin, onContactEdge) && halAttachEdgeInterrupt(chargePinNumber, onChargeEdge);
+}
+
+bool holdupService() {
+  // A contact that stays closed this long is stuck or held by something else;
+  // give up so holdupPending() does not keep the firmware awake for good.
+  if (armed && (uint32_t)halMicros() - fallUs >= HOLDUP_TIMEOUT_MS * 1000UL) {
+    armed = false;
+    timeoutsTotal++;
+  }
+
+  uint8_t head = pendingHead.load(std::memory_order_acquire);
+  if (pendingTail == head) {
+    return false;
+  }
+  while (pendingTail != head) {
+    HoldupRecord record = pending[pendingTail % PENDING_CAPACITY];
+    pendingTail++;
+    record.sequence = ++sequence;
+    history[historyNext] = record;
+    historyNext = (historyNext + 1) % HOLDUP_HISTORY;
+
+    stats.lastUs = record.holdupUs;
+    runningStatsAdd(running, record.holdupUs);
+    statsRecord(STATS_HOLDUP_US, record.holdupUs);
+  }
+  stats.count = running.count;
+  stats.minUs = (uint32_t)running.minValue;
+  stats.maxUs = (uint32_t)running.maxValue;
+  stats.meanUs = running.mean;
+  stats.stddevUs = runningStatsStddev(running);
+  return true;
+}
+
+void holdupReset() {
+  holdupService();
+  stats = {};
+  runningStatsReset(running);
+  sequence = 0;
+  historyNext = 0;
+  interruptedBase = interruptedTotal;
+  noPullInBase = noPullInTotal;
+  timeoutsBase = timeoutsTotal;
+}
+
+bool holdupEnabled() {
+  return contactPin >= 0;
+}
+
+int holdupContactPin() {
+  return contactPin;
+}
+
+bool holdupContactClosed() {
+  return contactClosed;
+}
+
+bool holdupPending() {
+  return armed;
+}
+
+uint32_t holdupPendingUs() {
+  uint32_t since = fallUs;
+  return armed ? (uint32_t)halMicros() - since : 0;
+}
+
+const HoldupStats& holdupStats() {
+  stats.interrupted = interruptedTotal - interruptedBase;
+  stats.noPullIn = noPullInTotal - noPullInBase;
+  stats.timeouts = timeoutsTotal - timeoutsBase;
+  return stats;
+}
+
+uint8_t holdupHistory(HoldupRecord* out, uint8_t max) {
+  uint8_t available = stats.count < HOLDUP_HISTORY ? (uint8_t)stats.count : HOLDUP_HISTORY;
+  uint8_t copied = 0;
+  while (copied < max && copied < available) {
+    out[copied] = history[(historyNext + HOLDUP_HISTORY - 1 - copied) % HOLDUP_HISTORY];
+    copied++;
+  }
+  return copied;
+}
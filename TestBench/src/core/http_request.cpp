@@ -0,0 +1,183 @@
+#include "core/http_request.h"
+
+#include <limits.h>
+#include <string.h>
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+/**
+ * @brief Decodes %XX escapes and '+' like WebServer::urlDecode(), in place.
+ */
+static std::string_view decodeInPlace(char* text, size_t length) {
+  size_t out = 0;
+  for (size_t i = 0; i < length; i++) {
+    char c = text[i];
+    if (c == '+') {
+      c = ' ';
+    } else if (c == '%' && i + 2 < length && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+      c = (char)(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+      i += 2;
+    }
+    text[out++] = c;
+  }
+  return std::string_view(text, out);
+}
+
+/**
+ * @brief Adds "a=1&b=2" style arguments.
+ */
+static void parseArgs(char* text, size_t length, RequestView& request) {
+  size_t start = 0;
+  while (start < length) {
+    char* pair = text + start;
+    char* end = (char*)memchr(pair, '&', length - start);
+    size_t pairLength = end ? (size_t)(end - pair) : length - start;
+    if (pairLength > 0 && request.argCount < REQUEST_MAX_ARGS) {
+      char* eq = (char*)memchr(pair, '=', pairLength);
+      size_t nameLength = eq ? (size_t)(eq - pair) : pairLength;
+      RequestArg& arg = request.args[request.argCount++];
+      arg.name = decodeInPlace(pair, nameLength);
+      arg.value = eq ? decodeInPlace(eq + 1, pairLength - nameLength - 1) : std::string_view();
+    }
+    start += pairLength + 1;
+  }
+}
+
+static bool equalsIgnoreCase(std::string_view text, const char* literal) {
+  size_t length = strlen(literal);
+  if (text.size() != length) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i++) {
+    char a = text[i];
+    char b = literal[i];
+    if (a >= 'A' && a <= 'Z') a += 'a' - 'A';
+    if (b >= 'A' && b <= 'Z') b += 'a' - 'A';
+    if (a != b) return false;
+  }
+  return true;
+}
+
+RequestParseResult requestParseHead(char* buffer, size_t length, RequestView& request) {
+  std::string_view data(buffer, length);
+  size_t headerEnd = data.find("\r\n\r\n");
+  if (headerEnd == std::string_view::npos) {
+    return REQUEST_INCOMPLETE;
+  }
+  request.method = HTTP_METHOD_OTHER;
+  request.path = std::string_view();
+  request.headerBytes = headerEnd + 4;
+  request.contentLength = 0;
+  request.formBody = false;
+  request.keepAlive = false;
+  request.accept = std::string_view();
+  request.argCount = 0;
+
+  // Request line: METHOD SP target SP version
+  size_t lineEnd = data.find("\r\n");
+  size_t sp1 = data.find(' ');
+  size_t sp2 = sp1 < lineEnd ? data.find(' ', sp1 + 1) : std::string_view::npos;
+  if (sp1 >= lineEnd || sp2 >= lineEnd) {
+    return REQUEST_MALFORMED;
+  }
+  std::string_view method = data.substr(0, sp1);
+  request.keepAlive = data.substr(sp2 + 1, lineEnd - sp2 - 1) == "HTTP/1.1";
+  request.method = method == "GET" ? HTTP_METHOD_GET : (method == "POST" ? HTTP_METHOD_POST : HTTP_METHOD_OTHER);
+
+  char* target = buffer + sp1 + 1;
+  size_t targetLength = sp2 - sp1 - 1;
+  char* question = (char*)memchr(target, '?', targetLength);
+  size_t pathLength = question ? (size_t)(question - target) : targetLength;
+  request.path = decodeInPlace(target, pathLength);
+  if (question) {
+    parseArgs(question + 1, targetLength - pathLength - 1, request);
+  }
+
+  // Headers: only the body framing, the connection's persistence and the
+  // response format matter to us.
+  bool closeRequested = false;
+  size_t pos = lineEnd + 2;
+  while (pos < headerEnd) {
+    size_t end = data.find("\r\n", pos);
+    std::string_view line = data.substr(pos, end - pos);
+    pos = end + 2;
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) continue;
+    std::string_view name = line.substr(0, colon);
+    std::string_view value = line.substr(colon + 1);
+    while (!value.empty() && value[0] == ' ') value.remove_prefix(1);
+    if (equalsIgnoreCase(name, "Content-Length")) {
+      long contentLength = 0;
+      if (!requestParseInteger(value, &contentLength) || contentLength < 0) {
+        return REQUEST_MALFORMED;
+      }
+      request.contentLength = (size_t)contentLength;
+    } else if (equalsIgnoreCase(name, "Content-Type")) {
+      request.formBody = value.find("application/x-www-form-urlencoded") != std::string_view::npos;
+    } else if (equalsIgnoreCase(name, "Accept")) {
+      request.accept = value;
+    } else if (equalsIgnoreCase(name, "Connection")) {
+      // A list of tokens, e.g. "keep-alive, Upgrade".
+      while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view token = value.substr(0, comma);
+        while (!token.empty() && token.back() == ' ') token.remove_suffix(1);
+        if (equalsIgnoreCase(token, "close")) {
+          closeRequested = true;
+        } else if (equalsIgnoreCase(token, "keep-alive")) {
+          request.keepAlive = true;
+        }
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+        while (!value.empty() && value[0] == ' ') value.remove_prefix(1);
+      }
+    }
+  }
+  if (closeRequested) {
+    request.keepAlive = false;
+  }
+  return REQUEST_OK;
+}
+
+void requestParseForm(char* body, size_t length, RequestView& request) {
+  parseArgs(body, length, request);
+}
+
+const RequestArg* requestFindArg(const RequestView& request, const char* name) {
+  std::string_view wanted(name);
+  for (uint8_t i = 0; i < request.argCount; i++) {
+    if (request.args[i].name == wanted) {
+      return &request.args[i];
+    }
+  }
+  return nullptr;
+}
+
+bool requestParseInteger(std::string_view text, long* value) {
+  bool negative = !text.empty() && text[0] == '-';
+  if (negative) {
+    text.remove_prefix(1);
+  }
+  if (text.empty()) {
+    return false;
+  }
+  // Accumulate the magnitude; the negative range is one larger.
+  unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+  unsigned long magnitude = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    unsigned long digit = (unsigned long)(c - '0');
+    if (magnitude > (limit - digit) / 10) {
+      return false;
+    }
+    magnitude = magnitude * 10 + digit;
+  }
+  *value = negative ? -(long)(magnitude - 1) - 1 : (long)magnitude;
+  return true;
+}
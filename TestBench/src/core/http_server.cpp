@@ -0,0 +1,558 @@
+#include "core/http_server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
+#include <string>
+
+#include "core/request_arena.h"
+#include "hal/clock.h"
+#include "hal/log.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// --- 1. LIMITS ---
+
+// Longest single wait for a slow client to accept more of a response (ms);
+// the onWait() callback runs between waits.
+static const uint32_t WRITE_SLICE_MS = 1;
+
+// Keep-alive defaults, see HttpServer::setKeepAlive().
+static const uint32_t DEFAULT_IDLE_TIMEOUT_MS = 5000;
+static const uint16_t DEFAULT_MAX_REQUESTS = 100;
+
+// --- 2. REQUEST / RESPONSE ---
+
+static const char* statusText(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 302: return "Found";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 408: return "Request Timeout";
+    case 409: return "Conflict";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+/**
+ * @brief Sends all parts on a non-blocking socket. While the client's window is
+ * full, waits for it in WRITE_SLICE_MS slices and runs service in between.
+ * @return false if the connection failed or timeoutMs passed.
+ */
+static bool sendAllv(int fd, struct iovec* parts, int count, void (*service)(), uint32_t timeoutMs) {
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = parts;
+  message.msg_iovlen = count;
+  uint32_t startMs = halMillis();
+  while (message.msg_iovlen > 0) {
+    ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (halMillis() - startMs >= timeoutMs) {
+        return false;
+      }
+      if (service) {
+        service();
+      }
+      fd_set writable;
+      FD_ZERO(&writable);
+      FD_SET(fd, &writable);
+      struct timeval slice = {0, WRITE_SLICE_MS * 1000};
+      select(fd + 1, nullptr, &writable, nullptr, &slice);
+      continue;
+    }
+    if (sent <= 0) {
+      if (sent < 0 && errno == EINTR) continue;
+      return false;
+    }
+    // Step over what went out; a short send can end inside a part.
+    while (message.msg_iovlen > 0 && (size_t)sent >= message.msg_iov->iov_len) {
+      sent -= message.msg_iov->iov_len;
+      message.msg_iov++;
+      message.msg_iovlen--;
+    }
+    if (message.msg_iovlen > 0) {
+      message.msg_iov->iov_base = (char*)message.msg_iov->iov_base + sent;
+      message.msg_iov->iov_len -= sent;
+    }
+  }
+  return true;
+}
+
+class SocketExchange : public HttpExchange {
+public:
+  // parkedMs: how long the request has been parked, or -1 if it cannot park.
+  SocketExchange(int fd, const RequestView& request, const RouteMatch* match, bool keepAlive, void (*service)(),
+                 int32_t parkedMs = -1)
+      : fd(fd), request(request), match(match), keepAlive(keepAlive), service(service), parkedMs(parkedMs) {}
+
+  HttpMethod method() const override { return request.method; }
+  std::string uri() const override { return std::string(request.path); }
+
+  // Path parameters take precedence over query arguments of the same name.
+  bool hasArg(const char* name) const override {
+    return (match && routeFindParam(*match, name)) || requestFindArg(request, name);
+  }
+
+  std::string arg(const char* name) const override {
+    if (match) {
+      const RouteParam* param = routeFindParam(*match, name);
+      if (param) return std::string(param->value, param->valueLength);
+    }
+    const RequestArg* found = requestFindArg(request, name);
+    return found ? std::string(found->value) : std::string();
+  }
+
+  std::string_view accept() const override { return request.accept; }
+
+  bool park(uint32_t timeoutMs) override {
+    if (parkedMs < 0 || responded || (uint32_t)parkedMs >= timeoutMs || (uint32_t)parkedMs >= HttpServer::MAX_PARK_MS) {
+      return false;
+    }
+    parkTimeoutMs = timeoutMs < HttpServer::MAX_PARK_MS ? timeoutMs : HttpServer::MAX_PARK_MS;
+    parked = true;
+    return true;
+  }
+
+  void sendHeader(const char* name, const char* value) override {
+    int n = snprintf(extraHeaders + extraLength, sizeof(extraHeaders) - extraLength, "%s: %s\r\n", name, value);
+    if (n > 0 && (size_t)n < sizeof(extraHeaders) - extraLength) {
+      extraLength += n;
+    } else {
+      extraHeaders[extraLength] = '\0';  // Dropped: does not fit
+    }
+  }
+
+  void send(int code, const char* contentType, const char* body, size_t length) override {
+    char head[160 + sizeof(extraHeaders)];
+    int headLength = snprintf(head, sizeof(head),
+                              "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n%sConnection: %s\r\n\r\n",
+                              code, statusText(code), contentType, (unsigned)length, extraHeaders,
+                              keepAlive ? "keep-alive" : "close");
+    if (headLength < 0 || (size_t)headLength >= sizeof(head)) {
+      headLength = 0;
+    }
+    // Head and body go out in one segment without being copied together.
+    struct iovec parts[2] = {{head, (size_t)headLength}, {(void*)body, length}};
+    sent = sendAllv(fd, parts, 2, service, writeTimeoutMs);
+    responded = true;
+  }
+
+  using HttpExchange::send;
+
+  bool responded = false;
+  bool sent = false;
+  bool parked = false;
+  uint32_t parkTimeoutMs = 0;
+  // 0: one attempt, nothing sent if the client's window is full.
+  uint32_t writeTimeoutMs = HttpServer::WRITE_TIMEOUT_MS;
+
+private:
+  int fd;
+  const RequestView& request;
+  const RouteMatch* match;
+  bool keepAlive;
+  void (*service)();
+  int32_t parkedMs;
+  char extraHeaders[256] = "";
+  size_t extraLength = 0;
+};
+
+// --- 3. SERVER ---
+
+HttpServer::HttpServer()
+    : listenFd(-1), boundPort(0), router(routeNodes, MAX_ROUTE_NODES, routeSlots, ROUTE_SLOTS), notFound(nullptr),
+      waitService(nullptr), wakeVersion(nullptr), wakeCount(0), idleTimeoutMs(DEFAULT_IDLE_TIMEOUT_MS),
+      maxRequests(DEFAULT_MAX_REQUESTS), acceptedCount(0), servedCount(0), rejectedCount(0), readTimeoutCount(0),
+      writeTimeoutCount(0), parkedCount(0) {
+  for (Connection& connection : connections) {
+    connection.fd = -1;
+    connection.parked = false;
+  }
+}
+
+HttpServer::~HttpServer() {
+  close();
+}
+
+bool HttpServer::addRoutes(const ApiRoute* routes, size_t count) {
+  return router.add(routes, count);
+}
+
+void HttpServer::onNotFound(void (*handler)(HttpExchange& http)) {
+  notFound = handler;
+}
+
+void HttpServer::onWait(void (*service)()) {
+  waitService = service;
+}
+
+bool HttpServer::wakeOn(int fd) {
+  if (fd < 0 || wakeCount >= MAX_WAKE_SOCKETS) {
+    return false;
+  }
+  wakeFds[wakeCount++] = fd;
+  return true;
+}
+
+void HttpServer::wakeParkedOn(uint32_t (*version)()) {
+  wakeVersion = version;
+}
+
+void HttpServer::setKeepAlive(uint32_t timeoutMs, uint16_t requests) {
+  idleTimeoutMs = timeoutMs;
+  maxRequests = requests;
+}
+
+bool HttpServer::begin(uint16_t port) {
+  listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    return false;
+  }
+  int yes = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 8) < 0) {
+    close();
+    return false;
+  }
+
+  socklen_t len = sizeof(addr);
+  getsockname(listenFd, (struct sockaddr*)&addr, &len);
+  boundPort = ntohs(addr.sin_port);
+  fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL, 0) | O_NONBLOCK);
+  acceptedCount = 0;
+  servedCount = 0;
+  rejectedCount = 0;
+  readTimeoutCount = 0;
+  writeTimeoutCount = 0;
+  parkedCount = 0;
+  return true;
+}
+
+void HttpServer::close() {
+  for (Connection& connection : connections) {
+    closeConnection(connection);
+  }
+  if (listenFd >= 0) {
+    ::close(listenFd);
+    listenFd = -1;
+  }
+}
+
+void HttpServer::closeConnection(Connection& connection) {
+  if (connection.fd >= 0) {
+    ::close(connection.fd);
+    connection.fd = -1;
+  }
+  connection.parked = false;
+}
+
+uint8_t HttpServer::parkedNow() const {
+  uint8_t count = 0;
+  for (const Connection& connection : connections) {
+    count += connection.fd >= 0 && connection.parked;
+  }
+  return count;
+}
+
+/**
+ * @brief True once a parked request is to run again: the version moved on, or
+ * its timeout passed.
+ */
+bool HttpServer::parkedDue(const Connection& connection, uint32_t now, uint32_t version) const {
+  return version != connection.parkedVersion || now - connection.parkedAtMs >= connection.parkTimeoutMs;
+}
+
+/**
+ * @brief Whether the client of a parked connection has closed it. Bytes it
+ * sent are left for after the answer, and no longer watched until then.
+ */
+static bool parkedClientGone(int fd, bool* inputWaiting) {
+  char byte;
+  ssize_t n = recv(fd, &byte, 1, MSG_PEEK);
+  if (n > 0) {
+    *inputWaiting = true;
+    return false;
+  }
+  return n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+void HttpServer::handleClient(uint32_t waitMs) {
+  if (listenFd < 0) {
+    return;
+  }
+
+  uint32_t now = halMillis();
+  uint32_t version = wakeVersion ? wakeVersion() : 0;
+  uint32_t timeoutMs = waitMs;
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(listenFd, &readable);
+  int maxFd = listenFd;
+  bool buffered = false;
+  for (Connection& connection : connections) {
+    if (connection.fd < 0) {
+      continue;
+    }
+    if (connection.parked) {
+      // Watched only for the client closing it; due ones do not wait.
+      if (parkedDue(connection, now, version)) {
+        timeoutMs = 0;
+      } else if (connection.parkTimeoutMs - (now - connection.parkedAtMs) < timeoutMs) {
+        timeoutMs = connection.parkTimeoutMs - (now - connection.parkedAtMs);
+      }
+      if (!connection.inputWaiting) {
+        FD_SET(connection.fd, &readable);
+        maxFd = connection.fd > maxFd ? connection.fd : maxFd;
+      }
+      continue;
+    }
+    // A new connection has until the read deadline for its first request; the
+    // idle timeout only applies between requests.
+    bool reading = connection.length > 0 || connection.requests == 0;
+    if (reading && now - connection.requestStartMs >= READ_TIMEOUT_MS) {
+      readTimeoutCount++;
+      reject(connection.fd, 408, "Request not received in time");
+      closeConnection(connection);
+      continue;
+    }
+    if (!reading && now - connection.lastActiveMs >= idleTimeoutMs) {
+      closeConnection(connection);
+      continue;
+    }
+    FD_SET(connection.fd, &readable);
+    maxFd = connection.fd > maxFd ? connection.fd : maxFd;
+    buffered = buffered || connection.buffered;
+  }
+
+  for (uint8_t i = 0; i < wakeCount; i++) {
+    FD_SET(wakeFds[i], &readable);
+    maxFd = wakeFds[i] > maxFd ? wakeFds[i] : maxFd;
+  }
+
+  // A pipelined request already in a buffer is served without waiting.
+  timeoutMs = buffered ? 0 : timeoutMs;
+  struct timeval timeout;
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_usec = (timeoutMs % 1000) * 1000;
+  if (select(maxFd + 1, &readable, nullptr, nullptr, &timeout) < 0) {
+    return;
+  }
+
+  for (Connection& connection : connections) {
+    if (connection.fd >= 0 && !connection.parked && (connection.buffered || FD_ISSET(connection.fd, &readable)) &&
+        !serve(connection)) {
+      closeConnection(connection);
+    }
+  }
+  if (FD_ISSET(listenFd, &readable)) {
+    acceptConnection();
+  }
+
+  // Last, so a change made by a request above (e.g. /stop) is answered now.
+  now = halMillis();
+  version = wakeVersion ? wakeVersion() : 0;
+  for (Connection& connection : connections) {
+    if (connection.fd < 0 || !connection.parked) {
+      continue;
+    }
+    if (FD_ISSET(connection.fd, &readable) && parkedClientGone(connection.fd, &connection.inputWaiting)) {
+      closeConnection(connection);
+    } else if (parkedDue(connection, now, version) && !answer(connection)) {
+      closeConnection(connection);
+    }
+  }
+}
+
+void HttpServer::acceptConnection() {
+  int fd = ::accept(listenFd, nullptr, nullptr);
+  if (fd < 0) {
+    return;
+  }
+  acceptedCount++;
+  // Set explicitly: whether the listener's O_NONBLOCK is inherited depends on the stack.
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  // Responses are written whole; do not hold them back for the client's ACK.
+  int yes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+  for (Connection& connection : connections) {
+    if (connection.fd < 0) {
+      connection.fd = fd;
+      connection.requests = 0;
+      connection.lastActiveMs = halMillis();
+      connection.requestStartMs = connection.lastActiveMs;
+      connection.headParsed = false;
+      connection.parked = false;
+      connection.length = 0;
+      // The request often arrives with the handshake's last ACK: try it now.
+      connection.buffered = true;
+      return;
+    }
+  }
+  rejectedCount++;
+  reject(fd, 503, "Too many connections");
+  // Unread request bytes would make close() reset the connection, and the
+  // client could lose the 503 with it.
+  char discard[256];
+  while (recv(fd, discard, sizeof(discard), 0) > 0) {
+  }
+  ::close(fd);
+}
+
+/**
+ * @brief Answers an error on a connection about to be closed. Best effort: the
+ * response is small and goes out in one attempt, so a client that does not
+ * read cannot hold up the loop for the write deadline.
+ */
+void HttpServer::reject(int fd, int code, const char* message) {
+  RequestView request{};
+  SocketExchange http(fd, request, nullptr, false, nullptr);
+  http.writeTimeoutMs = 0;
+  if (code == 503) {
+    http.sendHeader("Retry-After", "1");
+  }
+  http.send(code, "text/plain", message);
+}
+
+/**
+ * @brief Reads once without waiting and answers the request if that completes
+ * it. Returns false when the connection is to be closed.
+ */
+bool HttpServer::serve(Connection& connection) {
+  connection.buffered = false;
+  RequestView& request = connection.request;
+  size_t capacity = sizeof(connection.buffer);
+  bool received = false;
+  while (true) {
+    // The head is parsed (and decoded in place) once, when it is complete.
+    if (!connection.headParsed) {
+      RequestParseResult result = requestParseHead(connection.buffer, connection.length, request);
+      if (result == REQUEST_MALFORMED) {
+        return false;
+      }
+      if (result == REQUEST_OK && (request.headerBytes > MAX_HEADER_BYTES || request.contentLength > MAX_BODY_BYTES)) {
+        reject(connection.fd, 400, "Request too large");
+        return false;
+      }
+      if (result == REQUEST_INCOMPLETE && connection.length > MAX_HEADER_BYTES) {
+        reject(connection.fd, 400, "Request too large");
+        return false;
+      }
+      connection.headParsed = result == REQUEST_OK;
+    }
+    if (connection.headParsed && connection.length >= request.headerBytes + request.contentLength) {
+      break;
+    }
+    if (received) {
+      return true;  // Incomplete: the rest comes in a later call
+    }
+
+    ssize_t n = recv(connection.fd, connection.buffer + connection.length, capacity - connection.length, 0);
+    if (n == 0) {
+      return false;
+    }
+    if (n < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    if (connection.length == 0) {
+      connection.requestStartMs = halMillis();
+    }
+    connection.length += n;
+    received = true;
+  }
+
+  if (request.formBody) {
+    requestParseForm(connection.buffer + request.headerBytes, request.contentLength, request);
+  }
+  connection.requests++;
+  return answer(connection);
+}
+
+/**
+ * @brief Runs the handler for the request in the connection's buffer, or runs
+ * it again if it was parked. Returns false when the connection is to be closed.
+ */
+bool HttpServer::answer(Connection& connection) {
+  const RequestView& request = connection.request;
+  bool keepAlive = request.keepAlive && idleTimeoutMs > 0 && connection.requests < maxRequests;
+  bool sent = dispatch(connection, keepAlive);
+  if (connection.parked) {
+    return true;
+  }
+  servedCount++;
+  if (!sent) {
+    writeTimeoutCount++;
+  }
+  if (!sent || !keepAlive) {
+    return false;
+  }
+
+  // Requests pipelined behind this one are answered in the next calls.
+  size_t used = request.headerBytes + request.contentLength;
+  memmove(connection.buffer, connection.buffer + used, connection.length - used);
+  connection.length -= used;
+  connection.headParsed = false;
+  connection.buffered = connection.length > 0;
+  connection.lastActiveMs = halMillis();
+  connection.requestStartMs = connection.lastActiveMs;
+  return true;
+}
+
+bool HttpServer::dispatch(Connection& connection, bool keepAlive) {
+  const RequestView& request = connection.request;
+  RouteMatch match;
+  bool found = router.find(request.path.data(), request.path.size(), request.method, match);
+  uint32_t now = halMillis();
+  bool wasParked = connection.parked;
+  int32_t parkedMs = -1;
+  if (wasParked) {
+    parkedMs = (int32_t)(now - connection.parkedAtMs);
+  } else if (wakeVersion && parkedNow() < MAX_PARKED) {
+    parkedMs = 0;
+  }
+  SocketExchange http(connection.fd, request, found ? &match : nullptr, keepAlive, waitService, parkedMs);
+  if (found) {
+    match.route->handler(http);
+  } else if (notFound) {
+    notFound(http);
+  }
+
+  connection.parked = http.parked && !http.responded;
+  if (connection.parked) {
+    if (!wasParked) {
+      parkedCount++;
+      connection.parkedAtMs = now;
+      connection.inputWaiting = false;
+    }
+    connection.parkTimeoutMs = http.parkTimeoutMs;
+    connection.parkedVersion = wakeVersion();
+    arenaFinishRequest(found ? match.route : nullptr);
+    return true;
+  }
+  if (!http.responded) {
+    http.send(500, "text/plain", "Handler sent no response");
+  }
+  arenaFinishRequest(found ? match.route : nullptr);
+  return http.sent;
+}
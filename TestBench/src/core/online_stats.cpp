@@ -0,0 +1,121 @@
+#include "core/online_stats.h"
+
+#include <math.h>
+
+// --- 1. WELFORD ---
+
+void runningStatsReset(RunningStats& stats) {
+  stats = {};
+}
+
+void runningStatsAdd(RunningStats& stats, double value) {
+  if (stats.count == 0 || value < stats.minValue) stats.minValue = value;
+  if (stats.count == 0 || value > stats.maxValue) stats.maxValue = value;
+  stats.count++;
+  double delta = value - stats.mean;
+  stats.mean += delta / stats.count;
+  stats.m2 += delta * (value - stats.mean);
+}
+
+double runningStatsVariance(const RunningStats& stats) {
+  return stats.count > 1 ? stats.m2 / (stats.count - 1) : 0;
+}
+
+double runningStatsStddev(const RunningStats& stats) {
+  return sqrt(runningStatsVariance(stats));
+}
+
+// --- 2. P-SQUARE ---
+
+void p2Reset(P2Quantile& quantile, double p) {
+  quantile = {};
+  quantile.p = p;
+  for (int i = 0; i < 5; i++) {
+    quantile.positions[i] = i + 1;
+  }
+  quantile.desired[0] = 1;
+  quantile.desired[1] = 1 + 2 * p;
+  quantile.desired[2] = 1 + 4 * p;
+  quantile.desired[3] = 3 + 2 * p;
+  quantile.desired[4] = 5;
+}
+
+/**
+ * @brief Piecewise parabolic prediction of marker i moved by d (+1 or -1).
+ */
+static double parabolic(const P2Quantile& q, int i, double d) {
+  const double* h = q.heights;
+  const double* n = q.positions;
+  return h[i] + d / (n[i + 1] - n[i - 1]) *
+                    ((n[i] - n[i - 1] + d) * (h[i + 1] - h[i]) / (n[i + 1] - n[i]) +
+                     (n[i + 1] - n[i] - d) * (h[i] - h[i - 1]) / (n[i] - n[i - 1]));
+}
+
+void p2Add(P2Quantile& q, double value) {
+  if (q.count < 5) {
+    // Insertion sort of the first five samples; they become the markers.
+    int i = (int)q.count;
+    while (i > 0 && q.heights[i - 1] > value) {
+      q.heights[i] = q.heights[i - 1];
+      i--;
+    }
+    q.heights[i] = value;
+    q.count++;
+    return;
+  }
+  q.count++;
+
+  // Cell of the new sample; the extreme markers follow new extremes.
+  int k;
+  if (value < q.heights[0]) {
+    q.heights[0] = value;
+    k = 0;
+  } else if (value >= q.heights[4]) {
+    if (value > q.heights[4]) q.heights[4] = value;
+    k = 3;
+  } else {
+    k = 0;
+    while (value >= q.heights[k + 1]) k++;
+  }
+  for (int i = k + 1; i < 5; i++) {
+    q.positions[i] += 1;
+  }
+  const double increments[5] = {0, q.p / 2, q.p, (1 + q.p) / 2, 1};
+  for (int i = 0; i < 5; i++) {
+    q.desired[i] += increments[i];
+  }
+
+  // Move the middle markers towards their desired positions by at most one.
+  for (int i = 1; i <= 3; i++) {
+    double offset = q.desired[i] - q.positions[i];
+    if ((offset >= 1 && q.positions[i + 1] - q.positions[i] > 1) ||
+        (offset <= -1 && q.positions[i - 1] - q.positions[i] < -1)) {
+      double d = offset >= 0 ? 1 : -1;
+      double height = parabolic(q, i, d);
+      if (q.heights[i - 1] < height && height < q.heights[i + 1]) {
+        q.heights[i] = height;
+      } else {
+        // Linear fallback keeps the markers ordered.
+        int j = i + (int)d;
+        q.heights[i] += d * (q.heights[j] - q.heights[i]) / (q.positions[j] - q.positions[i]);
+      }
+      q.positions[i] += d;
+    }
+  }
+}
+
+double p2Value(const P2Quantile& q) {
+  if (q.count == 0) {
+    return 0;
+  }
+  if (q.count <= 5) {
+    // Exact, linearly interpolated between the sorted samples.
+    double rank = q.p * (q.count - 1);
+    int below = (int)rank;
+    if (below + 1 >= (int)q.count) {
+      return q.heights[q.count - 1];
+    }
+    return q.heights[below] + (rank - below) * (q.heights[below + 1] - q.heights[below]);
+  }
+  return q.heights[2];
+}
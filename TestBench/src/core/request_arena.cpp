@@ -0,0 +1,87 @@
+#include "core/request_arena.h"
+
+#include <new>
+
+alignas(8) static uint8_t arena[ARENA_BYTES];
+static size_t top = 0;
+static size_t peak = 0;
+static bool overflowed = false;
+static bool enabled = true;
+
+static ArenaRouteStats routeStats[ARENA_MAX_ROUTES];
+static size_t routeCount = 0;
+
+static size_t rounded(size_t bytes) {
+  return (bytes + 7) & ~(size_t)7;
+}
+
+static bool inArena(const void* memory) {
+  return memory >= arena && memory < arena + ARENA_BYTES;
+}
+
+void* arenaAllocate(size_t bytes) {
+  size_t size = rounded(bytes);
+  if (enabled && size <= ARENA_BYTES - top) {
+    void* memory = arena + top;
+    top += size;
+    if (top > peak) {
+      peak = top;
+    }
+    return memory;
+  }
+  // Where std::allocator would have taken it from.
+  overflowed = overflowed || enabled;
+  return ::operator new(bytes);
+}
+
+void arenaFree(void* memory, size_t bytes) {
+  if (!inArena(memory)) {
+    ::operator delete(memory);
+    return;
+  }
+  if ((uint8_t*)memory + rounded(bytes) == arena + top) {
+    top = (uint8_t*)memory - arena;
+  }
+}
+
+void arenaFinishRequest(const ApiRoute* route) {
+  ArenaRouteStats* stats = nullptr;
+  for (size_t i = 0; i < routeCount && !stats; i++) {
+    if (routeStats[i].route == route) {
+      stats = &routeStats[i];
+    }
+  }
+  if (!stats && routeCount < ARENA_MAX_ROUTES) {
+    stats = &routeStats[routeCount++];
+    *stats = ArenaRouteStats{route, 0, 0, 0, 0};
+  }
+  if (stats) {
+    stats->requests++;
+    stats->totalBytes += peak;
+    if (peak > stats->peakBytes) {
+      stats->peakBytes = (uint32_t)peak;
+    }
+    if (overflowed) {
+      stats->overflows++;
+    }
+  }
+  top = 0;
+  peak = 0;
+  overflowed = false;
+}
+
+size_t arenaUsed() {
+  return top;
+}
+
+size_t arenaRouteCount() {
+  return routeCount;
+}
+
+const ArenaRouteStats& arenaRouteStats(size_t index) {
+  return routeStats[index];
+}
+
+void arenaSetEnabled(bool on) {
+  enabled = on;
+}
@@ -0,0 +1,387 @@
+#include "core/response_writer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// --- 1. NEGOTIATION ---
+
+static bool equalsIgnoreCase(std::string_view text, const char* literal) {
+  size_t length = strlen(literal);
+  if (text.size() != length) return false;
+  for (size_t i = 0; i < length; i++) {
+    char a = text[i];
+    if (a >= 'A' && a <= 'Z') a += 'a' - 'A';
+    if (a != literal[i]) return false;
+  }
+  return true;
+}
+
+static std::string_view trimmed(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+  return text;
+}
+
+/**
+ * @brief The format of one media range, or -1 if not one we produce. Wildcards
+ * take the default, JSON.
+ */
+static int mediaFormat(std::string_view type) {
+  if (equalsIgnoreCase(type, "application/json") || equalsIgnoreCase(type, "application/*") ||
+      equalsIgnoreCase(type, "*/*")) {
+    return RESPONSE_JSON;
+  }
+  if (equalsIgnoreCase(type, "application/cbor")) {
+    return RESPONSE_CBOR;
+  }
+  if (equalsIgnoreCase(type, "application/msgpack") || equalsIgnoreCase(type, "application/x-msgpack") ||
+      equalsIgnoreCase(type, "application/vnd.msgpack")) {
+    return RESPONSE_MSGPACK;
+  }
+  return -1;
+}
+
+/**
+ * @brief The q parameter in thousandths, 1000 when absent.
+ */
+static int qualityOf(std::string_view parameters) {
+  while (!parameters.empty()) {
+    size_t semicolon = parameters.find(';');
+    std::string_view parameter = trimmed(parameters.substr(0, semicolon));
+    parameters = semicolon == std::string_view::npos ? std::string_view() : parameters.substr(semicolon + 1);
+    if (parameter.size() < 2 || (parameter[0] != 'q' && parameter[0] != 'Q') || parameter[1] != '=') {
+      continue;
+    }
+    // 0, 1, or 0. and up to three digits (RFC 9110, 12.4.2).
+    std::string_view number = parameter.substr(2);
+    int quality = !number.empty() && number[0] == '1' ? 1000 : 0;
+    int scale = 100;
+    for (size_t i = 2; i < number.size() && i < 5 && quality < 1000; i++, scale /= 10) {
+      if (number[i] >= '0' && number[i] <= '9') quality += (number[i] - '0') * scale;
+    }
+    return quality;
+  }
+  return 1000;
+}
+
+ResponseFormat responseFormat(std::string_view accept) {
+  std::string_view ranges = accept;
+  int best = RESPONSE_JSON;
+  int bestQuality = -1;
+  while (!ranges.empty()) {
+    size_t comma = ranges.find(',');
+    std::string_view range = ranges.substr(0, comma);
+    ranges = comma == std::string_view::npos ? std::string_view() : ranges.substr(comma + 1);
+    size_t semicolon = range.find(';');
+    int format = mediaFormat(trimmed(range.substr(0, semicolon)));
+    int quality = semicolon == std::string_view::npos ? 1000 : qualityOf(range.substr(semicolon + 1));
+    if (format >= 0 && quality > 0 && quality > bestQuality) {
+      best = format;
+      bestQuality = quality;
+    }
+  }
+  return (ResponseFormat)best;
+}
+
+const char* responseContentType(ResponseFormat format) {
+  switch (format) {
+    case RESPONSE_CBOR: return "application/cbor";
+    case RESPONSE_MSGPACK: return "application/msgpack";
+    default: return "application/json";
+  }
+}
+
+// --- 2. ENCODING ---
+
+// CBOR major types (RFC 8949, 3.1).
+static const uint8_t CBOR_UNSIGNED = 0;
+static const uint8_t CBOR_NEGATIVE = 1;
+static const uint8_t CBOR_TEXT = 3;
+static const uint8_t CBOR_ARRAY = 4;
+static const uint8_t CBOR_MAP = 5;
+
+// Bytes reserved for a container's header until its count is known.
+static const size_t HEADER_RESERVE = 3;
+
+static void appendBigEndian(ArenaString& out, uint64_t value, int bytes) {
+  for (int shift = 8 * (bytes - 1); shift >= 0; shift -= 8) {
+    out += (char)(uint8_t)(value >> shift);
+  }
+}
+
+void ResponseWriter::writeHead(uint8_t major, uint64_t argument) {
+  uint8_t type = (uint8_t)(major << 5);
+  if (argument < 24) {
+    out += (char)(type | argument);
+  } else if (argument <= 0xFF) {
+    out += (char)(type | 24);
+    appendBigEndian(out, argument, 1);
+  } else if (argument <= 0xFFFF) {
+    out += (char)(type | 25);
+    appendBigEndian(out, argument, 2);
+  } else if (argument <= 0xFFFFFFFF) {
+    out += (char)(type | 26);
+    appendBigEndian(out, argument, 4);
+  } else {
+    out += (char)(type | 27);
+    appendBigEndian(out, argument, 8);
+  }
+}
+
+void ResponseWriter::beforeValue() {
+  if (depth == 0) {
+    return;
+  }
+  Container& top = stack[depth - 1];
+  if (top.object) {
+    return;  // key() has counted the member
+  }
+  if (encoding == RESPONSE_JSON && top.count > 0) {
+    out += ", ";
+  }
+  top.count++;
+}
+
+void ResponseWriter::begin(bool object) {
+  beforeValue();
+  if (depth == MAX_DEPTH) {
+    return;
+  }
+  stack[depth++] = {(uint32_t)out.size(), 0, object};
+  if (encoding == RESPONSE_JSON) {
+    out += object ? '{' : '[';
+  } else {
+    out.append(HEADER_RESERVE, '\0');
+  }
+}
+
+void ResponseWriter::end() {
+  if (depth == 0) {
+    return;
+  }
+  const Container& closed = stack[--depth];
+  if (encoding == RESPONSE_JSON) {
+    out += closed.object ? '}' : ']';
+    return;
+  }
+
+  // The count in the shortest form, at the start of the reserved bytes.
+  uint8_t head[HEADER_RESERVE];
+  size_t length;
+  uint32_t count = closed.count;
+  if (encoding == RESPONSE_CBOR) {
+    uint8_t type = (uint8_t)((closed.object ? CBOR_MAP : CBOR_ARRAY) << 5);
+    if (count < 24) {
+      head[0] = (uint8_t)(type | count);
+      length = 1;
+    } else if (count <= 0xFF) {
+      head[0] = (uint8_t)(type | 24);
+      head[1] = (uint8_t)count;
+      length = 2;
+    } else {
+      head[0] = (uint8_t)(type | 25);
+      head[1] = (uint8_t)(count >> 8);
+      head[2] = (uint8_t)count;
+      length = 3;
+    }
+  } else if (count < 16) {
+    head[0] = (uint8_t)((closed.object ? 0x80 : 0x90) | count);
+    length = 1;
+  } else {
+    head[0] = closed.object ? 0xDE : 0xDC;  // map 16, array 16
+    head[1] = (uint8_t)(count >> 8);
+    head[2] = (uint8_t)count;
+    length = 3;
+  }
+  memcpy(&out[closed.offset], head, length);
+  out.erase(closed.offset + length, HEADER_RESERVE - length);
+}
+
+void ResponseWriter::beginObject() {
+  begin(true);
+}
+
+void ResponseWriter::endObject() {
+  end();
+}
+
+void ResponseWriter::beginArray() {
+  begin(false);
+}
+
+void ResponseWriter::endArray() {
+  end();
+}
+
+void ResponseWriter::key(const char* name) {
+  if (depth > 0 && stack[depth - 1].object) {
+    Container& top = stack[depth - 1];
+    if (encoding == RESPONSE_JSON && top.count > 0) {
+      out += ", ";
+    }
+    top.count++;
+  }
+  writeString(name, strlen(name));
+  if (encoding == RESPONSE_JSON) {
+    out += ':';
+  }
+}
+
+void ResponseWriter::writeString(const char* text, size_t length) {
+  if (encoding == RESPONSE_CBOR) {
+    writeHead(CBOR_TEXT, length);
+  } else if (encoding == RESPONSE_MSGPACK) {
+    if (length < 32) {
+      out += (char)(0xA0 | length);
+    } else if (length <= 0xFF) {
+      out += (char)0xD9;
+      appendBigEndian(out, length, 1);
+    } else if (length <= 0xFFFF) {
+      out += (char)0xDA;
+      appendBigEndian(out, length, 2);
+    } else {
+      out += (char)0xDB;
+      appendBigEndian(out, length, 4);
+    }
+  } else {
+    out += '"';
+    for (size_t i = 0; i < length; i++) {
+      char c = text[i];
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += c;
+      } else if ((uint8_t)c < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)(uint8_t)c);
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+    out += '"';
+    return;
+  }
+  out.append(text, length);
+}
+
+void ResponseWriter::writeInteger(bool negative, uint64_t magnitude) {
+  beforeValue();
+  if (encoding == RESPONSE_CBOR) {
+    writeHead(negative ? CBOR_NEGATIVE : CBOR_UNSIGNED, magnitude);
+    return;
+  }
+  if (encoding == RESPONSE_JSON) {
+    char text[24];
+    int length = snprintf(text, sizeof(text), negative ? "-%llu" : "%llu",
+                          (unsigned long long)(negative ? magnitude + 1 : magnitude));
+    out.append(text, length);
+    return;
+  }
+  if (!negative) {
+    if (magnitude < 0x80) {
+      out += (char)magnitude;  // positive fixint
+    } else if (magnitude <= 0xFF) {
+      out += (char)0xCC;
+      appendBigEndian(out, magnitude, 1);
+    } else if (magnitude <= 0xFFFF) {
+      out += (char)0xCD;
+      appendBigEndian(out, magnitude, 2);
+    } else if (magnitude <= 0xFFFFFFFF) {
+      out += (char)0xCE;
+      appendBigEndian(out, magnitude, 4);
+    } else {
+      out += (char)0xCF;
+      appendBigEndian(out, magnitude, 8);
+    }
+    return;
+  }
+  // -1 - magnitude, two's complement in the narrowest type.
+  uint64_t bits = ~magnitude;
+  if (magnitude < 32) {
+    out += (char)(uint8_t)bits;  // negative fixint
+  } else if (magnitude < 0x80) {
+    out += (char)0xD0;
+    appendBigEndian(out, bits, 1);
+  } else if (magnitude < 0x8000) {
+    out += (char)0xD1;
+    appendBigEndian(out, bits, 2);
+  } else if (magnitude < 0x80000000) {
+    out += (char)0xD2;
+    appendBigEndian(out, bits, 4);
+  } else {
+    out += (char)0xD3;
+    appendBigEndian(out, bits, 8);
+  }
+}
+
+void ResponseWriter::value(const char* text) {
+  if (!text) {
+    null();
+    return;
+  }
+  beforeValue();
+  writeString(text, strlen(text));
+}
+
+void ResponseWriter::value(bool flag) {
+  beforeValue();
+  if (encoding == RESPONSE_JSON) {
+    out += flag ? "true" : "false";
+  } else if (encoding == RESPONSE_CBOR) {
+    out += (char)(flag ? 0xF5 : 0xF4);
+  } else {
+    out += (char)(flag ? 0xC3 : 0xC2);
+  }
+}
+
+void ResponseWriter::null() {
+  beforeValue();
+  if (encoding == RESPONSE_JSON) {
+    out += "null";
+  } else {
+    out += (char)(encoding == RESPONSE_CBOR ? 0xF6 : 0xC0);
+  }
+}
+
+void ResponseWriter::value(double number, int decimals) {
+  if (!isfinite(number)) {
+    null();  // JSON has no NaN or infinity
+    return;
+  }
+  if (encoding == RESPONSE_JSON) {
+    beforeValue();
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%.*f", decimals, number);
+    out.append(text, length > 0 && (size_t)length < sizeof(text) ? length : 0);
+    return;
+  }
+  double scale = pow(10.0, decimals);
+  double rounded = round(number * scale) / scale;
+  if (decimals == 0 && fabs(rounded) < 9007199254740992.0) {  // 2^53
+    int64_t whole = (int64_t)rounded;
+    value(whole);
+    return;
+  }
+  beforeValue();
+  float single = (float)rounded;
+  if (fabs((double)single - rounded) <= 0.05 / scale) {
+    uint32_t bits;
+    memcpy(&bits, &single, sizeof(bits));
+    out += (char)(encoding == RESPONSE_CBOR ? 0xFA : 0xCA);
+    appendBigEndian(out, bits, 4);
+  } else {
+    uint64_t bits;
+    memcpy(&bits, &rounded, sizeof(bits));
+    out += (char)(encoding == RESPONSE_CBOR ? 0xFB : 0xCB);
+    appendBigEndian(out, bits, 8);
+  }
+}
+
+void ResponseWriter::send(HttpExchange& http, int code) {
+  while (depth > 0) {
+    end();
+  }
+  http.sendHeader("Vary", "Accept");
+  http.send(code, responseContentType(encoding), out);
+}
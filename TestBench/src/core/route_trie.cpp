@@ -0,0 +1,183 @@
+#include "core/route_trie.h"
+
+#include <string.h>
+
+// FNV-1a, seeded with the parent node so equal segments under different
+// parents land in different slots.
+static uint32_t hashStart(uint16_t parent) {
+  return (2166136261u ^ parent) * 16777619u;
+}
+
+static uint32_t hashByte(uint32_t hash, char c) {
+  return (hash ^ (uint8_t)c) * 16777619u;
+}
+
+static bool isParamSegment(const char* segment, size_t length) {
+  return length >= 2 && segment[0] == '{' && segment[length - 1] == '}';
+}
+
+static int methodIndex(HttpMethod method) {
+  switch (method) {
+    case HTTP_METHOD_GET: return 0;
+    case HTTP_METHOD_POST: return 1;
+    default: return -1;
+  }
+}
+
+RouteTrie::RouteTrie(RouteTrieNode* nodeArray, size_t nodeArraySize, RouteTrieSlot* slotArray, size_t slotArraySize)
+    : nodes(nodeArray), nodeCapacity(nodeArraySize), nodeCount(0), slots(slotArray), slotMask(slotArraySize - 1),
+      slotsUsed(0) {
+  clear();
+}
+
+void RouteTrie::clear() {
+  memset(slots, 0, (slotMask + 1) * sizeof(RouteTrieSlot));
+  slotsUsed = 0;
+  // Node 0 is the root, the position before the leading '/'.
+  nodes[0] = RouteTrieNode{"", 0, 0, 0, {nullptr, nullptr}};
+  nodeCount = 1;
+}
+
+uint16_t RouteTrie::findChild(uint16_t parent, const char* segment, size_t length, uint32_t hash) const {
+  for (size_t i = hash & slotMask;; i = (i + 1) & slotMask) {
+    const RouteTrieSlot& slot = slots[i];
+    if (slot.child == 0) {
+      return 0;
+    }
+    const RouteTrieNode& node = nodes[slot.child];
+    if (slot.hash == hash && node.parent == parent && node.segmentLength == length &&
+        memcmp(node.segment, segment, length) == 0) {
+      return slot.child;
+    }
+  }
+}
+
+bool RouteTrie::add(const ApiRoute& route) {
+  int method = methodIndex(route.method);
+  if (method < 0 || route.uri[0] != '/') {
+    return false;
+  }
+
+  uint16_t node = 0;
+  uint8_t params = 0;
+  const char* segment = route.uri + 1;
+  while (true) {
+    const char* end = strchr(segment, '/');
+    size_t length = end ? (size_t)(end - segment) : strlen(segment);
+    uint16_t child;
+
+    if (isParamSegment(segment, length)) {
+      if (++params > ROUTE_MAX_PARAMS) {
+        return false;
+      }
+      child = nodes[node].paramChild;
+      if (child != 0) {
+        const RouteTrieNode& existing = nodes[child];
+        if (existing.segmentLength != length || memcmp(existing.segment, segment, length) != 0) {
+          return false;
+        }
+      } else {
+        if (nodeCount == nodeCapacity) {
+          return false;
+        }
+        child = (uint16_t)nodeCount++;
+        nodes[child] = RouteTrieNode{segment, (uint16_t)length, node, 0, {nullptr, nullptr}};
+        nodes[node].paramChild = child;
+      }
+    } else {
+      uint32_t hash = hashStart(node);
+      for (size_t i = 0; i < length; i++) hash = hashByte(hash, segment[i]);
+      child = findChild(node, segment, length, hash);
+      if (child == 0) {
+        // Keep at least one slot empty so probes terminate.
+        if (nodeCount == nodeCapacity || slotsUsed + 1 >= slotMask + 1) {
+          return false;
+        }
+        child = (uint16_t)nodeCount++;
+        nodes[child] = RouteTrieNode{segment, (uint16_t)length, node, 0, {nullptr, nullptr}};
+        size_t i = hash & slotMask;
+        while (slots[i].child != 0) i = (i + 1) & slotMask;
+        slots[i].hash = hash;
+        slots[i].child = child;
+        slotsUsed++;
+      }
+    }
+
+    node = child;
+    if (!end) {
+      break;
+    }
+    segment = end + 1;
+  }
+
+  if (!nodes[node].routes[method]) {
+    nodes[node].routes[method] = &route;
+  }
+  return true;
+}
+
+bool RouteTrie::add(const ApiRoute* routes, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (!add(routes[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RouteTrie::find(const char* path, size_t length, HttpMethod method, RouteMatch& match) const {
+  match.route = nullptr;
+  match.paramCount = 0;
+  int index = methodIndex(method);
+  if (index < 0 || length == 0 || path[0] != '/') {
+    return false;
+  }
+
+  uint16_t node = 0;
+  size_t pos = 1;
+  while (true) {
+    // Hash the segment while looking for its end.
+    size_t start = pos;
+    uint32_t hash = hashStart(node);
+    while (pos < length && path[pos] != '/') {
+      hash = hashByte(hash, path[pos++]);
+    }
+    size_t segmentLength = pos - start;
+
+    uint16_t child = findChild(node, path + start, segmentLength, hash);
+    if (child == 0) {
+      child = nodes[node].paramChild;
+      if (child == 0 || segmentLength == 0) {
+        return false;
+      }
+      RouteParam& param = match.params[match.paramCount++];
+      param.name = nodes[child].segment + 1;
+      param.nameLength = (uint8_t)(nodes[child].segmentLength - 2);
+      param.value = path + start;
+      param.valueLength = (uint16_t)segmentLength;
+    }
+    node = child;
+    if (pos == length) {
+      break;
+    }
+    pos++;  // Past the '/'
+  }
+
+  match.route = nodes[node].routes[index];
+  return match.route != nullptr;
+}
+
+bool RouteTrie::find(const char* path, HttpMethod method, RouteMatch& match) const {
+  return find(path, strlen(path), method, match);
+}
+
+const RouteParam* routeFindParam(const RouteMatch& match, const char* name) {
+  size_t length = strlen(name);
+  for (uint8_t i = 0; i < match.paramCount; i++) {
+    const RouteParam& param = match.params[i];
+    if (param.nameLength == length && memcmp(param.name, name, length) == 0) {
+      return &param;
+    }
+  }
+  return nullptr;
+}
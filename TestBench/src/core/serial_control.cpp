@@ -0,0 +1,90 @@
+#include "core/serial_control.h"
+
+#include <string.h>
+
+#include "core/udp_control.h"
+#include "hal/serial.h"
+
+// Reads per serialControlService() call at most, so a flood of input cannot
+// hold up loop().
+static const int SERIAL_READ_BURST = 4;
+
+// Encoded bytes of the frame being received, between delimiters.
+static uint8_t received[SERIAL_REQUEST_MAX_BYTES];
+static size_t receivedLength = 0;
+static bool overrun = false;
+
+static SerialControlStats stats = {0, 0, 0};
+
+// The last reply and what it answered, for answering a repeated frame.
+static uint8_t lastReply[UDP_FRAME_BYTES];
+static UdpFrame lastRequest;
+static bool hasLastReply = false;
+
+/**
+ * @brief Runs one received frame and writes the reply frame.
+ */
+static void answer(const uint8_t* encoded, size_t length) {
+  uint8_t request[SERIAL_REQUEST_MAX_BYTES];
+  size_t requestLength = 0;
+  UdpFrame frame;
+  if (!serialFrameDecode(encoded, length, request, &requestLength) ||
+      !udpFrameDecode(request, requestLength, frame)) {
+    stats.corrupt++;
+    return;
+  }
+
+  // Static: a capture reply is over a kilobyte, too much for loop()'s stack.
+  static uint8_t reply[UDP_REPLY_MAX_BYTES + SERIAL_CRC_BYTES];
+  static uint8_t line[serialFrameBytes(UDP_REPLY_MAX_BYTES)];
+  size_t replyLength;
+  if (hasLastReply && frame.opcode == lastRequest.opcode && frame.sequence == lastRequest.sequence) {
+    memcpy(reply, lastReply, sizeof(lastReply));
+    replyLength = sizeof(lastReply);
+    stats.repeated++;
+  } else {
+    replyLength = udpControlHandle(request, requestLength, reply, UDP_REPLY_MAX_BYTES);
+    if (replyLength == 0) {
+      stats.corrupt++;
+      return;
+    }
+    if (replyLength == UDP_FRAME_BYTES) {
+      memcpy(lastReply, reply, sizeof(lastReply));
+      lastRequest = frame;
+      hasLastReply = true;
+    }
+  }
+  stats.frames++;
+  halSerialWrite(line, serialFrameEncode(reply, replyLength, line));
+}
+
+void serialControlService() {
+  uint8_t input[64];
+  for (int i = 0; i < SERIAL_READ_BURST; i++) {
+    size_t n = halSerialRead(input, sizeof(input));
+    if (n == 0) {
+      return;
+    }
+    for (size_t j = 0; j < n; j++) {
+      if (input[j] != SERIAL_FRAME_DELIMITER) {
+        if (receivedLength < sizeof(received)) {
+          received[receivedLength++] = input[j];
+        } else {
+          overrun = true;
+        }
+        continue;
+      }
+      if (overrun) {
+        stats.corrupt++;
+      } else if (receivedLength > 0) {
+        answer(received, receivedLength);
+      }
+      receivedLength = 0;
+      overrun = false;
+    }
+  }
+}
+
+const SerialControlStats& serialControlStats() {
+  return stats;
+}
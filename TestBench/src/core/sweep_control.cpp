@@ -0,0 +1,264 @@
+#include "core/sweep_control.h"
+
+#include <stdio.h>
+
+#include "core/charge_control.h"
+#include "core/holdup_monitor.h"
+#include "hal/clock.h"
+#include "hal/log.h"
+
+// A contact still open this long after the charge pin fell never pulled in.
+static const uint32_t PULL_IN_GRACE_MS = 100;
+
+enum SweepPhase {
+  PHASE_GAP,       // Waiting for the next scheduled start
+  PHASE_CHARGING,
+  PHASE_DROPOUT    // Waiting for the relay to drop out
+};
+
+static SweepDefinition definition = {};
+static SweepStep steps[SWEEP_MAX_STEPS];
+static SweepState state = SWEEP_IDLE;
+static SweepPhase phase = PHASE_GAP;
+static uint32_t sweepId = 0;
+static uint16_t stepIndex = 0;
+static uint16_t repeat = 0;
+static uint32_t cycles = 0;
+static uint32_t startMs = 0;
+static uint32_t endMs = 0;
+static uint64_t nextStartUs = 0;
+static uint32_t phaseStartMs = 0;
+static uint32_t holdupsBefore = 0;
+
+static void finish(SweepState next) {
+  state = next;
+  endMs = halMillis();
+}
+
+/**
+ * @brief Ends one cycle at endUs and schedules the next charge a gap later.
+ * @return true if this completed a step.
+ */
+static bool completeCycle(uint64_t endUs) {
+  cycles++;
+  steps[stepIndex].cycles++;
+  nextStartUs = endUs + (uint64_t)definition.gapMs * 1000;
+  phase = PHASE_GAP;
+  if (++repeat < definition.repeats) {
+    return false;
+  }
+  repeat = 0;
+  stepIndex++;
+  if (stepIndex == definition.steps) {
+    finish(SWEEP_DONE);
+    halLog("Sweep %u done: %u cycles in %u ms.\n", (unsigned)sweepId, (unsigned)cycles,
+           (unsigned)(endMs - startMs));
+  }
+  return true;
+}
+
+uint32_t sweepStepValue(const SweepDefinition& sweep, uint16_t index) {
+  if (sweep.steps <= 1) {
+    return sweep.from;
+  }
+  // Linear, rounded to the nearest unit, in either direction.
+  int64_t span = (int64_t)sweep.to - (int64_t)sweep.from;
+  int64_t offset = (span * index * 2 + (span >= 0 ? 1 : -1) * (sweep.steps - 1)) / (2 * (sweep.steps - 1));
+  return (uint32_t)((int64_t)sweep.from + offset);
+}
+
+// Text of the last range error returned by sweepStart().
+static char rangeErrorText[80];
+
+/**
+ * @brief Formats "'name' must be between minimum and maximum unit." from the limits themselves.
+ */
+static const char* rangeError(const char* name, long minimum, long maximum, const char* unit = nullptr) {
+  snprintf(rangeErrorText, sizeof(rangeErrorText), "'%s' must be between %ld and %ld%s%s.", name, minimum, maximum,
+           unit ? " " : "", unit ? unit : "");
+  return rangeErrorText;
+}
+
+const char* sweepStart(const SweepDefinition& sweep) {
+  if (sweepActive()) {
+    return "A sweep is already running.";
+  }
+  if (sweep.steps < 1 || sweep.steps > SWEEP_MAX_STEPS) {
+    return rangeError("steps", 1, SWEEP_MAX_STEPS);
+  }
+  if (sweep.repeats < 1 || sweep.repeats > SWEEP_MAX_REPEATS) {
+    return rangeError("repeats", 1, SWEEP_MAX_REPEATS);
+  }
+  if (sweep.gapMs > SWEEP_MAX_GAP_MS) {
+    return rangeError("gap_ms", 0, SWEEP_MAX_GAP_MS, "ms");
+  }
+  if (sweep.parameter == SWEEP_CHARGE_MS) {
+    if (sweep.from < (uint32_t)CHARGE_MIN_MS || sweep.from > (uint32_t)CHARGE_MAX_MS) {
+      return rangeError("from", CHARGE_MIN_MS, CHARGE_MAX_MS, "ms");
+    }
+    if (sweep.to < (uint32_t)CHARGE_MIN_MS || sweep.to > (uint32_t)CHARGE_MAX_MS) {
+      return rangeError("to", CHARGE_MIN_MS, CHARGE_MAX_MS, "ms");
+    }
+  } else {
+    if (!chargeHasSense()) {
+      return "A target_mv sweep needs a sense input, none is available.";
+    }
+    if (sweep.from < 1 || sweep.to < 1 || sweep.from > (uint32_t)chargeMaxTargetMv() ||
+        sweep.to > (uint32_t)chargeMaxTargetMv()) {
+      return "'from' and 'to' must be within the sense input range.";
+    }
+    if (sweep.timeoutMs < (uint32_t)CHARGE_MIN_MS || sweep.timeoutMs > (uint32_t)CHARGE_MAX_MS) {
+      return rangeError("timeout_ms", CHARGE_MIN_MS, CHARGE_MAX_MS, "ms");
+    }
+  }
+  if (sweep.waitDropout && !holdupEnabled()) {
+    return "'wait_dropout' needs a relay contact input, none is configured.";
+  }
+
+  definition = sweep;
+  for (uint16_t i = 0; i < definition.steps; i++) {
+    steps[i] = {};
+    steps[i].value = sweepStepValue(definition, i);
+  }
+  sweepId++;
+  state = SWEEP_RUNNING;
+  phase = PHASE_GAP;
+  stepIndex = 0;
+  repeat = 0;
+  cycles = 0;
+  startMs = halMillis();
+  nextStartUs = halMicros();
+  halLog("Sweep %u started: %s %u..%u in %u steps x %u.\n", (unsigned)sweepId,
+         sweepParameterName(definition.parameter), (unsigned)definition.from, (unsigned)definition.to,
+         (unsigned)definition.steps, (unsigned)definition.repeats);
+  return nullptr;
+}
+
+void sweepStop() {
+  if (state != SWEEP_RUNNING) {
+    return;
+  }
+  finish(SWEEP_STOPPED);
+  halLog("Sweep %u stopped after %u cycles.\n", (unsigned)sweepId, (unsigned)cycles);
+}
+
+bool sweepService() {
+  if (state != SWEEP_RUNNING) {
+    return false;
+  }
+  SweepStep& step = steps[stepIndex];
+
+  switch (phase) {
+    case PHASE_GAP: {
+      uint64_t now = halMicros();
+      if ((int64_t)(now - nextStartUs) < 0) {
+        return false;
+      }
+      ChargeStartResult result = definition.parameter == SWEEP_TARGET_MV
+                                     ? chargeStartToTarget(step.value, definition.timeoutMs)
+                                     : chargeStart(step.value);
+      if (result == CHARGE_BUSY) {
+        // The discharge output is within its dead time; the delay shows up
+        // in the gap error.
+        return false;
+      }
+      if (result != CHARGE_STARTED) {
+        halLog("Sweep %u: charge could not start (%d).\n", (unsigned)sweepId, (int)result);
+        finish(SWEEP_FAILED);
+        return false;
+      }
+      // The first charge has no previous cycle to be scheduled from.
+      uint32_t gapErrorUs = cycles > 0 ? (uint32_t)(now - nextStartUs) : 0;
+      if (gapErrorUs > step.maxGapErrorUs) step.maxGapErrorUs = gapErrorUs;
+      holdupService();
+      holdupsBefore = holdupStats().count;
+      phase = PHASE_CHARGING;
+      return false;
+    }
+
+    case PHASE_CHARGING: {
+      if (chargeActive()) {
+        return false;
+      }
+      const ChargeResult& result = chargeLastResult();
+      if (result.reason == CHARGE_END_STOPPED) {
+        finish(SWEEP_STOPPED);
+        return false;
+      }
+      runningStatsAdd(step.chargeUs, result.chargeUs);
+      if (chargeHasSense()) {
+        runningStatsAdd(step.endMv, result.endMv);
+      }
+      if (result.reason == CHARGE_END_TIMEOUT) {
+        step.timeouts++;
+      }
+      if (!definition.waitDropout) {
+        return completeCycle(result.endUs);
+      }
+      phase = PHASE_DROPOUT;
+      phaseStartMs = halMillis();
+      return false;
+    }
+
+    case PHASE_DROPOUT: {
+      uint32_t elapsed = halMillis() - phaseStartMs;
+      holdupService();
+      bool waiting = holdupPending() && (holdupContactClosed() || elapsed < PULL_IN_GRACE_MS);
+      if (waiting && elapsed < SWEEP_DROPOUT_TIMEOUT_MS) {
+        return false;
+      }
+      const HoldupStats& holdup = holdupStats();
+      if (holdup.count > holdupsBefore) {
+        runningStatsAdd(step.holdupUs, holdup.lastUs);
+        return completeCycle(chargeLastResult().endUs + holdup.lastUs);
+      }
+      step.timeouts++;
+      return completeCycle(halMicros());
+    }
+
+    default:
+      return false;
+  }
+}
+
+bool sweepActive() {
+  return state == SWEEP_RUNNING;
+}
+
+SweepStatus sweepStatus() {
+  SweepStatus status = {};
+  status.id = sweepId;
+  status.state = state;
+  status.step = stepIndex;
+  status.repeat = repeat;
+  status.stepsDone = stepIndex;
+  status.cycles = cycles;
+  status.totalCycles = (uint32_t)definition.steps * definition.repeats;
+  status.elapsedMs = (state == SWEEP_RUNNING ? halMillis() : endMs) - startMs;
+  for (uint16_t i = 0; i < definition.steps && i <= stepIndex && i < SWEEP_MAX_STEPS; i++) {
+    if (steps[i].maxGapErrorUs > status.maxGapErrorUs) status.maxGapErrorUs = steps[i].maxGapErrorUs;
+  }
+  return status;
+}
+
+const SweepDefinition& sweepDefinition() {
+  return definition;
+}
+
+const SweepStep* sweepStep(uint16_t index) {
+  return index < stepIndex ? &steps[index] : nullptr;
+}
+
+const char* sweepStateName(SweepState value) {
+  switch (value) {
+    case SWEEP_RUNNING: return "running";
+    case SWEEP_DONE: return "done";
+    case SWEEP_STOPPED: return "stopped";
+    case SWEEP_FAILED: return "failed";
+    default: return "idle";
+  }
+}
+
+const char* sweepParameterName(SweepParameter value) {
+  return value == SWEEP_TARGET_MV ? "target_mv" : "charge_ms";
+}
@@ -0,0 +1,198 @@
+#include "core/udp_control.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/cycle_control.h"
+#include "core/emergency_stop.h"
+#include "core/sweep_control.h"
+
+static int controlFd = -1;
+static uint16_t controlPort = 0;
+static UdpControlStats stats = {0, 0, 0};
+
+// The last reply and what it answered, for answering a repeated frame.
+static uint8_t lastReply[UDP_FRAME_BYTES];
+static struct sockaddr_in lastFrom;
+static UdpFrame lastRequest;
+static bool hasLastReply = false;
+
+/**
+ * @brief Starts a charge as /charge does, after the same checks.
+ */
+static uint8_t runCharge(uint32_t durationMs, uint32_t targetMv) {
+  if (apiChargeConflict()) {
+    return UDP_STATUS_CONFLICT;
+  }
+  ChargeStartResult result;
+  if (targetMv == 0) {
+    result = chargeStart((long)durationMs);
+  } else {
+    result = chargeStartToTarget((long)targetMv, durationMs ? (long)durationMs : CHARGE_TARGET_DEFAULT_TIMEOUT_MS);
+  }
+  switch (result) {
+    case CHARGE_STARTED: return UDP_STATUS_OK;
+    case CHARGE_BUSY: return UDP_STATUS_CONFLICT;
+    default: return UDP_STATUS_INVALID;
+  }
+}
+
+static uint8_t stateFlags() {
+  uint8_t flags = 0;
+  if (chargeActive()) flags |= UDP_FLAG_CHARGING;
+  if (chargePinHigh()) flags |= UDP_FLAG_PIN_HIGH;
+  if (cycleActive()) flags |= UDP_FLAG_CYCLES;
+  if (sweepActive()) flags |= UDP_FLAG_SWEEP;
+  if (estopLatched()) flags |= UDP_FLAG_ESTOP;
+  return flags;
+}
+
+/**
+ * @brief Appends capture samples from frame.value0 after the reply's fields.
+ * @return The number appended.
+ */
+static size_t appendCapture(UdpFrame& frame, uint8_t* samples, size_t room) {
+  size_t captured = chargeCaptureCount();
+  size_t first = frame.value0 < captured ? frame.value0 : captured;
+  size_t count = frame.value1 > 0 && frame.value1 < UDP_CAPTURE_CHUNK ? frame.value1 : UDP_CAPTURE_CHUNK;
+  count = count < room ? count : room;
+  count = count < captured - first ? count : captured - first;
+  for (size_t i = 0; i < count; i++) {
+    uint16_t mv = chargeCaptureSample(first + i);
+    samples[2 * i] = (uint8_t)mv;
+    samples[2 * i + 1] = (uint8_t)(mv >> 8);
+  }
+  frame.value0 = first;
+  frame.value1 = captured;
+  return count;
+}
+
+size_t udpControlHandle(const uint8_t* request, size_t length, uint8_t* reply, size_t capacity) {
+  UdpFrame frame;
+  if (length != UDP_FRAME_BYTES || capacity < UDP_FRAME_BYTES || !udpFrameDecode(request, length, frame)) {
+    return 0;
+  }
+  size_t samples = 0;
+  frame.status = UDP_STATUS_OK;
+  if (frame.version != UDP_FRAME_VERSION) {
+    frame.status = UDP_STATUS_BAD_FRAME;
+  } else {
+    switch (frame.opcode) {
+      case UDP_OP_CHARGE:
+        frame.status = runCharge(frame.value0, frame.value1);
+        break;
+      case UDP_OP_STOP:
+        apiStop();
+        frame.value0 = frame.value1 = 0;
+        break;
+      case UDP_OP_STATE:
+        frame.value0 = chargeRemainingMs();
+        frame.value1 = chargeLastResult().chargeUs;
+        break;
+      case UDP_OP_CAPTURE:
+        samples = appendCapture(frame, reply + UDP_FRAME_BYTES, (capacity - UDP_FRAME_BYTES) / 2);
+        break;
+      default:
+        frame.status = UDP_STATUS_BAD_FRAME;
+        break;
+    }
+  }
+  frame.version = UDP_FRAME_VERSION;
+  frame.opcode |= UDP_REPLY;
+  frame.flags = stateFlags();
+  frame.endReason = (uint8_t)chargeLastResult().reason;
+  udpFrameEncode(frame, reply);
+  return UDP_FRAME_BYTES + 2 * samples;
+}
+
+int udpControlBegin(uint16_t port) {
+  udpControlClose();
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  socklen_t length = sizeof(addr);
+  getsockname(fd, (struct sockaddr*)&addr, &length);
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  controlFd = fd;
+  controlPort = ntohs(addr.sin_port);
+  stats = {0, 0, 0};
+  hasLastReply = false;
+  return fd;
+}
+
+/**
+ * @brief True if the datagram repeats the last answered frame: same sender,
+ * opcode and sequence number.
+ */
+static bool isRepeat(const uint8_t* request, size_t length, const struct sockaddr_in& from) {
+  UdpFrame frame;
+  if (!hasLastReply || !udpFrameDecode(request, length, frame)) {
+    return false;
+  }
+  return from.sin_addr.s_addr == lastFrom.sin_addr.s_addr && from.sin_port == lastFrom.sin_port &&
+         frame.opcode == lastRequest.opcode && frame.sequence == lastRequest.sequence;
+}
+
+void udpControlService() {
+  for (int i = 0; i < UDP_CONTROL_BURST && controlFd >= 0; i++) {
+    // One byte more than a frame, so a longer datagram is not mistaken for one.
+    uint8_t request[UDP_FRAME_BYTES + 1];
+    struct sockaddr_in from;
+    socklen_t fromLength = sizeof(from);
+    ssize_t n = recvfrom(controlFd, request, sizeof(request), 0, (struct sockaddr*)&from, &fromLength);
+    if (n < 0) {
+      return;
+    }
+    if (isRepeat(request, n, from)) {
+      stats.received++;
+      stats.repeated++;
+      sendto(controlFd, lastReply, sizeof(lastReply), 0, (struct sockaddr*)&from, fromLength);
+      continue;
+    }
+    uint8_t reply[UDP_REPLY_MAX_BYTES];
+    size_t length = udpControlHandle(request, n, reply, sizeof(reply));
+    if (length == 0) {
+      stats.dropped++;
+      continue;
+    }
+    stats.received++;
+    if (length == UDP_FRAME_BYTES) {
+      memcpy(lastReply, reply, sizeof(lastReply));
+      udpFrameDecode(request, n, lastRequest);
+      lastFrom = from;
+      hasLastReply = true;
+    }
+    sendto(controlFd, reply, length, 0, (struct sockaddr*)&from, fromLength);
+  }
+}
+
+void udpControlClose() {
+  if (controlFd >= 0) {
+    close(controlFd);
+    controlFd = -1;
+  }
+  controlPort = 0;
+}
+
+uint16_t udpControlPort() {
+  return controlPort;
+}
+
+const UdpControlStats& udpControlStats() {
+  return stats;
+}
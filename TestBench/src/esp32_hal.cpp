@@ -0,0 +1,144 @@
+// ESP32 implementation of the clock, GPIO, ADC, logging and serial HAL (see include/hal/).
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include "esp_timer.h"
+#include "soc/gpio_periph.h"
+#include "soc/gpio_struct.h"
+#include "soc/io_mux_reg.h"
+
+#include "hal/adc.h"
+#include "hal/clock.h"
+#include "hal/gpio.h"
+#include "hal/log.h"
+#include "hal/serial.h"
+
+uint32_t halMillis() {
+  return millis();
+}
+
+uint64_t HAL_ISR_ATTR halMicros() {
+  return (uint64_t)esp_timer_get_time();
+}
+
+void halPinOutput(int pin) {
+  pinMode(pin, OUTPUT);
+}
+
+void halPinInput(int pin, bool pullUp) {
+  pinMode(pin, pullUp ? INPUT_PULLUP : INPUT);
+}
+
+void halDigitalWrite(int pin, int level) {
+  digitalWrite(pin, level == HAL_HIGH ? HIGH : LOW);
+}
+
+void HAL_ISR_ATTR halDigitalWriteFromIsr(int pin, int level) {
+  // The set/clear registers change only the given pin; pins 32 and up are in the second bank.
+  if (pin < 0 || pin >= SOC_GPIO_PIN_COUNT) {
+    return;
+  }
+  if (pin < 32) {
+    if (level == HAL_HIGH) {
+      GPIO.out_w1ts = 1UL << pin;
+    } else {
+      GPIO.out_w1tc = 1UL << pin;
+    }
+  } else if (level == HAL_HIGH) {
+    GPIO.out1_w1ts.val = 1UL << (pin - 32);
+  } else {
+    GPIO.out1_w1tc.val = 1UL << (pin - 32);
+  }
+}
+
+int halDigitalRead(int pin) {
+  return digitalRead(pin) == HIGH ? HAL_HIGH : HAL_LOW;
+}
+
+static HalEdgeCallback edgeCallbacks[SOC_GPIO_PIN_COUNT];
+
+static void ARDUINO_ISR_ATTR onEdge(void* arg) {
+  uint64_t atUs = (uint64_t)esp_timer_get_time();
+  int pin = (int)(intptr_t)arg;
+  HalEdgeCallback callback = edgeCallbacks[pin];
+  if (callback) {
+    callback(digitalRead(pin) == HIGH ? HAL_HIGH : HAL_LOW, atUs);
+  }
+}
+
+bool halAttachEdgeInterrupt(int pin, HalEdgeCallback callback) {
+  if (pin < 0 || pin >= SOC_GPIO_PIN_COUNT || !callback) {
+    return false;
+  }
+  // pinMode(OUTPUT) leaves the input buffer off; without it an output pin
+  // neither reads back nor raises interrupts on its own edges.
+  PIN_INPUT_ENABLE(GPIO_PIN_MUX_REG[pin]);
+  edgeCallbacks[pin] = callback;
+  attachInterruptArg(pin, onEdge, (void*)(intptr_t)pin, CHANGE);
+  return true;
+}
+
+void halDetachEdgeInterrupt(int pin) {
+  if (pin < 0 || pin >= SOC_GPIO_PIN_COUNT) {
+    return;
+  }
+  detachInterrupt(pin);
+  edgeCallbacks[pin] = nullptr;
+}
+
+int halAnalogReadMilliVolts(int pin) {
+  return analogReadMilliVolts(pin);
+}
+
+static esp_timer_handle_t samplerTimer = nullptr;
+static int samplerPin = -1;
+static HalSampleCallback samplerCallback = nullptr;
+
+static void onSamplerTimer(void*) {
+  uint64_t atUs = (uint64_t)esp_timer_get_time();
+  samplerCallback(analogReadMilliVolts(samplerPin), atUs);
+}
+
+bool halSamplerStart(int pin, uint32_t periodUs, HalSampleCallback callback) {
+  if (!samplerTimer) {
+    esp_timer_create_args_t args = {};
+    args.callback = onSamplerTimer;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "adc_sampler";
+    if (esp_timer_create(&args, &samplerTimer) != ESP_OK) {
+      return false;
+    }
+  }
+  esp_timer_stop(samplerTimer);
+  samplerPin = pin;
+  samplerCallback = callback;
+  return esp_timer_start_periodic(samplerTimer, periodUs) == ESP_OK;
+}
+
+void halSamplerStop() {
+  if (samplerTimer) {
+    esp_timer_stop(samplerTimer);
+  }
+}
+
+void halLog(const char* format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  Serial.print(buffer);
+}
+
+size_t halSerialRead(uint8_t* buffer, size_t capacity) {
+  int available = Serial.available();
+  if (available <= 0) {
+    return 0;
+  }
+  return Serial.read(buffer, (size_t)available < capacity ? (size_t)available : capacity);
+}
+
+void halSerialWrite(const uint8_t* data, size_t length) {
+  // One call, so the UART driver's lock keeps it whole.
+  Serial.write(data, length);
+}
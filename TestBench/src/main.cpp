@@ -1,6 +1,21 @@
 #include <WiFi.h>
-#include <WebServer.h>
 #include "driver/gpio.h" // For raw ESP32 GPIO configuration
+#include "esp_timer.h"
+#include "wifi_link.h"
+#include "power_policy.h"
+#include "sleep_schedule.h"
+#include "memory_telemetry.h"
+#include "stop_listener.h"
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/cycle_control.h"
+#include "core/emergency_stop.h"
+#include "core/holdup_monitor.h"
+#include "core/http_server.h"
+#include "core/sweep_control.h"
+#include "core/routes.h"
+#include "core/serial_control.h"
+#include "core/udp_control.h"
 
 // --- 1. CONFIGURATION ---
 
@@ -8,10 +23,63 @@
 const char* ssid = "YourSSID";
 const char* password = "YourPassword";
 
+// Optional static addressing. Leave USE_STATIC_IP false to use DHCP; the lease
+// is cached in NVS and reused on the next boot to skip the DHCP handshake, as
+// long as it is short of its renewal time.
+const bool USE_STATIC_IP = false;
+const IPAddress STATIC_IP(192, 168, 1, 50);
+const IPAddress STATIC_GATEWAY(192, 168, 1, 1);
+const IPAddress STATIC_SUBNET(255, 255, 255, 0);
+const IPAddress STATIC_DNS(192, 168, 1, 1);
+const bool REUSE_CACHED_LEASE = true;
+
+// Idle power policy used until another mode is selected through /power
+// (the selection is saved in NVS and survives reboots).
+const PowerMode DEFAULT_POWER_MODE = POWER_MODEM_SLEEP;
+
 // GPIO Pin Definitions
 // GPIO 17 is generally safe, though often the default TX for UART2.
 const int CHARGE_PIN = 17;
 
+// Optional output that actively discharges the capacitor between cycles
+// (e.g. a relay driver switching a bleed resistor across it). -1 if not fitted;
+// /cycle then waits for the capacitor to bleed down on its own.
+const int DISCHARGE_PIN = -1;
+
+// ADC1 input used to measure the capacitor voltage (through a divider if it
+// can exceed 3.3 V). ADC1 keeps working while Wi-Fi is active; ADC2 does not.
+const int SENSE_ADC_PIN = 34;
+
+// Digital input wired to the relay contact (contact to GND, internal pull-up).
+// GET /holdup reports the time from CHARGE_PIN going LOW to the contact
+// opening. -1 if not wired.
+const int CONTACT_SENSE_PIN = 27;
+
+// Emergency stop inputs that bypass the HTTP queue (GET /estop reports their
+// latency): a push button to GND on STOP_BUTTON_PIN (-1 if not fitted), and a
+// UDP port where a datagram starting with "STOP" stops the charge (0 for none).
+const int STOP_BUTTON_PIN = -1;
+const uint16_t STOP_UDP_PORT = 4210;
+
+// UDP port of the binary control protocol (charge, stop, state, capture; see
+// include/core/udp_control.h and src/native/udp_client.cpp). 0 for none.
+const uint16_t CONTROL_UDP_PORT = 4211;
+
+// The log's serial port also takes the control protocol in COBS frames
+// (include/core/serial_control.h). The TX buffer lets a capture reply be
+// queued without holding up loop() while it drains (~12 ms at this rate).
+const unsigned long SERIAL_BAUD = 921600;
+const size_t SERIAL_TX_BUFFER_BYTES = 4096;
+
+// Capacitor voltage per volt at SENSE_ADC_PIN, i.e. the divider ratio
+// (R_top + R_bottom) / R_bottom. 1.0 when the capacitor is wired directly.
+// /charge?target_mv= compares the scaled reading against the target.
+const float SENSE_DIVIDER_RATIO = 1.0f;
+
+// Collector for deep-sleep experiment results (JSON POST). Leave empty to keep
+// the results on the device and fetch them with GET /schedule/results.
+const char* SCHEDULE_UPLOAD_URL = "";
+
 /*
  * PROJECT CONTEXT: Project Scrooge - Zero-Leakage Switching Test Bench
  * This API is part of a larger project (Scrooge) designed to test the charge 
@@ -24,271 +92,466 @@ const int CHARGE_PIN = 17;
 
 // --- 2. GLOBAL VARIABLES ---
 
-WebServer server(80);
-
-// Non-blocking charge state management
-// We use volatile because these variables are modified in the main loop and potentially within an ISR/timer context, 
-// though here they are only used in the main loop and the HTTP handler.
-volatile bool isCharging = false;
-unsigned long chargeStartTime = 0;
-unsigned long chargeDurationMs = 0;
-
-// --- 3. SWAGGER / OPENAPI DEFINITION ---
-
-// OpenAPI 3.0 specification for the API. Reverted to standard C-string literal 
-// with escaped quotes to guarantee no trailing characters (like \n) are included.
-const char* swaggerJson = "{\"openapi\":\"3.0.0\",\"info\":{\"title\":\"ESP32 Capacitor Charger API (Project Scrooge)\",\"version\":\"1.0.1\",\"description\":\"API to control the charge duration of an external capacitor connected to GPIO 17. Part of Project Scrooge: a zero-leakage switching test bench.\",\"contact\":{\"url\":\"https://github.com/psmgeelen/ESP32_API_TestBench\"}},\"servers\":[{\"url\":\"/\",\"description\":\"Local ESP32 Server\"}],\"paths\":{\"/charge\":{\"get\":{\"tags\":[\"Control\"],\"summary\":\"Start Capacitor Charging\",\"parameters\":[{\"name\":\"time\",\"in\":\"query\",\"required\":true,\"schema\":{\"type\":\"integer\",\"format\":\"int32\",\"minimum\":100,\"maximum\":60000},\"description\":\"Duration to hold GPIO 17 HIGH, in milliseconds (100ms to 60000ms).\"}],\"responses\":{\"200\":{\"description\":\"Charging cycle initiated successfully.\"},\"400\":{\"description\":\"Invalid or missing 'time' parameter.\"},\"409\":{\"description\":\"A charging cycle is already in progress.\"}}}},\"/state\":{\"get\":{\"tags\":[\"Status\"],\"summary\":\"Get Current GPIO Charge State\",\"description\":\"Reports if the GPIO is currently HIGH (charging) or LOW (idle), and the remaining time if charging.\",\"responses\":{\"200\":{\"description\":\"Current state information.\",\"content\":{\"application/json\":{\"example\":{\"status\":\"charging\",\"gpio_level\":\"HIGH\",\"duration_ms\":5000,\"time_remaining_ms\":1500}}}}}}},\"/stop\":{\"post\":{\"tags\":[\"Control\"],\"summary\":\"Emergency Stop\",\"description\":\"Immediately stops any active charging cycle by setting GPIO 17 LOW.\",\"responses\":{\"200\":{\"description\":\"Charge stopped or confirmed idle.\"}}}},\"/health\":{\"get\":{\"tags\":[\"System\"],\"summary\":\"Health Check\",\"description\":\"Simple check to ensure the server is running.\",\"responses\":{\"200\":{\"description\":\"System operational.\"}}}},\"/info\":{\"get\":{\"tags\":[\"System\"],\"summary\":\"Get Project Information\",\"description\":\"Provides details about the project context and configuration.\",\"responses\":{\"200\":{\"description\":\"Project details.\"}}}}}}";
-
-// HTML for the Swagger UI page, loading assets from a CDN
-const char* swaggerHtml = R"rawliteral(
-<!DOCTYPE html>
-<html lang="en">
-<head>
-  <meta charset="UTF-8">
-  <title>ESP32 Capacitor Charger API</title>
-  <link rel="stylesheet" type="text/css" href="https://cdnjs.cloudflare.com/ajax/libs/swagger-ui/3.52.0/swagger-ui.css" >
-  <style>
-    body { font-family: 'Inter', sans-serif; background-color: #f0f0f0; }
-    .topbar a span { content: "Capacitor Charger (Project Scrooge)"; }
-  </style>
-</head>
-<body>
-  <div id="swagger-ui"></div>
-  <script src="https://cdnjs.cloudflare.com/ajax/libs/swagger-ui/3.52.0/swagger-ui-bundle.js"></script>
-  <script>
-    window.onload = function() {
-      // Build a system
-      const ui = SwaggerUIBundle({
-        url: window.location.origin + "/swagger.json", // Load the OpenAPI spec from our ESP32 endpoint
-        dom_id: '#swagger-ui',
-        deepLinking: true,
-        presets: [
-          SwaggerUIBundle.presets.apis,
-          SwaggerUIBundle.SwaggerUIStandalonePreset
-        ],
-        layout: "BaseLayout"
-      });
-      window.ui = ui;
-    };
-  </script>
-</body>
-</html>
-)rawliteral";
-
-// --- 4. API HANDLERS ---
+// Socket server shared with the virtual bench: keeps connections open between
+// requests (the Arduino WebServer closes every one) and routes through a trie.
+HttpServer server;
+
+// Boot timing benchmark: set once the first HTTP request has been served.
+bool firstRequestServed = false;
+
+// --- 3. DEVICE API HANDLERS ---
+
+// The core routes (/charge, /state, /stop, /health, /info, Swagger) are
+// platform independent and live in src/core/api.cpp. The handlers below use
+// ESP32-only subsystems.
+
+// In PowerMode order.
+constexpr const char* POWER_MODE_NAMES[] = {"performance", "modem_sleep", "light_sleep"};
+static_assert(sizeof(POWER_MODE_NAMES) / sizeof(POWER_MODE_NAMES[0]) == POWER_MODE_COUNT, "One name per PowerMode");
+
+constexpr ApiParam POWER_PARAMS[] = {
+  apiEnum("mode", POWER_MODE_NAMES).required()
+      .describedAs("Idle policy. A charge cycle always runs at full clock regardless of the mode."),
+};
+
+constexpr ApiParam SCHEDULE_PARAMS[] = {
+  apiInteger("charge_ms", CHARGE_MIN_MS, CHARGE_MAX_MS).inUnit("ms").required(),
+  apiInteger("interval_s", 1, SCHEDULE_MAX_INTERVAL_S).inUnit("s").required(),
+  apiInteger("measures", 1, SCHEDULE_MAX_MEASURES).required(),
+  apiInteger("cycles", 1, SCHEDULE_MAX_CYCLES).defaultsTo(1),
+  apiInteger("upload_every", 1, SCHEDULE_RESULT_CAPACITY).defaultsTo(SCHEDULE_RESULT_CAPACITY / 2)
+      .describedAs("Join Wi-Fi and upload after this many buffered results. Ignored without SCHEDULE_UPLOAD_URL."),
+};
 
 /**
- * @brief Serves the OpenAPI specification in JSON format.
+ * @brief Adds the Wi-Fi link state to /health.
  */
-void handleSwaggerJson() {
-  server.sendHeader("Content-Type", "application/json");
-  server.send(200, "application/json", swaggerJson);
+void appendHealth(ResponseWriter& response) {
+  response.field("wifi", wifiLinkStateName());
+  response.field("wifi_outages", wifiLinkStats().outages);
 }
 
 /**
- * @brief Serves the Swagger UI HTML page.
+ * @brief Refuses manual charges while a deep-sleep experiment owns the pin.
  */
-void handleSwaggerUi() {
-  server.send(200, "text/html", swaggerHtml);
+const char* chargeInterlock() {
+  return scheduleStatus().active ? "A scheduled experiment is running. Stop it first." : nullptr;
 }
 
 /**
- * @brief Handles the root path and redirects to Swagger UI.
+ * @brief Handles the /network API call, reporting link state and reconnect statistics.
  */
-void handleRoot() {
-  server.sendHeader("Location", "/swagger");
-  server.send(302, "text/plain", "Redirecting to Swagger UI...");
+void handleNetwork(HttpExchange& http) {
+  const WifiLinkStats& stats = wifiLinkStats();
+  unsigned long currentOutageMs = stats.outageStartMs != 0 ? millis() - stats.outageStartMs : 0;
+
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("state", wifiLinkStateName());
+  response.field("ip", WiFi.localIP().toString().c_str());
+  response.field("rssi_dbm", wifiLinkUp() ? WiFi.RSSI() : 0);
+  response.field("outages", stats.outages);
+  response.field("attempts", stats.attempts);
+  response.field("last_reconnect_ms", stats.lastReconnectMs);
+  response.field("max_reconnect_ms", stats.maxReconnectMs);
+  response.field("total_downtime_ms", stats.totalDowntimeMs);
+  response.field("current_outage_ms", currentOutageMs);
+  response.field("backoff_ms", stats.currentBackoffMs);
+  response.endObject();
+  response.send(http);
 }
 
 /**
- * @brief Handles the main /charge API call.
- * * Takes 'time' parameter and starts the non-blocking charge cycle.
- * URL format: /charge?time=500
+ * @brief Adds the heap figures {"free", "largest_block", "min_free"} as an
+ * object left open for more.
  */
-void handleCharge() {
-  if (isCharging) {
-    // Conflict: already busy
-    server.send(409, "application/json", "{\"status\":\"error\", \"message\":\"Charging in progress. Please wait.\"}");
-    return;
-  }
+static void writeHeap(ResponseWriter& response, const MemorySample& sample) {
+  response.key("heap");
+  response.beginObject();
+  response.field("free", sample.freeHeap);
+  response.field("largest_block", sample.largestBlock);
+  response.field("min_free", sample.minFreeHeap);
+}
 
-  if (!server.hasArg("time")) {
-    // Bad request: missing parameter
-    server.send(400, "application/json", "{\"status\":\"error\", \"message\":\"Missing 'time' parameter (ms).\"}");
-    return;
+/**
+ * @brief Handles the /system/memory API call: heap, fragmentation, PSRAM and
+ * task stack high-water marks now, and the sampled heap history.
+ */
+void handleSystemMemory(HttpExchange& http) {
+  MemorySample now = memoryNow();
+  uint32_t fragmentationPct = now.freeHeap ? 100 - (uint32_t)((uint64_t)now.largestBlock * 100 / now.freeHeap) : 0;
+
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("uptime_s", now.uptimeS);
+  writeHeap(response, now);
+  response.field("size", memoryHeapSize());
+  response.field("fragmentation_pct", fragmentationPct);
+  response.endObject();
+  if (memoryPsramSize() > 0) {
+    response.key("psram");
+    response.beginObject();
+    response.field("size", memoryPsramSize());
+    response.field("free", now.freePsram);
+    response.endObject();
+  } else {
+    response.nullField("psram");
   }
 
-  // Parse and validate the time parameter
-  long requestedTime = server.arg("time").toInt();
+  response.key("tasks");
+  response.beginArray();
+  for (uint8_t i = 0; i < memoryTaskCount(); i++) {
+    MemoryTaskStack stack = memoryTaskStack(i);
+    response.beginObject();
+    response.field("name", stack.name);
+    if (stack.running) {
+      response.field("stack_free_min", stack.stackFreeMin);
+    } else {
+      response.nullField("stack_free_min");
+    }
+    response.endObject();
+  }
+  response.endArray();
+
+  response.field("sample_period_s", MEMORY_SAMPLE_PERIOD_MS / 1000);
+  response.key("history");
+  response.beginArray();
+  MemorySample samples[MEMORY_HISTORY];
+  uint8_t count = memoryHistory(samples, MEMORY_HISTORY);
+  for (uint8_t i = 0; i < count; i++) {
+    response.beginObject();
+    response.field("t_s", samples[i].uptimeS);
+    writeHeap(response, samples[i]);
+    response.endObject();
+    response.endObject();
+  }
+  response.endArray();
+  response.endObject();
+  response.send(http);
+}
 
-  // Enforce a reasonable range (100ms to 60s)
-  if (requestedTime < 100 || requestedTime > 60000) {
-    server.send(400, "application/json", "{\"status\":\"error\", \"message\":\"'time' must be between 100 and 60000 ms.\"}");
-    return;
+/**
+ * @brief Handles the /power API call. GET reports the idle policy of every mode,
+ * POST with a 'mode' parameter selects one at runtime.
+ */
+void handlePower(HttpExchange& http) {
+  if (http.method() == HTTP_METHOD_POST) {
+    ApiArgs args;
+    if (!apiParseArgs(http, POWER_PARAMS, args)) {
+      return;
+    }
+    if (!powerSetMode((PowerMode)args.value("mode"))) {
+      http.send(409, "application/json", "{\"status\":\"error\", \"message\":\"Mode not supported by this firmware build.\"}");
+      return;
+    }
   }
 
-  // Start the non-blocking charge cycle
-  isCharging = true;
-  chargeStartTime = millis();
-  chargeDurationMs = requestedTime;
-  
-  // Immediately set pin HIGH
-  digitalWrite(CHARGE_PIN, HIGH);
-  
-  String response = "{\"status\":\"success\", \"message\":\"Charge cycle initiated for " + String(requestedTime) + "ms.\"}";
-  server.send(200, "application/json", response);
-
-  Serial.printf("Charge initiated for %d ms.\n", (int)requestedTime);
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("mode", powerModeName(powerMode()));
+  response.key("modes");
+  response.beginArray();
+  for (int i = 0; i < POWER_MODE_COUNT; i++) {
+    PowerMode mode = (PowerMode)i;
+    PowerModeStats stats = powerModeStats(mode);
+    response.beginObject();
+    response.field("name", powerModeName(mode));
+    response.field("supported", powerModeSupported(mode));
+    response.field("nominal_idle_current_ma", powerNominalIdleCurrentMa(mode), 1);
+    response.field("expected_added_latency_ms", powerExpectedAddedLatencyMs(mode));
+    response.field("measured_avg_loop_gap_us", stats.avgGapUs);
+    response.field("measured_max_loop_gap_us", stats.maxGapUs);
+    response.field("residency_ms", stats.residencyMs);
+    response.endObject();
+  }
+  response.endArray();
+  response.endObject();
+  response.send(http);
 }
 
 /**
- * @brief Handles the /state API call to report charge status.
+ * @brief Handles the /schedule API call. GET reports the deep-sleep experiment,
+ * POST defines and starts one; the device then sleeps between events.
+ * URL format: /schedule?charge_ms=500&interval_s=600&measures=144&cycles=1&upload_every=48
  */
-void handleState() {
-  String response;
-  if (isCharging) {
-    unsigned long timeElapsed = millis() - chargeStartTime;
-    // Calculate time remaining. Use ternary to prevent underflow if monitorChargeState hasn't run yet.
-    unsigned long timeRemaining = chargeDurationMs > timeElapsed ? chargeDurationMs - timeElapsed : 0;
-    
-    response = "{\"status\":\"charging\", ";
-    response += "\"gpio_level\":\"HIGH\", ";
-    response += "\"duration_ms\":" + String(chargeDurationMs) + ", ";
-    response += "\"time_remaining_ms\":" + String(timeRemaining) + "}";
-  } else {
-    // We check the actual digital read of the pin for the real state, 
-    // especially after an emergency stop or if the pin was manipulated externally.
-    int pinState = digitalRead(CHARGE_PIN);
-    
-    response = "{\"status\":\"idle\", \"gpio_level\":\"" + (pinState == HIGH ? String("HIGH") : String("LOW")) + "\"}";
+void handleSchedule(HttpExchange& http) {
+  if (http.method() == HTTP_METHOD_POST) {
+    if (chargeActive() || cycleActive() || sweepActive() || scheduleStatus().active) {
+      http.send(409, "application/json", "{\"status\":\"error\", \"message\":\"A charge cycle or experiment is already running.\"}");
+      return;
+    }
+    ApiArgs args;
+    if (!apiParseArgs(http, SCHEDULE_PARAMS, args)) {
+      return;
+    }
+
+    ScheduleDefinition definition;
+    definition.chargeMs = args.value("charge_ms");
+    definition.intervalS = args.value("interval_s");
+    definition.measures = args.value("measures");
+    definition.cycles = args.value("cycles");
+    definition.uploadEvery = args.value("upload_every");
+
+    const char* error = scheduleStart(definition);
+    if (error) {
+      http.send(400, "application/json", ArenaString("{\"status\":\"error\", \"message\":\"") + error + "\"}");
+      return;
+    }
   }
-  server.send(200, "application/json", response);
+
+  ScheduleStatus status = scheduleStatus();
+  ResponseWriter response(http);
+  response.beginObject();
+  response.field("active", status.active);
+  response.field("charge_ms", status.definition.chargeMs);
+  response.field("interval_s", status.definition.intervalS);
+  response.field("measures", status.definition.measures);
+  response.field("cycles", status.definition.cycles);
+  response.field("upload_every", status.definition.uploadEvery);
+  response.field("next_event", status.nextEvent);
+  response.field("total_events", status.totalEvents);
+  response.field("next_event_in_s", status.nextEventInS);
+  response.field("buffered", status.buffered);
+  response.field("uploaded", status.uploaded);
+  response.field("dropped", status.dropped);
+  response.field("wakeups", status.wakeups);
+  response.endObject();
+  response.send(http);
 }
 
 /**
- * @brief Handles the /stop API call to immediately halt charging (POST method).
+ * @brief Handles the /schedule/stop API call (POST). Buffered results are kept.
  */
-void handleStop() {
-  if (isCharging) {
-    digitalWrite(CHARGE_PIN, LOW); // Turn off the charge immediately
-    isCharging = false;
-    Serial.println("Emergency stop requested. Charge pin set LOW.");
-    server.send(200, "application/json", "{\"status\":\"success\", \"message\":\"Charging stopped immediately.\"}");
-  } else {
-    // Just ensure the pin is low and report success if it was already low/idle
-    digitalWrite(CHARGE_PIN, LOW);
-    server.send(200, "application/json", "{\"status\":\"success\", \"message\":\"Not currently charging. Pin confirmed LOW.\"}");
-  }
+void handleScheduleStop(HttpExchange& http) {
+  scheduleStop();
+  http.send(200, "application/json", "{\"status\":\"success\", \"message\":\"Scheduled experiment stopped.\"}");
 }
 
 /**
- * @brief Handles the /health API call.
+ * @brief Handles the /schedule/results API call, returning results not yet uploaded.
  */
-void handleHealth() {
-  String response = "{\"status\":\"ok\", \"device\":\"ESP32\", \"uptime_ms\":" + String(millis()) + "}";
-  server.send(200, "application/json", response);
+void handleScheduleResults(HttpExchange& http) {
+  ArenaString response = "{\"results\":";
+  scheduleResultsJson(response);
+  response += "}";
+  http.send(200, "application/json", response);
 }
 
+// --- 4. CORE FUNCTIONS ---
+
 /**
- * @brief Handles the /info API call, providing project context.
+ * @brief Starts the Wi-Fi connection in the background. Does not block setup().
  */
-void handleInfo() {
-  String response = "{\"project\":\"Scrooge Capacitor Test Bench\", ";
-  response += "\"description\":\"Tests capacitor charge/discharge for zero-leakage switching using relays (no transistors/MOSFETs).\", ";
-  response += "\"repository\":\"https://github.com/psmgeelen/ESP32_API_TestBench\", ";
-  response += "\"charge_pin\":" + String(CHARGE_PIN) + ", ";
-  response += "\"api_version\":\"1.0.1\"}";
-  server.send(200, "application/json", response);
+void connectWifi() {
+  WifiLinkConfig config;
+  config.ssid = ssid;
+  config.password = password;
+  config.useStaticIp = USE_STATIC_IP;
+  config.localIp = STATIC_IP;
+  config.gateway = STATIC_GATEWAY;
+  config.subnet = STATIC_SUBNET;
+  config.dns = STATIC_DNS;
+  config.reuseCachedLease = REUSE_CACHED_LEASE;
+  wifiLinkBegin(config);
 }
 
 /**
- * @brief Handles any 404 not found errors.
+ * @brief Logs the boot-to-first-request benchmark the first time a request is served.
  */
-void handleNotFound() {
-  String message = "Resource Not Found\n\n";
-  message += "URI: ";
-  message += server.uri();
-  message += "\nMethod: ";
-  message += (server.method() == HTTP_GET) ? "GET" : (server.method() == HTTP_POST ? "POST" : "OTHER");
-  server.send(404, "text/plain", message);
+void reportFirstRequest() {
+  if (firstRequestServed) {
+    return;
+  }
+  firstRequestServed = true;
+
+  const WifiLinkTimings& t = wifiLinkTimings();
+  int64_t nowUs = esp_timer_get_time();
+  Serial.println("[boot] Boot-to-first-request benchmark (ms since reset):");
+  Serial.printf("[boot]   wifi begin     %8.1f\n", t.beginUs / 1000.0);
+  Serial.printf("[boot]   associated     %8.1f (%s)\n", t.associatedUs / 1000.0,
+                t.usedCachedBssid ? "cached BSSID/channel" : "full scan");
+  Serial.printf("[boot]   got IP         %8.1f (%s)\n", t.gotIpUs / 1000.0,
+                USE_STATIC_IP ? "static" : (t.usedCachedLease ? "cached lease" : "DHCP"));
+  Serial.printf("[boot]   first request  %8.1f\n", nowUs / 1000.0);
 }
 
-// --- 5. CORE FUNCTIONS ---
+// ESP32-only routes, registered after the shared CORE_ROUTES (include/core/routes.h).
+constexpr ApiRoute DEVICE_ROUTES[] = {
+  apiRoute("/network", HTTP_METHOD_GET, handleNetwork)
+      .doc("System", "Wi-Fi Link Statistics",
+           "Reports the Wi-Fi link state, outage count and reconnect latency. The bench keeps charging through "
+           "outages and reconnects in the background with exponential backoff.")
+      .respond(200, "Link state and reconnect statistics.",
+               R"({"state":"connected","ip":"192.168.1.50","rssi_dbm":-61,"outages":2,"attempts":5,)"
+               R"("last_reconnect_ms":1840,"max_reconnect_ms":4210,"total_downtime_ms":6050,)"
+               R"("current_outage_ms":0,"backoff_ms":0})"),
+  apiRoute("/system/memory", HTTP_METHOD_GET, handleSystemMemory)
+      .doc("System", "Heap, Stack and Fragmentation Telemetry",
+           "Reports the free heap, its largest free block, the lowest free heap since boot, PSRAM where present "
+           "and the stack high-water mark of each watched task. The heap is also sampled once a minute into a "
+           "one-hour history, so leaks and fragmentation show up as trends.")
+      .respond(200, "Memory now and the sampled history, in bytes.",
+               R"({"uptime_s":7260,"heap":{"free":182340,"largest_block":110580,"min_free":171204,)"
+               R"("size":298912,"fragmentation_pct":40},"psram":null,"tasks":[{"name":"loopTask",)"
+               R"("stack_free_min":5132},{"name":"wifi","stack_free_min":3416}],"sample_period_s":60,)"
+               R"("history":[{"t_s":7200,"heap":{"free":182512,"largest_block":110580,"min_free":171204}}]})"),
+  apiRoute("/power", HTTP_METHOD_GET, handlePower)
+      .doc("System", "Get Idle Power Policy",
+           "Reports the active idle mode and, per mode, the nominal idle current from the ESP32 datasheet (not "
+           "measured), the expected added request latency and the measured loop service gap.")
+      .respond(200, "Idle power policy."),
+  apiRoute("/power", HTTP_METHOD_POST, handlePower)
+      .doc("System", "Select Idle Power Mode")
+      .withParams(POWER_PARAMS)
+      .respond(200, "Mode applied and saved.")
+      .respond(400, "Invalid or missing 'mode' parameter.")
+      .respond(409, "Mode not supported by this firmware build."),
+
+  // Deep-sleep experiment Endpoints
+  apiRoute("/schedule", HTTP_METHOD_GET, handleSchedule)
+      .doc("Schedule", "Get Deep-Sleep Experiment",
+           "Reports the scheduled experiment, its progress and the number of buffered results.")
+      .respond(200, "Experiment status."),
+  apiRoute("/schedule", HTTP_METHOD_POST, handleSchedule)
+      .doc("Schedule", "Start Deep-Sleep Experiment",
+           "Runs cycles of one charge followed by a series of voltage measurements. The device deep-sleeps between "
+           "events with GPIO 17 held LOW, and only starts Wi-Fi to upload buffered results.")
+      .withParams(SCHEDULE_PARAMS)
+      .respond(200, "Experiment started.")
+      .respond(400, "Invalid or missing parameter.")
+      .respond(409, "A charge cycle or experiment is already running."),
+  apiRoute("/schedule/stop", HTTP_METHOD_POST, handleScheduleStop)
+      .doc("Schedule", "Stop Deep-Sleep Experiment")
+      .respond(200, "Experiment stopped; buffered results are kept."),
+  apiRoute("/schedule/results", HTTP_METHOD_GET, handleScheduleResults)
+      .doc("Schedule", "Get Buffered Results", "Results held in RTC memory that have not been uploaded yet.")
+      .respond(200, "Buffered results."),
+};
+
+constexpr size_t DEVICE_ROUTE_COUNT = sizeof(DEVICE_ROUTES) / sizeof(DEVICE_ROUTES[0]);
+
+// OpenAPI document of both tables, rendered by the compiler.
+constexpr ApiRouteTable API_TABLES[] = {{CORE_ROUTES, CORE_ROUTE_COUNT}, {DEVICE_ROUTES, DEVICE_ROUTE_COUNT}};
+constexpr ApiRouteList API_ROUTE_LIST = {API_TABLES, 2};
+constexpr auto DEVICE_OPENAPI = openApiRender<openApiSize(API_INFO, API_ROUTE_LIST)>(API_INFO, API_ROUTE_LIST);
 
 /**
- * @brief Checks the non-blocking charge state and turns off the pin when time is up.
+ * @brief Holds the PM lock (full clock, no light sleep) while anything timed
+ * runs: a charge, and also the whole cycle run or sweep around it and a pending
+ * hold-up measurement, so discharge thresholds and relay drop-out are polled at
+ * full speed too.
  */
-void monitorChargeState() {
-  if (isCharging) {
-    // Check if the duration has passed
-    // This is the non-blocking way to check time elapsed, safely handling millis() overflow.
-    if (millis() - chargeStartTime >= chargeDurationMs) {
-      digitalWrite(CHARGE_PIN, LOW); // Turn off the charge
-      isCharging = false;
-      Serial.printf("Charge complete after %d ms. Pin set LOW.\n", (int)chargeDurationMs);
-    }
-  }
+static void updatePowerLock() {
+  powerSetChargeActive(chargeActive() || cycleActive() || sweepActive() || holdupPending());
 }
 
 /**
- * @brief Connects to Wi-Fi.
+ * @brief Charge start/end: takes or drops the PM lock at once, without waiting
+ * for the next serviceControl().
  */
-void connectWifi() {
-  Serial.print("Connecting to Wi-Fi...");
-  WiFi.begin(ssid, password);
-
-  int attempt = 0;
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-    attempt++;
-    if (attempt > 20) {
-      Serial.println("\nFailed to connect. Restarting...");
-      ESP.restart(); // Restart if connection fails
-    }
-  }
+void onChargeActive(bool /* active */) {
+  updatePowerLock();
+}
+
+/**
+ * @brief The charge control loop. Also run by the HTTP server while a response
+ * waits for a slow client, so no client can hold up the end of a pulse.
+ */
+void serviceControl() {
+  // Finish an emergency stop from the button or the UDP port first
+  estopService();
 
-  Serial.println("\nWiFi connected.");
-  Serial.print("Access API at: http://");
-  Serial.print(WiFi.localIP());
-  Serial.println("/swagger");
+  // Non-blocking check for the charge state
+  chargeMonitor();
+
+  // Advance queued charge/hold/discharge cycles and the running sweep, and
+  // collect hold-up measurements; keep full clock (and out of light sleep)
+  // while any of them runs
+  cycleService();
+  sweepService();
+  holdupService();
+  updatePowerLock();
 }
 
 void setup() {
-  Serial.begin(9600);
+  // Release the pad hold from deep sleep before anything drives CHARGE_PIN.
+  scheduleBegin(CHARGE_PIN, SCHEDULE_UPLOAD_URL);
+
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER_BYTES);
+  Serial.begin(SERIAL_BAUD);
   delay(100);
 
   // Set the pin to output mode and LOW initially
-  pinMode(CHARGE_PIN, OUTPUT);
-  digitalWrite(CHARGE_PIN, LOW);
-
+  chargeBegin(CHARGE_PIN);
+  chargeSetSense(SENSE_ADC_PIN, CHARGE_SAMPLE_PERIOD_US, SENSE_DIVIDER_RATIO);
+  chargeSetDischargePin(DISCHARGE_PIN);
+  chargeSetActiveCallback(onChargeActive);
+  holdupBegin(CONTACT_SENSE_PIN, CHARGE_PIN);
+  estopButtonBegin(STOP_BUTTON_PIN);
+
+  // Run any due scheduled event; it reads the sense input set up above. A timer
+  // wake-up that does not need Wi-Fi goes back to sleep in here.
+  scheduleHandleWake();
+
+  // Returns immediately; the link comes up in the background while
+  // charge control and the HTTP server are already running.
   connectWifi();
 
-  // Define API routes
-  server.on("/", HTTP_GET, handleRoot);
-  server.on("/swagger", HTTP_GET, handleSwaggerUi);
-  server.on("/swagger.json", HTTP_GET, handleSwaggerJson);
-  
-  // Control Endpoints
-  server.on("/charge", HTTP_GET, handleCharge);
-  server.on("/stop", HTTP_POST, handleStop); 
-  
-  // Status/Info Endpoints
-  server.on("/state", HTTP_GET, handleState);
-  server.on("/health", HTTP_GET, handleHealth);
-  server.on("/info", HTTP_GET, handleInfo);
-
-  // Fallback for 404
+  // Needs the Wi-Fi driver initialised by connectWifi() for modem sleep.
+  powerBegin(DEFAULT_POWER_MODE);
+
+  // Needs the network stack initialised by connectWifi().
+  if (STOP_UDP_PORT > 0 && !stopListenerBegin(STOP_UDP_PORT)) {
+    Serial.println("UDP stop listener could not start.");
+  }
+  if (CONTROL_UDP_PORT > 0 && udpControlBegin(CONTROL_UDP_PORT) < 0) {
+    Serial.println("UDP control port could not be opened.");
+  }
+
+  // After Wi-Fi so its tasks exist; samples the heap once a minute from loop().
+  memoryBegin();
+  memoryWatchTask("estop");
+
+  ApiPlatform platform = {"ESP32", appendHealth, chargeInterlock, DEVICE_OPENAPI.text};
+  apiBegin(platform);
+
+  // Define API routes: the shared table first, then the ESP32-only ones
+  if (!server.addRoutes(CORE_ROUTES, CORE_ROUTE_COUNT) || !server.addRoutes(DEVICE_ROUTES, DEVICE_ROUTE_COUNT)) {
+    Serial.println("Route table does not fit the router; raise HttpServer::MAX_ROUTE_NODES.");
+  }
   server.onNotFound(handleNotFound);
+  server.onWait(serviceControl);
+  // /state long polls wake when chargeMonitor() or /stop ends a charge
+  server.wakeParkedOn(chargeStateVersion);
 
-  server.begin();
-  Serial.println("HTTP Server started.");
+  if (!server.begin(80)) {
+    Serial.println("HTTP Server could not listen on port 80.");
+  }
+  Serial.printf("HTTP Server started %.1f ms after reset.\n", esp_timer_get_time() / 1000.0);
 }
 
 void loop() {
+  // Process Wi-Fi events (link up, cache update, retries)
+  wifiLinkService();
+
   // Handle incoming HTTP requests
   server.handleClient();
+  if (server.requestsServed() > 0) {
+    reportFirstRequest();
+  }
 
-  // Non-blocking check for the charge state
-  monitorChargeState();
+  // Handle incoming control frames over UDP and the serial port
+  udpControlService();
+  serialControlService();
+
+  serviceControl();
+
+  // Upload deep-sleep results and go back to sleep between scheduled events
+  scheduleService(wifiLinkUp(), chargeActive() || cycleActive() || sweepActive());
+
+  // Sample the heap into the /system/memory history
+  memoryService();
+
+  // Yield to the idle task (DFS / modem sleep / light sleep) when nothing is running
+  powerIdle();
 }
@@ -0,0 +1,98 @@
+#include "memory_telemetry.h"
+
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// --- 1. STATE ---
+
+// Tasks of the Arduino core and ESP-IDF that a request or a Wi-Fi outage can
+// push towards their stack limit.
+static const char* SYSTEM_TASKS[] = {"loopTask", "wifi", "tiT", "sys_evt", "esp_timer"};
+
+static const char* watchedTasks[MEMORY_MAX_TASKS];
+static uint8_t watchedCount = 0;
+
+static MemorySample history[MEMORY_HISTORY];
+static uint8_t historyHead = 0;   // Oldest sample
+static uint8_t historyCount = 0;
+static unsigned long lastSampleMs = 0;
+
+// --- 2. SAMPLING ---
+
+MemorySample memoryNow() {
+  MemorySample sample;
+  sample.uptimeS = millis() / 1000;
+  sample.freeHeap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  sample.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  sample.minFreeHeap = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  sample.freePsram = psramFound() ? heap_caps_get_free_size(MALLOC_CAP_SPIRAM) : 0;
+  return sample;
+}
+
+static void record() {
+  uint8_t slot = (historyHead + historyCount) % MEMORY_HISTORY;
+  history[slot] = memoryNow();
+  if (historyCount < MEMORY_HISTORY) {
+    historyCount++;
+  } else {
+    historyHead = (historyHead + 1) % MEMORY_HISTORY;
+  }
+  lastSampleMs = millis();
+}
+
+void memoryBegin() {
+  for (const char* name : SYSTEM_TASKS) {
+    memoryWatchTask(name);
+  }
+  record();
+}
+
+bool memoryWatchTask(const char* name) {
+  if (watchedCount == MEMORY_MAX_TASKS) {
+    return false;
+  }
+  watchedTasks[watchedCount++] = name;
+  return true;
+}
+
+void memoryService() {
+  if (millis() - lastSampleMs >= MEMORY_SAMPLE_PERIOD_MS) {
+    record();
+  }
+}
+
+uint8_t memoryHistory(MemorySample* out, uint8_t max) {
+  uint8_t count = historyCount < max ? historyCount : max;
+  // The most recent samples when out is smaller than the history.
+  uint8_t skip = historyCount - count;
+  for (uint8_t i = 0; i < count; i++) {
+    out[i] = history[(historyHead + skip + i) % MEMORY_HISTORY];
+  }
+  return count;
+}
+
+// --- 3. TASK STACKS ---
+
+uint8_t memoryTaskCount() {
+  return watchedCount;
+}
+
+MemoryTaskStack memoryTaskStack(uint8_t index) {
+  MemoryTaskStack stack = {watchedTasks[index], false, 0};
+  TaskHandle_t task = xTaskGetHandle(stack.name);
+  if (task) {
+    stack.running = true;
+    // ESP-IDF counts stack in bytes, not words.
+    stack.stackFreeMin = uxTaskGetStackHighWaterMark(task);
+  }
+  return stack;
+}
+
+uint32_t memoryHeapSize() {
+  return heap_caps_get_total_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+uint32_t memoryPsramSize() {
+  return psramFound() ? heap_caps_get_total_size(MALLOC_CAP_SPIRAM) : 0;
+}
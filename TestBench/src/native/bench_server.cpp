@@ -0,0 +1,256 @@
+/*
+ * Virtual test bench: the bench's HTTP API served over POSIX sockets on Linux.
+ *
+ * Runs the same route table as the firmware's setup() (CORE_ROUTES) with the
+ * same handlers, so request semantics (including the 400 and 409 paths) are
+ * identical. GPIO is simulated, the charge pin drives the circuit model
+ * (rc_circuit.h) whose sense divider feeds the ADC and whose relay contact
+ * feeds the hold-up input, and the virtual clock follows the host's monotonic
+ * clock.
+ *
+ *   bench_server [--port 8080] [--count N] [--start-ms MS] [--keep-alive-ms MS]
+ *                [--max-requests N] [--control-port N] [--serial] [--quiet]
+ *
+ * --count N forks N independent benches on consecutive ports, e.g. for
+ * integration and load tests against dozens of virtual benches at once.
+ * --start-ms sets the virtual clock's initial value, e.g. 4294960000 to run
+ * into the 49.7-day millis() wrap after a few seconds. --keep-alive-ms and
+ * --max-requests set the HttpServer keep-alive policy; --keep-alive-ms 0
+ * closes every connection after one request. --control-port sets the UDP
+ * control port (core/udp_control.h), counting up with --count like --port; by
+ * default a free one is picked and printed with the HTTP port. --serial
+ * opens a pty as the bench's serial port and prints its path: the log and
+ * the serial control protocol (core/serial_control.h) run on it as on the
+ * ESP32's UART, for src/native/serial_client.cpp or any terminal program.
+ *
+ * The UDP stop port (core/emergency_stop.h) listens on the HTTP port's number.
+ * Unlike the firmware's stop task it is polled with the control loop, so the
+ * bench's stop latency includes up to one loop pass.
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/cycle_control.h"
+#include "core/emergency_stop.h"
+#include "core/holdup_monitor.h"
+#include "core/http_server.h"
+#include "core/routes.h"
+#include "core/serial_control.h"
+#include "core/sweep_control.h"
+#include "core/udp_control.h"
+#include "rc_circuit.h"
+#include "sim_hal.h"
+
+static const int CHARGE_PIN = 17;
+static const int SENSE_ADC_PIN = 34;
+static const int DISCHARGE_PIN = 16;
+static const int CONTACT_SENSE_PIN = 27;
+
+static volatile sig_atomic_t running = 1;
+
+static void onSignal(int) {
+  running = 0;
+}
+
+static uint32_t keepAliveMs = 5000;
+static uint16_t maxRequests = 100;
+static uint16_t controlPort = 0;
+static bool serialPort = false;
+
+static HttpServer* benchServer = nullptr;
+static std::chrono::steady_clock::time_point origin;
+static uint64_t originUs = 0;
+static uint64_t lastServiceUs = 0;
+static uint64_t longestGapUs = 0;
+static int stopFd = -1;
+
+/**
+ * @brief Opens a pty for the simulated serial port and attaches its master
+ * side. The slave side stays open too, so the master does not report a
+ * hang-up while no client has it open.
+ * @return The master, or -1.
+ */
+static int openSerialPty() {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+    return -1;
+  }
+  open(ptsname(master), O_RDWR | O_NOCTTY);
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL, 0) | O_NONBLOCK);
+  simSerialAttach(master);
+  return master;
+}
+
+/**
+ * @brief /health reports the longest time the control loop went unserviced,
+ * which is what a slow client would stretch a charge pulse by.
+ */
+static void appendHealth(ResponseWriter& response) {
+  response.field("simulated", true);
+  response.field("pid", getpid());
+  response.field("control_gap_max_us", longestGapUs);
+  response.key("http");
+  response.beginObject();
+  response.field("accepted", benchServer->connectionsAccepted());
+  response.field("served", benchServer->requestsServed());
+  response.field("rejected", benchServer->connectionsRejected());
+  response.field("read_timeouts", benchServer->readTimeouts());
+  response.field("write_timeouts", benchServer->writeTimeouts());
+  response.field("parked", benchServer->requestsParked());
+  response.endObject();
+}
+
+/**
+ * @brief The bench's control loop: follows wall time with the virtual clock and
+ * polls the charge, cycle, sweep and hold-up state. Also run by the server
+ * while a response drains.
+ */
+static void serviceControl() {
+  uint64_t elapsedUs =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+  if (lastServiceUs > 0 && elapsedUs - lastServiceUs > longestGapUs) {
+    longestGapUs = elapsedUs - lastServiceUs;
+  }
+  lastServiceUs = elapsedUs;
+  simSetTimeUs(originUs + elapsedUs);
+
+  while (stopFd >= 0 && estopUdpReceive(stopFd)) {
+  }
+  estopService();
+  chargeMonitor();
+  cycleService();
+  sweepService();
+  holdupService();
+}
+
+static int runBench(uint16_t port, uint64_t startUs) {
+  HttpServer server;
+  benchServer = &server;
+  server.onWait(serviceControl);
+  server.wakeParkedOn(chargeStateVersion);
+  server.addRoutes(CORE_ROUTES, CORE_ROUTE_COUNT);
+  server.onNotFound(handleNotFound);
+  server.setKeepAlive(keepAliveMs, maxRequests);
+  if (!server.begin(port)) {
+    fprintf(stderr, "bench_server: cannot listen on port %u\n", (unsigned)port);
+    return 1;
+  }
+
+  simSetTimeUs(startUs);
+  RcCircuitConfig config = rcDefaultConfig();
+  RcCircuit circuit(config);
+  circuit.reset(startUs);
+  rcAttach(&circuit, CHARGE_PIN, SENSE_ADC_PIN, DISCHARGE_PIN, CONTACT_SENSE_PIN);
+  chargeBegin(CHARGE_PIN);
+  holdupBegin(CONTACT_SENSE_PIN, CHARGE_PIN);
+  chargeSetDischargePin(DISCHARGE_PIN);
+  chargeSetSense(SENSE_ADC_PIN, CHARGE_SAMPLE_PERIOD_US,
+                 (float)((config.dividerTopOhm + config.dividerBottomOhm) / config.dividerBottomOhm));
+  ApiPlatform platform = {"native", appendHealth, nullptr, nullptr};
+  apiBegin(platform);
+  stopFd = estopUdpOpen(server.port(), false);
+  server.wakeOn(stopFd);
+  server.wakeOn(udpControlBegin(controlPort));
+  int serialFd = serialPort ? openSerialPty() : -1;
+  server.wakeOn(serialFd);
+
+  printf("Virtual bench listening on http://127.0.0.1:%u/, UDP control on port %u (pid %d)\n",
+         (unsigned)server.port(), (unsigned)udpControlPort(), (int)getpid());
+  if (serialFd >= 0) {
+    printf("Serial port on %s\n", ptsname(serialFd));
+  }
+  fflush(stdout);
+
+  origin = std::chrono::steady_clock::now();
+  originUs = startUs;
+  while (running) {
+    server.handleClient(1);
+    udpControlService();
+    serialControlService();
+    serviceControl();
+  }
+  cycleStop();
+  sweepStop();
+  chargeStop();
+  if (stopFd >= 0) {
+    close(stopFd);
+  }
+  udpControlClose();
+  if (serialFd >= 0) {
+    simSerialAttach(-1);
+    close(serialFd);
+  }
+  rcAttach(nullptr, -1, -1);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  uint16_t port = 8080;
+  int count = 1;
+  uint64_t startUs = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = (uint16_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+      count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--start-ms") == 0 && i + 1 < argc) {
+      startUs = strtoull(argv[++i], nullptr, 10) * 1000ULL;
+    } else if (strcmp(argv[i], "--keep-alive-ms") == 0 && i + 1 < argc) {
+      keepAliveMs = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--max-requests") == 0 && i + 1 < argc) {
+      maxRequests = (uint16_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--control-port") == 0 && i + 1 < argc) {
+      controlPort = (uint16_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--serial") == 0) {
+      serialPort = true;
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      simSetLogEnabled(false);
+    } else {
+      fprintf(stderr, "usage: %s [--port 8080] [--count N] [--start-ms MS] [--keep-alive-ms MS] [--max-requests N] [--control-port N] [--serial] [--quiet]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  // No SA_RESTART: the parent's wait() must return on a signal so it can
+  // pass the shutdown on to its children.
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onSignal;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  if (count <= 1) {
+    return runBench(port, startUs);
+  }
+
+  // One process per bench keeps every bench's state fully independent.
+  std::vector<pid_t> children;
+  for (int i = 0; i < count; i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      controlPort = controlPort == 0 ? 0 : controlPort + i;
+      return runBench(port == 0 ? 0 : port + i, startUs);
+    }
+    if (pid > 0) children.push_back(pid);
+  }
+  while (running && wait(nullptr) > 0) {
+  }
+  for (pid_t pid : children) {
+    kill(pid, SIGTERM);
+  }
+  while (wait(nullptr) > 0) {
+  }
+  return 0;
+}
@@ -0,0 +1,299 @@
+// Native checks against the circuit model (rc_circuit.h): charge curve, relay
+// timing, self-discharge, ADC noise, /charge?target_mv= and the hold-up measurement.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/holdup_monitor.h"
+#include "hal/adc.h"
+#include "hal/gpio.h"
+#include "checks.h"
+#include "native_support.h"
+#include "rc_circuit.h"
+#include "recording_exchange.h"
+#include "sim_hal.h"
+
+static uint64_t contactClosedAtUs = 0;
+static uint64_t contactOpenedAtUs = 0;
+
+static void onContact(bool closed, uint64_t atUs) {
+  if (closed) contactClosedAtUs = atUs;
+  else contactOpenedAtUs = atUs;
+}
+
+/**
+ * @brief A 200 ms charge through the real controller, with the model attached
+ * to the simulated pin. Checks the charge curve and the relay timing against
+ * the closed-form solution.
+ */
+static void checkChargeAndHoldUp() {
+  RcCircuitConfig config = rcDefaultConfig();
+  config.adcNoiseLsb = 0;
+  RcCircuit circuit(config);
+  circuit.setContactListener(onContact);
+  rcAttach(&circuit, CHARGE_PIN, SENSE_ADC_PIN);
+  simAddPinListener(onPin);
+
+  simSetTimeUs(5000000);
+  circuit.reset(simTimeUs());
+  contactClosedAtUs = contactOpenedAtUs = 0;
+  chargeStart(200);
+  double vTarget = circuit.targetV();
+  double tauOnUs = circuit.tauUs();
+  while (chargeActive()) {
+    simAdvanceUs(10);
+    chargeMonitor();
+  }
+  uint64_t widthUs = pinLowAtUs - pinHighAtUs;
+  double expectedV = vTarget * (1 - exp(-(double)widthUs / tauOnUs));
+  check(fabs(circuit.capacitorV() - expectedV) < 1e-6, "capacitor follows V(1 - exp(-t/RC)) while charging");
+
+  double pullInUs = -tauOnUs * log(1 - config.pullInV / vTarget);
+  int64_t closeError = (int64_t)(contactClosedAtUs - pinHighAtUs) - (int64_t)ceil(pullInUs) - config.operateUs;
+  char line[160];
+  snprintf(line, sizeof(line), "relay pulls in %.3f ms after the pin goes HIGH (error %lld us)",
+           (contactClosedAtUs - pinHighAtUs) / 1000.0, (long long)closeError);
+  check(contactClosedAtUs > 0 && closeError >= 0 && closeError <= 1, line);
+
+  double holdUpUs = circuit.tauUs() * log(expectedV / config.dropOutV) + config.releaseUs;
+  circuit.advanceTo(simTimeUs() + 2000000);
+  int64_t openError = (int64_t)(contactOpenedAtUs - pinLowAtUs) - (int64_t)ceil(holdUpUs);
+  snprintf(line, sizeof(line), "relay holds %.3f ms after the pin goes LOW (error %lld us)",
+           (contactOpenedAtUs - pinLowAtUs) / 1000.0, (long long)openError);
+  check(contactOpenedAtUs > contactClosedAtUs && openError >= -1 && openError <= 1, line);
+
+  simRemovePinListener(onPin);
+  rcAttach(nullptr, -1, -1);
+}
+
+/**
+ * @brief Six hours of self-discharge without a relay, both in one analytic
+ * step and as a 1 kS/s ADC stream for the first hour.
+ */
+static void checkSelfDischarge() {
+  RcCircuitConfig config = rcDefaultConfig();
+  config.coilOhm = 0;
+  config.leakageOhm = 20e6;
+  config.dividerTopOhm = 1e6;
+  config.dividerBottomOhm = 1e6;
+  RcCircuit circuit(config);
+
+  circuit.setDrive(true, 0);
+  circuit.setDrive(false, 10000000);
+  double v0 = circuit.capacitorV();
+  double tauUs = circuit.tauUs();
+  const uint64_t sixHoursUs = 6ULL * 3600 * 1000000;
+  circuit.advanceTo(10000000 + sixHoursUs);
+  double expectedV = v0 * exp(-(double)sixHoursUs / tauUs);
+  check(fabs(circuit.capacitorV() - expectedV) < 1e-9, "6 h of self-discharge in one step matches V0 exp(-t/RC)");
+
+  circuit.reset(0);
+  circuit.setDrive(true, 0);
+  circuit.setDrive(false, 10000000);
+  const uint32_t RATE_HZ = 1000;
+  const uint32_t CHUNK = 100000;
+  std::vector<uint16_t> samples(CHUNK);
+  uint64_t t = 10000000;
+  uint64_t total = 0;
+  double worstErrorMv = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (total < 3600ULL * RATE_HZ) {
+    circuit.sampleStream(t, 1000000 / RATE_HZ, CHUNK, samples.data());
+    double expectedMv = circuit.senseMv();
+    worstErrorMv = fmax(worstErrorMv, fabs(samples[CHUNK - 1] - expectedMv));
+    t += (uint64_t)CHUNK * (1000000 / RATE_HZ);
+    total += CHUNK;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  char line[160];
+  snprintf(line, sizeof(line), "1 h at 1 kS/s (%llu samples) in %.3f s wall, %.0f ns/sample",
+           (unsigned long long)total, seconds, seconds * 1e9 / total);
+  check(seconds < 10, line);
+  check(worstErrorMv < 10 * config.adcFullScaleMv / 4095, "stream stays within 10 LSB of the analytic curve");
+}
+
+/**
+ * @brief ADC quantisation and noise through halAnalogReadMilliVolts().
+ */
+static void checkAdc() {
+  RcCircuitConfig config = rcDefaultConfig();
+  config.coilOhm = 0;
+  config.leakageOhm = 0;
+  config.dividerTopOhm = 0;
+  config.dividerBottomOhm = 0;
+  config.supplyV = 1.2345;
+  RcCircuit circuit(config);
+  rcAttach(&circuit, CHARGE_PIN, SENSE_ADC_PIN);
+
+  simSetTimeUs(0);
+  circuit.reset(0);
+  circuit.setDrive(true, 0);
+  simSetTimeUs(10000000);  // Fully charged, held by the driver
+
+  const int N = 20000;
+  double lsbMv = config.adcFullScaleMv / 4095;
+  double sum = 0;
+  double sumSquares = 0;
+  bool quantised = true;
+  for (int i = 0; i < N; i++) {
+    simAdvanceUs(100);
+    int mv = halAnalogReadMilliVolts(SENSE_ADC_PIN);
+    double code = mv / lsbMv;
+    if (fabs(code - round(code)) > 0.5 / lsbMv + 1e-9) quantised = false;
+    sum += mv;
+    sumSquares += (double)mv * mv;
+  }
+  double mean = sum / N;
+  double sigmaLsb = sqrt(sumSquares / N - mean * mean) / lsbMv;
+  char line[160];
+  snprintf(line, sizeof(line), "ADC mean %.1f mV for %.1f mV, noise %.2f LSB rms (configured %.1f)",
+           mean, circuit.senseMv(), sigmaLsb, config.adcNoiseLsb);
+  check(fabs(mean - circuit.senseMv()) < lsbMv && fabs(sigmaLsb - config.adcNoiseLsb) < 0.3, line);
+  check(quantised, "readings fall on ADC codes");
+  check(halAnalogReadMilliVolts(SENSE_ADC_PIN + 1) == 0, "other ADC pins read 0 mV");
+  rcAttach(nullptr, -1, -1);
+}
+
+static int chargeToTarget(const char* targetMv, const char* time) {
+  RecordingExchange http(HTTP_METHOD_GET, "/charge");
+  http.withArg("target_mv", targetMv);
+  if (time) http.withArg("time", time);
+  handleCharge(http);
+  return http.status;
+}
+
+/**
+ * @brief /charge?target_mv= against the circuit model, with the clock moved
+ * in 1 ms loop() iterations while the sampler runs in virtual time.
+ */
+static void checkChargeToTarget() {
+  check(chargeToTarget("abc", nullptr) == 400, "target_mv=abc -> 400");
+  check(chargeToTarget("99999", nullptr) == 400, "target_mv=99999 -> 400");
+  check(chargeToTarget("4000", "50") == 400, "target_mv=4000&time=50 -> 400");
+
+  RcCircuitConfig config = rcDefaultConfig();
+  config.adcNoiseLsb = 0;
+  RcCircuit circuit(config);
+  rcAttach(&circuit, CHARGE_PIN, SENSE_ADC_PIN);
+  simAddPinListener(onPin);
+
+  simSetTimeUs(20000000);
+  circuit.reset(simTimeUs());
+  check(chargeToTarget("4000", "1000") == 200, "target_mv=4000&time=1000 -> 200");
+  double crossingUs = circuit.timeToVoltageUs(4.0);
+  while (chargeActive()) {
+    simAdvanceUs(1000);
+    chargeMonitor();
+  }
+  const ChargeResult& result = chargeLastResult();
+  double lateUs = (pinLowAtUs - pinHighAtUs) - crossingUs;
+  char line[160];
+  snprintf(line, sizeof(line), "cut off %.0f us after the crossing (period %u us), reading %u mV, reported latency %u us",
+           lateUs, (unsigned)CHARGE_SAMPLE_PERIOD_US, (unsigned)result.cutoffMv, (unsigned)result.latencyUs);
+  check(result.reason == CHARGE_END_TARGET && lateUs >= 0 && lateUs <= CHARGE_SAMPLE_PERIOD_US &&
+        result.latencyUs <= CHARGE_SAMPLE_PERIOD_US && result.cutoffMv >= 4000, line);
+  check(!chargePinHigh() && result.chargeUs == pinLowAtUs - pinHighAtUs, "pin LOW and charge_us matches the pin");
+
+  RecordingExchange state(HTTP_METHOD_GET, "/state");
+  handleState(state);
+  check(state.responseBody.find("\"end\":\"target\"") != std::string::npos, "/state reports the cutoff");
+
+  // 4.9 V is above what the supply can reach through the coil load.
+  check(chargeToTarget("4900", "200") == 200, "unreachable target_mv=4900&time=200 -> 200");
+  while (chargeActive()) {
+    simAdvanceUs(1000);
+    chargeMonitor();
+  }
+  check(chargeLastResult().reason == CHARGE_END_TIMEOUT && !chargePinHigh(), "unreachable target ends on the timeout");
+
+  simRemovePinListener(onPin);
+  rcAttach(nullptr, -1, -1);
+}
+
+/**
+ * @brief Hold-up measurement through the edge interrupts on the charge pin
+ * and the model's relay contact, against the closed-form drop-out time, with
+ * the clock moved in 1 ms loop() iterations.
+ */
+static void checkHoldupMeasurement() {
+  RcCircuitConfig config = rcDefaultConfig();
+  config.adcNoiseLsb = 0;
+  RcCircuit circuit(config);
+  rcAttach(&circuit, CHARGE_PIN, SENSE_ADC_PIN, -1, CONTACT_SENSE_PIN);
+  simSetTimeUs(30000000);
+  circuit.reset(simTimeUs());
+  check(holdupBegin(CONTACT_SENSE_PIN, CHARGE_PIN), "hold-up interrupts attached");
+  holdupReset();
+
+  const long durationsMs[] = {100, 200, 400, 800};
+  int64_t worstError = 0;
+  for (long durationMs : durationsMs) {
+    runCharge(durationMs);
+    double holdUpUs = circuit.tauUs() * log(circuit.capacitorV() / config.dropOutV) + config.releaseUs;
+    while (holdupPending()) {
+      simAdvanceUs(1000);
+    }
+    holdupService();
+    int64_t error = (int64_t)holdupStats().lastUs - (int64_t)ceil(holdUpUs);
+    if (llabs(error) > llabs(worstError)) worstError = error;
+  }
+  const HoldupStats& stats = holdupStats();
+  char line[160];
+  snprintf(line, sizeof(line), "%u hold-ups of %.3f to %.3f ms measured by interrupt (worst error %lld us)",
+           (unsigned)stats.count, stats.minUs / 1000.0, stats.maxUs / 1000.0, (long long)worstError);
+  check(stats.count == 4 && stats.minUs < stats.maxUs && llabs(worstError) <= 1, line);
+
+  // Recharging while the contact is still closed ends the measurement without a result.
+  runCharge(200);
+  simAdvanceUs(50000);
+  runCharge(100);
+  while (holdupPending()) {
+    simAdvanceUs(1000);
+  }
+  holdupService();
+  check(holdupStats().interrupted == 1 && holdupStats().count == 5, "recharge before drop-out counted as interrupted");
+
+  RecordingExchange http(HTTP_METHOD_GET, "/holdup");
+  handleHoldup(http);
+  check(http.status == 200 && http.responseBody.find("\"count\":5") != std::string::npos &&
+        http.responseBody.find("{\"seq\":5") != std::string::npos, "/holdup reports the count and the newest measurement first");
+  rcAttach(nullptr, -1, -1);
+
+  // Unwired contact: the input reads open through its pull-up.
+  simSetPinLevel(CONTACT_SENSE_PIN, HAL_HIGH);
+  uint32_t noPullIn = holdupStats().noPullIn;
+  runCharge(100);
+  simAdvanceUs(3600ULL * 1000000);
+  holdupService();
+  check(!holdupPending() && holdupStats().noPullIn == noPullIn + 1 && holdupStats().count == 5,
+        "unwired contact: no pull-in at the end of the charge, nothing left pending");
+
+  // Contact stuck closed: given up after HOLDUP_TIMEOUT_MS.
+  simSetPinLevel(CONTACT_SENSE_PIN, HAL_LOW);
+  runCharge(100);
+  simAdvanceUs((HOLDUP_TIMEOUT_MS - 1) * 1000ULL);
+  holdupService();
+  bool waited = holdupPending();
+  simAdvanceUs(1000);
+  holdupService();
+  check(waited && !holdupPending() && holdupStats().timeouts == 1 && holdupStats().count == 5,
+        "contact stuck closed: pending until HOLDUP_TIMEOUT_MS, then counted as a timeout");
+  simSetPinLevel(CONTACT_SENSE_PIN, HAL_HIGH);
+}
+
+void checkCircuit() {
+  printf("Circuit model\n");
+  checkChargeAndHoldUp();
+  checkSelfDischarge();
+  checkAdc();
+  printf("Closed-loop charge\n");
+  checkChargeToTarget();
+  printf("Hold-up measurement\n");
+  checkHoldupMeasurement();
+}
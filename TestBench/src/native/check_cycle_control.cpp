@@ -0,0 +1,108 @@
+// Native checks of /cycle: break-before-make gaps and cycles per minute with
+// active and passive discharge.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/cycle_control.h"
+#include "hal/gpio.h"
+#include "checks.h"
+#include "native_support.h"
+#include "rc_circuit.h"
+#include "recording_exchange.h"
+#include "sim_hal.h"
+
+static uint64_t chargeLowAtUs = 0;
+static uint64_t dischargeLowAtUs = 0;
+static bool chargeHigh = false;
+static bool dischargeHigh = false;
+static uint64_t minGapUs = UINT64_MAX;
+
+/**
+ * @brief Records the gap between one output going LOW and the other going HIGH.
+ */
+static void onOutputs(int pin, int level, uint64_t atUs) {
+  if (pin == CHARGE_PIN) {
+    chargeHigh = level == HAL_HIGH;
+    if (chargeHigh && dischargeLowAtUs > 0) minGapUs = std::min(minGapUs, atUs - dischargeLowAtUs);
+    if (!chargeHigh) chargeLowAtUs = atUs;
+  } else if (pin == DISCHARGE_PIN) {
+    dischargeHigh = level == HAL_HIGH;
+    if (dischargeHigh) minGapUs = std::min(minGapUs, atUs - chargeLowAtUs);
+    if (!dischargeHigh) dischargeLowAtUs = atUs;
+  }
+}
+
+/**
+ * @brief Runs a batch of cycles against the circuit model in 1 ms loop()
+ * iterations and returns the measured throughput.
+ */
+static float runCycles(bool activeDischarge, int count, uint64_t* overlapUs) {
+  RcCircuitConfig config = rcDefaultConfig();
+  RcCircuit circuit(config);
+  rcAttach(&circuit, CHARGE_PIN, SENSE_ADC_PIN, activeDischarge ? DISCHARGE_PIN : -1);
+  chargeSetDischargePin(activeDischarge ? DISCHARGE_PIN : -1);
+  simAddPinListener(onOutputs);
+  simSetTimeUs(100000000);
+  circuit.reset(simTimeUs());
+  chargeLowAtUs = dischargeLowAtUs = 0;
+  minGapUs = UINT64_MAX;
+
+  RecordingExchange http(HTTP_METHOD_POST, "/cycle");
+  http.withArg("target_mv", "4000").withArg("hold_ms", "20").withArg("discharge_mv", "300")
+      .withArg("count", std::to_string(count).c_str());
+  handleCycle(http);
+
+  uint64_t limitUs = simTimeUs() + 600000000ULL;
+  while (cycleActive() && simTimeUs() < limitUs) {
+    simAdvanceUs(1000);
+    chargeMonitor();
+    cycleService();
+  }
+  CycleStatus status = cycleStatus();
+  *overlapUs = circuit.overlapUs();
+
+  simRemovePinListener(onOutputs);
+  rcAttach(nullptr, -1, -1);
+  chargeSetDischargePin(-1);
+  return status.completed == (uint32_t)count && status.dischargeTimeouts == 0 ? status.cyclesPerMinute : -1;
+}
+
+void checkCycles() {
+  printf("Charge/discharge cycles\n");
+  {
+    RecordingExchange http(HTTP_METHOD_POST, "/cycle");
+    http.withArg("target_mv", "4000");
+    handleCycle(http);
+    check(http.status == 400, "/cycle without discharge_mv -> 400");
+  }
+
+  uint64_t overlapUs = 0;
+  float passive = runCycles(false, 10, &overlapUs);
+  char line[160];
+  snprintf(line, sizeof(line), "10 cycles, passive discharge: %.1f cycles/min", passive);
+  check(passive > 0, line);
+
+  float active = runCycles(true, 10, &overlapUs);
+  snprintf(line, sizeof(line), "10 cycles, active discharge:  %.1f cycles/min (%.1fx)", active, active / passive);
+  check(active > passive, line);
+  snprintf(line, sizeof(line), "break-before-make: outputs never on together, min gap %.1f ms",
+           minGapUs / 1000.0);
+  check(overlapUs == 0 && minGapUs >= CHARGE_DEAD_TIME_US, line);
+
+  chargeSetDischargePin(DISCHARGE_PIN);
+  simSetTimeUs(200000000);
+  check(dischargeOn(), "manual discharge on while idle");
+  check(chargeStart(100) == CHARGE_BUSY, "charge refused while discharging");
+  dischargeOff();
+  check(chargeStart(100) == CHARGE_BUSY, "charge refused within the dead time");
+  simAdvanceUs(CHARGE_DEAD_TIME_US);
+  check(chargeStart(100) == CHARGE_STARTED, "charge allowed after the dead time");
+  check(!dischargeOn(), "discharge refused while charging");
+  chargeStop();
+  chargeSetDischargePin(-1);
+}
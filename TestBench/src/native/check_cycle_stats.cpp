@@ -0,0 +1,86 @@
+// Native checks of the Welford and P-square accumulators against exact
+// two-pass results, and of /stats fed from real charges.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/cycle_stats.h"
+#include "core/holdup_monitor.h"
+#include "checks.h"
+#include "native_support.h"
+#include "rc_circuit.h"
+#include "recording_exchange.h"
+#include "sim_hal.h"
+
+void checkStatistics() {
+  printf("Statistics\n");
+  const int N = 100000;
+  std::vector<double> samples(N);
+  uint32_t state = 0x2545F491;
+  RunningStats running;
+  P2Quantile p50, p95;
+  runningStatsReset(running);
+  p2Reset(p50, 0.5);
+  p2Reset(p95, 0.95);
+  for (double& sample : samples) {
+    sample = skewedSample(state);
+    runningStatsAdd(running, sample);
+    p2Add(p50, sample);
+    p2Add(p95, sample);
+  }
+
+  double mean = 0, m2 = 0;
+  for (double sample : samples) mean += sample;
+  mean /= N;
+  for (double sample : samples) m2 += (sample - mean) * (sample - mean);
+  std::sort(samples.begin(), samples.end());
+  double exact50 = samples[N / 2];
+  double exact95 = samples[(size_t)(0.95 * N)];
+
+  char line[160];
+  double varianceError = fabs(runningStatsVariance(running) / (m2 / (N - 1)) - 1);
+  snprintf(line, sizeof(line), "Welford over %d samples: mean %.3f, variance within %.1e of two-pass", N, running.mean,
+           varianceError);
+  check(fabs(running.mean - mean) < 1e-6 && varianceError < 1e-9 && running.minValue == samples.front() &&
+        running.maxValue == samples.back(), line);
+  double error50 = fabs(p2Value(p50) - exact50) / (exact95 - exact50);
+  double error95 = fabs(p2Value(p95) - exact95) / (exact95 - exact50);
+  snprintf(line, sizeof(line), "P-square p50 %.1f (exact %.1f), p95 %.1f (exact %.1f), %u bytes per metric",
+           p2Value(p50), exact50, p2Value(p95), exact95, (unsigned)sizeof(StatsMetric));
+  check(error50 < 0.01 && error95 < 0.01, line);
+
+  P2Quantile few;
+  p2Reset(few, 0.5);
+  for (double value : {5.0, 1.0, 3.0}) p2Add(few, value);
+  check(p2Value(few) == 3.0, "P-square is exact below five samples");
+
+  // Fed from real charges through chargeMonitor() and holdupService().
+  RcCircuitConfig config = rcDefaultConfig();
+  RcCircuit circuit(config);
+  rcAttach(&circuit, CHARGE_PIN, SENSE_ADC_PIN, -1, CONTACT_SENSE_PIN);
+  simSetTimeUs(400000000);
+  circuit.reset(simTimeUs());
+  statsReset();
+  for (long durationMs : {100, 200, 300}) {
+    runCharge(durationMs);
+    while (holdupPending()) simAdvanceUs(1000);
+    holdupService();
+  }
+  RecordingExchange http(HTTP_METHOD_GET, "/stats");
+  handleStats(http);
+  const std::string& body = http.responseBody;
+  check(statsMetric(STATS_PULSE_WIDTH_US).running.count == 3 && statsMetric(STATS_HOLDUP_US).running.count == 3 &&
+        statsMetric(STATS_END_MV).running.count == 3 && body.find("\"pulse_width_us\":{\"count\":3") != std::string::npos &&
+        body.find("\"p95\":") != std::string::npos, "/stats counts 3 pulse widths, hold-ups and end voltages");
+  statsReset();
+  RecordingExchange cleared(HTTP_METHOD_GET, "/stats");
+  handleStats(cleared);
+  check(cleared.responseBody.find("\"holdup_us\":null") != std::string::npos, "reset clears every metric");
+  rcAttach(nullptr, -1, -1);
+}
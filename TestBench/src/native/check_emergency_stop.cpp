@@ -0,0 +1,68 @@
+// Native checks of the emergency stop: the button and UDP paths driving the pin
+// LOW at arrival, the latch and its release.
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "core/charge_control.h"
+#include "core/emergency_stop.h"
+#include "hal/gpio.h"
+#include "checks.h"
+#include "native_support.h"
+#include "sim_hal.h"
+
+static const int STOP_BUTTON_PIN = 25;
+static uint64_t chargeFellAtUs = 0;
+
+static void onChargeFall(int pin, int level, uint64_t atUs) {
+  if (pin == CHARGE_PIN && level == HAL_LOW) chargeFellAtUs = atUs;
+}
+
+void checkEmergencyStop() {
+  printf("Emergency stop\n");
+  simSetTimeUs(300000000);
+  simAddPinListener(onChargeFall);
+  check(estopButtonBegin(STOP_BUTTON_PIN), "stop button on an edge interrupt");
+
+  chargeStart(5000);
+  simAdvanceUs(1234);
+  uint64_t pressUs = simTimeUs();
+  simSetPinLevel(STOP_BUTTON_PIN, HAL_LOW);
+  check(!chargePinHigh() && chargeFellAtUs == pressUs && estopLatched(),
+        "button: charge pin LOW at the press edge, before loop() runs");
+  check(chargeStart(100) == CHARGE_BUSY, "no charge starts while the stop is latched");
+  for (int i = 0; i < 3; i++) {
+    simAdvanceUs(2000);
+    simSetPinLevel(STOP_BUTTON_PIN, i % 2 ? HAL_LOW : HAL_HIGH);
+  }
+  check(estopService() && !chargeActive() && chargeLastResult().reason == CHARGE_END_STOPPED && !estopLatched(),
+        "estopService() ends the cycle as /stop does and releases the latch");
+  check(estopLatency(ESTOP_BUTTON).count == 1, "contact bounce counts as one press");
+  check(chargeStart(100) == CHARGE_STARTED, "charging resumes after the stop");
+
+  int fd = estopUdpOpen(0, false);
+  int client = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in to = {};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(estopUdpPort());
+  to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sendto(client, "PING", 4, 0, (struct sockaddr*)&to, sizeof(to));
+  bool ignored = estopUdpReceive(fd) && chargePinHigh() && !estopLatched();
+  sendto(client, "STOP", 4, 0, (struct sockaddr*)&to, sizeof(to));
+  bool stopped = estopUdpReceive(fd) && !chargePinHigh() && estopLatched();
+  char reply[32] = "";
+  ssize_t n = recv(client, reply, sizeof(reply) - 1, MSG_DONTWAIT);
+  check(fd >= 0 && ignored && stopped && n > 0 && strncmp(reply, "STOPPED ", 8) == 0,
+        "UDP: other datagrams ignored, STOP drives the pin LOW and is answered");
+  check(estopService() && !chargeActive() && !estopUdpReceive(fd) && estopLatency(ESTOP_UDP).count == 1,
+        "UDP stop finished; nothing left to receive");
+  close(client);
+  close(fd);
+
+  halDetachEdgeInterrupt(STOP_BUTTON_PIN);
+  simRemovePinListener(onChargeFall);
+}
@@ -0,0 +1,47 @@
+// Native checks of the /charge handler: validation paths, busy and /stop.
+
+#include <stdio.h>
+#include <string>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "checks.h"
+#include "native_support.h"
+#include "recording_exchange.h"
+#include "sim_hal.h"
+
+static void stopCharge() {
+  RecordingExchange http(HTTP_METHOD_POST, "/stop");
+  handleStop(http);
+}
+
+void checkValidation() {
+  printf("/charge validation\n");
+  check(chargeRequest(nullptr) == 400, "missing 'time' -> 400");
+  check(chargeRequest("abc") == 400, "time=abc -> 400");
+  check(chargeRequest("99") == 400, "time=99 -> 400");
+  check(chargeRequest("60001") == 400, "time=60001 -> 400");
+  check(chargeRequest("-5") == 400, "time=-5 -> 400");
+  check(chargeRequest("500ms") == 400, "time=500ms -> 400");
+  check(chargeRequest("99999999999999999999") == 400, "time=99999999999999999999 (overflow) -> 400");
+  RecordingExchange nul(HTTP_METHOD_GET, "/charge");
+  nul.withArg("time", std::string("500\0abc", 7));
+  handleCharge(nul);
+  check(nul.status == 400, "time=500%00abc (embedded NUL) -> 400");
+  check(chargeRequest("100") == 200, "time=100 -> 200");
+  check(chargeRequest("500") == 409, "second charge while busy -> 409");
+  stopCharge();
+  check(!chargeActive() && !chargePinHigh(), "/stop ends the cycle and drives the pin LOW");
+  check(chargeRequest("60000") == 200, "time=60000 -> 200");
+  stopCharge();
+
+  chargeSetDischargePin(DISCHARGE_PIN);
+  simAdvanceUs(CHARGE_DEAD_TIME_US);
+  check(dischargeOn(), "manual discharge on while idle");
+  dischargeOff();
+  check(chargeRequest("500") == 409, "charge within the discharge dead time -> 409");
+  simAdvanceUs(CHARGE_DEAD_TIME_US);
+  check(chargeRequest("500") == 200, "charge after the dead time -> 200");
+  stopCharge();
+  chargeSetDischargePin(-1);
+}
@@ -0,0 +1,118 @@
+// Native checks of in-place request parsing: decoding, strict integers and no heap use.
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "core/http_request.h"
+#include "core/route_trie.h"
+#include "core/routes.h"
+#include "checks.h"
+#include "native_support.h"
+
+static std::string argValue(const RequestView& request, const char* name) {
+  const RequestArg* arg = requestFindArg(request, name);
+  return arg ? std::string(arg->value) : std::string("<none>");
+}
+
+static bool integerIs(const char* text, long expected) {
+  long value = 0;
+  return requestParseInteger(text, &value) && value == expected;
+}
+
+static bool integerRejected(const char* text) {
+  long value = 0;
+  return !requestParseInteger(text, &value);
+}
+
+void checkRequestParsing() {
+  printf("Request parsing\n");
+  static char buffer[1024];
+  RequestView request;
+
+  std::string get = "GET /sw%65eps/results?since=5&limit=16&note=a+b%2Fc&since=9&flag HTTP/1.1\r\nHost: x\r\n\r\n";
+  check(parseCopy(get, request, buffer) == REQUEST_OK && request.method == HTTP_METHOD_GET &&
+        request.path == "/sweeps/results" && request.headerBytes == get.size(),
+        "request line parsed, path decoded");
+  check(argValue(request, "limit") == "16" && argValue(request, "note") == "a b/c",
+        "query arguments decoded in place ('+' and %XX)");
+  check(argValue(request, "since") == "5", "the first of repeated arguments wins");
+  check(requestFindArg(request, "flag") && argValue(request, "flag").empty() &&
+        argValue(request, "missing") == "<none>", "a bare name is present and empty; others are absent");
+
+  const char partial[] = "GET /state?x=%41 HTTP/1.1\r\nHost: x\r\n";
+  memcpy(buffer, partial, sizeof(partial));
+  check(requestParseHead(buffer, sizeof(partial) - 1, request) == REQUEST_INCOMPLETE &&
+        memcmp(buffer, partial, sizeof(partial)) == 0, "no blank line yet: incomplete, buffer untouched");
+
+  std::string post = "POST /cycle?count=3 HTTP/1.1\r\ncontent-length: 21\r\n"
+                     "Content-Type: application/x-www-form-urlencoded\r\n\r\ncharge_ms=800&count=9";
+  bool parsed = parseCopy(post, request, buffer) == REQUEST_OK && request.method == HTTP_METHOD_POST &&
+                request.contentLength == 21 && request.formBody;
+  if (parsed) requestParseForm(buffer + request.headerBytes, request.contentLength, request);
+  check(parsed && argValue(request, "charge_ms") == "800" && argValue(request, "count") == "3",
+        "form body arguments follow the query string's");
+
+  const char* malformed[] = {
+      "GET\r\n\r\n",
+      "GET /state\r\nHost: a b\r\n\r\n",
+      "POST /stop HTTP/1.1\r\nContent-Length: 12abc\r\n\r\n",
+      "POST /stop HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+      "POST /stop HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n",
+  };
+  bool rejected = true;
+  for (const char* text : malformed) {
+    rejected = rejected && parseCopy(text, request, buffer) == REQUEST_MALFORMED;
+  }
+  check(rejected, "bad request lines and Content-Length values are malformed");
+
+  bool http11 = parseCopy("GET /state HTTP/1.1\r\n\r\n", request, buffer) == REQUEST_OK && request.keepAlive;
+  bool http10 = parseCopy("GET /state HTTP/1.0\r\n\r\n", request, buffer) == REQUEST_OK && !request.keepAlive;
+  bool asked = parseCopy("GET /state HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", request, buffer) == REQUEST_OK &&
+               request.keepAlive;
+  bool closed = parseCopy("GET /state HTTP/1.1\r\nconnection: keep-alive, close\r\n\r\n", request, buffer) ==
+                    REQUEST_OK && !request.keepAlive;
+  check(http11 && http10 && asked && closed,
+        "keep-alive: default for HTTP/1.1, on request for 1.0, \"close\" always wins");
+
+  // Pipelined: the next request starts where this one's body ends.
+  std::string pipelined = "POST /stop HTTP/1.1\r\nContent-Length: 2\r\n\r\nokGET /state?x=1 HTTP/1.1\r\n\r\nGET /heal";
+  parsed = parseCopy(pipelined, request, buffer) == REQUEST_OK && request.path == "/stop";
+  size_t used = request.headerBytes + request.contentLength;
+  parsed = parsed && requestParseHead(buffer + used, pipelined.size() - used, request) == REQUEST_OK &&
+           request.path == "/state" && argValue(request, "x") == "1";
+  used += request.headerBytes;
+  check(parsed && requestParseHead(buffer + used, pipelined.size() - used, request) == REQUEST_INCOMPLETE,
+        "pipelined requests parse one after another; a partial one waits for more");
+
+  std::string many = "GET /state?";
+  for (int i = 0; i < 20; i++) many += "a" + std::to_string(i) + "=1&";
+  many += " HTTP/1.1\r\n\r\n";
+  check(parseCopy(many, request, buffer) == REQUEST_OK && request.argCount == REQUEST_MAX_ARGS,
+        "arguments beyond REQUEST_MAX_ARGS are ignored");
+
+  char longMax[32];
+  char longMin[32];
+  snprintf(longMax, sizeof(longMax), "%ld", LONG_MAX);
+  snprintf(longMin, sizeof(longMin), "%ld", LONG_MIN);
+  check(integerIs("0", 0) && integerIs("-0", 0) && integerIs("007", 7) && integerIs("-42", -42) &&
+        integerIs(longMax, LONG_MAX) && integerIs(longMin, LONG_MIN), "integers up to the limits of long");
+  std::string aboveMax = std::to_string((unsigned long)LONG_MAX + 1);
+  std::string belowMin = "-" + std::to_string((unsigned long)LONG_MAX + 2);
+  check(integerRejected(aboveMax.c_str()) && integerRejected(belowMin.c_str()) &&
+        integerRejected("99999999999999999999999"), "overflow in either direction is rejected");
+  check(integerRejected("") && integerRejected("-") && integerRejected("+5") && integerRejected(" 5") &&
+        integerRejected("5 ") && integerRejected("1e3") && integerRejected("0x10") && integerRejected("--5"),
+        "signs, spaces and other characters are rejected");
+
+  size_t before = heapAllocations;
+  RouteTrie trie(trieNodes, TRIE_NODES, trieSlots, 2 * TRIE_NODES);
+  trie.add(CORE_ROUTES, CORE_ROUTE_COUNT);
+  RouteMatch match;
+  long steps = 0;
+  bool served = parseCopy(SWEEP_REQUEST, request, buffer) == REQUEST_OK &&
+                trie.find(request.path.data(), request.path.size(), request.method, match) &&
+                requestParseInteger(requestFindArg(request, "steps")->value, &steps) && steps == 50;
+  check(served && heapAllocations == before, "parse, route and read an argument without touching the heap");
+}
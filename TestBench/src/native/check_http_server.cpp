@@ -0,0 +1,231 @@
+// Native checks of HttpServer over loopback: the keep-alive policy and read
+// deadline, and parked /state long polls.
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/http_server.h"
+#include "core/routes.h"
+#include "checks.h"
+#include "recording_exchange.h"
+#include "sim_hal.h"
+
+static int connectLocal(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int sendGet(uint16_t port, const char* target) {
+  int fd = connectLocal(port);
+  char request[256];
+  int length = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: bench\r\n\r\n", target);
+  send(fd, request, length, 0);
+  return fd;
+}
+
+/**
+ * @brief Runs handleClient() without waiting, as loop() does.
+ */
+static void serveCalls(HttpServer& server, int calls) {
+  for (int i = 0; i < calls; i++) {
+    server.handleClient(0);
+  }
+}
+
+// What has arrived on the client's socket so far.
+static std::string receivedOn(int fd) {
+  std::string text;
+  char buffer[1024];
+  ssize_t n;
+  while ((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+    text.append(buffer, n);
+  }
+  return text;
+}
+
+static bool answeredWith(const std::string& response, const char* text) {
+  return response.compare(0, 15, "HTTP/1.1 200 OK") == 0 && response.find(text) != std::string::npos;
+}
+
+void checkKeepAlive() {
+  printf("HTTP server keep-alive\n");
+  HttpServer server;
+  server.addRoutes(CORE_ROUTES, CORE_ROUTE_COUNT);
+  if (!server.begin(0)) {
+    check(false, "server listens on loopback");
+    return;
+  }
+  uint16_t port = server.port();
+  simSetTimeUs(650000000);
+
+  // Keep-alive 0: every request is answered, then the connection closed.
+  server.setKeepAlive(0, 100);
+  int client = sendGet(port, "/health");
+  simAdvanceUs(50000);
+  serveCalls(server, 3);
+  std::string response = receivedOn(client);
+  char byte;
+  check(answeredWith(response, "\"device\"") && response.find("Connection: close") != std::string::npos &&
+        recv(client, &byte, 1, MSG_DONTWAIT) == 0,
+        "setKeepAlive(0, ...) answers the first request, then closes");
+  close(client);
+
+  // The idle timeout runs between requests only; a new connection has the read deadline.
+  server.setKeepAlive(20, 100);
+  client = connectLocal(port);
+  serveCalls(server, 2);
+  simAdvanceUs(100000);
+  serveCalls(server, 2);
+  const char* request = "GET /health HTTP/1.1\r\nHost: bench\r\n\r\n";
+  send(client, request, strlen(request), 0);
+  serveCalls(server, 2);
+  bool first = answeredWith(receivedOn(client), "\"device\"");
+  simAdvanceUs(20000);
+  serveCalls(server, 2);
+  check(first && recv(client, &byte, 1, MSG_DONTWAIT) == 0,
+        "a request 100 ms after connecting is served; the idle timeout closes the connection after it");
+  close(client);
+
+  uint32_t timeouts = server.readTimeouts();
+  client = connectLocal(port);
+  serveCalls(server, 2);
+  simAdvanceUs(HttpServer::READ_TIMEOUT_MS * 1000);
+  serveCalls(server, 2);
+  check(server.readTimeouts() == timeouts + 1 && receivedOn(client).find("408") != std::string::npos,
+        "a connection that sends nothing is answered 408 at the read deadline");
+  close(client);
+  server.close();
+}
+
+void checkLongPoll() {
+  printf("Long poll\n");
+  RecordingExchange recorded(HTTP_METHOD_GET, "/state");
+  chargeStop();
+  chargeStart(1000);
+  recorded.withArg("wait_until", "idle");
+  handleState(recorded);
+  check(recorded.status == 200 && recorded.responseBody.find("\"charging\"") != std::string::npos,
+        "an exchange that cannot park is answered at once");
+  RecordingExchange invalid(HTTP_METHOD_GET, "/state");
+  invalid.withArg("wait_until", "done").withArg("timeout_ms", "100");
+  handleState(invalid);
+  check(invalid.status == 400, "wait_until=done answered 400");
+  chargeStop();
+
+  HttpServer server;
+  server.addRoutes(CORE_ROUTES, CORE_ROUTE_COUNT);
+  server.wakeParkedOn(chargeStateVersion);
+  if (!server.begin(0)) {
+    check(false, "server listens on loopback");
+    return;
+  }
+  uint16_t port = server.port();
+  simSetTimeUs(700000000);
+
+  // Woken by chargeMonitor() ending the charge, in the next call.
+  chargeStart(1000);
+  int waiter = sendGet(port, "/state?wait_until=idle&timeout_ms=5000");
+  serveCalls(server, 3);
+  bool parked = server.parkedNow() == 1 && receivedOn(waiter).empty();
+  simAdvanceUs(999000);
+  chargeMonitor();
+  serveCalls(server, 3);
+  parked = parked && receivedOn(waiter).empty();
+  simAdvanceUs(1000);
+  chargeMonitor();
+  server.handleClient(0);
+  std::string response = receivedOn(waiter);
+  check(parked && answeredWith(response, "\"status\":\"idle\"") && server.parkedNow() == 0,
+        "wait_until=idle parked for the whole charge, answered in the call after chargeMonitor() ended it");
+
+  // The same connection stays open for the next request.
+  const char* next = "GET /state?wait_until=idle HTTP/1.1\r\nHost: bench\r\n\r\n";
+  send(waiter, next, strlen(next), 0);
+  serveCalls(server, 2);
+  check(answeredWith(receivedOn(waiter), "\"status\":\"idle\""), "already idle: answered at once, keep-alive");
+  close(waiter);
+
+  // Woken by /stop from another client, in the call that serves it.
+  chargeStart(5000);
+  char target[96];
+  snprintf(target, sizeof(target), "/state?since_version=%u", (unsigned)chargeStateVersion());
+  waiter = sendGet(port, target);
+  serveCalls(server, 3);
+  parked = server.parkedNow() == 1 && receivedOn(waiter).empty();
+  int stopper = connectLocal(port);
+  const char* stop = "POST /stop HTTP/1.1\r\nHost: bench\r\nContent-Length: 0\r\n\r\n";
+  send(stopper, stop, strlen(stop), 0);
+  int calls = 0;
+  while (calls < 5 && (response = receivedOn(waiter)).empty()) {
+    server.handleClient(0);
+    calls++;
+  }
+  snprintf(target, sizeof(target), "\"version\":%u", (unsigned)chargeStateVersion());
+  // One call accepts the stopper's connection, the next serves /stop and the waiter.
+  check(parked && calls == 2 && answeredWith(response, target) && answeredWith(receivedOn(stopper), "stopped"),
+        "since_version woken by /stop from another connection, with the new version");
+  close(waiter);
+  close(stopper);
+
+  // The timeout answers with the state as it is.
+  chargeStart(5000);
+  waiter = sendGet(port, "/state?wait_until=idle&timeout_ms=300");
+  serveCalls(server, 3);
+  simAdvanceUs(299000);
+  serveCalls(server, 3);
+  parked = receivedOn(waiter).empty();
+  simAdvanceUs(1000);
+  server.handleClient(0);
+  check(parked && answeredWith(receivedOn(waiter), "\"status\":\"charging\"") && chargeActive(),
+        "timeout_ms=300 answered at 300 ms, still charging");
+  close(waiter);
+
+  // Two parked at most; a client that hangs up frees its place.
+  int waiters[3];
+  for (int& fd : waiters) {
+    fd = sendGet(port, "/state?wait_until=idle&timeout_ms=30000");
+    serveCalls(server, 3);
+  }
+  bool limited = server.parkedNow() == HttpServer::MAX_PARKED && receivedOn(waiters[0]).empty() &&
+                 answeredWith(receivedOn(waiters[2]), "\"charging\"");
+  close(waiters[0]);
+  serveCalls(server, 2);
+  check(limited && server.parkedNow() == 1, "a third waiter is answered at once; closing a parked one frees it");
+
+  // A request pipelined behind a parked one waits its turn.
+  std::string pipelined = "GET /state?wait_until=idle HTTP/1.1\r\nHost: bench\r\n\r\n"
+                          "GET /health HTTP/1.1\r\nHost: bench\r\n\r\n";
+  waiter = connectLocal(port);
+  send(waiter, pipelined.data(), pipelined.size(), 0);
+  serveCalls(server, 5);
+  bool held = receivedOn(waiter).empty();
+  chargeStop();
+  serveCalls(server, 3);
+  response = receivedOn(waiter);
+  size_t second = response.find("HTTP/1.1", 1);
+  check(held && answeredWith(response, "\"idle\"") && second != std::string::npos &&
+        response.find("\"device\"", second) != std::string::npos && answeredWith(receivedOn(waiters[1]), "\"idle\""),
+        "the request behind a parked one is answered after it, in order");
+  close(waiter);
+  close(waiters[1]);
+  close(waiters[2]);
+  serveCalls(server, 2);
+  check(server.requestsParked() == 6 && server.parkedNow() == 0, "6 requests parked, none left");
+  server.close();
+}
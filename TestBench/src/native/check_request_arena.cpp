@@ -0,0 +1,91 @@
+// Native checks of the request arena: a soak of the GET routes with and without
+// it, per-route statistics and the heap fallback.
+
+#include <stdio.h>
+
+#include "core/api.h"
+#include "core/request_arena.h"
+#include "core/route_trie.h"
+#include "core/routes.h"
+#include "checks.h"
+#include "native_support.h"
+#include "recording_exchange.h"
+
+static const char* SOAK_PATHS[] = {"/state", "/cycle", "/sweeps", "/sweeps/results", "/stats",
+                                   "/holdup", "/health", "/info", "/system/arena", "/nope"};
+static const size_t SOAK_PATH_COUNT = sizeof(SOAK_PATHS) / sizeof(SOAK_PATHS[0]);
+
+/**
+ * @brief Serves GET requests round SOAK_PATHS as HttpServer::serve() does.
+ * @return Heap allocations made meanwhile.
+ */
+static size_t soak(const RouteTrie& trie, size_t requests, size_t* responseBytes) {
+  size_t before = heapAllocations;
+  for (size_t i = 0; i < requests; i++) {
+    DiscardingExchange http;
+    RouteMatch match;
+    bool found = trie.find(SOAK_PATHS[i % SOAK_PATH_COUNT], HTTP_METHOD_GET, match);
+    if (found) {
+      match.route->handler(http);
+    } else {
+      handleNotFound(http);
+    }
+    arenaFinishRequest(found ? match.route : nullptr);
+    *responseBytes += http.bytes;
+  }
+  return heapAllocations - before;
+}
+
+static const ArenaRouteStats* arenaStatsFor(const ApiRoute* route) {
+  for (size_t i = 0; i < arenaRouteCount(); i++) {
+    if (arenaRouteStats(i).route == route) return &arenaRouteStats(i);
+  }
+  return nullptr;
+}
+
+void checkArena() {
+  printf("Request arena\n");
+  RouteTrie trie(trieNodes, TRIE_NODES, trieSlots, 2 * TRIE_NODES);
+  trie.add(CORE_ROUTES, CORE_ROUTE_COUNT);
+  arenaFinishRequest(nullptr);  // Drop what handlers called directly left behind
+
+  const size_t SOAK_REQUESTS = 100000;
+  size_t bytes = 0;
+  size_t arenaAllocations = soak(trie, SOAK_REQUESTS, &bytes);
+  arenaSetEnabled(false);
+  size_t heapOnlyAllocations = soak(trie, SOAK_REQUESTS, &bytes);
+  arenaSetEnabled(true);
+  printf("  soak of %zu requests (%.0f B/response): %.2f heap allocations/request with the arena, %.2f without\n",
+         SOAK_REQUESTS, (double)bytes / (2 * SOAK_REQUESTS), (double)arenaAllocations / SOAK_REQUESTS,
+         (double)heapOnlyAllocations / SOAK_REQUESTS);
+  check(arenaAllocations == 0, "responses of the GET routes never touch the heap");
+  check(heapOnlyAllocations > SOAK_REQUESTS, "without the arena the same requests allocate");
+
+  RouteMatch match;
+  trie.find("/state", HTTP_METHOD_GET, match);
+  const ArenaRouteStats* state = arenaStatsFor(match.route);
+  check(state && state->requests == 2 * SOAK_REQUESTS / SOAK_PATH_COUNT && state->peakBytes > 0 &&
+        state->totalBytes / state->requests <= state->peakBytes && state->overflows == 0,
+        "per-route request count, peak and mean for /state");
+  const ArenaRouteStats* unmatched = arenaStatsFor(nullptr);
+  check(unmatched && unmatched->requests > SOAK_REQUESTS / SOAK_PATH_COUNT, "unmatched requests are recorded too");
+
+  void* first = arenaAllocate(100);
+  void* second = arenaAllocate(10);
+  arenaFree(second, 10);
+  bool rolledBack = arenaUsed() == 104;
+  arenaFree(first, 100);
+  check(rolledBack && arenaUsed() == 0, "freeing the latest allocation hands it back");
+
+  const size_t before = heapAllocations;
+  ArenaString large(ARENA_BYTES + 1, 'x');
+  ArenaString small = "fits";
+  bool intact = large.size() == ARENA_BYTES + 1 && large.back() == 'x' && small == "fits";
+  large = ArenaString();
+  small = ArenaString();
+  trie.find("/info", HTTP_METHOD_GET, match);
+  arenaFinishRequest(match.route);
+  const ArenaRouteStats* info = arenaStatsFor(match.route);
+  check(intact && info && info->overflows == 1 && heapAllocations == before + 1,
+        "a request outgrowing the arena falls back to the heap and is counted");
+}
@@ -0,0 +1,355 @@
+// Native checks of the response formats: Accept negotiation, CBOR and
+// MessagePack against the specifications' examples, and every data route
+// decoding to the same document in each format.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/request_arena.h"
+#include "core/response_writer.h"
+#include "core/route_trie.h"
+#include "core/routes.h"
+#include "checks.h"
+#include "native_support.h"
+#include "recording_exchange.h"
+#include "sim_hal.h"
+
+// A decoded document, for comparing the formats of one response.
+struct Document {
+  enum Type { NONE, NULL_VALUE, BOOLEAN, NUMBER, TEXT, ARRAY, OBJECT } type = NONE;
+  double number = 0;
+  std::string text;
+  std::vector<std::pair<std::string, Document>> members;
+  std::vector<Document> items;
+};
+
+struct JsonReader {
+  const std::string& in;
+  size_t at = 0;
+
+  void skipSpace() {
+    while (at < in.size() && isspace((unsigned char)in[at])) at++;
+  }
+
+  bool readString(std::string& out) {
+    if (at >= in.size() || in[at] != '"') return false;
+    for (at++; at < in.size() && in[at] != '"'; at++) {
+      if (in[at] == '\\' && ++at < in.size() && in[at] == 'u') {
+        out += (char)strtol(in.substr(at + 1, 4).c_str(), nullptr, 16);
+        at += 4;
+      } else {
+        out += in[at];
+      }
+    }
+    return at++ < in.size();
+  }
+
+  bool read(Document& doc) {
+    skipSpace();
+    if (at >= in.size()) return false;
+    char c = in[at];
+    if (c == '{' || c == '[') {
+      doc.type = c == '{' ? Document::OBJECT : Document::ARRAY;
+      at++;
+      skipSpace();
+      if (at < in.size() && in[at] == (c == '{' ? '}' : ']')) return ++at, true;
+      while (true) {
+        skipSpace();
+        std::string name;
+        if (c == '{') {
+          if (!readString(name)) return false;
+          skipSpace();
+          if (at >= in.size() || in[at++] != ':') return false;
+        }
+        Document item;
+        if (!read(item)) return false;
+        if (c == '{') doc.members.emplace_back(name, item);
+        else doc.items.push_back(item);
+        skipSpace();
+        if (at < in.size() && in[at] == ',') {
+          at++;
+          continue;
+        }
+        return at < in.size() && in[at++] == (c == '{' ? '}' : ']');
+      }
+    }
+    if (c == '"') {
+      doc.type = Document::TEXT;
+      return readString(doc.text);
+    }
+    for (const char* word : {"true", "false", "null"}) {
+      if (in.compare(at, strlen(word), word) == 0) {
+        at += strlen(word);
+        doc.type = word[0] == 'n' ? Document::NULL_VALUE : Document::BOOLEAN;
+        doc.number = word[0] == 't';
+        return true;
+      }
+    }
+    char* end;
+    doc.number = strtod(in.c_str() + at, &end);
+    doc.type = Document::NUMBER;
+    if (end == in.c_str() + at) return false;
+    at = end - in.c_str();
+    return true;
+  }
+};
+
+// CBOR or MessagePack, whichever binary is set for.
+struct BinaryReader {
+  const std::string& in;
+  bool msgpack;
+  size_t at = 0;
+
+  bool bigEndian(int bytes, uint64_t& value) {
+    if (at + bytes > in.size()) return false;
+    value = 0;
+    for (int i = 0; i < bytes; i++) value = value << 8 | (uint8_t)in[at++];
+    return true;
+  }
+
+  bool floatOf(int bytes, Document& doc) {
+    uint64_t bits;
+    if (!bigEndian(bytes, bits)) return false;
+    doc.type = Document::NUMBER;
+    if (bytes == 4) {
+      uint32_t narrow = (uint32_t)bits;
+      float single;
+      memcpy(&single, &narrow, sizeof(single));
+      doc.number = single;
+    } else {
+      memcpy(&doc.number, &bits, sizeof(doc.number));
+    }
+    return true;
+  }
+
+  bool container(Document& doc, bool object, uint64_t count) {
+    doc.type = object ? Document::OBJECT : Document::ARRAY;
+    for (uint64_t i = 0; i < count; i++) {
+      Document name, item;
+      if (object && (!read(name) || name.type != Document::TEXT)) return false;
+      if (!read(item)) return false;
+      if (object) doc.members.emplace_back(name.text, item);
+      else doc.items.push_back(item);
+    }
+    return true;
+  }
+
+  bool text(Document& doc, uint64_t length) {
+    if (at + length > in.size()) return false;
+    doc.type = Document::TEXT;
+    doc.text = in.substr(at, length);
+    at += length;
+    return true;
+  }
+
+  bool read(Document& doc) {
+    if (at >= in.size()) return false;
+    uint8_t b = (uint8_t)in[at++];
+    uint64_t n = 0;
+    if (!msgpack) {
+      uint8_t major = b >> 5, info = b & 31;
+      if (major == 7) {
+        if (info == 20 || info == 21) return doc.type = Document::BOOLEAN, doc.number = info == 21, true;
+        if (info == 22) return doc.type = Document::NULL_VALUE, true;
+        return (info == 26 || info == 27) && floatOf(info == 26 ? 4 : 8, doc);
+      }
+      if (info >= 24 && (info > 27 || !bigEndian(1 << (info - 24), n))) return false;
+      if (info < 24) n = info;
+      switch (major) {
+        case 0: return doc.type = Document::NUMBER, doc.number = (double)n, true;
+        case 1: return doc.type = Document::NUMBER, doc.number = -1.0 - (double)n, true;
+        case 3: return text(doc, n);
+        case 4: return container(doc, false, n);
+        case 5: return container(doc, true, n);
+        default: return false;
+      }
+    }
+    if (b < 0x80) return doc.type = Document::NUMBER, doc.number = b, true;
+    if (b >= 0xE0) return doc.type = Document::NUMBER, doc.number = (int8_t)b, true;
+    if ((b & 0xF0) == 0x80) return container(doc, true, b & 15);
+    if ((b & 0xF0) == 0x90) return container(doc, false, b & 15);
+    if ((b & 0xE0) == 0xA0) return text(doc, b & 31);
+    switch (b) {
+      case 0xC0: return doc.type = Document::NULL_VALUE, true;
+      case 0xC2: case 0xC3: return doc.type = Document::BOOLEAN, doc.number = b == 0xC3, true;
+      case 0xCA: return floatOf(4, doc);
+      case 0xCB: return floatOf(8, doc);
+      case 0xCC: case 0xCD: case 0xCE: case 0xCF:
+        if (!bigEndian(1 << (b - 0xCC), n)) return false;
+        return doc.type = Document::NUMBER, doc.number = (double)n, true;
+      case 0xD0: case 0xD1: case 0xD2: case 0xD3: {
+        int bytes = 1 << (b - 0xD0);
+        if (!bigEndian(bytes, n)) return false;
+        int64_t value = bytes == 8 ? (int64_t)n : (int64_t)(n << (64 - 8 * bytes)) >> (64 - 8 * bytes);
+        return doc.type = Document::NUMBER, doc.number = (double)value, true;
+      }
+      case 0xD9: case 0xDA: case 0xDB:
+        return bigEndian(1 << (b - 0xD9), n) && text(doc, n);
+      case 0xDC: return bigEndian(2, n) && container(doc, false, n);
+      case 0xDE: return bigEndian(2, n) && container(doc, true, n);
+      default: return false;
+    }
+  }
+};
+
+static bool sameDocument(const Document& a, const Document& b) {
+  if (a.type != b.type) return false;
+  switch (a.type) {
+    case Document::NUMBER: return fabs(a.number - b.number) <= 0.01 + 1e-9 * fabs(a.number);
+    case Document::BOOLEAN: return a.number == b.number;
+    case Document::TEXT: return a.text == b.text;
+    case Document::ARRAY:
+      if (a.items.size() != b.items.size()) return false;
+      for (size_t i = 0; i < a.items.size(); i++) {
+        if (!sameDocument(a.items[i], b.items[i])) return false;
+      }
+      return true;
+    case Document::OBJECT:
+      if (a.members.size() != b.members.size()) return false;
+      for (size_t i = 0; i < a.members.size(); i++) {
+        if (a.members[i].first != b.members[i].first || !sameDocument(a.members[i].second, b.members[i].second)) {
+          return false;
+        }
+      }
+      return true;
+    default: return true;
+  }
+}
+
+static std::string hexOf(const ArenaString& bytes) {
+  std::string hex;
+  char digits[4];
+  for (char c : bytes) {
+    snprintf(digits, sizeof(digits), "%02x", (unsigned)(uint8_t)c);
+    hex += digits;
+  }
+  return hex;
+}
+
+// {"a":1, "b":[2, 3]}, RFC 8949 Appendix A.
+static ArenaString smallDocument(ResponseFormat format) {
+  ResponseWriter writer(format);
+  writer.beginObject();
+  writer.field("a", 1);
+  writer.key("b");
+  writer.beginArray();
+  writer.value(2);
+  writer.value(3);
+  writer.endArray();
+  writer.endObject();
+  return writer.body();
+}
+
+static std::string scalarHex(ResponseFormat format, void (*write)(ResponseWriter&)) {
+  ResponseWriter writer(format);
+  write(writer);
+  return hexOf(writer.body());
+}
+
+static const char* DOCUMENT_PATHS[] = {"/state", "/info", "/health", "/estop", "/cycle", "/sweeps",
+                                       "/sweeps/results", "/stats", "/holdup", "/system/arena"};
+
+void checkResponseFormats() {
+  printf("Response formats\n");
+  check(responseFormat("") == RESPONSE_JSON && responseFormat("*/*") == RESPONSE_JSON &&
+        responseFormat("text/html") == RESPONSE_JSON && responseFormat("application/cbor") == RESPONSE_CBOR &&
+        responseFormat("Application/CBOR") == RESPONSE_CBOR && responseFormat("application/x-msgpack") == RESPONSE_MSGPACK,
+        "Accept: none, */* and unsupported types give JSON; cbor and msgpack media types are recognised");
+  check(responseFormat("application/cbor;q=0.5, application/msgpack;q=0.9") == RESPONSE_MSGPACK &&
+        responseFormat("application/json, application/cbor") == RESPONSE_JSON &&
+        responseFormat("application/cbor;q=0, */*;q=0.1") == RESPONSE_JSON &&
+        responseFormat("text/html, application/msgpack ; q=1.0") == RESPONSE_MSGPACK,
+        "highest q wins, the earlier type on a tie, q=0 refuses");
+
+  check(hexOf(smallDocument(RESPONSE_CBOR)) == "a26161016162820203" &&
+        hexOf(smallDocument(RESPONSE_MSGPACK)) == "82a16101a162920203" &&
+        smallDocument(RESPONSE_JSON) == "{\"a\":1, \"b\":[2, 3]}",
+        "{\"a\":1, \"b\":[2, 3]} in CBOR (RFC 8949 appendix A), MessagePack and JSON");
+  check(scalarHex(RESPONSE_CBOR, [](ResponseWriter& w) { w.value(1000); }) == "1903e8" &&
+        scalarHex(RESPONSE_CBOR, [](ResponseWriter& w) { w.value(-1000); }) == "3903e7" &&
+        scalarHex(RESPONSE_CBOR, [](ResponseWriter& w) { w.value(1000000000000ULL); }) == "1b000000e8d4a51000" &&
+        scalarHex(RESPONSE_CBOR, [](ResponseWriter& w) { w.value(1.5, 1); }) == "fa3fc00000" &&
+        scalarHex(RESPONSE_CBOR, [](ResponseWriter& w) { w.value(-4.1, 1); }) == "fac0833333" &&
+        scalarHex(RESPONSE_CBOR, [](ResponseWriter& w) { w.value(1.1, 9); }) == "fb3ff199999999999a" &&
+        scalarHex(RESPONSE_CBOR, [](ResponseWriter& w) { w.value("IETF"); }) == "6449455446" &&
+        scalarHex(RESPONSE_CBOR, [](ResponseWriter& w) { w.null(); }) == "f6",
+        "CBOR integers, floats (32-bit where exact enough), text and null as in RFC 8949");
+  check(scalarHex(RESPONSE_MSGPACK, [](ResponseWriter& w) { w.value(-33); }) == "d0df" &&
+        scalarHex(RESPONSE_MSGPACK, [](ResponseWriter& w) { w.value(-32); }) == "e0" &&
+        scalarHex(RESPONSE_MSGPACK, [](ResponseWriter& w) { w.value(200); }) == "ccc8" &&
+        scalarHex(RESPONSE_MSGPACK, [](ResponseWriter& w) { w.value(70000); }) == "ce00011170" &&
+        scalarHex(RESPONSE_MSGPACK, [](ResponseWriter& w) { w.value(2.5, 0); }) == "03" &&
+        scalarHex(RESPONSE_MSGPACK, [](ResponseWriter& w) { w.value(true); }) == "c3",
+        "MessagePack fixints, int8, uint8, uint32, rounded integers and booleans");
+
+  ResponseWriter cbor(RESPONSE_CBOR), msgpack(RESPONSE_MSGPACK);
+  for (ResponseWriter* writer : {&cbor, &msgpack}) {
+    writer->beginArray();
+    for (int i = 0; i < 300; i++) writer->value(i % 10);
+    writer->endArray();
+  }
+  check(hexOf(cbor.body()).compare(0, 8, "99012c00") == 0 && cbor.body().size() == 303 &&
+        hexOf(msgpack.body()).compare(0, 8, "dc012c00") == 0 && msgpack.body().size() == 303,
+        "long arrays take a 16-bit count, short ones none to spare");
+
+  // Every data route, at one instant, in all three formats.
+  simSetTimeUs(600000000);
+  chargeStart(1000);
+  simAdvanceUs(200000);
+  chargeMonitor();
+  RecordingExchange charging(HTTP_METHOD_GET, "/state");
+  charging.withAccept("application/cbor");
+  handleState(charging);
+  BinaryReader chargingReader = {charging.responseBody, false};
+  Document chargingDoc;
+  check(charging.responseType == "application/cbor" && charging.headers["Vary"] == "Accept" &&
+        chargingReader.read(chargingDoc) && chargingDoc.members.size() == 5 &&
+        chargingDoc.members[0].second.text == "charging" && chargingDoc.members[4].second.number == 800,
+        "/state while charging in CBOR, with Vary: Accept");
+  chargeStop();
+
+  RouteTrie trie(trieNodes, TRIE_NODES, trieSlots, 2 * TRIE_NODES);
+  trie.add(CORE_ROUTES, CORE_ROUTE_COUNT);
+  size_t same = 0;
+  size_t jsonBytes = 0, cborBytes = 0, msgpackBytes = 0;
+  for (const char* path : DOCUMENT_PATHS) {
+    RouteMatch match;
+    trie.find(path, HTTP_METHOD_GET, match);
+    RecordingExchange json(HTTP_METHOD_GET, path), asCbor(HTTP_METHOD_GET, path), asMsgpack(HTTP_METHOD_GET, path);
+    asCbor.withAccept("application/cbor");
+    asMsgpack.withAccept("application/msgpack");
+    match.route->handler(json);
+    match.route->handler(asCbor);
+    match.route->handler(asMsgpack);
+    arenaFinishRequest(nullptr);
+    Document fromJson, fromCbor, fromMsgpack;
+    JsonReader jsonReader = {json.responseBody};
+    BinaryReader cborReader = {asCbor.responseBody, false};
+    BinaryReader msgpackReader = {asMsgpack.responseBody, true};
+    bool decoded = jsonReader.read(fromJson) && cborReader.read(fromCbor) && msgpackReader.read(fromMsgpack) &&
+                   cborReader.at == asCbor.responseBody.size() && msgpackReader.at == asMsgpack.responseBody.size();
+    if (decoded && fromJson.type == Document::OBJECT && sameDocument(fromJson, fromCbor) &&
+        sameDocument(fromJson, fromMsgpack) && json.responseType == "application/json" &&
+        asMsgpack.responseType == "application/msgpack") {
+      same++;
+    } else {
+      printf("  %s differs: %s\n", path, json.responseBody.c_str());
+    }
+    jsonBytes += json.responseBody.size();
+    cborBytes += asCbor.responseBody.size();
+    msgpackBytes += asMsgpack.responseBody.size();
+  }
+  char what[160];
+  snprintf(what, sizeof(what), "%zu data routes decode to the same document in JSON, CBOR and MessagePack "
+           "(%zu, %zu, %zu bytes)", same, jsonBytes, cborBytes, msgpackBytes);
+  check(same == sizeof(DOCUMENT_PATHS) / sizeof(DOCUMENT_PATHS[0]) && cborBytes < jsonBytes &&
+        msgpackBytes < jsonBytes, what);
+}
@@ -0,0 +1,68 @@
+// Native checks of the route trie against a linear scan of the tables, and
+// of {name} captures.
+
+#include <stdio.h>
+#include <string>
+
+#include "core/route_trie.h"
+#include "core/routes.h"
+#include "checks.h"
+#include "native_support.h"
+
+static std::string paramValue(const RouteMatch& match, const char* name) {
+  const RouteParam* param = routeFindParam(match, name);
+  return param ? std::string(param->value, param->valueLength) : std::string("<none>");
+}
+
+static const ApiRoute PARAM_ROUTES[] = {
+  apiRoute("/items/{id}", HTTP_METHOD_GET, noopHandler),
+  apiRoute("/items/all", HTTP_METHOD_GET, noopHandler),
+  apiRoute("/items/{id}/stats", HTTP_METHOD_GET, noopHandler),
+  apiRoute("/items/{id}/runs/{run}", HTTP_METHOD_POST, noopHandler),
+};
+
+void checkRouting() {
+  printf("Routing\n");
+  RouteTrie trie(trieNodes, TRIE_NODES, trieSlots, 2 * TRIE_NODES);
+  check(trie.add(CORE_ROUTES, CORE_ROUTE_COUNT), "core routes fit the trie");
+
+  RouteMatch match;
+  bool same = true;
+  for (size_t i = 0; i < CORE_ROUTE_COUNT; i++) {
+    const ApiRoute& route = CORE_ROUTES[i];
+    trie.find(route.uri, route.method, match);
+    same = same && match.route == linearFind(CORE_ROUTES, CORE_ROUTE_COUNT, route.uri, route.method);
+  }
+  check(same, "every core route resolves to the entry a linear scan finds");
+
+  const char* misses[] = {"/charge/", "/charg", "/chargex", "//", "/sweeps/results/1", "charge", ""};
+  bool missed = true;
+  for (const char* path : misses) {
+    missed = missed && !trie.find(path, HTTP_METHOD_GET, match) && match.route == nullptr;
+  }
+  check(missed, "near-miss paths are not found");
+  check(!trie.find("/charge", HTTP_METHOD_POST, match), "POST /charge (GET only) is not found");
+  check(!trie.find("/charge", HTTP_METHOD_OTHER, match), "other methods are not found");
+
+  trie.clear();
+  check(trie.add(PARAM_ROUTES, 4), "{name} routes added");
+  check(trie.find("/items/42", HTTP_METHOD_GET, match) && match.route == &PARAM_ROUTES[0] &&
+        paramValue(match, "id") == "42", "/items/42 -> /items/{id}, id=42");
+  check(trie.find("/items/all", HTTP_METHOD_GET, match) && match.route == &PARAM_ROUTES[1] && match.paramCount == 0,
+        "/items/all: the literal segment wins over {id}");
+  check(trie.find("/items/7/stats", HTTP_METHOD_GET, match) && match.route == &PARAM_ROUTES[2] &&
+        paramValue(match, "id") == "7", "/items/7/stats -> /items/{id}/stats, id=7");
+  check(trie.find("/items/7/runs/3", HTTP_METHOD_POST, match) && match.route == &PARAM_ROUTES[3] &&
+        paramValue(match, "id") == "7" && paramValue(match, "run") == "3", "/items/7/runs/3 captures id and run");
+  check(!trie.find("/items/", HTTP_METHOD_GET, match) && !trie.find("/items//stats", HTTP_METHOD_GET, match),
+        "an empty segment does not match {id}");
+
+  const ApiRoute renamed = apiRoute("/items/{key}/other", HTTP_METHOD_GET, noopHandler);
+  check(!trie.add(renamed), "a different name at the same position is rejected");
+
+  RouteTrieNode fewNodes[3];
+  RouteTrieSlot fewSlots[4];
+  RouteTrie small(fewNodes, 3, fewSlots, 4);
+  const ApiRoute deep = apiRoute("/a/b/c", HTTP_METHOD_GET, noopHandler);
+  check(!small.add(deep), "a route that does not fit the arrays is rejected");
+}
@@ -0,0 +1,191 @@
+// Native checks of the serial control transport: COBS and CRC framing, capture
+// download in chunks, and frames among log text over a socket pair standing in for the UART.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "core/charge_control.h"
+#include "core/serial_control.h"
+#include "core/serial_frame.h"
+#include "core/udp_control.h"
+#include "checks.h"
+#include "native_support.h"
+#include "rc_circuit.h"
+#include "sim_hal.h"
+
+static bool cobsRoundTrip(const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> encoded(data.size() + data.size() / 254 + 1);
+  std::vector<uint8_t> decoded(data.size() + 1);
+  size_t encodedLength = cobsEncode(data.data(), data.size(), encoded.data());
+  size_t decodedLength = 0;
+  return encodedLength <= encoded.size() &&
+         std::find(encoded.begin(), encoded.begin() + encodedLength, 0) == encoded.begin() + encodedLength &&
+         cobsDecode(encoded.data(), encodedLength, decoded.data(), &decodedLength) && decodedLength == data.size() &&
+         std::equal(data.begin(), data.end(), decoded.begin());
+}
+
+/**
+ * @brief Writes a control frame to the line as the host would.
+ */
+static void serialSend(int host, uint8_t opcode, uint32_t sequence, uint32_t value0, uint32_t value1) {
+  UdpFrame request = {UDP_FRAME_VERSION, opcode, sequence, 0, 0, 0, value0, value1};
+  uint8_t payload[UDP_FRAME_BYTES + SERIAL_CRC_BYTES];
+  uint8_t line[serialFrameBytes(UDP_FRAME_BYTES)];
+  udpFrameEncode(request, payload);
+  send(host, line, serialFrameEncode(payload, UDP_FRAME_BYTES, line), 0);
+}
+
+/**
+ * @brief Splits what the bench wrote on the line into frame payloads and text.
+ */
+static void serialReceive(int host, std::vector<std::vector<uint8_t>>& frames, std::string& text) {
+  std::vector<uint8_t> line(16384);
+  ssize_t n = recv(host, line.data(), line.size(), MSG_DONTWAIT);
+  std::vector<uint8_t> segment;
+  for (ssize_t i = 0; i < n; i++) {
+    if (line[i] != SERIAL_FRAME_DELIMITER) {
+      segment.push_back(line[i]);
+      continue;
+    }
+    std::vector<uint8_t> payload(segment.size());
+    size_t length = 0;
+    if (!segment.empty() && serialFrameDecode(segment.data(), segment.size(), payload.data(), &length)) {
+      payload.resize(length);
+      frames.push_back(payload);
+    } else {
+      text.append(segment.begin(), segment.end());
+    }
+    segment.clear();
+  }
+  text.append(segment.begin(), segment.end());
+}
+
+void checkSerialControl() {
+  printf("Serial control transport\n");
+  const uint8_t check9[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  check(serialCrc16(check9, sizeof(check9)) == 0x29B1, "CRC-16/CCITT-FALSE of \"123456789\" is 0x29B1");
+  std::vector<uint8_t> zeros(10, 0);
+  std::vector<uint8_t> run(600, 0x55);
+  std::vector<uint8_t> mixed;
+  for (int i = 0; i < 1000; i++) mixed.push_back((uint8_t)(i * 7 % 5 ? i : 0));
+  check(cobsRoundTrip({}) && cobsRoundTrip(zeros) && cobsRoundTrip(run) && cobsRoundTrip(mixed),
+        "COBS round trip: empty, zeros, runs over 254 bytes, mixed; no 0x00 inside");
+
+  uint8_t payload[UDP_FRAME_BYTES + SERIAL_CRC_BYTES];
+  uint8_t line[serialFrameBytes(UDP_FRAME_BYTES)];
+  uint8_t decoded[sizeof(line)];
+  UdpFrame request = {UDP_FRAME_VERSION, UDP_OP_STATE, 1, 0, 0, 0, 0, 0};
+  udpFrameEncode(request, payload);
+  size_t length = serialFrameEncode(payload, UDP_FRAME_BYTES, line);
+  size_t decodedLength = 0;
+  bool framed = line[0] == SERIAL_FRAME_DELIMITER && line[length - 1] == SERIAL_FRAME_DELIMITER &&
+                length <= sizeof(line) &&
+                serialFrameDecode(line + 1, length - 2, decoded, &decodedLength) && decodedLength == UDP_FRAME_BYTES;
+  line[5] ^= 0x01;
+  check(framed && !serialFrameDecode(line + 1, length - 2, decoded, &decodedLength),
+        "frame decodes between delimiters; a flipped bit fails the CRC");
+
+  // A charge to a target fills the capture.
+  RcCircuitConfig config = rcDefaultConfig();
+  config.adcNoiseLsb = 0;
+  RcCircuit circuit(config);
+  rcAttach(&circuit, CHARGE_PIN, SENSE_ADC_PIN);
+  simSetTimeUs(500000000);
+  circuit.reset(simTimeUs());
+  check(udpCommand(UDP_OP_CHARGE, 30, 0, 4000).status == UDP_STATUS_OK, "charge to 4000 mV over the protocol");
+  while (chargeActive()) {
+    simAdvanceUs(1000);
+    chargeMonitor();
+  }
+  size_t captured = chargeCaptureCount();
+  bool rising = captured > 1;
+  for (size_t i = 1; i < captured; i++) {
+    rising = rising && chargeCaptureSample(i) >= chargeCaptureSample(i - 1);
+  }
+  char what[160];
+  snprintf(what, sizeof(what), "capture: %zu rising samples up to the cutoff reading %u mV", captured,
+           captured ? (unsigned)chargeCaptureSample(captured - 1) : 0u);
+  check(rising && chargeCaptureSample(captured - 1) == chargeLastResult().cutoffMv, what);
+  rcAttach(nullptr, -1, -1);
+
+  // Download in chunks of 8 samples, as a host would read a long capture.
+  std::vector<uint16_t> samples;
+  uint8_t reply[UDP_REPLY_MAX_BYTES];
+  UdpFrame fields = {};
+  bool chunked = true;
+  while (chunked && samples.size() < captured) {
+    request = {UDP_FRAME_VERSION, UDP_OP_CAPTURE, 31, 0, 0, 0, (uint32_t)samples.size(), 8};
+    udpFrameEncode(request, payload);
+    size_t replyLength = udpControlHandle(payload, UDP_FRAME_BYTES, reply, sizeof(reply));
+    chunked = udpFrameDecode(reply, replyLength, fields) && fields.value0 == samples.size() &&
+              fields.value1 == captured && replyLength > UDP_FRAME_BYTES &&
+              replyLength <= UDP_FRAME_BYTES + 2 * 8;
+    for (size_t i = UDP_FRAME_BYTES; chunked && i + 1 < replyLength; i += 2) {
+      samples.push_back((uint16_t)(reply[i] | reply[i + 1] << 8));
+    }
+  }
+  bool same = samples.size() == captured;
+  for (size_t i = 0; same && i < captured; i++) {
+    same = samples[i] == chargeCaptureSample(i);
+  }
+  request = {UDP_FRAME_VERSION, UDP_OP_CAPTURE, 32, 0, 0, 0, (uint32_t)captured, 0};
+  udpFrameEncode(request, payload);
+  check(chunked && same && udpControlHandle(payload, UDP_FRAME_BYTES, reply, sizeof(reply)) == UDP_FRAME_BYTES,
+        "capture download in chunks of 8 matches; reading past the end gives no samples");
+
+  // Over a socket pair standing in for the UART, with the log on the same line.
+  int pair[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+  fcntl(pair[0], F_SETFL, fcntl(pair[0], F_GETFL, 0) | O_NONBLOCK);
+  simSerialAttach(pair[0]);
+  int host = pair[1];
+  std::vector<std::vector<uint8_t>> frames;
+  std::string text;
+  serialSend(host, UDP_OP_CHARGE, 40, 500, 0);
+  serialControlService();
+  serialReceive(host, frames, text);
+  bool charged = frames.size() == 1 && udpFrameDecode(frames[0].data(), frames[0].size(), fields) &&
+                 fields.sequence == 40 && fields.status == UDP_STATUS_OK && chargeActive();
+  check(charged && text.find("Charge initiated for 500 ms") != std::string::npos,
+        "charge over the line: one reply frame, the log text around it");
+
+  frames.clear();
+  serialSend(host, UDP_OP_CHARGE, 40, 500, 0);
+  serialControlService();
+  serialReceive(host, frames, text);
+  check(frames.size() == 1 && udpFrameDecode(frames[0].data(), frames[0].size(), fields) &&
+        fields.status == UDP_STATUS_OK && serialControlStats().repeated == 1,
+        "a repeated charge is answered from the last reply, not run again");
+
+  frames.clear();
+  uint32_t corrupt = serialControlStats().corrupt;
+  send(host, "hello\n\0", 7, 0);
+  request = {UDP_FRAME_VERSION, UDP_OP_STOP, 41, 0, 0, 0, 0, 0};
+  udpFrameEncode(request, payload);
+  length = serialFrameEncode(payload, UDP_FRAME_BYTES, line);
+  line[3] ^= 0x40;
+  send(host, line, length, 0);
+  serialControlService();
+  serialReceive(host, frames, text);
+  check(frames.empty() && serialControlStats().corrupt == corrupt + 2 && chargeActive(),
+        "text and a corrupt frame are dropped unanswered");
+
+  serialSend(host, UDP_OP_STOP, 42, 0, 0);
+  serialSend(host, UDP_OP_CAPTURE, 43, 0, 0);
+  serialControlService();
+  serialReceive(host, frames, text);
+  bool stopped = frames.size() == 2 && udpFrameDecode(frames[0].data(), frames[0].size(), fields) &&
+                 fields.sequence == 42 && !chargeActive();
+  check(stopped && udpFrameDecode(frames[1].data(), frames[1].size(), fields) && fields.sequence == 43 &&
+        frames[1].size() == UDP_FRAME_BYTES + 2 * std::min(captured, UDP_CAPTURE_CHUNK),
+        "two frames in one read: stop, then a capture chunk");
+  simSerialAttach(-1);
+  close(pair[0]);
+  close(host);
+}
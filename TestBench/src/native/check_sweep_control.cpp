@@ -0,0 +1,110 @@
+// Native checks of /sweeps: start times against the schedule, per-step
+// statistics and incremental reads of the results.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/holdup_monitor.h"
+#include "core/sweep_control.h"
+#include "hal/gpio.h"
+#include "checks.h"
+#include "native_support.h"
+#include "rc_circuit.h"
+#include "recording_exchange.h"
+#include "sim_hal.h"
+
+static uint32_t latestStartErrorUs = 0;
+static uint64_t scheduledStartUs = 0;
+
+/**
+ * @brief Records how late each charge starts relative to the end of the
+ * previous cycle plus the gap (the relay drop-out, seen on the contact pin).
+ */
+static void onSweepPins(int pin, int level, uint64_t atUs) {
+  if (pin == CONTACT_SENSE_PIN && level == HAL_HIGH) {
+    scheduledStartUs = atUs + 200000;
+  } else if (pin == CHARGE_PIN && level == HAL_HIGH && scheduledStartUs > 0) {
+    latestStartErrorUs = std::max(latestStartErrorUs, (uint32_t)(atUs - scheduledStartUs));
+  }
+}
+
+static std::string sweepResults(long since, long limit) {
+  RecordingExchange http(HTTP_METHOD_GET, "/sweeps/results");
+  http.withArg("since", std::to_string(since).c_str()).withArg("limit", std::to_string(limit).c_str());
+  handleSweepResults(http);
+  return http.responseBody;
+}
+
+void checkSweep() {
+  printf("Sweeps\n");
+  RcCircuitConfig config = rcDefaultConfig();
+  config.adcNoiseLsb = 0;
+  RcCircuit circuit(config);
+  rcAttach(&circuit, CHARGE_PIN, SENSE_ADC_PIN, -1, CONTACT_SENSE_PIN);
+  simAddPinListener(onSweepPins);
+  simSetTimeUs(300000000);
+  circuit.reset(simTimeUs());
+  scheduledStartUs = 0;
+  latestStartErrorUs = 0;
+
+  {
+    RecordingExchange http(HTTP_METHOD_POST, "/sweeps");
+    http.withArg("param", "charge_ms").withArg("from", "100").withArg("to", "400").withArg("steps", "65");
+    handleSweeps(http);
+    check(http.status == 400, "/sweeps with 65 steps -> 400");
+  }
+  RecordingExchange http(HTTP_METHOD_POST, "/sweeps");
+  http.withArg("param", "charge_ms").withArg("from", "100").withArg("to", "400").withArg("steps", "4")
+      .withArg("repeats", "3").withArg("gap_ms", "200");
+  handleSweeps(http);
+  check(http.status == 200 && sweepActive(), "/sweeps charge_ms 100..400 in 4 steps x 3, gap 200 ms -> 200");
+  check(chargeRequest("100") == 409, "/charge while the sweep runs -> 409");
+
+  // Read the results incrementally while the sweep runs.
+  long since = 0;
+  int reads = 0;
+  std::string streamed;
+  uint64_t limitUs = simTimeUs() + 60000000ULL;
+  while (simTimeUs() < limitUs) {
+    simAdvanceUs(1000);
+    chargeMonitor();
+    sweepService();
+    holdupService();
+    std::string body = sweepResults(since, 2);
+    size_t at = body.find("\"next\":");
+    long next = atol(body.c_str() + at + 7);
+    if (next > since) {
+      streamed += body.substr(body.find("\"results\":"));
+      since = next;
+      reads++;
+    }
+    if (body.find("\"done\":true") != std::string::npos) break;
+  }
+
+  SweepStatus status = sweepStatus();
+  bool stepsOk = status.state == SWEEP_DONE && status.cycles == 12;
+  double lastHoldup = 0;
+  for (uint16_t i = 0; i < 4 && stepsOk; i++) {
+    const SweepStep* step = sweepStep(i);
+    double meanChargeUs = step->chargeUs.mean;
+    double meanHoldupUs = step->holdupUs.mean;
+    stepsOk = step->value == 100 + 100u * i && step->cycles == 3 && step->holdupUs.count == 3 &&
+              fabs(meanChargeUs - step->value * 1000.0) <= 1000 && meanHoldupUs >= lastHoldup && step->endMv.count == 3;
+    lastHoldup = meanHoldupUs;
+  }
+  check(stepsOk, "4 steps of 3 cycles: pulse widths match, hold-up grows with the charge");
+  char line[160];
+  snprintf(line, sizeof(line), "starts %u us after relay drop-out + gap at worst (reported %u us, 1 ms loop)",
+           (unsigned)latestStartErrorUs, (unsigned)status.maxGapErrorUs);
+  check(latestStartErrorUs <= 1000 && status.maxGapErrorUs <= 1000, line);
+  check(reads >= 2 && streamed.find("\"step\":3") != std::string::npos, "results streamed in pages while running");
+
+  simRemovePinListener(onSweepPins);
+  rcAttach(nullptr, -1, -1);
+}
@@ -0,0 +1,84 @@
+// Native checks of the UDP control protocol: acknowledgements, the /charge
+// checks, and repeated frames answered without running them again.
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "core/charge_control.h"
+#include "core/udp_control.h"
+#include "checks.h"
+#include "native_support.h"
+#include "sim_hal.h"
+
+void checkUdpControl() {
+  printf("UDP control protocol\n");
+  simSetTimeUs(400000000);
+  UdpFrame reply = udpCommand(UDP_OP_CHARGE, 7, 500, 0);
+  check(reply.opcode == (UDP_OP_CHARGE | UDP_REPLY) && reply.sequence == 7 && reply.status == UDP_STATUS_OK &&
+        (reply.flags & UDP_FLAG_PIN_HIGH) && chargeDurationMs() == 500,
+        "charge: acknowledged with its sequence number, pin HIGH");
+  check(udpCommand(UDP_OP_CHARGE, 8, 500, 0).status == UDP_STATUS_CONFLICT && chargeRequest("500") == 409,
+        "second charge: conflict, where /charge answers 409");
+  simAdvanceUs(100000);
+  chargeMonitor();
+  reply = udpCommand(UDP_OP_STATE, 9, 0, 0);
+  check(reply.status == UDP_STATUS_OK && (reply.flags & UDP_FLAG_CHARGING) && reply.value0 == chargeRemainingMs() &&
+        reply.value0 <= 400, "state: charging, time remaining");
+  reply = udpCommand(UDP_OP_STOP, 10, 0, 0);
+  check(reply.status == UDP_STATUS_OK && !(reply.flags & (UDP_FLAG_CHARGING | UDP_FLAG_PIN_HIGH)) &&
+        reply.endReason == CHARGE_END_STOPPED, "stop: pin LOW, last charge stopped");
+  check(udpCommand(UDP_OP_CHARGE, 11, 99, 0).status == UDP_STATUS_INVALID &&
+        udpCommand(UDP_OP_CHARGE, 12, 0, (uint32_t)chargeMaxTargetMv() + 1).status == UDP_STATUS_INVALID &&
+        !chargeActive(), "out-of-range duration and target: invalid, where /charge answers 400");
+  check(udpCommand(9, 13, 0, 0).status == UDP_STATUS_BAD_FRAME, "unknown opcode: bad frame");
+
+  uint8_t frame[UDP_FRAME_BYTES + 1];
+  uint8_t out[UDP_FRAME_BYTES];
+  UdpFrame request = {UDP_FRAME_VERSION + 1, UDP_OP_CHARGE, 14, 0, 0, 0, 500, 0};
+  udpFrameEncode(request, frame);
+  bool badVersion = udpControlHandle(frame, UDP_FRAME_BYTES, out, sizeof(out)) == UDP_FRAME_BYTES &&
+                    udpFrameDecode(out, sizeof(out), reply) && reply.status == UDP_STATUS_BAD_FRAME && !chargeActive();
+  bool wrongLength = udpControlHandle(frame, UDP_FRAME_BYTES - 1, out, sizeof(out)) == 0 &&
+                     udpControlHandle(frame, UDP_FRAME_BYTES + 1, out, sizeof(out)) == 0;
+  frame[0] = 'X';
+  check(badVersion && wrongLength && udpControlHandle(frame, UDP_FRAME_BYTES, out, sizeof(out)) == 0,
+        "other versions are refused; wrong length or magic is not answered");
+
+  // Over a socket: a lost reply makes the client send the same frame again.
+  int fd = udpControlBegin(0);
+  int client = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in to = {};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(udpControlPort());
+  to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  connect(client, (struct sockaddr*)&to, sizeof(to));
+  request = {UDP_FRAME_VERSION, UDP_OP_CHARGE, 20, 0, 0, 0, 500, 0};
+  udpFrameEncode(request, frame);
+  uint8_t first[UDP_FRAME_BYTES] = {};
+  uint8_t repeat[UDP_FRAME_BYTES] = {};
+  send(client, frame, UDP_FRAME_BYTES, 0);
+  udpControlService();
+  bool answered = recv(client, first, sizeof(first), MSG_DONTWAIT) == UDP_FRAME_BYTES;
+  send(client, frame, UDP_FRAME_BYTES, 0);
+  udpControlService();
+  answered = answered && recv(client, repeat, sizeof(repeat), MSG_DONTWAIT) == UDP_FRAME_BYTES;
+  check(fd >= 0 && answered && memcmp(first, repeat, sizeof(first)) == 0 && udpControlStats().repeated == 1 &&
+        udpFrameDecode(repeat, sizeof(repeat), reply) && reply.status == UDP_STATUS_OK,
+        "a repeated charge is answered from the last reply, not run again");
+  send(client, "STOP", 4, 0);
+  udpControlService();
+  check(udpControlStats().dropped == 1 && recv(client, out, sizeof(out), MSG_DONTWAIT) < 0 && chargeActive(),
+        "a datagram that is not a frame is dropped unanswered");
+  request = {UDP_FRAME_VERSION, UDP_OP_STOP, 21, 0, 0, 0, 0, 0};
+  udpFrameEncode(request, frame);
+  send(client, frame, UDP_FRAME_BYTES, 0);
+  udpControlService();
+  check(recv(client, out, sizeof(out), MSG_DONTWAIT) == UDP_FRAME_BYTES && !chargeActive() &&
+        udpControlStats().received == 3, "stop over the socket");
+  close(client);
+  udpControlClose();
+}
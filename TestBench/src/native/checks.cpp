@@ -0,0 +1,79 @@
+/*
+ * Native checks of the charge control logic.
+ *
+ * Runs the platform-independent core against the simulated clock and GPIO,
+ * one check_<module>.cpp per area:
+ *   1. /charge validation and /state arithmetic through the real handlers,
+ *   2. charge pulses started around the 49.7-day millis() wrap, stepped in
+ *      1 us increments, with the pulse width measured from the simulated pin,
+ *   3. the circuit model (src/native/rc_circuit.h): charge curve, relay
+ *      pull-in and hold-up, hours of self-discharge and ADC noise, and
+ *      /charge?target_mv= cutting off within one sample period of the crossing,
+ *      and the interrupt-timed hold-up measurement against the model's relay,
+ *   4. /cycle with active and passive discharge: break-before-make gaps and
+ *      cycles per minute,
+ *   5. a /sweeps run: start times against the schedule, per-step statistics
+ *      and incremental reads of the results,
+ *   6. the Welford and P-square accumulators against exact two-pass results,
+ *      and /stats fed from real charges,
+ *   7. the route trie against a linear scan of the tables, and {name}
+ *      captures,
+ *   8. in-place request parsing: decoding, strict integers and no heap use,
+ *   9. the request arena: a soak of the GET routes with and without it,
+ *      per-route statistics and the heap fallback,
+ *  10. the emergency stop: the button and UDP paths driving the pin LOW
+ *      at arrival, the latch and its release,
+ *  11. the UDP control protocol: acknowledgements, the /charge checks, and
+ *      repeated frames answered without running them again,
+ *  12. the serial control transport: COBS and CRC framing, the capture of a
+ *      charge to a target and its download in chunks, and frames among log
+ *      text over a socket pair standing in for the UART,
+ *  13. response formats: Accept negotiation, CBOR and MessagePack encodings
+ *      against the specifications' examples, and every data route decoding
+ *      to the same document in each format,
+ *  14. the HTTP server over loopback: the keep-alive policy and read deadline,
+ *      and /state long polls parked without blocking handleClient(), woken
+ *      by the charge ending or /stop, the timeout, the parking limit and
+ *      clients hanging up.
+ *
+ * The host benchmark is separate: src/native/timing_bench.cpp.
+ *
+ * Build and run: pio run -e native -t exec
+ * Exits non-zero if any check fails.
+ */
+
+#include "checks.h"
+
+#include <stdio.h>
+
+#include "native_support.h"
+
+static int failures = 0;
+
+void check(bool ok, const char* what) {
+  printf("  [%s] %s\n", ok ? "PASS" : "FAIL", what);
+  if (!ok) failures++;
+}
+
+int main() {
+  nativeBegin();
+
+  checkValidation();
+  checkWraparound();
+  checkCircuit();
+  checkCycles();
+  checkSweep();
+  checkStatistics();
+  checkRouting();
+  checkRequestParsing();
+  checkArena();
+  checkEmergencyStop();
+  checkUdpControl();
+  checkSerialControl();
+  checkResponseFormats();
+  checkKeepAlive();
+  checkLongPoll();
+
+  printf("%s (%d failure%s)\n", failures ? "FAILED" : "OK", failures, failures == 1 ? "" : "s");
+  return failures ? 1 : 0;
+}
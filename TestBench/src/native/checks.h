@@ -0,0 +1,28 @@
+#pragma once
+
+/*
+ * Native checks of the platform-independent core, one file per module
+ * (check_<module>.cpp), run in order by checks.cpp. Later checks pick up the
+ * simulated clock and the core state where the earlier ones left them.
+ */
+
+/**
+ * @brief Prints one PASS/FAIL line; any failure makes the run exit non-zero.
+ */
+void check(bool ok, const char* what);
+
+void checkValidation();       // check_handlers.cpp
+void checkWraparound();       // check_wraparound.cpp
+void checkCircuit();          // check_circuit.cpp
+void checkCycles();           // check_cycle_control.cpp
+void checkSweep();            // check_sweep_control.cpp
+void checkStatistics();       // check_cycle_stats.cpp
+void checkRouting();          // check_route_trie.cpp
+void checkRequestParsing();   // check_http_request.cpp
+void checkArena();            // check_request_arena.cpp
+void checkEmergencyStop();    // check_emergency_stop.cpp
+void checkUdpControl();       // check_udp_control.cpp
+void checkSerialControl();    // check_serial_control.cpp
+void checkResponseFormats();  // check_response_writer.cpp
+void checkKeepAlive();        // check_http_server.cpp
+void checkLongPoll();         // check_http_server.cpp
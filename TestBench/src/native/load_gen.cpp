@@ -0,0 +1,645 @@
+/*
+ * HTTP load generator for the test bench.
+ *
+ * Drives the API of a device or a virtual bench (bench_server) from a number of
+ * concurrent connections and reports throughput, latency percentiles and error
+ * rates as JSON on stdout, so loop() and handler regressions show up as numbers.
+ *
+ *   load_gen [--host 127.0.0.1] [--port 8080] [--concurrency 4] [--duration 10]
+ *            [--requests N] [--rate R] [--keep-alive] [--mix SPEC] [--charge MS]
+ *            [--warmup S] [--timeout-ms 2000] [--max-p99-us US] [--max-error-rate F]
+ *            [--trickle N] [--stall N] [--accept TYPE]
+ *
+ * --mix is a comma-separated list of "[METHOD ]target[:weight]" entries, e.g.
+ *   "/state:8,/health:1,POST /stop:1". The default is "/state".
+ * --rate R paces the whole run at R requests/s (open loop). Latency is then
+ *   measured from each request's scheduled start, so a stalled server is not
+ *   hidden by the generator waiting for it (coordinated omission).
+ * --charge MS starts a charge cycle of MS ms before the run and stops it
+ *   afterwards, to measure the API while the charge pin is driven.
+ * --max-p99-us / --max-error-rate make the exit code 3 when exceeded (for CI).
+ * --trickle N adds N connections that send a request one byte every 100 ms,
+ *   and --stall N adds N that send requests but never read the responses, to
+ *   measure how well the server isolates slow clients. They are not measured.
+ * --accept TYPE sends "Accept: TYPE", e.g. application/cbor, to load the
+ *   binary response formats.
+ *
+ * Without --keep-alive every request opens a new connection, like a one-shot
+ * curl. With it, a connection is reused until the server answers
+ * "Connection: close"; "connection_reuse" in the report is the share of
+ * requests sent on an already open connection.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+// --- 1. CONFIGURATION ---
+
+struct MixEntry {
+  std::string method;
+  std::string target;
+  unsigned weight;
+};
+
+struct Options {
+  std::string host = "127.0.0.1";
+  std::string port = "8080";
+  int concurrency = 4;
+  double durationS = 10;
+  uint64_t requests = 0;  // 0: run for durationS
+  double rate = 0;        // 0: closed loop, as fast as responses arrive
+  bool keepAlive = false;
+  long chargeMs = 0;
+  double warmupS = 0;
+  int timeoutMs = 2000;
+  double maxP99Us = 0;
+  double maxErrorRate = -1;
+  int trickle = 0;
+  int stall = 0;
+  std::string accept;
+  std::vector<MixEntry> mix;
+};
+
+static bool parseMix(const char* spec, std::vector<MixEntry>& mix) {
+  std::string text = spec;
+  size_t start = 0;
+  while (start <= text.size()) {
+    size_t end = text.find(',', start);
+    if (end == std::string::npos) end = text.size();
+    std::string item = text.substr(start, end - start);
+    start = end + 1;
+    if (item.empty()) continue;
+
+    MixEntry entry = {"GET", "", 1};
+    size_t colon = item.rfind(':');
+    if (colon != std::string::npos) {
+      entry.weight = (unsigned)atoi(item.c_str() + colon + 1);
+      item = item.substr(0, colon);
+    }
+    size_t space = item.find(' ');
+    if (space != std::string::npos) {
+      entry.method = item.substr(0, space);
+      item = item.substr(space + 1);
+    }
+    entry.target = item;
+    if (entry.target.empty() || entry.target[0] != '/' || entry.weight == 0) {
+      return false;
+    }
+    mix.push_back(entry);
+  }
+  return !mix.empty();
+}
+
+// --- 2. CONNECTION ---
+
+struct Connection {
+  int fd = -1;
+  std::string pending;  // Bytes received beyond the previous response
+};
+
+enum ExchangeResult { EXCHANGE_OK, EXCHANGE_CONNECT_ERROR, EXCHANGE_TIMEOUT, EXCHANGE_IO_ERROR };
+
+static void closeConnection(Connection& conn) {
+  if (conn.fd >= 0) {
+    close(conn.fd);
+    conn.fd = -1;
+  }
+  conn.pending.clear();
+}
+
+/**
+ * @brief Connects with a timeout, then switches to blocking I/O with send and
+ * receive timeouts.
+ */
+static ExchangeResult openConnection(Connection& conn, const addrinfo* address, int timeoutMs) {
+  int fd = socket(address->ai_family, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return EXCHANGE_CONNECT_ERROR;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  if (connect(fd, address->ai_addr, address->ai_addrlen) < 0) {
+    if (errno != EINPROGRESS) {
+      close(fd);
+      return EXCHANGE_CONNECT_ERROR;
+    }
+    struct pollfd pfd = {fd, POLLOUT, 0};
+    int error = 0;
+    socklen_t length = sizeof(error);
+    int ready = poll(&pfd, 1, timeoutMs);
+    if (ready <= 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+      close(fd);
+      return ready == 0 ? EXCHANGE_TIMEOUT : EXCHANGE_CONNECT_ERROR;
+    }
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+
+  struct timeval timeout;
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_usec = (timeoutMs % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  int yes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+  conn.fd = fd;
+  conn.pending.clear();
+  return EXCHANGE_OK;
+}
+
+static ExchangeResult receiveMore(Connection& conn) {
+  char buffer[2048];
+  ssize_t n;
+  do {
+    n = recv(conn.fd, buffer, sizeof(buffer), 0);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? EXCHANGE_TIMEOUT : EXCHANGE_IO_ERROR;
+  }
+  if (n == 0) {
+    return EXCHANGE_IO_ERROR;
+  }
+  conn.pending.append(buffer, n);
+  return EXCHANGE_OK;
+}
+
+/**
+ * @brief Sends one request and reads the complete response.
+ * @param status Set to the HTTP status code on EXCHANGE_OK.
+ * @param reusable Set to false if the server closes the connection afterwards.
+ */
+static ExchangeResult exchange(Connection& conn, const std::string& request, int* status, bool* reusable) {
+  const char* data = request.data();
+  size_t left = request.size();
+  while (left > 0) {
+    ssize_t sent = send(conn.fd, data, left, MSG_NOSIGNAL);
+    if (sent <= 0) {
+      if (sent < 0 && errno == EINTR) continue;
+      return sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? EXCHANGE_TIMEOUT : EXCHANGE_IO_ERROR;
+    }
+    data += sent;
+    left -= sent;
+  }
+
+  size_t headerEnd;
+  while ((headerEnd = conn.pending.find("\r\n\r\n")) == std::string::npos) {
+    ExchangeResult result = receiveMore(conn);
+    if (result != EXCHANGE_OK) return result;
+  }
+
+  // Status line: HTTP/1.1 200 OK
+  size_t space = conn.pending.find(' ');
+  if (space == std::string::npos || space > headerEnd) {
+    return EXCHANGE_IO_ERROR;
+  }
+  *status = atoi(conn.pending.c_str() + space + 1);
+
+  long contentLength = -1;
+  bool closeAfter = false;
+  size_t pos = conn.pending.find("\r\n") + 2;
+  while (pos < headerEnd) {
+    size_t end = conn.pending.find("\r\n", pos);
+    const char* line = conn.pending.c_str() + pos;
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      contentLength = atol(line + 15);
+    } else if (strncasecmp(line, "Connection:", 11) == 0) {
+      closeAfter = strncasecmp(line + 11 + strspn(line + 11, " "), "close", 5) == 0;
+    }
+    pos = end + 2;
+  }
+
+  size_t bodyStart = headerEnd + 4;
+  if (contentLength < 0) {
+    // No framing: the body runs until the server closes the connection.
+    while (receiveMore(conn) == EXCHANGE_OK) {
+    }
+    *reusable = false;
+    conn.pending.clear();
+    return EXCHANGE_OK;
+  }
+  while (conn.pending.size() < bodyStart + (size_t)contentLength) {
+    ExchangeResult result = receiveMore(conn);
+    if (result != EXCHANGE_OK) return result;
+  }
+  conn.pending.erase(0, bodyStart + contentLength);
+  *reusable = !closeAfter;
+  return EXCHANGE_OK;
+}
+
+// --- 3. WORKERS ---
+
+struct WorkerStats {
+  std::vector<std::vector<uint32_t>> latencyUs;  // Per mix entry
+  std::map<int, uint64_t> statuses;
+  uint64_t connectErrors = 0;
+  uint64_t timeouts = 0;
+  uint64_t ioErrors = 0;
+  uint64_t connections = 0;
+};
+
+static Options options;
+static const addrinfo* serverAddress = nullptr;
+static std::vector<std::string> requests;  // Pre-rendered, one per mix entry
+static std::atomic<uint64_t> issued(0);
+
+static std::string renderRequest(const MixEntry& entry) {
+  std::string request = entry.method + " " + entry.target + " HTTP/1.1\r\nHost: " + options.host + "\r\n";
+  request += options.keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  if (!options.accept.empty()) {
+    request += "Accept: " + options.accept + "\r\n";
+  }
+  if (entry.method == "POST") {
+    request += "Content-Length: 0\r\n";
+  }
+  request += "\r\n";
+  return request;
+}
+
+/**
+ * @brief Picks a mix entry by weight with a per-worker xorshift generator.
+ */
+static size_t pickEntry(uint32_t& seed, unsigned totalWeight) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  unsigned ticket = seed % totalWeight;
+  for (size_t i = 0; i < options.mix.size(); i++) {
+    if (ticket < options.mix[i].weight) return i;
+    ticket -= options.mix[i].weight;
+  }
+  return 0;
+}
+
+static void runWorker(int index, Clock::time_point start, Clock::time_point measureFrom,
+                      Clock::time_point end, WorkerStats* stats) {
+  stats->latencyUs.resize(options.mix.size());
+  unsigned totalWeight = 0;
+  for (const MixEntry& entry : options.mix) totalWeight += entry.weight;
+  uint32_t seed = 2463534242u + index * 7919u;
+
+  // Open-loop pacing: each worker owns every concurrency-th slot of the schedule.
+  Clock::duration interval = Clock::duration::zero();
+  Clock::time_point next = start;
+  if (options.rate > 0) {
+    interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.concurrency / options.rate));
+    next = start + interval * index / options.concurrency;
+  }
+
+  Connection conn;
+  while (true) {
+    if (options.requests > 0 ? issued.fetch_add(1) >= options.requests : Clock::now() >= end) {
+      break;
+    }
+    Clock::time_point scheduled = Clock::now();
+    if (options.rate > 0) {
+      std::this_thread::sleep_until(next);
+      if (options.requests == 0 && next >= end) break;
+      scheduled = next;
+      next += interval;
+    }
+
+    size_t entry = pickEntry(seed, totalWeight);
+    ExchangeResult result = EXCHANGE_OK;
+    if (conn.fd < 0) {
+      result = openConnection(conn, serverAddress, options.timeoutMs);
+      stats->connections++;
+    }
+    int status = 0;
+    bool reusable = false;
+    if (result == EXCHANGE_OK) {
+      result = exchange(conn, requests[entry], &status, &reusable);
+    }
+    Clock::time_point done = Clock::now();
+    if (result != EXCHANGE_OK || !reusable || !options.keepAlive) {
+      closeConnection(conn);
+    }
+
+    if (scheduled < measureFrom) {
+      continue;  // Warm-up
+    }
+    switch (result) {
+      case EXCHANGE_OK:
+        stats->statuses[status]++;
+        stats->latencyUs[entry].push_back(
+            (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(done - scheduled).count());
+        break;
+      case EXCHANGE_CONNECT_ERROR: stats->connectErrors++; break;
+      case EXCHANGE_TIMEOUT: stats->timeouts++; break;
+      case EXCHANGE_IO_ERROR: stats->ioErrors++; break;
+    }
+  }
+  closeConnection(conn);
+}
+
+/**
+ * @brief Sends a single request outside the measurement (used for --charge).
+ */
+static int sendControl(const char* method, const std::string& target) {
+  MixEntry entry = {method, target, 1};
+  bool keepAlive = options.keepAlive;
+  options.keepAlive = false;
+  std::string request = renderRequest(entry);
+  options.keepAlive = keepAlive;
+
+  Connection conn;
+  int status = 0;
+  bool reusable = false;
+  if (openConnection(conn, serverAddress, options.timeoutMs) != EXCHANGE_OK ||
+      exchange(conn, request, &status, &reusable) != EXCHANGE_OK) {
+    status = 0;
+  }
+  closeConnection(conn);
+  return status;
+}
+
+// --- 4. SLOW CLIENTS ---
+
+static std::atomic<bool> slowClientsRunning(true);
+
+/**
+ * @brief Sends requests one byte every 100 ms, reconnecting whenever the server
+ * gives up on the connection.
+ */
+static void runTrickle() {
+  static const char request[] = "GET /state HTTP/1.1\r\nHost: trickle\r\n\r\n";
+  Connection conn;
+  size_t pos = 0;
+  while (slowClientsRunning) {
+    if (conn.fd < 0 && openConnection(conn, serverAddress, options.timeoutMs) != EXCHANGE_OK) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    if (send(conn.fd, request + pos, 1, MSG_NOSIGNAL) != 1) {
+      closeConnection(conn);
+      pos = 0;
+      continue;
+    }
+    pos = (pos + 1) % (sizeof(request) - 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  closeConnection(conn);
+}
+
+/**
+ * @brief Pipelines requests for the largest response without reading any, so
+ * the server's writes stall on a full window.
+ */
+static void runStall() {
+  static const char request[] = "GET /swagger.json HTTP/1.1\r\nHost: stall\r\n\r\n";
+  Connection conn;
+  while (slowClientsRunning) {
+    if (conn.fd < 0) {
+      if (openConnection(conn, serverAddress, options.timeoutMs) != EXCHANGE_OK) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        continue;
+      }
+      int small = 2048;
+      setsockopt(conn.fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    }
+    if (send(conn.fd, request, sizeof(request) - 1, MSG_NOSIGNAL) != (ssize_t)(sizeof(request) - 1)) {
+      closeConnection(conn);
+      continue;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  closeConnection(conn);
+}
+
+// --- 5. REPORT ---
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+static void appendLatency(std::string& json, const std::vector<uint32_t>& sorted) {
+  double sum = 0;
+  for (uint32_t v : sorted) sum += v;
+  char text[256];
+  snprintf(text, sizeof(text),
+           "{\"min\":%u, \"mean\":%.1f, \"p50\":%u, \"p90\":%u, \"p99\":%u, \"p999\":%u, \"max\":%u}",
+           sorted.empty() ? 0 : sorted.front(), sorted.empty() ? 0.0 : sum / sorted.size(),
+           percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99), percentile(sorted, 99.9),
+           sorted.empty() ? 0 : sorted.back());
+  json += text;
+}
+
+static std::string jsonEscape(const std::string& text) {
+  std::string out;
+  for (char c : text) {
+    if (c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [--host H] [--port P] [--concurrency N] [--duration S] [--requests N]\n"
+          "          [--rate R] [--keep-alive] [--mix SPEC] [--charge MS] [--warmup S]\n"
+          "          [--timeout-ms MS] [--max-p99-us US] [--max-error-rate F] [--trickle N] [--stall N]\n"
+          "          [--accept TYPE]\n",
+          program);
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char* flag = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(flag, "--keep-alive") == 0) {
+      options.keepAlive = true;
+      continue;
+    }
+    if (!value) {
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+    if (strcmp(flag, "--host") == 0) options.host = value;
+    else if (strcmp(flag, "--port") == 0) options.port = value;
+    else if (strcmp(flag, "--concurrency") == 0) options.concurrency = std::max(1, atoi(value));
+    else if (strcmp(flag, "--duration") == 0) options.durationS = atof(value);
+    else if (strcmp(flag, "--requests") == 0) options.requests = strtoull(value, nullptr, 10);
+    else if (strcmp(flag, "--rate") == 0) options.rate = atof(value);
+    else if (strcmp(flag, "--charge") == 0) options.chargeMs = atol(value);
+    else if (strcmp(flag, "--warmup") == 0) options.warmupS = atof(value);
+    else if (strcmp(flag, "--timeout-ms") == 0) options.timeoutMs = atoi(value);
+    else if (strcmp(flag, "--max-p99-us") == 0) options.maxP99Us = atof(value);
+    else if (strcmp(flag, "--max-error-rate") == 0) options.maxErrorRate = atof(value);
+    else if (strcmp(flag, "--trickle") == 0) options.trickle = std::max(0, atoi(value));
+    else if (strcmp(flag, "--stall") == 0) options.stall = std::max(0, atoi(value));
+    else if (strcmp(flag, "--accept") == 0) options.accept = value;
+    else if (strcmp(flag, "--mix") == 0) {
+      if (!parseMix(value, options.mix)) {
+        fprintf(stderr, "load_gen: invalid --mix '%s'\n", value);
+        return 2;
+      }
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (options.mix.empty()) {
+    options.mix.push_back({"GET", "/state", 1});
+  }
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* resolved = nullptr;
+  if (getaddrinfo(options.host.c_str(), options.port.c_str(), &hints, &resolved) != 0 || !resolved) {
+    fprintf(stderr, "load_gen: cannot resolve %s:%s\n", options.host.c_str(), options.port.c_str());
+    return 1;
+  }
+  serverAddress = resolved;
+  for (const MixEntry& entry : options.mix) {
+    requests.push_back(renderRequest(entry));
+  }
+
+  int chargeStatus = 0;
+  if (options.chargeMs > 0) {
+    chargeStatus = sendControl("GET", "/charge?time=" + std::to_string(options.chargeMs));
+    if (chargeStatus != 200) {
+      fprintf(stderr, "load_gen: /charge returned %d\n", chargeStatus);
+    }
+  }
+
+  std::vector<std::thread> slowClients;
+  for (int i = 0; i < options.trickle; i++) slowClients.emplace_back(runTrickle);
+  for (int i = 0; i < options.stall; i++) slowClients.emplace_back(runStall);
+
+  // --- Run ---
+  fprintf(stderr, "load_gen: %d connection(s) against %s:%s ...\n", options.concurrency,
+          options.host.c_str(), options.port.c_str());
+  Clock::time_point start = Clock::now();
+  Clock::time_point measureFrom = start + std::chrono::duration_cast<Clock::duration>(
+                                              std::chrono::duration<double>(options.warmupS));
+  Clock::time_point end = measureFrom + std::chrono::duration_cast<Clock::duration>(
+                                            std::chrono::duration<double>(options.durationS));
+  std::vector<WorkerStats> stats(options.concurrency);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < options.concurrency; i++) {
+    workers.emplace_back(runWorker, i, start, measureFrom, end, &stats[i]);
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  double elapsedS = std::chrono::duration<double>(Clock::now() - std::max(start, measureFrom)).count();
+  slowClientsRunning = false;
+  for (std::thread& client : slowClients) {
+    client.join();
+  }
+
+  if (options.chargeMs > 0) {
+    sendControl("POST", "/stop");
+  }
+  freeaddrinfo(resolved);
+
+  // --- Merge ---
+  WorkerStats total;
+  total.latencyUs.resize(options.mix.size());
+  for (const WorkerStats& s : stats) {
+    for (size_t e = 0; e < options.mix.size(); e++) {
+      total.latencyUs[e].insert(total.latencyUs[e].end(), s.latencyUs[e].begin(), s.latencyUs[e].end());
+    }
+    for (const auto& status : s.statuses) total.statuses[status.first] += status.second;
+    total.connectErrors += s.connectErrors;
+    total.timeouts += s.timeouts;
+    total.ioErrors += s.ioErrors;
+    total.connections += s.connections;
+  }
+  std::vector<uint32_t> all;
+  for (std::vector<uint32_t>& latencies : total.latencyUs) {
+    std::sort(latencies.begin(), latencies.end());
+    all.insert(all.end(), latencies.begin(), latencies.end());
+  }
+  std::sort(all.begin(), all.end());
+
+  uint64_t http5xx = 0;
+  for (const auto& status : total.statuses) {
+    if (status.first >= 500) http5xx += status.second;
+  }
+  uint64_t transportErrors = total.connectErrors + total.timeouts + total.ioErrors;
+  uint64_t attempts = all.size() + transportErrors;
+  double errorRate = attempts ? (double)(transportErrors + http5xx) / attempts : 0;
+
+  // --- Report ---
+  char text[256];
+  std::string json = "{\"target\":\"" + jsonEscape(options.host) + ":" + jsonEscape(options.port) + "\"";
+  snprintf(text, sizeof(text),
+           ", \"concurrency\":%d, \"keep_alive\":%s, \"rate_limit\":%.1f, \"charge_ms\":%ld, \"duration_s\":%.3f"
+           ", \"trickle\":%d, \"stall\":%d",
+           options.concurrency, options.keepAlive ? "true" : "false", options.rate, options.chargeMs, elapsedS,
+           options.trickle, options.stall);
+  json += text;
+  double reuse = attempts > total.connections ? 1.0 - (double)total.connections / attempts : 0;
+  snprintf(text, sizeof(text),
+           ", \"requests\":%llu, \"connections\":%llu, \"connection_reuse\":%.4f, \"throughput_rps\":%.1f",
+           (unsigned long long)attempts, (unsigned long long)total.connections, reuse,
+           elapsedS > 0 ? all.size() / elapsedS : 0.0);
+  json += text;
+
+  json += ", \"latency_us\":";
+  appendLatency(json, all);
+
+  json += ", \"status\":{";
+  bool first = true;
+  for (const auto& status : total.statuses) {
+    json += std::string(first ? "" : ", ") + "\"" + std::to_string(status.first) + "\":" + std::to_string(status.second);
+    first = false;
+  }
+  json += "}";
+
+  snprintf(text, sizeof(text),
+           ", \"errors\":{\"connect\":%llu, \"timeout\":%llu, \"io\":%llu, \"http_5xx\":%llu}, \"error_rate\":%.6f",
+           (unsigned long long)total.connectErrors, (unsigned long long)total.timeouts,
+           (unsigned long long)total.ioErrors, (unsigned long long)http5xx, errorRate);
+  json += text;
+
+  json += ", \"per_target\":[";
+  for (size_t e = 0; e < options.mix.size(); e++) {
+    if (e > 0) json += ", ";
+    json += "{\"request\":\"" + jsonEscape(options.mix[e].method + " " + options.mix[e].target) + "\"";
+    json += ", \"count\":" + std::to_string(total.latencyUs[e].size()) + ", \"latency_us\":";
+    appendLatency(json, total.latencyUs[e]);
+    json += "}";
+  }
+  json += "]}";
+  printf("%s\n", json.c_str());
+
+  bool failed = false;
+  if (options.maxP99Us > 0 && percentile(all, 99) > options.maxP99Us) {
+    fprintf(stderr, "load_gen: p99 %u us exceeds %.0f us\n", percentile(all, 99), options.maxP99Us);
+    failed = true;
+  }
+  if (options.maxErrorRate >= 0 && errorRate > options.maxErrorRate) {
+    fprintf(stderr, "load_gen: error rate %.4f exceeds %.4f\n", errorRate, options.maxErrorRate);
+    failed = true;
+  }
+  return failed ? 3 : 0;
+}
@@ -0,0 +1,124 @@
+#include "native_support.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "hal/gpio.h"
+#include "recording_exchange.h"
+#include "sim_hal.h"
+
+void nativeBegin() {
+  simSetLogEnabled(false);
+  chargeBegin(CHARGE_PIN);
+  chargeSetSense(SENSE_ADC_PIN, CHARGE_SAMPLE_PERIOD_US, 2.0f);  // rcDefaultConfig() divider
+  ApiPlatform platform = {"native", nullptr, nullptr, nullptr};
+  apiBegin(platform);
+}
+
+uint64_t pinHighAtUs = 0;
+uint64_t pinLowAtUs = 0;
+
+void onPin(int pin, int level, uint64_t atUs) {
+  if (pin != CHARGE_PIN) return;
+  if (level == HAL_HIGH) pinHighAtUs = atUs;
+  else pinLowAtUs = atUs;
+}
+
+int chargeRequest(const char* time) {
+  RecordingExchange http(HTTP_METHOD_GET, "/charge");
+  if (time) http.withArg("time", time);
+  handleCharge(http);
+  return http.status;
+}
+
+void runCharge(long durationMs) {
+  chargeStart(durationMs);
+  while (chargeActive()) {
+    simAdvanceUs(1000);
+    chargeMonitor();
+  }
+}
+
+bool runPulse(uint64_t startUs, long durationMs, uint64_t* widthUs, uint64_t* steps) {
+  simSetTimeUs(startUs);
+  pinHighAtUs = pinLowAtUs = 0;
+  if (chargeStart(durationMs) != CHARGE_STARTED) return false;
+
+  bool stateOk = true;
+  uint32_t lastRemaining = chargeRemainingMs();
+  uint64_t limitUs = startUs + (uint64_t)(durationMs + 10) * 1000;
+  *steps = 0;
+
+  while (chargeActive() && simTimeUs() < limitUs) {
+    simAdvanceUs(1);
+    (*steps)++;
+    chargeMonitor();
+    uint32_t remaining = chargeRemainingMs();
+    // /state must count down monotonically and never exceed the duration.
+    if (remaining > lastRemaining || remaining > (uint32_t)durationMs) stateOk = false;
+    lastRemaining = remaining;
+  }
+
+  *widthUs = pinLowAtUs - pinHighAtUs;
+  // halMillis() has 1 ms resolution, so the pulse can be up to 1 ms short
+  // depending on where inside a millisecond it started.
+  uint64_t nominalUs = (uint64_t)durationMs * 1000;
+  bool widthOk = !chargeActive() && *widthUs <= nominalUs && *widthUs + 1000 > nominalUs;
+  return widthOk && stateOk;
+}
+
+size_t heapAllocations = 0;
+
+void* operator new(size_t size) {
+  heapAllocations++;
+  void* memory = malloc(size ? size : 1);
+  if (!memory) throw std::bad_alloc();
+  return memory;
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+RouteTrieNode trieNodes[TRIE_NODES];
+RouteTrieSlot trieSlots[2 * TRIE_NODES];
+
+void noopHandler(HttpExchange&) {}
+
+volatile uintptr_t routeSink = 0;
+
+const ApiRoute* linearFind(const ApiRoute* routes, size_t count, const char* path, HttpMethod method) {
+  for (size_t i = 0; i < count; i++) {
+    if (routes[i].method == method && strcmp(routes[i].uri, path) == 0) {
+      return &routes[i];
+    }
+  }
+  return nullptr;
+}
+
+RequestParseResult parseCopy(std::string_view text, RequestView& request, char* buffer) {
+  memcpy(buffer, text.data(), text.size());
+  return requestParseHead(buffer, text.size(), request);
+}
+
+double skewedSample(uint32_t& state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return 350000.0 - 2000.0 * log((state + 1.0) / 4294967297.0);
+}
+
+UdpFrame udpCommand(uint8_t opcode, uint32_t sequence, uint32_t value0, uint32_t value1) {
+  UdpFrame request = {UDP_FRAME_VERSION, opcode, sequence, 0, 0, 0, value0, value1};
+  uint8_t frame[UDP_FRAME_BYTES];
+  uint8_t reply[UDP_FRAME_BYTES];
+  udpFrameEncode(request, frame);
+  UdpFrame decoded = {};
+  if (udpControlHandle(frame, sizeof(frame), reply, sizeof(reply)) == UDP_FRAME_BYTES) {
+    udpFrameDecode(reply, sizeof(reply), decoded);
+  }
+  return decoded;
+}
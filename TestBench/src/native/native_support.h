@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+#include "core/api_schema.h"
+#include "core/http_request.h"
+#include "core/route_trie.h"
+#include "core/udp_control.h"
+
+/*
+ * Fixtures shared by the native checks (checks.cpp and check_*.cpp) and the
+ * host benchmark (timing_bench.cpp): the bench's pin assignment, the core
+ * brought up on the simulated HAL, and the helpers more than one of them
+ * drives the core through.
+ */
+
+const int CHARGE_PIN = 17;
+const int SENSE_ADC_PIN = 34;
+const int DISCHARGE_PIN = 16;
+const int CONTACT_SENSE_PIN = 27;
+
+/**
+ * @brief Brings up charge control and the API on the simulated HAL, as
+ * setup() does on the board, with the simulation's log muted.
+ */
+void nativeBegin();
+
+// /charge?time= through the real handler; returns the HTTP status.
+int chargeRequest(const char* time);
+
+// Runs a charge to its end in 1 ms loop() iterations.
+void runCharge(long durationMs);
+
+// Virtual times of the last charge pin edges, while onPin() is a pin listener.
+extern uint64_t pinHighAtUs;
+extern uint64_t pinLowAtUs;
+void onPin(int pin, int level, uint64_t atUs);
+
+/**
+ * @brief Starts a charge at the given virtual time and steps the clock in 1 us
+ * increments until the controller ends it.
+ * @return true if the pulse width and /state arithmetic were correct.
+ */
+bool runPulse(uint64_t startUs, long durationMs, uint64_t* widthUs, uint64_t* steps);
+
+// Heap allocations made through operator new, to show what a code path costs.
+extern size_t heapAllocations;
+
+// Node and slot arrays for the route tries the checks and the benchmark build.
+const size_t TRIE_NODES = 1024;
+extern RouteTrieNode trieNodes[TRIE_NODES];
+extern RouteTrieSlot trieSlots[2 * TRIE_NODES];
+
+void noopHandler(HttpExchange&);
+
+// Keeps the benchmarked lookups from being optimised away.
+extern volatile uintptr_t routeSink;
+
+/**
+ * @brief The lookup the socket server used before the trie: first match in table order.
+ */
+const ApiRoute* linearFind(const ApiRoute* routes, size_t count, const char* path, HttpMethod method);
+
+const char SWEEP_REQUEST[] =
+    "POST /sweeps?param=charge_ms&from=100&to=5000&steps=50&repeats=20&gap_ms=500 HTTP/1.1\r\n"
+    "Host: 192.168.4.1\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\n\r\n";
+
+// Copies a request into the buffer and parses its head there, as recv() fills it.
+RequestParseResult parseCopy(std::string_view text, RequestView& request, char* buffer);
+
+/**
+ * @brief Exponentially distributed samples (xorshift32), a skewed
+ * distribution on top of a large offset, like hold-up times in microseconds.
+ */
+double skewedSample(uint32_t& state);
+
+// One UDP control frame through udpControlHandle(); the decoded reply, zeroed if none.
+UdpFrame udpCommand(uint8_t opcode, uint32_t sequence, uint32_t value0, uint32_t value1);
@@ -0,0 +1,230 @@
+#include "rc_circuit.h"
+
+#include <math.h>
+
+#include "hal/gpio.h"
+#include "sim_hal.h"
+
+RcCircuitConfig rcDefaultConfig() {
+  RcCircuitConfig config;
+  config.supplyV = 5.0;
+  config.seriesOhm = 4.7;
+  config.capacitanceF = 2200e-6;
+  config.leakageOhm = 2e6;
+  config.coilOhm = 70.0;
+  config.pullInV = 3.75;
+  config.dropOutV = 0.5;
+  config.operateUs = 5000;
+  config.releaseUs = 3000;
+  config.dividerTopOhm = 100e3;
+  config.dividerBottomOhm = 100e3;
+  config.dischargeOhm = 10.0;
+  config.adcFullScaleMv = 3100.0;
+  config.adcBits = 12;
+  config.adcNoiseLsb = 2.0;
+  config.noiseSeed = 0x5C400E01;
+  return config;
+}
+
+// --- 1. MODEL ---
+
+RcCircuit::RcCircuit(const RcCircuitConfig& config)
+    : cfg(config), nowUs(0), voltage(0), drive(false), discharge(false), overlap(0), contact(false), pending(false),
+      pendingAtUs(0),
+      rng(config.noiseSeed ? config.noiseSeed : 1), contactListener(nullptr) {
+  double dividerOhm = cfg.dividerTopOhm + cfg.dividerBottomOhm;
+  dividerRatio = dividerOhm > 0 ? cfg.dividerBottomOhm / dividerOhm : 1.0;
+
+  // Everything that discharges the capacitor, in parallel, without and with
+  // the discharge resistor.
+  double conductance = 0;
+  if (cfg.leakageOhm > 0) conductance += 1.0 / cfg.leakageOhm;
+  if (cfg.coilOhm > 0) conductance += 1.0 / cfg.coilOhm;
+  if (dividerOhm > 0) conductance += 1.0 / dividerOhm;
+
+  for (int bleed = 0; bleed < 2; bleed++) {
+    double load = conductance + (bleed && cfg.dischargeOhm > 0 ? 1.0 / cfg.dischargeOhm : 0);
+    double loadOhm = load > 0 ? 1.0 / load : INFINITY;
+
+    // Driver on: Thevenin equivalent of the supply, R_series and the load.
+    double sourceOhm = isinf(loadOhm) ? cfg.seriesOhm : cfg.seriesOhm * loadOhm / (cfg.seriesOhm + loadOhm);
+    targetTable[1][bleed] = isinf(loadOhm) ? cfg.supplyV : cfg.supplyV * loadOhm / (cfg.seriesOhm + loadOhm);
+    tauTable[1][bleed] = cfg.capacitanceF * sourceOhm * 1e6;
+    targetTable[0][bleed] = 0;
+    tauTable[0][bleed] = cfg.capacitanceF * loadOhm * 1e6;
+  }
+
+  adcMaxCode = (1 << cfg.adcBits) - 1;
+  adcLsbMv = cfg.adcFullScaleMv / adcMaxCode;
+}
+
+void RcCircuit::reset(uint64_t atUs) {
+  nowUs = atUs;
+  voltage = 0;
+  drive = false;
+  discharge = false;
+  overlap = 0;
+  contact = false;
+  pending = false;
+}
+
+void RcCircuit::setDrive(bool on, uint64_t atUs) {
+  advanceTo(atUs);
+  drive = on;
+  // A contact transition already in progress completes regardless: the
+  // armature is moving.
+  advanceTo(atUs);
+}
+
+void RcCircuit::setDischarge(bool on, uint64_t atUs) {
+  advanceTo(atUs);
+  discharge = on;
+  advanceTo(atUs);
+}
+
+double RcCircuit::timeToVoltageUs(double volts) const {
+  double target = targetV();
+  double from = voltage - target;
+  double to = volts - target;
+  if (volts == voltage) return 0;
+  if (from == 0 || to == 0 || (from > 0) != (to > 0) || fabs(to) > fabs(from)) return -1;
+  return tauUs() * log(from / to);
+}
+
+void RcCircuit::integrate(uint64_t toUs) {
+  double target = targetV();
+  voltage = target + (voltage - target) * exp(-(double)(toUs - nowUs) / tauUs());
+  if (drive && discharge) {
+    overlap += toUs - nowUs;
+  }
+  nowUs = toUs;
+}
+
+void RcCircuit::advanceTo(uint64_t us) {
+  for (;;) {
+    if (pending && pendingAtUs <= nowUs) {
+      contact = !contact;
+      pending = false;
+      if (contactListener) contactListener(contact, nowUs);
+      continue;
+    }
+
+    double threshold = contact ? cfg.dropOutV : cfg.pullInV;
+    if (!pending && (contact ? voltage <= threshold : voltage >= threshold)) {
+      pending = true;
+      pendingAtUs = nowUs + (contact ? cfg.releaseUs : cfg.operateUs);
+      continue;
+    }
+    if (nowUs >= us) {
+      return;
+    }
+
+    // Step to the next threshold crossing or contact transition, whichever
+    // comes first, so every transition lands on its exact microsecond.
+    uint64_t next = us;
+    if (pending) {
+      if (pendingAtUs < next) next = pendingAtUs;
+    } else {
+      double crossingUs = timeToVoltageUs(threshold);
+      if (crossingUs >= 0) {
+        uint64_t at = nowUs + (uint64_t)ceil(crossingUs);
+        if (at <= nowUs) at = nowUs + 1;
+        if (at < next) next = at;
+      }
+    }
+    integrate(next);
+  }
+}
+
+void RcCircuit::setContactListener(void (*listener)(bool closed, uint64_t atUs)) {
+  contactListener = listener;
+}
+
+// --- 2. ADC ---
+
+/**
+ * @brief Standard normal sample (Box-Muller over a xorshift32 generator, so
+ * runs are reproducible for a given seed).
+ */
+double RcCircuit::gaussian() {
+  double u[2];
+  for (double& value : u) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    value = (rng + 1.0) / 4294967297.0;
+  }
+  return sqrt(-2.0 * log(u[0])) * cos(2.0 * M_PI * u[1]);
+}
+
+int RcCircuit::readAdcMv(uint64_t atUs) {
+  advanceTo(atUs);
+  double mv = senseMv();
+  if (cfg.adcNoiseLsb > 0) {
+    mv += gaussian() * cfg.adcNoiseLsb * adcLsbMv;
+  }
+  long code = lround(mv / adcLsbMv);
+  if (code < 0) code = 0;
+  if (code > adcMaxCode) code = adcMaxCode;
+  return (int)lround(code * adcLsbMv);
+}
+
+void RcCircuit::sampleStream(uint64_t fromUs, uint32_t periodUs, uint32_t count, uint16_t* out) {
+  for (uint32_t i = 0; i < count; i++) {
+    out[i] = (uint16_t)readAdcMv(fromUs + (uint64_t)i * periodUs);
+  }
+}
+
+// --- 3. SIMULATED HAL ---
+
+static RcCircuit* attached = nullptr;
+static int attachedChargePin = -1;
+static int attachedSensePin = -1;
+static int attachedDischargePin = -1;
+static int attachedContactPin = -1;
+
+static void onPin(int pin, int level, uint64_t atUs) {
+  if (!attached) {
+    return;
+  }
+  if (pin == attachedChargePin) {
+    attached->setDrive(level == HAL_HIGH, atUs);
+  } else if (pin == attachedDischargePin) {
+    attached->setDischarge(level == HAL_HIGH, atUs);
+  }
+}
+
+static void onContact(bool closed, uint64_t atUs) {
+  simSetPinLevelAt(attachedContactPin, closed ? HAL_LOW : HAL_HIGH, atUs);
+}
+
+static void onClock(uint64_t us) {
+  if (attached) {
+    attached->advanceTo(us);
+  }
+}
+
+static int readSense(int pin, uint64_t atUs) {
+  return attached && pin == attachedSensePin ? attached->readAdcMv(atUs) : 0;
+}
+
+void rcAttach(RcCircuit* circuit, int chargePin, int sensePin, int dischargePin, int contactPin) {
+  attached = circuit;
+  attachedChargePin = chargePin;
+  attachedSensePin = sensePin;
+  attachedDischargePin = dischargePin;
+  attachedContactPin = contactPin;
+  simRemovePinListener(onPin);
+  if (circuit) {
+    simAddPinListener(onPin);
+    simSetAnalogSource(readSense);
+    simSetClockListener(onClock);
+    if (contactPin >= 0) {
+      circuit->setContactListener(onContact);
+      simSetPinLevel(contactPin, circuit->contactClosed() ? HAL_LOW : HAL_HIGH);
+    }
+  } else {
+    simSetAnalogSource(nullptr);
+    simSetClockListener(nullptr);
+  }
+}
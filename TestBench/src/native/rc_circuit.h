@@ -0,0 +1,157 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Host-side model of the Scrooge circuit, standing in for the hardware in
+ * native tests:
+ *
+ *   supply --[ driver ]--[ R_series ]--+-- C --- GND
+ *              ^ CHARGE_PIN            |
+ *                                      +-- relay coil (R_coil) --- GND
+ *                                      |     contact: CONTACT_PIN --/ -- GND
+ *                                      +-- leakage (R_leak) ------ GND
+ *                                      +-- sense divider --------- GND
+ *                                      |          `-> ADC pin
+ *                                      +-- [ R_discharge ]--[ switch ]-- GND
+ *                                                              ^ DISCHARGE_PIN
+ *
+ * While CHARGE_PIN is HIGH the capacitor charges towards the supply through
+ * R_series; afterwards it discharges through the coil, the leakage and the
+ * divider. The relay contact closes once the capacitor voltage rises above
+ * the pull-in voltage (after the operate time) and opens again once it falls
+ * below the drop-out voltage (after the release time).
+ *
+ * Between drive changes the capacitor voltage is a single exponential, so the
+ * model is advanced analytically: the cost of a step does not depend on its
+ * length, and hours of self-discharge take microseconds to simulate. Only ADC
+ * samples cost time, one exp() each.
+ */
+
+struct RcCircuitConfig {
+  double supplyV;          // Charging supply behind the driver
+  double seriesOhm;        // Charge resistor plus driver on-resistance
+  double capacitanceF;
+  double leakageOhm;       // Capacitor self-discharge (dielectric leakage)
+  double coilOhm;          // Relay coil resistance; 0 for no coil (pure self-discharge)
+  double pullInV;          // Contact closes when the capacitor rises above this...
+  double dropOutV;         // ...and opens when it falls below this
+  uint32_t operateUs;      // Armature travel after reaching pull-in
+  uint32_t releaseUs;      // Armature travel after reaching drop-out
+  double dividerTopOhm;    // Sense divider from the capacitor to the ADC pin
+  double dividerBottomOhm;
+  double dischargeOhm;     // Bleed resistor switched by the discharge output
+  double adcFullScaleMv;   // ADC input range (ESP32 at 11 dB: ~3100 mV)
+  int adcBits;
+  double adcNoiseLsb;      // Gaussian noise, one standard deviation in LSB
+  uint32_t noiseSeed;
+};
+
+/**
+ * @brief A 5 V / 2200 uF bench charged through 4.7 ohm, with a 5 V, 70 ohm
+ * relay (75 % pull-in, 10 % drop-out), 2 Mohm leakage, a 1:2 sense divider
+ * and a 10 ohm discharge resistor.
+ */
+RcCircuitConfig rcDefaultConfig();
+
+class RcCircuit {
+public:
+  explicit RcCircuit(const RcCircuitConfig& config);
+
+  /**
+   * @brief Discharged capacitor, driver off and contact open at the given time.
+   */
+  void reset(uint64_t atUs);
+
+  /**
+   * @brief Switches the charge driver at the given time (advances to it first).
+   */
+  void setDrive(bool on, uint64_t atUs);
+
+  /**
+   * @brief Switches the discharge resistor at the given time.
+   */
+  void setDischarge(bool on, uint64_t atUs);
+
+  /**
+   * @brief Advances the model to the given time. Times before the current
+   * model time are ignored.
+   */
+  void advanceTo(uint64_t us);
+
+  /**
+   * @brief One ADC conversion at the given time, in millivolts at the ADC pin
+   * (quantised, with noise, clipped to the ADC range).
+   */
+  int readAdcMv(uint64_t atUs);
+
+  /**
+   * @brief Fills out[] with count ADC samples, one every periodUs, starting at fromUs.
+   */
+  void sampleStream(uint64_t fromUs, uint32_t periodUs, uint32_t count, uint16_t* out);
+
+  /**
+   * @brief Called on every contact transition with its exact time.
+   */
+  void setContactListener(void (*listener)(bool closed, uint64_t atUs));
+
+  double capacitorV() const { return voltage; }
+  double senseMv() const { return voltage * dividerRatio * 1000.0; }
+  bool driveOn() const { return drive; }
+  bool dischargeOn() const { return discharge; }
+
+  // Time the driver and the discharge switch were on together (shoot-through).
+  uint64_t overlapUs() const { return overlap; }
+  bool contactClosed() const { return contact; }
+  uint64_t timeUs() const { return nowUs; }
+
+  /**
+   * @brief Time constant and end voltage of the current segment.
+   */
+  double tauUs() const { return tauTable[drive][discharge]; }
+  double targetV() const { return targetTable[drive][discharge]; }
+
+  /**
+   * @brief Time from now until the capacitor reaches the voltage with the
+   * current drive, or a negative value if it never does.
+   */
+  double timeToVoltageUs(double volts) const;
+
+  const RcCircuitConfig& config() const { return cfg; }
+
+private:
+  void integrate(uint64_t toUs);
+  double gaussian();
+
+  RcCircuitConfig cfg;
+  double dividerRatio;
+  double tauTable[2][2];     // [drive][discharge]
+  double targetTable[2][2];
+  double adcLsbMv;
+  int adcMaxCode;
+
+  uint64_t nowUs;
+  double voltage;
+  bool drive;
+  bool discharge;
+  uint64_t overlap;
+  bool contact;
+  bool pending;           // A contact transition is in progress
+  uint64_t pendingAtUs;
+  uint32_t rng;
+  void (*contactListener)(bool, uint64_t);
+};
+
+/**
+ * @brief Connects a circuit to the simulated HAL: transitions of chargePin
+ * switch the driver, those of dischargePin (-1 for none) the discharge
+ * resistor, and halAnalogReadMilliVolts(sensePin) reads its ADC.
+ *
+ * With a contactPin the relay contact is wired to it as a switch to GND on a
+ * pulled-up input: closed reads LOW, open reads HIGH, and each edge lands at
+ * the contact's exact transition time as the clock moves. This takes over the
+ * circuit's contact listener.
+ *
+ * One circuit at a time; pass nullptr to detach.
+ */
+void rcAttach(RcCircuit* circuit, int chargePin, int sensePin, int dischargePin = -1, int contactPin = -1);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "hal/http.h"
+
+/*
+ * In-memory HttpExchange for driving API handlers off-target: the request is
+ * set up by the caller and the response is captured instead of sent.
+ */
+class RecordingExchange : public HttpExchange {
+public:
+  RecordingExchange(HttpMethod method, const std::string& uri) : requestMethod(method), requestUri(uri) {}
+
+  RecordingExchange& withArg(const std::string& name, const std::string& value) {
+    args[name] = value;
+    return *this;
+  }
+
+  RecordingExchange& withAccept(const std::string& value) {
+    acceptHeader = value;
+    return *this;
+  }
+
+  HttpMethod method() const override { return requestMethod; }
+  std::string uri() const override { return requestUri; }
+  bool hasArg(const char* name) const override { return args.count(name) != 0; }
+
+  std::string arg(const char* name) const override {
+    auto it = args.find(name);
+    return it == args.end() ? std::string() : it->second;
+  }
+
+  std::string_view accept() const override { return acceptHeader; }
+
+  void sendHeader(const char* name, const char* value) override {
+    headers[name] = value;
+  }
+
+  void send(int code, const char* contentType, const char* body, size_t length) override {
+    status = code;
+    responseType = contentType;
+    responseBody.assign(body, length);
+  }
+
+  using HttpExchange::send;
+
+  int status = 0;
+  std::string responseType;
+  std::string responseBody;
+  std::map<std::string, std::string> headers;
+
+private:
+  HttpMethod requestMethod;
+  std::string requestUri;
+  std::map<std::string, std::string> args;
+  std::string acceptHeader;
+};
+
+// Answers like a socket: counts the body bytes and keeps nothing.
+class DiscardingExchange : public HttpExchange {
+public:
+  HttpMethod method() const override { return HTTP_METHOD_GET; }
+  std::string uri() const override { return std::string(); }
+  bool hasArg(const char*) const override { return false; }
+  std::string arg(const char*) const override { return std::string(); }
+  std::string_view accept() const override { return acceptHeader; }
+  void sendHeader(const char*, const char*) override {}
+  void send(int code, const char*, const char*, size_t length) override {
+    status = code;
+    bytes += length;
+  }
+  using HttpExchange::send;
+
+  int status = 0;
+  size_t bytes = 0;
+  std::string acceptHeader;
+};
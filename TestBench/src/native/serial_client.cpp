@@ -0,0 +1,373 @@
+/*
+ * Host client for the serial control transport (include/core/serial_control.h).
+ *
+ * Talks to the ESP32 over its USB-UART, or to a virtual bench started with
+ * --serial over the pty it prints. Sends one command and prints the reply as
+ * JSON, downloads the last capture, or benchmarks command latency and capture
+ * download throughput. The device's log text, which shares the line, is
+ * copied to stderr.
+ *
+ *   serial_client [--device /dev/ttyUSB0] [--baud 921600] [--timeout-ms 500] [--retries 3]
+ *                 charge MS [TARGET_MV] | stop | state | capture
+ *   serial_client [...] bench [--commands 1000] [--downloads 20] [--target-mv 4000]
+ *
+ * A command without a reply within --timeout-ms is sent again with the same
+ * sequence number, up to --retries times.
+ *
+ * capture prints the sense readings of the last charge to a target, in mV.
+ * bench sends --commands commands, cycling through charge (100 ms), state and
+ * stop, then charges from empty to --target-mv to fill the capture and downloads it
+ * --downloads times, and reports latency (us) and throughput (bytes/s).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "core/serial_frame.h"
+#include "core/udp_frame.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// --- 1. CONFIGURATION ---
+
+struct Options {
+  std::string device = "/dev/ttyUSB0";
+  long baud = 921600;
+  int timeoutMs = 500;
+  int retries = 3;
+  long commands = 1000;
+  long downloads = 20;
+  long targetMv = 4000;
+};
+
+static Options options;
+
+static speed_t baudConstant(long baud) {
+  switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B0;
+  }
+}
+
+/**
+ * @brief Opens the port raw at the configured rate, discarding what is queued.
+ * @return The descriptor, or -1.
+ */
+static int openPort() {
+  int fd = open(options.device.c_str(), O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    return -1;
+  }
+  struct termios tty;
+  if (tcgetattr(fd, &tty) == 0) {
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, baudConstant(options.baud));
+    cfsetospeed(&tty, baudConstant(options.baud));
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tty);
+  }
+  tcflush(fd, TCIOFLUSH);
+  return fd;
+}
+
+// --- 2. LINE ---
+
+// Bytes since the last delimiter: a frame or log text, told apart by whether
+// they decode.
+static std::vector<uint8_t> segment;
+static uint64_t lineBytes = 0;
+
+// The last read; bytes after a frame's delimiter wait here for the next call.
+static uint8_t readBuffer[4096];
+static size_t readLength = 0;
+static size_t readAt = 0;
+
+static void writeLog(const std::vector<uint8_t>& text) {
+  if (!text.empty()) {
+    fwrite(text.data(), 1, text.size(), stderr);
+  }
+}
+
+/**
+ * @brief Reads until a complete frame arrives, copying log text to stderr.
+ * @return false on a timeout.
+ */
+static bool readFrame(int fd, std::vector<uint8_t>& payload, int timeoutMs) {
+  Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+  while (true) {
+    while (readAt < readLength) {
+      uint8_t byte = readBuffer[readAt++];
+      if (byte != SERIAL_FRAME_DELIMITER) {
+        segment.push_back(byte);
+        continue;
+      }
+      payload.resize(segment.size());
+      size_t length = 0;
+      if (!segment.empty() && serialFrameDecode(segment.data(), segment.size(), payload.data(), &length)) {
+        payload.resize(length);
+        segment.clear();
+        return true;
+      }
+      writeLog(segment);
+      segment.clear();
+    }
+    int leftMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+    struct pollfd readable = {fd, POLLIN, 0};
+    if (leftMs <= 0 || poll(&readable, 1, leftMs) <= 0) {
+      return false;
+    }
+    ssize_t n = read(fd, readBuffer, sizeof(readBuffer));
+    if (n < 0 && errno != EAGAIN && errno != EINTR) {
+      return false;
+    }
+    readLength = n > 0 ? (size_t)n : 0;
+    readAt = 0;
+    lineBytes += readLength;
+  }
+}
+
+static uint32_t nextSequence = 1;
+static uint64_t retriesSent = 0;
+
+/**
+ * @brief Sends a command frame and waits for its reply, resending on a timeout.
+ * @param reply Receives the reply's fields; samples holds a capture reply's samples.
+ * @return false if no reply arrived.
+ */
+static bool command(int fd, uint8_t opcode, uint32_t value0, uint32_t value1, UdpFrame& reply,
+                    std::vector<uint16_t>* samples = nullptr) {
+  UdpFrame request = {UDP_FRAME_VERSION, opcode, nextSequence++, 0, 0, 0, value0, value1};
+  uint8_t payload[UDP_FRAME_BYTES + SERIAL_CRC_BYTES];
+  uint8_t line[serialFrameBytes(UDP_FRAME_BYTES)];
+  udpFrameEncode(request, payload);
+  size_t length = serialFrameEncode(payload, UDP_FRAME_BYTES, line);
+  std::vector<uint8_t> received;
+  for (int attempt = 0; attempt <= options.retries; attempt++) {
+    if (attempt > 0) {
+      retriesSent++;
+    }
+    if (write(fd, line, length) != (ssize_t)length) {
+      return false;
+    }
+    // A late reply to an earlier command is skipped.
+    while (readFrame(fd, received, options.timeoutMs)) {
+      if (udpFrameDecode(received.data(), received.size(), reply) && reply.sequence == request.sequence &&
+          reply.opcode == (opcode | UDP_REPLY)) {
+        if (samples) {
+          for (size_t i = UDP_FRAME_BYTES; i + 1 < received.size(); i += 2) {
+            samples->push_back((uint16_t)(received[i] | received[i + 1] << 8));
+          }
+        }
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Downloads the whole capture in chunks.
+ * @return false if a chunk went unanswered.
+ */
+static bool downloadCapture(int fd, std::vector<uint16_t>& samples) {
+  samples.clear();
+  UdpFrame reply;
+  do {
+    size_t before = samples.size();
+    if (!command(fd, UDP_OP_CAPTURE, (uint32_t)samples.size(), 0, reply, &samples)) {
+      return false;
+    }
+    if (samples.size() == before) {
+      break;
+    }
+  } while (samples.size() < reply.value1);
+  return true;
+}
+
+static const char* statusName(uint8_t status) {
+  switch (status) {
+    case UDP_STATUS_OK: return "ok";
+    case UDP_STATUS_CONFLICT: return "conflict";
+    case UDP_STATUS_INVALID: return "invalid";
+    case UDP_STATUS_BAD_FRAME: return "bad_frame";
+    default: return "unknown";
+  }
+}
+
+static void printReply(const UdpFrame& reply) {
+  printf("{\"sequence\":%u, \"status\":\"%s\", \"charging\":%s, \"gpio_level\":\"%s\", \"cycles\":%s, "
+         "\"sweep\":%s, \"estop\":%s, \"last_end\":%u, \"value0\":%u, \"value1\":%u}\n",
+         reply.sequence, statusName(reply.status), reply.flags & UDP_FLAG_CHARGING ? "true" : "false",
+         reply.flags & UDP_FLAG_PIN_HIGH ? "HIGH" : "LOW", reply.flags & UDP_FLAG_CYCLES ? "true" : "false",
+         reply.flags & UDP_FLAG_SWEEP ? "true" : "false", reply.flags & UDP_FLAG_ESTOP ? "true" : "false",
+         (unsigned)reply.endReason, reply.value0, reply.value1);
+}
+
+// --- 3. BENCHMARK ---
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+static uint32_t elapsedUs(Clock::time_point since) {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - since).count();
+}
+
+static int bench(int fd) {
+  static const uint8_t sequence[] = {UDP_OP_CHARGE, UDP_OP_STATE, UDP_OP_STOP};
+  UdpFrame reply;
+  command(fd, UDP_OP_STOP, 0, 0, reply);
+  std::vector<uint32_t> latencyUs;
+  uint64_t errors = 0;
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < options.commands; i++) {
+    uint8_t opcode = sequence[i % 3];
+    Clock::time_point sent = Clock::now();
+    bool ok = command(fd, opcode, opcode == UDP_OP_CHARGE ? 100 : 0, 0, reply);
+    latencyUs.push_back(elapsedUs(sent));
+    if (!ok || reply.status != UDP_STATUS_OK) errors++;
+  }
+  double commandSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  command(fd, UDP_OP_STOP, 0, 0, reply);
+  std::sort(latencyUs.begin(), latencyUs.end());
+
+  // Fill the capture: let the capacitor discharge, charge to the target and
+  // wait for the cutoff.
+  usleep(500000);
+  if (!command(fd, UDP_OP_CHARGE, 0, (uint32_t)options.targetMv, reply) || reply.status != UDP_STATUS_OK) {
+    fprintf(stderr, "serial_client: charge to %ld mV refused\n", options.targetMv);
+    return 1;
+  }
+  do {
+    usleep(10000);
+  } while (command(fd, UDP_OP_STATE, 0, 0, reply) && (reply.flags & UDP_FLAG_CHARGING));
+
+  std::vector<uint16_t> samples;
+  uint64_t downloadErrors = 0;
+  uint64_t lineBefore = lineBytes;
+  start = Clock::now();
+  for (long i = 0; i < options.downloads; i++) {
+    if (!downloadCapture(fd, samples)) downloadErrors++;
+  }
+  double downloadSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  double sampleBytes = 2.0 * samples.size() * options.downloads;
+
+  printf("{\"commands\":%ld, \"commands_per_s\":%.0f, \"errors\":%llu, \"retries\":%llu, "
+         "\"latency_us\":{\"min\":%u, \"p50\":%u, \"p90\":%u, \"p99\":%u, \"max\":%u}, "
+         "\"capture\":{\"samples\":%zu, \"downloads\":%ld, \"errors\":%llu, \"ms_per_download\":%.2f, "
+         "\"sample_bytes_per_s\":%.0f, \"line_bytes_per_s\":%.0f}}\n",
+         options.commands, options.commands / commandSeconds, (unsigned long long)errors,
+         (unsigned long long)retriesSent, latencyUs.front(), percentile(latencyUs, 50), percentile(latencyUs, 90),
+         percentile(latencyUs, 99), latencyUs.back(), samples.size(), options.downloads,
+         (unsigned long long)downloadErrors, downloadSeconds * 1000 / options.downloads, sampleBytes / downloadSeconds,
+         (lineBytes - lineBefore) / downloadSeconds);
+  return errors || downloadErrors ? 3 : 0;
+}
+
+// --- 4. MAIN ---
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [--device PATH] [--baud 921600] [--timeout-ms MS] [--retries N]\n"
+          "          charge MS [TARGET_MV] | stop | state | capture\n"
+          "          bench [--commands N] [--downloads N] [--target-mv MV]\n",
+          program);
+}
+
+int main(int argc, char** argv) {
+  int i = 1;
+  for (; i + 1 < argc && strncmp(argv[i], "--", 2) == 0; i += 2) {
+    const char* flag = argv[i];
+    const char* value = argv[i + 1];
+    if (strcmp(flag, "--device") == 0) options.device = value;
+    else if (strcmp(flag, "--baud") == 0) options.baud = atol(value);
+    else if (strcmp(flag, "--timeout-ms") == 0) options.timeoutMs = atoi(value);
+    else if (strcmp(flag, "--retries") == 0) options.retries = atoi(value);
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (i >= argc || baudConstant(options.baud) == B0) {
+    usage(argv[0]);
+    return 2;
+  }
+  const char* verb = argv[i++];
+
+  int fd = openPort();
+  if (fd < 0) {
+    fprintf(stderr, "serial_client: cannot open %s: %s\n", options.device.c_str(), strerror(errno));
+    return 1;
+  }
+  // Sequence numbers start where the last run's probably did not.
+  nextSequence = (uint32_t)std::chrono::system_clock::now().time_since_epoch().count();
+
+  UdpFrame reply;
+  bool ok;
+  int result = 0;
+  if (strcmp(verb, "charge") == 0 && i < argc) {
+    uint32_t durationMs = (uint32_t)strtoul(argv[i], nullptr, 10);
+    uint32_t targetMv = i + 1 < argc ? (uint32_t)strtoul(argv[i + 1], nullptr, 10) : 0;
+    ok = command(fd, UDP_OP_CHARGE, durationMs, targetMv, reply);
+  } else if (strcmp(verb, "stop") == 0) {
+    ok = command(fd, UDP_OP_STOP, 0, 0, reply);
+  } else if (strcmp(verb, "state") == 0) {
+    ok = command(fd, UDP_OP_STATE, 0, 0, reply);
+  } else if (strcmp(verb, "capture") == 0) {
+    std::vector<uint16_t> samples;
+    ok = downloadCapture(fd, samples);
+    if (ok) {
+      std::string json = "{\"samples\":" + std::to_string(samples.size()) + ", \"mv\":[";
+      for (size_t j = 0; j < samples.size(); j++) {
+        json += (j ? "," : "") + std::to_string(samples[j]);
+      }
+      printf("%s]}\n", json.c_str());
+      reply.status = UDP_STATUS_OK;
+    }
+  } else if (strcmp(verb, "bench") == 0) {
+    for (; i + 1 < argc; i += 2) {
+      if (strcmp(argv[i], "--commands") == 0) options.commands = atol(argv[i + 1]);
+      else if (strcmp(argv[i], "--downloads") == 0) options.downloads = atol(argv[i + 1]);
+      else if (strcmp(argv[i], "--target-mv") == 0) options.targetMv = atol(argv[i + 1]);
+      else break;
+    }
+    if (i < argc || options.commands <= 0 || options.downloads <= 0) {
+      usage(argv[0]);
+      return 2;
+    }
+    result = bench(fd);
+    close(fd);
+    return result;
+  } else {
+    usage(argv[0]);
+    return 2;
+  }
+  writeLog(segment);
+  close(fd);
+
+  if (!ok) {
+    fprintf(stderr, "serial_client: no reply on %s\n", options.device.c_str());
+    return 1;
+  }
+  if (strcmp(verb, "capture") != 0) {
+    printReply(reply);
+  }
+  return reply.status == UDP_STATUS_OK ? 0 : 3;
+}
@@ -0,0 +1,230 @@
+// Native implementation of the clock, GPIO, ADC, logging and serial HAL (see include/hal/).
+
+#include "sim_hal.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "hal/adc.h"
+#include "hal/clock.h"
+#include "hal/gpio.h"
+#include "hal/log.h"
+#include "hal/serial.h"
+
+static uint64_t nowUs = 0;
+static int levels[SIM_PIN_COUNT];
+static SimPinListener pinListeners[SIM_MAX_PIN_LISTENERS];
+static HalEdgeCallback edgeCallbacks[SIM_PIN_COUNT];
+static int (*analogSource)(int, uint64_t) = nullptr;
+static void (*clockListener)(uint64_t) = nullptr;
+
+static int samplerPin = -1;
+static uint32_t samplerPeriodUs = 0;
+static uint64_t nextSampleUs = 0;
+static HalSampleCallback samplerCallback = nullptr;
+
+/**
+ * @brief Moves the clock, firing every sampler tick on the way at its exact
+ * virtual time.
+ */
+static void moveClock(uint64_t us) {
+  if (us < nowUs) {
+    nowUs = us;
+    nextSampleUs = us + samplerPeriodUs;
+    return;
+  }
+  while (samplerCallback && nextSampleUs <= us) {
+    nowUs = nextSampleUs;
+    nextSampleUs += samplerPeriodUs;
+    samplerCallback(halAnalogReadMilliVolts(samplerPin), nowUs);
+  }
+  nowUs = us;
+  if (clockListener) {
+    clockListener(us);
+  }
+}
+static bool logEnabled = true;
+static int serialFd = -1;
+
+void simSetTimeUs(uint64_t us) {
+  moveClock(us);
+}
+
+void simAdvanceUs(uint64_t us) {
+  moveClock(nowUs + us);
+}
+
+uint64_t simTimeUs() {
+  return nowUs;
+}
+
+bool simAddPinListener(SimPinListener listener) {
+  for (SimPinListener& slot : pinListeners) {
+    if (!slot) {
+      slot = listener;
+      return true;
+    }
+  }
+  return false;
+}
+
+void simRemovePinListener(SimPinListener listener) {
+  for (SimPinListener& slot : pinListeners) {
+    if (slot == listener) {
+      slot = nullptr;
+    }
+  }
+}
+
+void simSetAnalogSource(int (*source)(int pin, uint64_t atUs)) {
+  analogSource = source;
+}
+
+void simSetPinLevel(int pin, int level) {
+  simSetPinLevelAt(pin, level, nowUs);
+}
+
+void simSetPinLevelAt(int pin, int level, uint64_t atUs) {
+  if (pin < 0 || pin >= SIM_PIN_COUNT || levels[pin] == level) {
+    return;
+  }
+  levels[pin] = level;
+  for (SimPinListener listener : pinListeners) {
+    if (listener) {
+      listener(pin, level, atUs);
+    }
+  }
+  if (edgeCallbacks[pin]) {
+    edgeCallbacks[pin](level, atUs);
+  }
+}
+
+void simSetClockListener(void (*listener)(uint64_t us)) {
+  clockListener = listener;
+}
+
+void simSetLogEnabled(bool enabled) {
+  logEnabled = enabled;
+}
+
+void simSerialAttach(int fd) {
+  serialFd = fd;
+}
+
+uint32_t halMillis() {
+  return (uint32_t)(nowUs / 1000);
+}
+
+uint64_t halMicros() {
+  return nowUs;
+}
+
+void halPinOutput(int pin) {
+  (void)pin;
+}
+
+void halPinInput(int pin, bool pullUp) {
+  // Nothing drives a floating input in the simulation; a pull-up reads HIGH.
+  if (pin >= 0 && pin < SIM_PIN_COUNT && pullUp) {
+    levels[pin] = HAL_HIGH;
+  }
+}
+
+void halDigitalWrite(int pin, int level) {
+  simSetPinLevel(pin, level);
+}
+
+void halDigitalWriteFromIsr(int pin, int level) {
+  simSetPinLevel(pin, level);
+}
+
+int halDigitalRead(int pin) {
+  return pin >= 0 && pin < SIM_PIN_COUNT ? levels[pin] : HAL_LOW;
+}
+
+bool halAttachEdgeInterrupt(int pin, HalEdgeCallback callback) {
+  if (pin < 0 || pin >= SIM_PIN_COUNT || !callback) {
+    return false;
+  }
+  edgeCallbacks[pin] = callback;
+  return true;
+}
+
+void halDetachEdgeInterrupt(int pin) {
+  if (pin >= 0 && pin < SIM_PIN_COUNT) {
+    edgeCallbacks[pin] = nullptr;
+  }
+}
+
+int halAnalogReadMilliVolts(int pin) {
+  return analogSource ? analogSource(pin, nowUs) : 0;
+}
+
+bool halSamplerStart(int pin, uint32_t periodUs, HalSampleCallback callback) {
+  if (periodUs == 0) {
+    return false;
+  }
+  samplerPin = pin;
+  samplerPeriodUs = periodUs;
+  samplerCallback = callback;
+  nextSampleUs = nowUs + periodUs;
+  return true;
+}
+
+void halSamplerStop() {
+  samplerCallback = nullptr;
+}
+
+void halLog(const char* format, ...) {
+  if (!logEnabled && serialFd < 0) {
+    return;
+  }
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (n < 0) {
+    return;
+  }
+  size_t length = (size_t)n < sizeof(buffer) ? (size_t)n : sizeof(buffer) - 1;
+  if (logEnabled) {
+    fwrite(buffer, 1, length, stdout);
+  }
+  // As on the ESP32, the log shares the serial line with control frames.
+  halSerialWrite((const uint8_t*)buffer, length);
+}
+
+size_t halSerialRead(uint8_t* buffer, size_t capacity) {
+  if (serialFd < 0) {
+    return 0;
+  }
+  ssize_t n = read(serialFd, buffer, capacity);
+  return n > 0 ? (size_t)n : 0;
+}
+
+void halSerialWrite(const uint8_t* data, size_t length) {
+  // Like a UART without flow control, nothing waits for a reader: with the
+  // other end's buffer full the write is lost. One that has started is
+  // given 100 ms to finish, so frames are not cut.
+  bool started = false;
+  while (serialFd >= 0 && length > 0) {
+    ssize_t n = write(serialFd, data, length);
+    if (n > 0) {
+      data += n;
+      length -= n;
+      started = true;
+      continue;
+    }
+    if (!started || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return;
+    }
+    struct pollfd writable = {serialFd, POLLOUT, 0};
+    if (poll(&writable, 1, 100) <= 0) {
+      return;
+    }
+  }
+}
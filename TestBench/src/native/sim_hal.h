@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Simulated clock, GPIO and ADC for the native build.
+ *
+ * The virtual clock starts at 0 and only moves when the simulation advances
+ * it, in microseconds. halMillis() is derived from it and truncated to 32 bits
+ * exactly like Arduino's millis(), so setting the clock near
+ * SIM_MILLIS_WRAP_US reproduces the 49.7-day overflow.
+ */
+
+// Virtual time at which halMillis() wraps from 0xFFFFFFFF back to 0.
+const uint64_t SIM_MILLIS_WRAP_US = (uint64_t)0x100000000ULL * 1000ULL;
+
+const int SIM_PIN_COUNT = 40;
+const int SIM_MAX_PIN_LISTENERS = 4;
+
+/**
+ * @brief Moves the virtual clock. Moving forward fires every halSamplerStart()
+ * tick that falls due on the way, each at its own virtual time.
+ */
+void simSetTimeUs(uint64_t us);
+void simAdvanceUs(uint64_t us);
+uint64_t simTimeUs();
+
+typedef void (*SimPinListener)(int pin, int level, uint64_t atUs);
+
+/**
+ * @brief Registers a callback for every simulated pin transition, with its
+ * virtual timestamp. Up to SIM_MAX_PIN_LISTENERS, called in registration order.
+ * @return false if all slots are taken.
+ */
+bool simAddPinListener(SimPinListener listener);
+void simRemovePinListener(SimPinListener listener);
+
+/**
+ * @brief Drives a pin from "outside", e.g. a test fixture or a circuit model.
+ * Listeners and halAttachEdgeInterrupt() callbacks see the transition at the
+ * current virtual time, or at atUs for an edge that a model places exactly.
+ */
+void simSetPinLevel(int pin, int level);
+void simSetPinLevelAt(int pin, int level, uint64_t atUs);
+
+/**
+ * @brief Called after every clock move with the new time, so a model can
+ * catch up and report the transitions it passed (e.g. a relay drop-out) even
+ * when nothing else touches it. One listener; nullptr to remove it.
+ */
+void simSetClockListener(void (*listener)(uint64_t us));
+
+/**
+ * @brief Supplies halAnalogReadMilliVolts(), e.g. from a circuit model.
+ * Without a source every ADC pin reads 0 mV.
+ */
+void simSetAnalogSource(int (*source)(int pin, uint64_t atUs));
+
+void simSetLogEnabled(bool enabled);
+
+/**
+ * @brief Connects the serial HAL to a non-blocking file descriptor, e.g. a pty
+ * master; -1 disconnects it. halLog() output goes there too, whether or not
+ * logging to stdout is enabled.
+ */
+void simSerialAttach(int fd);
@@ -0,0 +1,223 @@
+/*
+ * Host benchmark of the charge control logic.
+ *
+ * Runs the platform-independent core against the simulated clock and GPIO and
+ * prints the host wall-clock cost of the hot paths: route lookup at 10, 50 and
+ * 200 routes, request parsing against a std::string/std::map parser, response
+ * size and encoding time per format, and how fast the virtual clock covers a
+ * charge in 1 us steps.
+ *
+ * Numbers only; the correctness checks are in checks.cpp (pio run -e native -t exec).
+ *
+ * Build and run: pio run -e native_bench -t exec
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "core/api.h"
+#include "core/charge_control.h"
+#include "core/cycle_stats.h"
+#include "core/http_request.h"
+#include "core/request_arena.h"
+#include "core/route_trie.h"
+#include "core/routes.h"
+#include "core/serial_frame.h"
+#include "core/udp_control.h"
+#include "native_support.h"
+#include "recording_exchange.h"
+#include "sim_hal.h"
+
+template <typename F>
+static double nsPerCall(F fn, int iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+// The request parser HttpServer used before parsing in place: copies into
+// std::string and std::map, decoding into fresh strings.
+static void legacyParseArgs(const std::string& text, std::map<std::string, std::string>& args) {
+  auto decode = [](const std::string& in) {
+    std::string out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+      if (in[i] == '%' && i + 2 < in.size() && isxdigit((uint8_t)in[i + 1]) && isxdigit((uint8_t)in[i + 2])) {
+        out += (char)strtol(in.substr(i + 1, 2).c_str(), nullptr, 16);
+        i += 2;
+      } else {
+        out += in[i] == '+' ? ' ' : in[i];
+      }
+    }
+    return out;
+  };
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('&', start);
+    if (end == std::string::npos) end = text.size();
+    std::string pair = text.substr(start, end - start);
+    if (!pair.empty()) {
+      size_t eq = pair.find('=');
+      std::string value = eq == std::string::npos ? std::string() : decode(pair.substr(eq + 1));
+      args.insert(std::make_pair(decode(pair.substr(0, eq)), value));
+    }
+    start = end + 1;
+  }
+}
+
+static size_t legacyParse(const std::string& data) {
+  size_t headerEnd = data.find("\r\n\r\n");
+  size_t lineEnd = data.find("\r\n");
+  std::string requestLine = data.substr(0, lineEnd);
+  size_t sp1 = requestLine.find(' ');
+  size_t sp2 = requestLine.find(' ', sp1 + 1);
+  std::string method = requestLine.substr(0, sp1);
+  std::string target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+  size_t question = target.find('?');
+  std::string path = target.substr(0, question);
+  std::map<std::string, std::string> args;
+  if (question != std::string::npos) {
+    legacyParseArgs(target.substr(question + 1), args);
+  }
+  size_t contentLength = 0;
+  size_t pos = lineEnd + 2;
+  while (pos < headerEnd) {
+    size_t end = data.find("\r\n", pos);
+    std::string line = data.substr(pos, end - pos);
+    pos = end + 2;
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) continue;
+    std::string value = line.substr(colon + 1);
+    while (!value.empty() && value[0] == ' ') value.erase(0, 1);
+    if (strcasecmp(line.substr(0, colon).c_str(), "Content-Length") == 0) {
+      contentLength = strtoul(value.c_str(), nullptr, 10);
+    }
+  }
+  return args.size() + path.size() + method.size() + contentLength;
+}
+
+static void benchmark() {
+  printf("Host cost per call\n");
+  const int N = 2000000;
+
+  simSetTimeUs(SIM_MILLIS_WRAP_US - 1000);
+  printf("  chargeMonitor() idle           %8.1f ns\n", nsPerCall([] { chargeMonitor(); }, N));
+
+  chargeStart(CHARGE_MAX_MS);
+  printf("  chargeMonitor() charging       %8.1f ns\n", nsPerCall([] { chargeMonitor(); }, N));
+  printf("  chargeRemainingMs()            %8.1f ns\n", nsPerCall([] { chargeRemainingMs(); }, N));
+  printf("  handleState() charging         %8.1f ns\n", nsPerCall([] {
+    RecordingExchange http(HTTP_METHOD_GET, "/state");
+    handleState(http);
+  }, N / 10));
+  printf("  udpControlHandle() state       %8.1f ns\n", nsPerCall([] { udpCommand(UDP_OP_STATE, 1, 0, 0); }, N / 10));
+  chargeStop();
+
+  static uint8_t chunk[UDP_REPLY_MAX_BYTES + SERIAL_CRC_BYTES];
+  static uint8_t chunkLine[serialFrameBytes(UDP_REPLY_MAX_BYTES)];
+  for (size_t i = 0; i < UDP_REPLY_MAX_BYTES; i++) chunk[i] = (uint8_t)(i * 31);
+  printf("  serialFrameEncode() chunk      %8.1f ns\n", nsPerCall([] {
+    serialFrameEncode(chunk, UDP_REPLY_MAX_BYTES, chunkLine);
+  }, N / 100));
+
+  uint32_t state = 1;
+  printf("  statsRecord()                  %8.1f ns\n", nsPerCall([&state] {
+    statsRecord(STATS_HOLDUP_US, skewedSample(state));
+  }, N));
+  statsReset();
+
+  printf("  handleCharge() 400 path        %8.1f ns\n", nsPerCall([] {
+    RecordingExchange http(HTTP_METHOD_GET, "/charge");
+    http.withArg("time", "abc");
+    handleCharge(http);
+  }, N / 10));
+
+  // Route lookup, averaged over every route of a table shaped like a larger API:
+  // "/api/groupG/resourceI" with GET and POST, ten resources per group.
+  for (size_t size : {10, 50, 200}) {
+    std::vector<std::string> uris;
+    for (size_t i = 0; i < size; i++) {
+      uris.push_back("/api/group" + std::to_string(i / 10) + "/resource" + std::to_string(i));
+    }
+    std::vector<ApiRoute> routes;
+    for (size_t i = 0; i < size; i++) {
+      routes.push_back(apiRoute(uris[i].c_str(), i % 2 ? HTTP_METHOD_POST : HTTP_METHOD_GET, noopHandler));
+    }
+    RouteTrie trie(trieNodes, TRIE_NODES, trieSlots, 2 * TRIE_NODES);
+    trie.add(routes.data(), routes.size());
+
+    size_t next = 0;
+    double linearNs = nsPerCall([&] {
+      const ApiRoute& route = routes[next++ % size];
+      routeSink = (uintptr_t)linearFind(routes.data(), size, route.uri, route.method);
+    }, N / 4);
+    double trieNs = nsPerCall([&] {
+      const ApiRoute& route = routes[next++ % size];
+      RouteMatch match;
+      trie.find(route.uri, route.method, match);
+      routeSink = (uintptr_t)match.route;
+    }, N / 4);
+    printf("  route lookup, %3zu routes        linear %7.1f ns, trie %5.1f ns\n", size, linearNs, trieNs);
+  }
+
+  // Parsing the head of a /sweeps request with six arguments. The in-place
+  // parser's cost includes copying the request into its buffer, as recv() does.
+  std::string raw = SWEEP_REQUEST;
+  static char buffer[sizeof(SWEEP_REQUEST)];
+  size_t before = heapAllocations;
+  double legacyNs = nsPerCall([&] { routeSink = legacyParse(raw); }, N / 20);
+  double legacyAllocations = (double)(heapAllocations - before) / (N / 20);
+  before = heapAllocations;
+  double inPlaceNs = nsPerCall([&] {
+    RequestView request;
+    parseCopy(raw, request, buffer);
+    routeSink = request.argCount;
+  }, N / 20);
+  double inPlaceAllocations = (double)(heapAllocations - before) / (N / 20);
+  printf("  request parse, std::string/map %8.1f ns, %4.1f allocations\n", legacyNs, legacyAllocations);
+  printf("  request parse, in place        %8.1f ns, %4.1f allocations\n", inPlaceNs, inPlaceAllocations);
+
+  // Response size and the handler's time to build it, per format.
+  static const char* FORMAT_PATHS[] = {"/state", "/health", "/holdup", "/sweeps/results"};
+  static const char* ACCEPT[] = {"application/json", "application/cbor", "application/msgpack"};
+  RouteTrie formatTrie(trieNodes, TRIE_NODES, trieSlots, 2 * TRIE_NODES);
+  formatTrie.add(CORE_ROUTES, CORE_ROUTE_COUNT);
+  for (const char* path : FORMAT_PATHS) {
+    RouteMatch match;
+    formatTrie.find(path, HTTP_METHOD_GET, match);
+    printf("  %-16s", path);
+    for (int format = 0; format < 3; format++) {
+      DiscardingExchange http;
+      http.acceptHeader = ACCEPT[format];
+      double ns = nsPerCall([&] {
+        http.bytes = 0;
+        match.route->handler(http);
+        arenaFinishRequest(match.route);
+      }, N / 100);
+      printf("%s %5zu B %6.0f ns", format == 0 ? " JSON" : (format == 1 ? ", CBOR" : ", MessagePack"), http.bytes, ns);
+    }
+    printf("\n");
+  }
+
+  // Virtual time throughput: how fast the simulation covers a charge in 1 us steps.
+  auto start = std::chrono::steady_clock::now();
+  uint64_t widthUs = 0;
+  uint64_t steps = 0;
+  runPulse(SIM_MILLIS_WRAP_US - 30000000, CHARGE_MAX_MS, &widthUs, &steps);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("  simulated 60 s in 1 us steps   %8.3f s wall (%.0fx real time)\n", seconds, 60.0 / seconds);
+}
+
+int main() {
+  nativeBegin();
+  benchmark();
+  return 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * Host client for the UDP control protocol (include/core/udp_control.h).
+ *
+ * Sends one command and prints the reply as JSON, or benchmarks the protocol
+ * against the HTTP API on the same device or virtual bench (bench_server).
+ *
+ *   udp_client [--host 127.0.0.1] [--port 4211] [--timeout-ms 200] [--retries 3]
+ *              charge MS [TARGET_MV] | stop | state
+ *   udp_client [...] bench [--commands 3000] [--charge-ms 100] [--http-port 80]
+ *
+ * A command without a reply within --timeout-ms is sent again with the same
+ * sequence number, up to --retries times; the device answers a repeat from
+ * its last reply, so a charge is never started twice.
+ *
+ * bench sends --commands commands, cycling through charge (--charge-ms),
+ * state and stop, one at a time, and reports the round-trip latency (us) and
+ * commands per second. With --http-port the same sequence is then sent as
+ * /charge, /state and /stop requests, on one keep-alive connection and with a
+ * new connection per request.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "core/udp_frame.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+// --- 1. CONFIGURATION ---
+
+struct Options {
+  std::string host = "127.0.0.1";
+  std::string port = "4211";
+  int timeoutMs = 200;
+  int retries = 3;
+  long commands = 3000;
+  long chargeMs = 100;
+  std::string httpPort;  // Empty: no HTTP comparison
+};
+
+static Options options;
+
+static void setTimeout(int fd, int timeoutMs) {
+  struct timeval timeout;
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_usec = (timeoutMs % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+/**
+ * @brief Resolves host:port and connects a socket of the given type to it.
+ * @return The socket, or -1.
+ */
+static int connectTo(const std::string& port, int type) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = type;
+  struct addrinfo* address = nullptr;
+  if (getaddrinfo(options.host.c_str(), port.c_str(), &hints, &address) != 0) {
+    return -1;
+  }
+  int fd = socket(address->ai_family, type, 0);
+  if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) < 0) {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(address);
+  if (fd >= 0) {
+    setTimeout(fd, options.timeoutMs);
+  }
+  if (fd >= 0 && type == SOCK_STREAM) {
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  }
+  return fd;
+}
+
+// --- 2. UDP ---
+
+static uint32_t nextSequence = 1;
+static uint64_t retriesSent = 0;
+
+/**
+ * @brief Sends a command and waits for its reply, resending on a timeout.
+ * @return false if no reply arrived.
+ */
+static bool command(int fd, uint8_t opcode, uint32_t value0, uint32_t value1, UdpFrame& reply) {
+  UdpFrame request = {UDP_FRAME_VERSION, opcode, nextSequence++, 0, 0, 0, value0, value1};
+  uint8_t frame[UDP_FRAME_BYTES];
+  udpFrameEncode(request, frame);
+  for (int attempt = 0; attempt <= options.retries; attempt++) {
+    if (attempt > 0) {
+      retriesSent++;
+    }
+    if (send(fd, frame, sizeof(frame), 0) < 0) {
+      return false;
+    }
+    uint8_t datagram[UDP_FRAME_BYTES + 1];
+    ssize_t n;
+    // A late reply to an earlier command is skipped.
+    while ((n = recv(fd, datagram, sizeof(datagram), 0)) >= 0) {
+      if (udpFrameDecode(datagram, n, reply) && reply.sequence == request.sequence &&
+          reply.opcode == (opcode | UDP_REPLY)) {
+        return true;
+      }
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      return false;
+    }
+  }
+  return false;
+}
+
+static const char* statusName(uint8_t status) {
+  switch (status) {
+    case UDP_STATUS_OK: return "ok";
+    case UDP_STATUS_CONFLICT: return "conflict";
+    case UDP_STATUS_INVALID: return "invalid";
+    case UDP_STATUS_BAD_FRAME: return "bad_frame";
+    default: return "unknown";
+  }
+}
+
+static void printReply(const UdpFrame& reply) {
+  printf("{\"sequence\":%u, \"status\":\"%s\", \"charging\":%s, \"gpio_level\":\"%s\", \"cycles\":%s, "
+         "\"sweep\":%s, \"estop\":%s, \"last_end\":%u, \"value0\":%u, \"value1\":%u}\n",
+         reply.sequence, statusName(reply.status), reply.flags & UDP_FLAG_CHARGING ? "true" : "false",
+         reply.flags & UDP_FLAG_PIN_HIGH ? "HIGH" : "LOW", reply.flags & UDP_FLAG_CYCLES ? "true" : "false",
+         reply.flags & UDP_FLAG_SWEEP ? "true" : "false", reply.flags & UDP_FLAG_ESTOP ? "true" : "false",
+         (unsigned)reply.endReason, reply.value0, reply.value1);
+}
+
+// --- 3. HTTP ---
+
+/**
+ * @brief Sends one request and reads the response by its Content-Length.
+ * @param closed Set if the server closes the connection after the response.
+ * @return The status code, or -1.
+ */
+static int httpExchange(int fd, const std::string& request, bool* closed) {
+  if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size()) {
+    return -1;
+  }
+  std::string response;
+  size_t headerEnd;
+  char buffer[2048];
+  while ((headerEnd = response.find("\r\n\r\n")) == std::string::npos) {
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) return -1;
+    response.append(buffer, n);
+  }
+  const char* length = strcasestr(response.c_str(), "\r\nContent-Length:");
+  size_t total = headerEnd + 4 + (length ? atol(length + 17) : 0);
+  while (response.size() < total) {
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) return -1;
+    response.append(buffer, n);
+  }
+  *closed = strcasestr(response.c_str(), "\r\nConnection: close\r\n") != nullptr;
+  size_t space = response.find(' ');
+  return space == std::string::npos ? -1 : atoi(response.c_str() + space + 1);
+}
+
+// --- 4. BENCHMARK ---
+
+struct Run {
+  std::vector<uint32_t> latencyUs;
+  double seconds = 0;
+  uint64_t errors = 0;  // No reply, or not ok / 200
+};
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+static void appendRun(std::string& json, const char* name, Run& run) {
+  std::sort(run.latencyUs.begin(), run.latencyUs.end());
+  double sum = 0;
+  for (uint32_t v : run.latencyUs) sum += v;
+  const std::vector<uint32_t>& sorted = run.latencyUs;
+  char text[384];
+  snprintf(text, sizeof(text),
+           ", \"%s\":{\"commands_per_s\":%.0f, \"errors\":%llu, \"latency_us\":{\"min\":%u, \"mean\":%.1f, "
+           "\"p50\":%u, \"p90\":%u, \"p99\":%u, \"max\":%u}}",
+           name, run.seconds > 0 ? sorted.size() / run.seconds : 0.0, (unsigned long long)run.errors,
+           sorted.empty() ? 0 : sorted.front(), sorted.empty() ? 0.0 : sum / sorted.size(), percentile(sorted, 50),
+           percentile(sorted, 90), percentile(sorted, 99), sorted.empty() ? 0 : sorted.back());
+  json += text;
+}
+
+static Run benchUdp(int fd) {
+  static const uint8_t sequence[] = {UDP_OP_CHARGE, UDP_OP_STATE, UDP_OP_STOP};
+  Run run;
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < options.commands; i++) {
+    uint8_t opcode = sequence[i % 3];
+    UdpFrame reply;
+    Clock::time_point sent = Clock::now();
+    bool ok = command(fd, opcode, opcode == UDP_OP_CHARGE ? options.chargeMs : 0, 0, reply);
+    run.latencyUs.push_back(
+        (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - sent).count());
+    if (!ok || reply.status != UDP_STATUS_OK) run.errors++;
+  }
+  run.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return run;
+}
+
+static Run benchHttp(bool keepAlive) {
+  std::string host = "Host: " + options.host + "\r\n";
+  std::string connection = keepAlive ? "" : "Connection: close\r\n";
+  const std::string requests[] = {
+      "GET /charge?time=" + std::to_string(options.chargeMs) + " HTTP/1.1\r\n" + host + connection + "\r\n",
+      "GET /state HTTP/1.1\r\n" + host + connection + "\r\n",
+      "POST /stop HTTP/1.1\r\n" + host + connection + "Content-Length: 0\r\n\r\n",
+  };
+  Run run;
+  int fd = -1;
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < options.commands; i++) {
+    Clock::time_point sent = Clock::now();
+    if (fd < 0) {
+      fd = connectTo(options.httpPort, SOCK_STREAM);
+    }
+    bool closed = true;
+    int status = fd >= 0 ? httpExchange(fd, requests[i % 3], &closed) : -1;
+    run.latencyUs.push_back(
+        (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - sent).count());
+    if (status != 200) run.errors++;
+    if (fd >= 0 && closed) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  run.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  if (fd >= 0) {
+    close(fd);
+  }
+  return run;
+}
+
+// --- 5. MAIN ---
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [--host H] [--port P] [--timeout-ms MS] [--retries N]\n"
+          "          charge MS [TARGET_MV] | stop | state\n"
+          "          bench [--commands N] [--charge-ms MS] [--http-port P]\n",
+          program);
+}
+
+int main(int argc, char** argv) {
+  int i = 1;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; i += 2) {
+    const char* flag = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      usage(argv[0]);
+      return 2;
+    }
+    if (strcmp(flag, "--host") == 0) options.host = value;
+    else if (strcmp(flag, "--port") == 0) options.port = value;
+    else if (strcmp(flag, "--timeout-ms") == 0) options.timeoutMs = atoi(value);
+    else if (strcmp(flag, "--retries") == 0) options.retries = atoi(value);
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (i >= argc) {
+    usage(argv[0]);
+    return 2;
+  }
+  const char* verb = argv[i++];
+
+  int fd = connectTo(options.port, SOCK_DGRAM);
+  if (fd < 0) {
+    fprintf(stderr, "udp_client: cannot resolve %s:%s\n", options.host.c_str(), options.port.c_str());
+    return 1;
+  }
+  // Sequence numbers start where the last run's probably did not.
+  nextSequence = (uint32_t)std::chrono::system_clock::now().time_since_epoch().count();
+
+  UdpFrame reply;
+  bool ok;
+  if (strcmp(verb, "charge") == 0 && i < argc) {
+    uint32_t durationMs = (uint32_t)strtoul(argv[i], nullptr, 10);
+    uint32_t targetMv = i + 1 < argc ? (uint32_t)strtoul(argv[i + 1], nullptr, 10) : 0;
+    ok = command(fd, UDP_OP_CHARGE, durationMs, targetMv, reply);
+  } else if (strcmp(verb, "stop") == 0) {
+    ok = command(fd, UDP_OP_STOP, 0, 0, reply);
+  } else if (strcmp(verb, "state") == 0) {
+    ok = command(fd, UDP_OP_STATE, 0, 0, reply);
+  } else if (strcmp(verb, "bench") == 0) {
+    for (; i + 1 < argc; i += 2) {
+      if (strcmp(argv[i], "--commands") == 0) options.commands = atol(argv[i + 1]);
+      else if (strcmp(argv[i], "--charge-ms") == 0) options.chargeMs = atol(argv[i + 1]);
+      else if (strcmp(argv[i], "--http-port") == 0) options.httpPort = argv[i + 1];
+      else break;
+    }
+    if (i < argc || options.commands <= 0) {
+      usage(argv[0]);
+      return 2;
+    }
+    // Each run starts idle, whichever command the previous one ended on.
+    std::string json = "{\"commands\":" + std::to_string(options.commands);
+    command(fd, UDP_OP_STOP, 0, 0, reply);
+    Run udp = benchUdp(fd);
+    appendRun(json, "udp", udp);
+    json += ", \"udp_retries\":" + std::to_string(retriesSent);
+    if (!options.httpPort.empty()) {
+      command(fd, UDP_OP_STOP, 0, 0, reply);
+      Run keepAlive = benchHttp(true);
+      appendRun(json, "http_keep_alive", keepAlive);
+      command(fd, UDP_OP_STOP, 0, 0, reply);
+      Run oneShot = benchHttp(false);
+      appendRun(json, "http", oneShot);
+      command(fd, UDP_OP_STOP, 0, 0, reply);
+    }
+    printf("%s}\n", json.c_str());
+    close(fd);
+    return 0;
+  } else {
+    usage(argv[0]);
+    return 2;
+  }
+  close(fd);
+
+  if (!ok) {
+    fprintf(stderr, "udp_client: no reply from %s:%s\n", options.host.c_str(), options.port.c_str());
+    return 1;
+  }
+  printReply(reply);
+  return reply.status == UDP_STATUS_OK ? 0 : 3;
+}
@@ -0,0 +1,207 @@
+#include "power_policy.h"
+
+#include <Preferences.h>
+#include "esp_pm.h"
+#include "esp_wifi.h"
+#include "esp_timer.h"
+
+// --- 1. CONFIGURATION ---
+
+static const int CPU_MAX_FREQ_MHZ = 240;
+static const int CPU_MIN_FREQ_MHZ = 80;  // Lowest clock that keeps Wi-Fi and APB timers stable
+
+// How long loop() yields per iteration when idle (ms). Longer yields give the
+// idle task more chances to enter light sleep, at the cost of request latency.
+static const uint32_t MODEM_SLEEP_POLL_MS = 1;
+static const uint32_t LIGHT_SLEEP_POLL_MS = 20;
+
+// A DTIM1 beacon interval (100 TU). Power-save stations only see buffered
+// unicast frames at the next DTIM beacon, so this bounds the radio's added latency.
+static const uint32_t DTIM_INTERVAL_MS = 103;
+
+static const char* NVS_NAMESPACE = "power";
+static const char* NVS_KEY_MODE = "mode";
+
+// --- 2. STATE ---
+
+static PowerMode currentMode = POWER_PERFORMANCE;
+static bool modeSupported[POWER_MODE_COUNT] = {true, true, false};
+static PowerModeStats modeStats[POWER_MODE_COUNT];
+
+static esp_pm_lock_handle_t cpuLock = nullptr;
+static esp_pm_lock_handle_t noSleepLock = nullptr;
+static bool chargeActive = false;
+
+static int64_t lastIdleUs = 0;
+static uint64_t gapSumUs[POWER_MODE_COUNT];
+static unsigned long modeSinceMs = 0;
+
+static Preferences prefs;
+
+/**
+ * @brief Configures DFS and light sleep. Returns the esp_pm_configure() result,
+ * which is ESP_ERR_NOT_SUPPORTED when the SDK was built without CONFIG_PM_ENABLE
+ * (or without tickless idle, for light sleep).
+ */
+static esp_err_t configurePm(int minFreqMhz, bool lightSleep) {
+  esp_pm_config_esp32_t config = {};
+  config.max_freq_mhz = CPU_MAX_FREQ_MHZ;
+  config.min_freq_mhz = minFreqMhz;
+  config.light_sleep_enable = lightSleep;
+  return esp_pm_configure(&config);
+}
+
+static void applyMode(PowerMode mode) {
+  switch (mode) {
+    case POWER_PERFORMANCE:
+      configurePm(CPU_MAX_FREQ_MHZ, false);
+      esp_wifi_set_ps(WIFI_PS_NONE);
+      break;
+    case POWER_MODEM_SLEEP:
+      // DFS is best effort: without PM support the CPU simply stays at full clock.
+      configurePm(CPU_MIN_FREQ_MHZ, false);
+      esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+      break;
+    case POWER_LIGHT_SLEEP:
+      configurePm(CPU_MIN_FREQ_MHZ, true);
+      esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+      break;
+    default:
+      break;
+  }
+}
+
+static void accountResidency() {
+  unsigned long now = millis();
+  modeStats[currentMode].residencyMs += now - modeSinceMs;
+  modeSinceMs = now;
+}
+
+// --- 3. PUBLIC API ---
+
+void powerBegin(PowerMode defaultMode) {
+  // Probe what this SDK build supports. Light sleep needs both CONFIG_PM_ENABLE
+  // and CONFIG_FREERTOS_USE_TICKLESS_IDLE.
+  modeSupported[POWER_LIGHT_SLEEP] = configurePm(CPU_MIN_FREQ_MHZ, true) == ESP_OK;
+
+  if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "charge_cpu", &cpuLock) != ESP_OK) {
+    cpuLock = nullptr;
+  }
+  if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "charge_nosleep", &noSleepLock) != ESP_OK) {
+    noSleepLock = nullptr;
+  }
+
+  prefs.begin(NVS_NAMESPACE, false);
+  PowerMode mode = (PowerMode)prefs.getUChar(NVS_KEY_MODE, (uint8_t)defaultMode);
+  if (mode >= POWER_MODE_COUNT || !modeSupported[mode]) {
+    mode = defaultMode < POWER_MODE_COUNT && modeSupported[defaultMode] ? defaultMode : POWER_PERFORMANCE;
+  }
+
+  currentMode = mode;
+  modeSinceMs = millis();
+  applyMode(currentMode);
+  Serial.printf("[power] Idle mode '%s' (light sleep %s in this build).\n",
+                powerModeName(currentMode), modeSupported[POWER_LIGHT_SLEEP] ? "available" : "not available");
+}
+
+bool powerSetMode(PowerMode mode) {
+  if (mode >= POWER_MODE_COUNT || !modeSupported[mode]) {
+    return false;
+  }
+  accountResidency();
+  currentMode = mode;
+  applyMode(currentMode);
+  prefs.putUChar(NVS_KEY_MODE, (uint8_t)mode);
+  lastIdleUs = 0;
+  Serial.printf("[power] Idle mode set to '%s'.\n", powerModeName(mode));
+  return true;
+}
+
+void powerSetChargeActive(bool active) {
+  if (active == chargeActive) {
+    return;
+  }
+  chargeActive = active;
+  if (active) {
+    if (cpuLock) esp_pm_lock_acquire(cpuLock);
+    if (noSleepLock) esp_pm_lock_acquire(noSleepLock);
+  } else {
+    if (noSleepLock) esp_pm_lock_release(noSleepLock);
+    if (cpuLock) esp_pm_lock_release(cpuLock);
+  }
+}
+
+void powerIdle() {
+  int64_t now = esp_timer_get_time();
+  if (lastIdleUs != 0) {
+    uint32_t gap = (uint32_t)(now - lastIdleUs);
+    PowerModeStats& stats = modeStats[currentMode];
+    stats.samples++;
+    gapSumUs[currentMode] += gap;
+    stats.avgGapUs = (uint32_t)(gapSumUs[currentMode] / stats.samples);
+    if (gap > stats.maxGapUs) stats.maxGapUs = gap;
+  }
+
+  // Never yield while charging: the loop must keep polling chargeMonitor().
+  if (!chargeActive) {
+    if (currentMode == POWER_MODEM_SLEEP) {
+      delay(MODEM_SLEEP_POLL_MS);
+    } else if (currentMode == POWER_LIGHT_SLEEP) {
+      delay(LIGHT_SLEEP_POLL_MS);
+    }
+  }
+  lastIdleUs = esp_timer_get_time();
+}
+
+PowerMode powerMode() {
+  return currentMode;
+}
+
+const char* powerModeName(PowerMode mode) {
+  switch (mode) {
+    case POWER_PERFORMANCE: return "performance";
+    case POWER_MODEM_SLEEP: return "modem_sleep";
+    case POWER_LIGHT_SLEEP: return "light_sleep";
+    default: return "unknown";
+  }
+}
+
+bool powerModeFromName(const char* name, PowerMode* mode) {
+  for (int i = 0; i < POWER_MODE_COUNT; i++) {
+    if (strcmp(name, powerModeName((PowerMode)i)) == 0) {
+      *mode = (PowerMode)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool powerModeSupported(PowerMode mode) {
+  return mode < POWER_MODE_COUNT && modeSupported[mode];
+}
+
+PowerModeStats powerModeStats(PowerMode mode) {
+  // The current mode's residency runs on until the next switch; add it to the copy.
+  PowerModeStats stats = modeStats[mode];
+  if (mode == currentMode) {
+    stats.residencyMs += millis() - modeSinceMs;
+  }
+  return stats;
+}
+
+float powerNominalIdleCurrentMa(PowerMode mode) {
+  switch (mode) {
+    case POWER_PERFORMANCE: return 100.0f;  // 240 MHz, radio listening continuously
+    case POWER_MODEM_SLEEP: return 25.0f;   // DFS + DTIM1 modem sleep
+    case POWER_LIGHT_SLEEP: return 3.0f;    // Automatic light sleep between DTIM1 beacons
+    default: return 0.0f;
+  }
+}
+
+uint32_t powerExpectedAddedLatencyMs(PowerMode mode) {
+  switch (mode) {
+    case POWER_MODEM_SLEEP: return MODEM_SLEEP_POLL_MS + DTIM_INTERVAL_MS;
+    case POWER_LIGHT_SLEEP: return LIGHT_SLEEP_POLL_MS + DTIM_INTERVAL_MS;
+    default: return 0;
+  }
+}
@@ -0,0 +1,362 @@
+#include "sleep_schedule.h"
+
+#include <HTTPClient.h>
+#include <sys/time.h>
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+
+#include "core/charge_control.h"
+
+// --- 1. CONFIGURATION ---
+
+static const uint32_t RTC_MAGIC = 0x5C400E01;
+
+// How long the device stays awake on Wi-Fi after an upload, so the API can be
+// used (e.g. to stop the experiment) before it goes back to sleep.
+static const unsigned long AWAKE_WINDOW_MS = 20000;
+
+// Give up on the Wi-Fi session after this long and sleep again; the results
+// stay buffered for the next attempt.
+static const unsigned long WIFI_WAIT_MS = 30000;
+
+// Delay between starting an experiment and the first sleep, so the HTTP
+// response still reaches the client.
+static const unsigned long START_GRACE_MS = 1000;
+
+// ADC samples averaged per measurement.
+static const int SENSE_OVERSAMPLING = 16;
+
+// --- 2. RTC STATE ---
+
+// Everything in here survives deep sleep (but not a power cycle).
+struct RtcSchedule {
+  uint32_t magic;
+  bool active;
+  ScheduleDefinition definition;
+  int64_t startUs;      // Experiment start on the RTC-backed system clock
+  uint32_t nextEvent;
+  uint16_t head;        // Oldest buffered result
+  uint16_t count;
+  uint32_t uploaded;
+  uint32_t dropped;
+  uint32_t wakeups;
+  ScheduleResult results[SCHEDULE_RESULT_CAPACITY];
+};
+
+RTC_DATA_ATTR static RtcSchedule rtc;
+
+static int chargePin = -1;
+static const char* uploadUrl = "";
+
+static bool uploadPending = false;
+static unsigned long sleepAtMs = 0;
+static bool sleepArmed = false;
+
+/**
+ * @brief Microseconds on the system clock. Unlike millis() this keeps counting
+ * through deep sleep, because it is backed by the RTC timer.
+ */
+static int64_t rtcNowUs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static uint32_t eventsPerCycle() {
+  return 1 + rtc.definition.measures;
+}
+
+static uint32_t totalEvents() {
+  return eventsPerCycle() * rtc.definition.cycles;
+}
+
+/**
+ * @brief Scheduled time of an event. Event 0 of each cycle is the charge,
+ * events 1..measures are the measurements that follow it, one interval apart.
+ * The next cycle's charge follows the last measurement by one interval too,
+ * so a cycle lasts (measures + 1) intervals.
+ */
+static int64_t eventTimeUs(uint32_t event) {
+  uint32_t cycle = event / eventsPerCycle();
+  uint32_t step = event % eventsPerCycle();
+  int64_t intervalUs = (int64_t)rtc.definition.intervalS * 1000000LL;
+  return rtc.startUs + (int64_t)cycle * eventsPerCycle() * intervalUs + (int64_t)step * intervalUs;
+}
+
+// --- 3. EVENTS ---
+
+/**
+ * @brief Averaged capacitor voltage, read through the charge module so the
+ * sense divider is applied as for /charge?target_mv=.
+ */
+static uint16_t readSenseMv() {
+  uint32_t sum = 0;
+  for (int i = 0; i < SENSE_OVERSAMPLING; i++) {
+    sum += chargeReadSenseMv();
+  }
+  return (uint16_t)(sum / SENSE_OVERSAMPLING);
+}
+
+static void pushResult(const ScheduleResult& result) {
+  if (rtc.count == SCHEDULE_RESULT_CAPACITY) {
+    // Full: overwrite the oldest result.
+    rtc.head = (rtc.head + 1) % SCHEDULE_RESULT_CAPACITY;
+    rtc.count--;
+    rtc.dropped++;
+  }
+  rtc.results[(rtc.head + rtc.count) % SCHEDULE_RESULT_CAPACITY] = result;
+  rtc.count++;
+}
+
+static void runEvent(uint32_t event) {
+  ScheduleResult result = {};
+  result.offsetS = (uint32_t)((rtcNowUs() - rtc.startUs) / 1000000LL);
+  result.cycle = event / eventsPerCycle();
+  result.isCharge = event % eventsPerCycle() == 0;
+
+  if (result.isCharge) {
+    // Nothing else runs during a scheduled wake-up, so a blocking pulse is fine.
+    digitalWrite(chargePin, HIGH);
+    delay(rtc.definition.chargeMs);
+    digitalWrite(chargePin, LOW);
+  }
+  result.millivolts = readSenseMv();
+  pushResult(result);
+
+  Serial.printf("[schedule] Event %u/%u: %s, %u mV.\n", (unsigned)event + 1, (unsigned)totalEvents(),
+                result.isCharge ? "charge" : "measure", (unsigned)result.millivolts);
+}
+
+/**
+ * @brief Runs every event that is due. Finishes the experiment after the last one.
+ */
+static void runDueEvents() {
+  while (rtc.active && rtc.nextEvent < totalEvents() && eventTimeUs(rtc.nextEvent) <= rtcNowUs()) {
+    runEvent(rtc.nextEvent);
+    rtc.nextEvent++;
+  }
+  if (rtc.active && rtc.nextEvent >= totalEvents()) {
+    rtc.active = false;
+    uploadPending = true;
+    Serial.println("[schedule] Experiment finished.");
+  }
+}
+
+/**
+ * @brief Holds CHARGE_PIN LOW through deep sleep and sleeps until the next event.
+ */
+static void sleepUntilNextEvent() {
+  runDueEvents();
+  if (!rtc.active) {
+    return;
+  }
+
+  int64_t waitUs = eventTimeUs(rtc.nextEvent) - rtcNowUs();
+  if (waitUs < 1000) waitUs = 1000;
+
+  // Latch the pad so the relay cannot see a floating pin while the digital
+  // domain is powered down.
+  digitalWrite(chargePin, LOW);
+  gpio_hold_en((gpio_num_t)chargePin);
+  gpio_deep_sleep_hold_en();
+
+  Serial.printf("[schedule] Sleeping %lu s until event %u.\n",
+                (unsigned long)(waitUs / 1000000LL), (unsigned)rtc.nextEvent + 1);
+  Serial.flush();
+  esp_sleep_enable_timer_wakeup((uint64_t)waitUs);
+  esp_deep_sleep_start();
+}
+
+/**
+ * @brief POSTs all buffered results to the collector. Clears them on a 2xx reply.
+ */
+static bool uploadResults() {
+  if (rtc.count == 0) {
+    return true;
+  }
+  if (uploadUrl[0] == '\0') {
+    // No collector configured: keep the results for GET /schedule/results.
+    return true;
+  }
+
+  std::string body = "{\"device\":\"ESP32\", \"uploaded\":" + std::to_string(rtc.uploaded) + ", \"dropped\":" + std::to_string(rtc.dropped) + ", \"results\":";
+  scheduleResultsJson(body);
+  body += "}";
+
+  HTTPClient http;
+  http.begin(uploadUrl);
+  http.addHeader("Content-Type", "application/json");
+  int code = http.POST((uint8_t*)body.data(), body.size());
+  http.end();
+
+  if (code < 200 || code >= 300) {
+    Serial.printf("[schedule] Upload of %u results failed (%d).\n", (unsigned)rtc.count, code);
+    return false;
+  }
+  Serial.printf("[schedule] Uploaded %u results.\n", (unsigned)rtc.count);
+  rtc.uploaded += rtc.count;
+  rtc.head = 0;
+  rtc.count = 0;
+  return true;
+}
+
+// --- 4. PUBLIC API ---
+
+void scheduleBegin(int chargePinNumber, const char* collectorUrl) {
+  chargePin = chargePinNumber;
+  uploadUrl = collectorUrl;
+
+  if (rtc.magic != RTC_MAGIC) {
+    memset(&rtc, 0, sizeof(rtc));
+    rtc.magic = RTC_MAGIC;
+  }
+
+  // The pad may still be latched from the previous sleep. Drive the same level
+  // before releasing the hold so the pin does not glitch.
+  pinMode(chargePin, OUTPUT);
+  digitalWrite(chargePin, LOW);
+  gpio_hold_dis((gpio_num_t)chargePin);
+  gpio_deep_sleep_hold_dis();
+}
+
+void scheduleHandleWake() {
+  if (!rtc.active) {
+    return;
+  }
+  rtc.wakeups++;
+
+  if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) {
+    // Reset or power-on during an experiment: stay up for one Wi-Fi session so
+    // results can be collected and the experiment stopped if needed.
+    uploadPending = true;
+    return;
+  }
+
+  runDueEvents();
+  // Without a collector there is nothing to upload to: the results wait in RTC
+  // memory for GET /schedule/results, and timer wake-ups stay off Wi-Fi.
+  if (uploadUrl[0] != '\0' && rtc.count >= rtc.definition.uploadEvery) {
+    uploadPending = true;
+  }
+  if (!uploadPending) {
+    sleepUntilNextEvent();
+  }
+  Serial.printf("[schedule] Wi-Fi session to upload %u results.\n", (unsigned)rtc.count);
+}
+
+// Text of the last range error returned by scheduleStart().
+static char rangeErrorText[80];
+
+/**
+ * @brief Formats "'name' must be between minimum and maximum unit." from the limits themselves.
+ */
+static const char* rangeError(const char* name, long minimum, long maximum, const char* unit = nullptr) {
+  snprintf(rangeErrorText, sizeof(rangeErrorText), "'%s' must be between %ld and %ld%s%s.", name, minimum, maximum,
+           unit ? " " : "", unit ? unit : "");
+  return rangeErrorText;
+}
+
+const char* scheduleStart(const ScheduleDefinition& definition) {
+  if (definition.chargeMs < (uint32_t)CHARGE_MIN_MS || definition.chargeMs > (uint32_t)CHARGE_MAX_MS) {
+    return rangeError("charge_ms", CHARGE_MIN_MS, CHARGE_MAX_MS, "ms");
+  }
+  if (definition.intervalS < 1 || definition.intervalS > SCHEDULE_MAX_INTERVAL_S) {
+    return rangeError("interval_s", 1, SCHEDULE_MAX_INTERVAL_S, "s");
+  }
+  if (definition.chargeMs >= definition.intervalS * 1000UL) {
+    return "'charge_ms' must be shorter than 'interval_s'.";
+  }
+  if (definition.measures < 1 || definition.measures > SCHEDULE_MAX_MEASURES) {
+    return rangeError("measures", 1, SCHEDULE_MAX_MEASURES);
+  }
+  if (definition.cycles < 1 || definition.cycles > SCHEDULE_MAX_CYCLES) {
+    return rangeError("cycles", 1, SCHEDULE_MAX_CYCLES);
+  }
+  if (definition.uploadEvery < 1 || definition.uploadEvery > SCHEDULE_RESULT_CAPACITY) {
+    return rangeError("upload_every", 1, SCHEDULE_RESULT_CAPACITY);
+  }
+
+  rtc.definition = definition;
+  rtc.startUs = rtcNowUs();
+  rtc.nextEvent = 0;
+  rtc.head = 0;
+  rtc.count = 0;
+  rtc.uploaded = 0;
+  rtc.dropped = 0;
+  rtc.wakeups = 0;
+  rtc.active = true;
+
+  uploadPending = false;
+  sleepArmed = true;
+  sleepAtMs = millis() + START_GRACE_MS;
+  Serial.printf("[schedule] Experiment started: %u cycles x (charge %u ms + %u measures every %u s).\n",
+                (unsigned)definition.cycles, (unsigned)definition.chargeMs,
+                (unsigned)definition.measures, (unsigned)definition.intervalS);
+  return nullptr;
+}
+
+void scheduleStop() {
+  rtc.active = false;
+  sleepArmed = false;
+  Serial.println("[schedule] Experiment stopped.");
+}
+
+void scheduleService(bool linkUp, bool busy) {
+  if (uploadPending) {
+    if (linkUp) {
+      uploadPending = false;
+      uploadResults();
+      sleepArmed = true;
+      sleepAtMs = millis() + AWAKE_WINDOW_MS;
+    } else if (millis() > WIFI_WAIT_MS) {
+      // No network this time; try again at the next upload point.
+      uploadPending = false;
+      sleepArmed = true;
+      sleepAtMs = millis();
+    }
+  }
+
+  if (sleepArmed && rtc.active && !busy && (long)(millis() - sleepAtMs) >= 0) {
+    sleepArmed = false;
+    sleepUntilNextEvent();
+  }
+}
+
+ScheduleStatus scheduleStatus() {
+  ScheduleStatus status = {};
+  status.active = rtc.active;
+  status.definition = rtc.definition;
+  status.nextEvent = rtc.nextEvent;
+  status.totalEvents = rtc.magic == RTC_MAGIC && rtc.definition.cycles > 0 ? totalEvents() : 0;
+  if (rtc.active) {
+    int64_t waitUs = eventTimeUs(rtc.nextEvent) - rtcNowUs();
+    status.nextEventInS = waitUs > 0 ? (uint32_t)(waitUs / 1000000LL) : 0;
+  }
+  status.buffered = rtc.count;
+  status.uploaded = rtc.uploaded;
+  status.dropped = rtc.dropped;
+  status.wakeups = rtc.wakeups;
+  return status;
+}
+
+// One body for the upload (heap) and the /schedule/results handler (request arena).
+template <typename String>
+static void appendResultsJson(String& out) {
+  out += "[";
+  for (uint16_t i = 0; i < rtc.count; i++) {
+    const ScheduleResult& r = rtc.results[(rtc.head + i) % SCHEDULE_RESULT_CAPACITY];
+    char record[96];
+    snprintf(record, sizeof(record), "%s{\"t_s\":%lu, \"cycle\":%u, \"event\":\"%s\", \"mv\":%u}", i > 0 ? ", " : "",
+             (unsigned long)r.offsetS, (unsigned)r.cycle, r.isCharge ? "charge" : "measure", (unsigned)r.millivolts);
+    out += record;
+  }
+  out += "]";
+}
+
+void scheduleResultsJson(std::string& out) {
+  appendResultsJson(out);
+}
+
+void scheduleResultsJson(ArenaString& out) {
+  appendResultsJson(out);
+}
@@ -0,0 +1,27 @@
+#include "stop_listener.h"
+
+#include "esp_task.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "core/emergency_stop.h"
+
+static int stopFd = -1;
+
+static void stopListenerTask(void*) {
+  while (true) {
+    if (!estopUdpReceive(stopFd)) {
+      // A socket error, e.g. while Wi-Fi reconnects: do not spin on it.
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+  }
+}
+
+bool stopListenerBegin(uint16_t port) {
+  stopFd = estopUdpOpen(port, true);
+  if (stopFd < 0) {
+    return false;
+  }
+  return xTaskCreate(stopListenerTask, "estop", STOP_LISTENER_STACK, nullptr, ESP_TASK_TCPIP_PRIO + 1, nullptr) ==
+         pdPASS;
+}
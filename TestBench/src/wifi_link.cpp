@@ -0,0 +1,401 @@
+#include "wifi_link.h"
+
+#include <WiFi.h>
+#include <Preferences.h>
+#include <sys/time.h>
+#include "esp_timer.h"
+#include "esp_netif.h"
+#include "esp_netif_net_stack.h"
+#include "lwip/dhcp.h"
+
+// --- 1. NVS CACHE ---
+
+// Bumped whenever the layout of CachedLink changes, so stale blobs are ignored.
+static const uint8_t CACHE_VERSION = 2;
+static const char* CACHE_NAMESPACE = "wifilink";
+static const char* CACHE_KEY = "link";
+
+// Reconnect backoff (ms). The delay doubles after every failed attempt.
+static const uint32_t BACKOFF_INITIAL_MS = 250;
+static const uint32_t BACKOFF_MAX_MS = 30000;
+
+// An attempt with no CONNECTED/GOT_IP event within this window counts as failed.
+static const unsigned long ATTEMPT_TIMEOUT_MS = 15000;
+
+// How long to wait for the disconnect event after dropping an attempt ourselves.
+static const unsigned long DISCONNECT_SETTLE_MS = 1000;
+
+// A cached lease is not reused when less than this is left before its renewal time.
+static const uint32_t LEASE_MARGIN_S = 60;
+
+struct CachedLink {
+  uint8_t version;
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t leaseObtainedS;  // System clock when the lease was granted, see clockSeconds()
+  uint32_t leaseSeconds;    // Lease time from the DHCP server, 0 if not a DHCP lease
+};
+
+static Preferences prefs;
+static CachedLink cache;
+static bool cacheValid = false;
+
+/**
+ * @brief Seconds on the system clock. It is backed by the RTC timer, so it keeps
+ * counting through deep sleep and software resets, and restarts at power-on.
+ */
+static uint32_t clockSeconds() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (uint32_t)tv.tv_sec;
+}
+
+/**
+ * @brief Lease time the DHCP server granted the station, 0 if there is none.
+ */
+static uint32_t dhcpLeaseSeconds() {
+  esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  struct netif* lwipNetif = netif ? (struct netif*)esp_netif_get_netif_impl(netif) : nullptr;
+  struct dhcp* dhcp = lwipNetif ? netif_dhcp_data(lwipNetif) : nullptr;
+  return dhcp ? dhcp->offered_t0_lease : 0;
+}
+
+/**
+ * @brief Clock time at which the cached lease is due for renewal (T1, half the
+ * lease time). A DHCP client would renew there; we go back to DHCP instead.
+ */
+static uint32_t leaseRenewAtS() {
+  return cache.leaseObtainedS + cache.leaseSeconds / 2;
+}
+
+/**
+ * @brief True if the cached lease can still be used without asking the server.
+ * A stamp later than the clock is from before a power cycle, so its age is unknown.
+ */
+static bool cachedLeaseUsable() {
+  uint32_t now = clockSeconds();
+  return cacheValid && cache.ip != 0 && cache.leaseSeconds != 0 &&
+         now >= cache.leaseObtainedS && now + LEASE_MARGIN_S < leaseRenewAtS();
+}
+
+static void loadCache() {
+  prefs.begin(CACHE_NAMESPACE, false);
+  size_t len = prefs.getBytes(CACHE_KEY, &cache, sizeof(cache));
+  cacheValid = len == sizeof(cache) && cache.version == CACHE_VERSION && cache.channel > 0;
+}
+
+/**
+ * @brief Stores the current session in NVS. Only writes when something changed,
+ * since every boot would otherwise wear the same flash sector. A session running
+ * on the cached lease keeps that lease's stamp; only a fresh DHCP lease restarts it.
+ */
+static void saveCache(bool onCachedLease) {
+  CachedLink current = {};
+  current.version = CACHE_VERSION;
+  memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+  current.channel = WiFi.channel();
+  current.ip = (uint32_t)WiFi.localIP();
+  current.gateway = (uint32_t)WiFi.gatewayIP();
+  current.subnet = (uint32_t)WiFi.subnetMask();
+  current.dns = (uint32_t)WiFi.dnsIP();
+  if (onCachedLease) {
+    current.leaseObtainedS = cache.leaseObtainedS;
+    current.leaseSeconds = cache.leaseSeconds;
+  } else {
+    current.leaseSeconds = dhcpLeaseSeconds();
+    current.leaseObtainedS = current.leaseSeconds != 0 ? clockSeconds() : 0;
+  }
+
+  if (cacheValid && memcmp(&current, &cache, sizeof(current)) == 0) {
+    return;
+  }
+  cache = current;
+  cacheValid = true;
+  prefs.putBytes(CACHE_KEY, &cache, sizeof(cache));
+  Serial.printf("[wifi] Cached BSSID %02X:%02X:%02X:%02X:%02X:%02X, channel %d.\n",
+                cache.bssid[0], cache.bssid[1], cache.bssid[2],
+                cache.bssid[3], cache.bssid[4], cache.bssid[5], (int)cache.channel);
+}
+
+static void clearCache() {
+  cacheValid = false;
+  prefs.remove(CACHE_KEY);
+}
+
+// --- 2. EVENT HANDLING ---
+
+static WifiLinkConfig linkConfig;
+static WifiLinkTimings timings;
+static WifiLinkStats stats;
+
+// Written by the Wi-Fi event task, consumed by wifiLinkService() in loop().
+static volatile bool pendingAssociated = false;
+static volatile bool pendingGotIp = false;
+static volatile bool pendingDisconnect = false;
+static volatile uint8_t lastDisconnectReason = 0;
+
+static WifiLinkState state = WIFI_LINK_CONNECTING;
+static unsigned long stateSinceMs = 0;
+static uint32_t nextBackoffMs = BACKOFF_INITIAL_MS;
+
+// Set while we wait for the disconnect we asked for; runs once it is reported.
+static void (*afterDisconnect)() = nullptr;
+static unsigned long disconnectRequestedMs = 0;
+
+/**
+ * @brief Runs in the Wi-Fi event task. Only records what happened; all logging,
+ * NVS access and reconnect decisions are made in wifiLinkService().
+ */
+static void onWifiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      if (timings.associatedUs == 0) timings.associatedUs = esp_timer_get_time();
+      pendingAssociated = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      if (timings.gotIpUs == 0) timings.gotIpUs = esp_timer_get_time();
+      pendingGotIp = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      lastDisconnectReason = info.wifi_sta_disconnected.reason;
+      pendingDisconnect = true;
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Applies the addressing mode: static IP, cached lease or DHCP. The cached
+ * lease is only taken while it is short of its renewal time.
+ */
+static void applyAddressing(bool allowCachedLease) {
+  if (linkConfig.useStaticIp) {
+    WiFi.config(linkConfig.localIp, linkConfig.gateway, linkConfig.subnet, linkConfig.dns);
+  } else if (allowCachedLease && linkConfig.reuseCachedLease && cachedLeaseUsable()) {
+    WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+    timings.usedCachedLease = true;
+  } else {
+    // An all-zero address switches the station back to DHCP.
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+    timings.usedCachedLease = false;
+  }
+}
+
+static void enterState(WifiLinkState next) {
+  state = next;
+  stateSinceMs = millis();
+}
+
+static void startAssociation(bool useCache) {
+  stats.attempts++;
+  stats.currentBackoffMs = 0;
+  enterState(WIFI_LINK_CONNECTING);
+
+  if (!useCache && timings.usedCachedLease) {
+    // Retries always ask the DHCP server; the cached lease is only a boot shortcut.
+    applyAddressing(false);
+  }
+
+  if (useCache && cacheValid) {
+    // Fast path: pinning BSSID and channel skips the full channel scan.
+    timings.usedCachedBssid = true;
+    WiFi.begin(linkConfig.ssid, linkConfig.password, cache.channel, cache.bssid);
+  } else {
+    timings.usedCachedBssid = false;
+    WiFi.begin(linkConfig.ssid, linkConfig.password);
+  }
+}
+
+/**
+ * @brief Schedules the next attempt. The first retry after losing an established
+ * link is quick; every further failure doubles the wait up to BACKOFF_MAX_MS.
+ * A little jitter keeps a room full of benches from retrying in lockstep.
+ */
+static void enterBackoff() {
+  uint32_t jitter = esp_random() % (nextBackoffMs / 4 + 1);
+  stats.currentBackoffMs = nextBackoffMs + jitter;
+  nextBackoffMs = nextBackoffMs >= BACKOFF_MAX_MS / 2 ? BACKOFF_MAX_MS : nextBackoffMs * 2;
+  enterState(WIFI_LINK_BACKOFF);
+  Serial.printf("[wifi] Next attempt in %u ms.\n", (unsigned)stats.currentBackoffMs);
+}
+
+static void onGotIp() {
+  enterState(WIFI_LINK_CONNECTED);
+  nextBackoffMs = BACKOFF_INITIAL_MS;
+  stats.currentBackoffMs = 0;
+  saveCache(timings.usedCachedLease);
+
+  if (stats.outageStartMs != 0) {
+    uint32_t downMs = millis() - stats.outageStartMs;
+    stats.outageStartMs = 0;
+    stats.lastReconnectMs = downMs;
+    if (downMs > stats.maxReconnectMs) stats.maxReconnectMs = downMs;
+    stats.totalDowntimeMs += downMs;
+    Serial.printf("[wifi] Reconnected after %u ms outage (outage #%u).\n",
+                  (unsigned)downMs, (unsigned)stats.outages);
+  } else {
+    Serial.printf("[wifi] Got IP after %lu ms (%lu ms since boot).\n",
+                  (unsigned long)((timings.gotIpUs - timings.beginUs) / 1000),
+                  (unsigned long)(timings.gotIpUs / 1000));
+  }
+  Serial.print("Access API at: http://");
+  Serial.print(WiFi.localIP());
+  Serial.println("/swagger");
+}
+
+/**
+ * @brief Drops the association and runs next() once the station reports the
+ * disconnect, or after DISCONNECT_SETTLE_MS if it never does. Starting the next
+ * attempt right away would let that event count as the new attempt failing.
+ */
+static void disconnectThen(void (*next)()) {
+  afterDisconnect = next;
+  disconnectRequestedMs = millis();
+  WiFi.disconnect();
+}
+
+static void onAttemptFailed() {
+  if (timings.usedCachedBssid || timings.usedCachedLease) {
+    // The cached AP or lease did not work out. Forget it and fall back to a
+    // full scan with DHCP right away instead of restarting the board.
+    Serial.println("[wifi] Cached link failed, falling back to full scan.");
+    clearCache();
+    applyAddressing(false);
+    startAssociation(false);
+    return;
+  }
+  enterBackoff();
+}
+
+static void renewLease() {
+  applyAddressing(false);
+  startAssociation(true);
+}
+
+// --- 3. PUBLIC API ---
+
+void wifiLinkBegin(const WifiLinkConfig& config) {
+  linkConfig = config;
+  timings = WifiLinkTimings();
+  stats = WifiLinkStats();
+  timings.beginUs = esp_timer_get_time();
+
+  loadCache();
+
+  // We persist our own cache and run our own reconnect policy; stop the SDK
+  // from rewriting its config on every begin() and from reconnecting behind our back.
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.onEvent(onWifiEvent);
+
+  applyAddressing(true);
+  startAssociation(true);
+
+  Serial.printf("[wifi] Connecting to '%s' (%s, %s) in the background.\n", linkConfig.ssid,
+                timings.usedCachedBssid ? "cached BSSID/channel" : "full scan",
+                linkConfig.useStaticIp ? "static IP" : (timings.usedCachedLease ? "cached lease" : "DHCP"));
+}
+
+/**
+ * @brief Advances the link state machine:
+ *
+ *   CONNECTING --GOT_IP--> CONNECTED --DISCONNECTED--> BACKOFF --delay--> CONNECTING
+ *   CONNECTING --DISCONNECTED/timeout--> BACKOFF (delay doubles)
+ *   CONNECTED on the cached lease --renewal time--> CONNECTING with DHCP
+ *
+ * On a timeout or lease renewal the station is disconnected first, and the
+ * next step waits for that disconnect event so it is not taken for a failure.
+ */
+void wifiLinkService() {
+  if (pendingAssociated) {
+    pendingAssociated = false;
+    if (stats.attempts == 1) {
+      Serial.printf("[wifi] Associated after %lu ms.\n",
+                    (unsigned long)((timings.associatedUs - timings.beginUs) / 1000));
+    }
+  }
+
+  if (pendingGotIp) {
+    pendingGotIp = false;
+    onGotIp();
+  }
+
+  if (pendingDisconnect) {
+    pendingDisconnect = false;
+    Serial.printf("[wifi] Disconnected (reason %u).\n", (unsigned)lastDisconnectReason);
+
+    if (afterDisconnect) {
+      // The disconnect we asked for; not a failure of the link.
+      void (*next)() = afterDisconnect;
+      afterDisconnect = nullptr;
+      next();
+    } else if (state == WIFI_LINK_CONNECTED) {
+      stats.outages++;
+      stats.outageStartMs = millis();
+      if (stats.outageStartMs == 0) stats.outageStartMs = 1;
+      // Retry the same AP quickly first; most drops are short.
+      nextBackoffMs = BACKOFF_INITIAL_MS;
+      enterBackoff();
+    } else if (state == WIFI_LINK_CONNECTING) {
+      onAttemptFailed();
+    }
+    // Disconnect events while already backing off are echoes of the last failure.
+  }
+
+  if (afterDisconnect) {
+    if (millis() - disconnectRequestedMs >= DISCONNECT_SETTLE_MS) {
+      void (*next)() = afterDisconnect;
+      afterDisconnect = nullptr;
+      next();
+    }
+    return;
+  }
+
+  if (state == WIFI_LINK_CONNECTED && timings.usedCachedLease && clockSeconds() >= leaseRenewAtS()) {
+    // The address is configured statically, so nothing renews it; the server may
+    // hand it to someone else once the lease runs out. Rejoin and ask for a new one.
+    Serial.println("[wifi] Cached lease is due for renewal, rejoining with DHCP.");
+    disconnectThen(renewLease);
+    return;
+  }
+
+  unsigned long inState = millis() - stateSinceMs;
+  if (state == WIFI_LINK_CONNECTING && inState >= ATTEMPT_TIMEOUT_MS) {
+    Serial.println("[wifi] Attempt timed out.");
+    disconnectThen(onAttemptFailed);
+  } else if (state == WIFI_LINK_BACKOFF && inState >= stats.currentBackoffMs) {
+    Serial.printf("[wifi] Reconnect attempt %u...\n", (unsigned)stats.attempts + 1);
+    startAssociation(false);
+  }
+}
+
+bool wifiLinkUp() {
+  return state == WIFI_LINK_CONNECTED;
+}
+
+WifiLinkState wifiLinkState() {
+  return state;
+}
+
+const char* wifiLinkStateName() {
+  switch (state) {
+    case WIFI_LINK_CONNECTING: return "connecting";
+    case WIFI_LINK_CONNECTED: return "connected";
+    case WIFI_LINK_BACKOFF: return "backoff";
+  }
+  return "unknown";
+}
+
+const WifiLinkTimings& wifiLinkTimings() {
+  return timings;
+}
+
+const WifiLinkStats& wifiLinkStats() {
+  return stats;
+}